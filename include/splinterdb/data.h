@@ -148,7 +148,8 @@ typedef void (*message_to_str_fn)(const data_config *cfg,
  *
  * The application needs to tell SplinterDB some things about keys and values:
  *
- *  1. The sorting order of keys - defined by the key_compare function
+ *  1. The sorting order of keys - defined by the key_compare function, or
+ *     by memcmp for fixed-width keys (see fixed_key_size)
  *  2. How to hash keys - defined by the key_hash function
  *  3. How to merge update messages - defined by the pair of merge_tuples* fns.
  *  4. How to convert between messages and values (encode and decode functions)
@@ -170,4 +171,11 @@ struct data_config {
    merge_tuple_final_fn merge_tuples_final;
    key_to_str_fn        key_to_string;
    message_to_str_fn    message_to_string;
+
+   /* If non-zero, every key is exactly fixed_key_size bytes and keys sort
+      by memcmp, as big-endian integers do. SplinterDB then compares keys
+      itself instead of calling key_compare, hashes 8- and 16-byte keys
+      itself instead of calling key_hash, and rejects keys of other sizes.
+      Must be the same every time a database is opened. */
+   uint64 fixed_key_size;
 };
@@ -70,10 +70,38 @@ typedef struct splinterdb_config {
    uint32 io_perms;
    uint64 io_async_queue_depth;
 
+   // Largest IO, in pages, used to write back runs of adjacent dirty pages.
+   // 0 means one extent; larger values let writes span several extents.
+   uint64 io_async_max_pages;
+
    // cache
    _Bool       cache_use_stats;
    const char *cache_logfile;
 
+   // Per-page-type cache shares, in percent of cache_size (0 = no limit).
+   // Trunk and filter pages are not evicted while at or below their minimum
+   // share; branch pages above their maximum share are evicted first.
+   // cache_pin_trunk_pages keeps all trunk pages resident.
+   uint64 cache_trunk_min_share;
+   uint64 cache_filter_min_share;
+   uint64 cache_branch_max_share;
+   _Bool  cache_pin_trunk_pages;
+
+   // Size of an optional DRAM tier holding evicted branch pages in compressed
+   // form, checked on a cache miss before reading from disk (0 = disabled).
+   uint64 cache_compressed_size;
+
+   // If set, a background thread writes back dirty pages ahead of the
+   // cache's clock hand, keeping this percentage of them clean (0 = disabled).
+   uint64 cache_cleaner_clean_share;
+
+   // Compress branch pages on disk with the built-in LZ codec. Each page is
+   // written as a shorter, block-aligned write at the start of its slot, and
+   // expanded when it is read into the cache. A hole is punched over the rest
+   // of the slot, which frees space only where it spans whole file system
+   // blocks, i.e. on file systems with blocks smaller than a page.
+   _Bool cache_branch_compression;
+
    // task system
    // Background threads configuration:
    //
@@ -92,15 +120,83 @@ typedef struct splinterdb_config {
    // btree
    uint64 btree_rough_count_height;
 
+   // Branch scans prefetch up to this many extents ahead once they are found
+   // to be sequential (0 = default), issuing at most btree_readahead_budget
+   // extents of readahead per iterator (0 = unlimited).
+   uint64 btree_readahead_max_extents;
+   uint64 btree_readahead_budget;
+
+   // Store the leading key bytes next to each btree entry offset so node
+   // searches mostly avoid dereferencing keys. Only valid when
+   // data_cfg->key_compare orders keys lexicographically by bytes, shorter
+   // keys first (as the default data config does).
+   _Bool btree_key_prefix_slots;
+
+   // Strip the key prefix shared by the entries of each full branch node
+   // when building branches, storing it once per node. Same key order
+   // requirement as btree_key_prefix_slots.
+   _Bool btree_prefix_compression;
+
+   // Insert into memtables with optimistic lock coupling: inserts read the
+   // btree index without locking it, validating what they read by page
+   // versions instead, and lock only the leaf they change. Lets insert
+   // throughput keep scaling with the number of inserting threads.
+   _Bool btree_optimistic_inserts;
+
    // filter
    uint64 filter_remainder_size;
    uint64 filter_index_size;
 
+   // Build the filters of trunk nodes at these heights (bit 0 is the leaves)
+   // as blocked Bloom filters of filter_bloom_bits_per_key bits per key
+   // (0 = default), which take one cache line to probe and need no sort to
+   // build, instead of quotient filters.
+   uint64 filter_bloom_heights;
+   uint64 filter_bloom_bits_per_key;
+
+   // Keep up to filter_cache_size bytes (0 = none) of the filters of trunk
+   // nodes at the heights in filter_cache_heights (0 = all but the leaves)
+   // decoded in memory, so probing them reads no cache pages.
+   uint64 filter_cache_size;
+   uint64 filter_cache_heights;
+
+   // Size the fingerprints of the quotient filters built at each trunk height
+   // by the false positives seen there and the I/O they waste, keeping about
+   // the memory filter_remainder_size gives all of them.
+   _Bool filter_adaptive_fingerprints;
+
    // log
    _Bool use_log;
 
+   // value log
+   // Values longer than value_log_threshold bytes are appended to a separate
+   // value log and the trunk only holds a reference to them, so compaction
+   // does not copy them (0 = disabled). Values may then be as long as an
+   // extent, less the key. splinterdb_update() is not supported with a value
+   // log, and a database must be opened with the value log enabled if and
+   // only if it was created with one.
+   //
+   // The oldest extent of the log is collected once the garbage in the log,
+   // estimated from the tuples compaction reclaims, exceeds
+   // value_log_gc_percent of it (0 = default).
+   uint64 value_log_threshold;
+   uint64 value_log_gc_percent;
+
    // splinter
    uint64 memtable_capacity;
+
+   // Hold memtables in a concurrent skiplist allocated from the heap, rather
+   // than in a btree on cache pages. Inserts avoid page locks and node
+   // defragmentation, and memtables no longer take up cache space; the
+   // skiplist is packed into a branch when the memtable is flushed.
+   _Bool memtable_skiplist;
+
+   // Keep a hash index over the keys of each memtable, so point lookups
+   // skip the memtables which don't hold the key and, with
+   // memtable_skiplist, find the key without searching. Each memtable's
+   // index takes up to memtable_capacity bytes of memory.
+   _Bool memtable_hash_index;
+
    uint64 fanout;
    uint64 max_branches_per_node;
    uint64 use_stats;
@@ -213,9 +309,39 @@ splinterdb_delete(const splinterdb *kvsb, slice key);
 
 // Insert a key and value.
 // Relies on data_config->encode_message
+// Returns EINVAL if the database has a value log.
 int
 splinterdb_update(const splinterdb *kvsb, slice key, slice delta);
 
+// Bulk load
+
+// A source of tuples for splinterdb_bulk_load.
+//
+// Each call stores the next key and value in *key and *value and returns
+// true, or returns false once the source is exhausted. Keys must be strictly
+// increasing. The memory they point to must stay valid until the next call.
+typedef _Bool (*splinterdb_bulk_load_next_fn)(void  *arg,   // IN
+                                              slice *key,   // OUT
+                                              slice *value  // OUT
+);
+
+// Insert the tuples of a sorted source, bypassing the memtable.
+//
+// The tuples are packed directly into branches of the trunk. Threads may
+// load disjoint key ranges in parallel.
+//
+// A load does not override writes to the same keys which are still in the
+// memtable, so keys should not be written while they are being loaded.
+//
+// Returns EINVAL if the keys are not in order or one is too long, or if the
+// database has a value log. On error, a prefix of the source may have been
+// loaded.
+int
+splinterdb_bulk_load(const splinterdb            *kvs,  // IN
+                     splinterdb_bulk_load_next_fn next, // IN
+                     void                        *arg   // IN
+);
+
 // Lookups
 
 // Size of opaque data required to hold a lookup result
@@ -281,6 +407,16 @@ splinterdb_lookup(const splinterdb         *kvs,   // IN
                   splinterdb_lookup_result *result // IN/OUT
 );
 
+// Returns false if key is certainly absent, true if it may be present
+//
+// Only the memtables and the routing filters on the way to key are checked,
+// so no branch page is read. A true answer may be a false positive; follow
+// it with splinterdb_lookup when the value or a definite answer is needed.
+_Bool
+splinterdb_may_contain(const splinterdb *kvs, // IN
+                       slice             key  // IN
+);
+
 
 /*
 Iterator API (range query)
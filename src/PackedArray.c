@@ -424,11 +424,30 @@ void PackedArray_pack(uint32* a, const uint32 offset, const uint32* in, uint32 c
   }
 }
 
-void PackedArray_unpack(const uint32* a, const uint32 offset, uint32* out, uint32 count, size_t bitsPerItem)
+void PackedArray_unpack(const uint32* a, uint32 offset, uint32* out, uint32 count, size_t bitsPerItem)
 {
   PACKEDARRAY_ASSERT(a != NULL);
   PACKEDARRAY_ASSERT(out != NULL);
 
+#ifdef __AVX2__
+  if (bitsPerItem <= PACKEDARRAY_AVX2_MAX_BITS)
+  {
+    // reads must stay within the cells holding the items
+    uint64_t endCell = ((uint64_t)(offset + count) * bitsPerItem + 31) / 32;
+
+    while (count >= 8 && ((uint64_t)offset * bitsPerItem) / 32 + 8 <= endCell)
+    {
+      _mm256_storeu_si256((__m256i*)out, PackedArray_get8_avx2(a, offset, bitsPerItem));
+      offset += 8;
+      out += 8;
+      count -= 8;
+    }
+
+    if (count == 0)
+      return;
+  }
+#endif
+
   switch (bitsPerItem)
   {
     case 1:   __PackedArray_unpack_1(a, offset, out, count); break;
@@ -5,6 +5,9 @@
 #define PACKEDARRAY_H
 
 #include "platform.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "poison.h"
 
 /*
@@ -57,4 +60,39 @@ PackedArray_set(uint32      *a,
 uint32
 PackedArray_get(const uint32 *a, const uint32 offset, size_t bitsPerItem);
 
+#ifdef __AVX2__
+// widest items PackedArray_get8_avx2 can extract
+#define PACKEDARRAY_AVX2_MAX_BITS 28
+
+/*
+ * Returns items [offset, offset + 8) in the 32-bit lanes of a vector.
+ *
+ * The 8 cells starting at the one holding item offset are loaded at once and
+ * each lane picks out the cell its item starts in, and the next one in case
+ * the item straddles them. The caller must ensure those 8 cells are in
+ * bounds.
+ */
+static inline __m256i
+PackedArray_get8_avx2(const uint32 *a, const uint32 offset, size_t bitsPerItem)
+{
+   uint64  startBit = (uint64)offset * bitsPerItem;
+   __m256i packed   = _mm256_loadu_si256((const __m256i *)(a + startBit / 32));
+   __m256i bit      = _mm256_add_epi32(
+      _mm256_set1_epi32(startBit % 32),
+      _mm256_mullo_epi32(_mm256_set1_epi32(bitsPerItem),
+                         _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+   __m256i cell     = _mm256_srli_epi32(bit, 5);
+   __m256i shift    = _mm256_and_si256(bit, _mm256_set1_epi32(31));
+   __m256i low      = _mm256_srlv_epi32(
+      _mm256_permutevar8x32_epi32(packed, cell), shift);
+   // a shift by 32 zeroes the lane when the item starts on a cell boundary
+   __m256i high = _mm256_sllv_epi32(
+      _mm256_permutevar8x32_epi32(
+         packed, _mm256_add_epi32(cell, _mm256_set1_epi32(1))),
+      _mm256_sub_epi32(_mm256_set1_epi32(32), shift));
+   return _mm256_and_si256(_mm256_or_si256(low, high),
+                           _mm256_set1_epi32((1U << bitsPerItem) - 1));
+}
+#endif
+
 #endif // #ifndef PACKEDARRAY_H
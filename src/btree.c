@@ -41,6 +41,18 @@
  * If dead space is:
  *  - below a threshold, we split the node.
  *  - above the threshold, then we defragment the node instead of splitting it.
+ *
+ * Packed branch nodes may be prefix-compressed: when btree_pack fills a
+ * node, it moves the key bytes shared by all its entries (and by the key
+ * it is trying to add) to the end of the page, and rebuilds the entries
+ * with only their key suffixes:
+ *
+ *   -----------------------------------------------------------------
+ *   | header | offsets table ---> | empty space | <--- entries|prefix|
+ *   -----------------------------------------------------------------
+ *
+ * hdr->prefix_length is then non-zero. Searches strip the prefix from the
+ * target once and compare suffixes, and iterators reassemble full keys.
  * *****************************************************************
  */
 
@@ -91,6 +103,9 @@
  */
 #define BTREE_DEFRAGMENT_THRESHOLD(page_size) ((page_size) / 4)
 
+/* Default for btree_config.readahead_max_extents. */
+#define BTREE_DEFAULT_READAHEAD_EXTENTS (8)
+
 /*
  * Branches keep track of the number of keys and the total size of
  * all keys and messages in their subtrees.  But memtables do not
@@ -113,10 +128,10 @@ btree_height(const btree_hdr *hdr)
 }
 
 static inline table_entry
-btree_get_table_entry(btree_hdr *hdr, int i)
+btree_get_table_entry(const btree_config *cfg, btree_hdr *hdr, int i)
 {
    debug_assert(i < hdr->num_entries);
-   return hdr->offsets[i];
+   return btree_get_entry_offset(cfg, hdr, i);
 }
 
 static inline table_index
@@ -198,6 +213,130 @@ log_trace_leaf(const btree_config *cfg, const btree_hdr *hdr, char *msg)
 #endif /* BTREE_KEY_TRACING */
 
 
+/*
+ * Moves the last slot of the offset table to position k, shifting slots k
+ * and above up by one. Used to insert an entry that was appended.
+ */
+static inline void
+btree_rotate_table_slot(const btree_config *cfg, btree_hdr *hdr, uint64 k)
+{
+   uint64 slot_size = btree_table_entry_size(cfg);
+   uint64 last      = hdr->num_entries - 1;
+   char   last_slot[sizeof(btree_prefix_slot)];
+
+   memcpy(last_slot,
+          pointer_byte_offset(hdr->offsets, last * slot_size),
+          slot_size);
+   memmove(pointer_byte_offset(hdr->offsets, (k + 1) * slot_size),
+           pointer_byte_offset(hdr->offsets, k * slot_size),
+           (last - k) * slot_size);
+   memcpy(pointer_byte_offset(hdr->offsets, k * slot_size),
+          last_slot,
+          slot_size);
+}
+
+/*
+ * With key prefix slots, compares the prefix of entry k to target's.
+ * Returns 0 when they tie and the keys themselves must be compared.
+ */
+static inline int
+btree_prefix_compare(const btree_config *cfg,
+                     const btree_hdr    *hdr,
+                     int64               k,
+                     uint64              target_prefix)
+{
+   if (!cfg->key_prefix_slots) {
+      return 0;
+   }
+   uint64 prefix = btree_get_entry_prefix(hdr, k);
+   return (prefix > target_prefix) - (prefix < target_prefix);
+}
+
+
+/*
+ * Compares target to the key prefix of a prefix-compressed node. Returns a
+ * negative (positive) value if target is below (above) every key the node
+ * can hold. Otherwise, returns 0 and sets *suffix to the part of target
+ * that compares against the node's stored keys (all of target, if the node
+ * is not compressed).
+ */
+static inline int
+btree_strip_node_prefix(const btree_config *cfg,
+                        const btree_hdr    *hdr,
+                        key                 target,
+                        key                *suffix)
+{
+   if (hdr->prefix_length == 0) {
+      *suffix = target;
+      return 0;
+   }
+   if (key_is_negative_infinity(target)) {
+      return -1;
+   }
+   if (key_is_positive_infinity(target)) {
+      return 1;
+   }
+
+   slice  prefix = btree_node_key_prefix(cfg, hdr);
+   uint64 length = key_length(target);
+   int    cmp    = memcmp(key_data(target),
+                      slice_data(prefix),
+                      MIN(length, hdr->prefix_length));
+   if (cmp != 0) {
+      return cmp;
+   }
+   if (length < hdr->prefix_length) {
+      return -1;
+   }
+   *suffix = key_create(length - hdr->prefix_length,
+                        (const char *)key_data(target) + hdr->prefix_length);
+   return 0;
+}
+
+/*
+ * Compares the full key of an entry of hdr, whose stored key is stored_key,
+ * to other.
+ */
+static inline int
+btree_entry_key_compare(const btree_config *cfg,
+                        const btree_hdr    *hdr,
+                        key                 stored_key,
+                        key                 other)
+{
+   key suffix;
+   int cmp = btree_strip_node_prefix(cfg, hdr, other, &suffix);
+   if (cmp != 0) {
+      return -cmp;
+   }
+   return btree_key_compare(cfg, stored_key, suffix);
+}
+
+/*
+ * Returns the full key of an entry of hdr, whose stored key is stored_key.
+ * For prefix-compressed nodes, the key is assembled in buffer.
+ */
+static key
+btree_entry_full_key(const btree_config *cfg,
+                     const btree_hdr    *hdr,
+                     key                 stored_key,
+                     writable_buffer    *buffer)
+{
+   if (hdr->prefix_length == 0) {
+      return stored_key;
+   }
+   debug_assert(key_is_user_key(stored_key));
+
+   slice           prefix = btree_node_key_prefix(cfg, hdr);
+   uint64          length = hdr->prefix_length + key_length(stored_key);
+   platform_status rc     = writable_buffer_resize(buffer, length);
+   platform_assert_status_ok(rc);
+   char *data = writable_buffer_data(buffer);
+   memcpy(data, slice_data(prefix), hdr->prefix_length);
+   key_copy_contents(data + hdr->prefix_length, stored_key);
+   return key_create(length, data);
+}
+
+
 /**************************************
  * Basic get/set on index nodes
  **************************************/
@@ -234,7 +373,7 @@ btree_set_index_entry(const btree_config *cfg,
    if (k < hdr->num_entries) {
       index_entry *old_entry = btree_get_index_entry(cfg, hdr, k);
       if (hdr->next_entry == diff_ptr(hdr, old_entry)
-          && (diff_ptr(hdr, &hdr->offsets[new_num_entries])
+          && (btree_table_end(cfg, new_num_entries)
                  + index_entry_required_capacity(new_pivot_key)
               <= hdr->next_entry + sizeof_index_entry(old_entry)))
       {
@@ -253,12 +392,14 @@ btree_set_index_entry(const btree_config *cfg,
           */
          btree_fill_index_entry(
             cfg, hdr, old_entry, new_pivot_key, new_addr, stats);
+         btree_set_table_slot(
+            cfg, hdr, k, diff_ptr(hdr, old_entry), new_pivot_key);
          return TRUE;
       }
       /* Fall through */
    }
 
-   if (hdr->next_entry < diff_ptr(hdr, &hdr->offsets[new_num_entries])
+   if (hdr->next_entry < btree_table_end(cfg, new_num_entries)
                             + index_entry_required_capacity(new_pivot_key))
    {
       return FALSE;
@@ -268,7 +409,7 @@ btree_set_index_entry(const btree_config *cfg,
       hdr, hdr->next_entry - index_entry_required_capacity(new_pivot_key));
    btree_fill_index_entry(cfg, hdr, new_entry, new_pivot_key, new_addr, stats);
 
-   hdr->offsets[k]  = diff_ptr(hdr, new_entry);
+   btree_set_table_slot(cfg, hdr, k, diff_ptr(hdr, new_entry), new_pivot_key);
    hdr->num_entries = new_num_entries;
    hdr->next_entry  = diff_ptr(hdr, new_entry);
    return TRUE;
@@ -285,11 +426,7 @@ btree_insert_index_entry(const btree_config *cfg,
    bool32 succeeded = btree_set_index_entry(
       cfg, hdr, hdr->num_entries, new_pivot_key, new_addr, stats);
    if (succeeded) {
-      node_offset this_entry_offset = hdr->offsets[hdr->num_entries - 1];
-      memmove(&hdr->offsets[k + 1],
-              &hdr->offsets[k],
-              (hdr->num_entries - k - 1) * sizeof(hdr->offsets[0]));
-      hdr->offsets[k] = this_entry_offset;
+      btree_rotate_table_slot(cfg, hdr, k);
    }
    return succeeded;
 }
@@ -336,7 +473,7 @@ btree_can_set_leaf_entry(const btree_config *cfg,
 
    uint64 new_num_entries = k < hdr->num_entries ? hdr->num_entries : k + 1;
    if (hdr->next_entry
-       < diff_ptr(hdr, &hdr->offsets[new_num_entries])
+       < btree_table_end(cfg, new_num_entries)
             + leaf_entry_required_capacity(new_key, new_message))
    {
       return FALSE;
@@ -358,6 +495,7 @@ btree_set_leaf_entry(const btree_config *cfg,
           <= sizeof_leaf_entry(old_entry))
       {
          btree_fill_leaf_entry(cfg, hdr, old_entry, new_key, new_message);
+         btree_set_table_slot(cfg, hdr, k, diff_ptr(hdr, old_entry), new_key);
          return TRUE;
       }
       /* Fall through */
@@ -366,7 +504,7 @@ btree_set_leaf_entry(const btree_config *cfg,
    platform_assert(k <= hdr->num_entries);
    uint64 new_num_entries = k < hdr->num_entries ? hdr->num_entries : k + 1;
    if (hdr->next_entry
-       < diff_ptr(hdr, &hdr->offsets[new_num_entries])
+       < btree_table_end(cfg, new_num_entries)
             + leaf_entry_required_capacity(new_key, new_message))
    {
       return FALSE;
@@ -376,15 +514,15 @@ btree_set_leaf_entry(const btree_config *cfg,
       hdr,
       hdr->next_entry - leaf_entry_required_capacity(new_key, new_message));
    platform_assert(
-      (void *)&hdr->offsets[new_num_entries] <= (void *)new_entry,
-      "Offset addr 0x%p for index, new_num_entries=%lu is incorrect."
+      btree_table_end(cfg, new_num_entries) <= diff_ptr(hdr, new_entry),
+      "Offset %lu for index, new_num_entries=%lu is incorrect."
       " It should be <= new_entry=0x%p\n",
-      &hdr->offsets[new_num_entries],
+      btree_table_end(cfg, new_num_entries),
       new_num_entries,
       new_entry);
    btree_fill_leaf_entry(cfg, hdr, new_entry, new_key, new_message);
 
-   hdr->offsets[k]  = diff_ptr(hdr, new_entry);
+   btree_set_table_slot(cfg, hdr, k, diff_ptr(hdr, new_entry), new_key);
    hdr->num_entries = new_num_entries;
    hdr->next_entry  = diff_ptr(hdr, new_entry);
    platform_assert(0 < hdr->num_entries);
@@ -403,16 +541,97 @@ btree_insert_leaf_entry(const btree_config *cfg,
    bool32 succeeded =
       btree_set_leaf_entry(cfg, hdr, hdr->num_entries, new_key, new_message);
    if (succeeded) {
-      node_offset this_entry_offset = hdr->offsets[hdr->num_entries - 1];
       debug_assert(k + 1 <= hdr->num_entries);
-      memmove(&hdr->offsets[k + 1],
-              &hdr->offsets[k],
-              (hdr->num_entries - k - 1) * sizeof(hdr->offsets[0]));
-      hdr->offsets[k] = this_entry_offset;
+      btree_rotate_table_slot(cfg, hdr, k);
    }
    return succeeded;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * btree_find_fixed_width --
+ *
+ *      btree_find_pivot and btree_find_tuple for data_configs with 8- or
+ *      16-byte fixed-width keys, in nodes without key prefixes. The target
+ *      is loaded once, keys compare as big-endian words, and the search
+ *      does not stop early on a match, so its only branch is the loop's.
+ *      Returns the same idx and *found as the general searches.
+ *-----------------------------------------------------------------------------
+ */
+static inline bool32
+btree_use_fixed_width_search(const btree_config *cfg,
+                             const btree_hdr    *hdr,
+                             key                 target)
+{
+   uint64 fixed_key_size = cfg->data_cfg->fixed_key_size;
+   return data_fixed_key_is_word_sized(fixed_key_size)
+          && !cfg->key_prefix_slots && hdr->prefix_length == 0
+          && key_length(target) == fixed_key_size;
+}
+
+static inline int
+btree_fixed_width_compare(const btree_config *cfg,
+                          key                 entry_key,
+                          key                 target,
+                          uint64              target_high,
+                          uint64              target_low)
+{
+   uint64 fixed_key_size = cfg->data_cfg->fixed_key_size;
+   if (key_length(entry_key) != fixed_key_size) {
+      // infinite pivots
+      return btree_key_compare(cfg, entry_key, target);
+   }
+   const void *data = key_data(entry_key);
+   uint64      word = data_fixed_key_word(data, 0);
+   int         cmp  = (word > target_high) - (word < target_high);
+   if (fixed_key_size == 2 * sizeof(uint64)) {
+      word        = data_fixed_key_word(data, 1);
+      int low_cmp = (word > target_low) - (word < target_low);
+      cmp         = cmp != 0 ? cmp : low_cmp;
+   }
+   return cmp;
+}
+
+static inline int64
+btree_find_fixed_width(const btree_config *cfg,
+                       const btree_hdr    *hdr,
+                       key                 target,
+                       bool32              is_leaf,
+                       bool32             *found)
+{
+   uint64 num_entries = btree_num_entries(hdr);
+   *found             = FALSE;
+   if (num_entries == 0) {
+      return -1;
+   }
+
+   uint64 target_high = data_fixed_key_word(key_data(target), 0);
+   uint64 target_low  = 0;
+   if (key_length(target) == 2 * sizeof(uint64)) {
+      target_low = data_fixed_key_word(key_data(target), 1);
+   }
+
+   // the answer is in [base, base + n)
+   int64  base = 0;
+   uint64 n    = num_entries;
+   while (n > 1) {
+      uint64 half      = n / 2;
+      key    entry_key = is_leaf ? btree_get_tuple_key(cfg, hdr, base + half)
+                                 : btree_get_pivot(cfg, hdr, base + half);
+      int cmp = btree_fixed_width_compare(
+         cfg, entry_key, target, target_high, target_low);
+      base = cmp <= 0 ? base + half : base;
+      n -= half;
+   }
+
+   key entry_key = is_leaf ? btree_get_tuple_key(cfg, hdr, base)
+                           : btree_get_pivot(cfg, hdr, base);
+   int cmp =
+      btree_fixed_width_compare(cfg, entry_key, target, target_high, target_low);
+   *found = cmp == 0;
+   return cmp <= 0 ? base : base - 1;
+}
+
 /*
  *-----------------------------------------------------------------------------
  * btree_find_pivot --
@@ -473,9 +692,22 @@ btree_find_pivot(const btree_config *cfg,
 
    *found = FALSE;
 
+   if (btree_use_fixed_width_search(cfg, hdr, target)) {
+      return btree_find_fixed_width(cfg, hdr, target, FALSE, found);
+   }
+
+   int node_cmp = btree_strip_node_prefix(cfg, hdr, target, &target);
+   if (node_cmp != 0) {
+      return node_cmp < 0 ? -1 : hi - 1;
+   }
+   uint64 target_prefix = cfg->key_prefix_slots ? btree_key_prefix(target) : 0;
+
    while (lo < hi) {
       int64 mid = (lo + hi) / 2;
-      int cmp = btree_key_compare(cfg, btree_get_pivot(cfg, hdr, mid), target);
+      int   cmp = btree_prefix_compare(cfg, hdr, mid, target_prefix);
+      if (cmp == 0) {
+         cmp = btree_key_compare(cfg, btree_get_pivot(cfg, hdr, mid), target);
+      }
       if (cmp == 0) {
          *found = TRUE;
          return mid;
@@ -515,10 +747,23 @@ btree_find_tuple(const btree_config *cfg,
 
    *found = FALSE;
 
+   if (btree_use_fixed_width_search(cfg, hdr, target)) {
+      return btree_find_fixed_width(cfg, hdr, target, TRUE, found);
+   }
+
+   int node_cmp = btree_strip_node_prefix(cfg, hdr, target, &target);
+   if (node_cmp != 0) {
+      return node_cmp < 0 ? -1 : hi - 1;
+   }
+   uint64 target_prefix = cfg->key_prefix_slots ? btree_key_prefix(target) : 0;
+
    while (lo < hi) {
       int64 mid = (lo + hi) / 2;
-      int   cmp =
-         btree_key_compare(cfg, btree_get_tuple_key(cfg, hdr, mid), target);
+      int   cmp = btree_prefix_compare(cfg, hdr, mid, target_prefix);
+      if (cmp == 0) {
+         cmp =
+            btree_key_compare(cfg, btree_get_tuple_key(cfg, hdr, mid), target);
+      }
       if (cmp == 0) {
          *found = TRUE;
          return mid;
@@ -724,8 +969,8 @@ btree_truncate_leaf(const btree_config *cfg, // IN
    uint64 new_next_entry = btree_page_size(cfg);
 
    for (uint64 i = 0; i < target_entries; i++) {
-      if (hdr->offsets[i] < new_next_entry)
-         new_next_entry = hdr->offsets[i];
+      if (btree_get_entry_offset(cfg, hdr, i) < new_next_entry)
+         new_next_entry = btree_get_entry_offset(cfg, hdr, i);
    }
 
    hdr->num_entries = target_entries;
@@ -746,12 +991,14 @@ static leaf_splitting_plan initial_plan = {0, FALSE};
 
 
 static bool32
-most_of_entry_is_on_left_side(uint64 total_bytes,
-                              uint64 left_bytes,
-                              uint64 entry_size)
+most_of_entry_is_on_left_side(const btree_config *cfg,
+                              uint64              total_bytes,
+                              uint64              left_bytes,
+                              uint64              entry_size)
 {
-   return left_bytes + sizeof(table_entry) + entry_size
-          < (total_bytes + sizeof(table_entry) + entry_size) / 2;
+   uint64 slot_size = btree_table_entry_size(cfg);
+   return left_bytes + slot_size + entry_size
+          < (total_bytes + slot_size + entry_size) / 2;
 }
 
 /*
@@ -781,9 +1028,9 @@ plan_move_more_entries_to_left(const btree_config  *cfg,
    while (plan->split_idx < max_entries
           && (entry = btree_get_leaf_entry(cfg, hdr, plan->split_idx))
           && most_of_entry_is_on_left_side(
-             total_bytes, left_bytes, sizeof_leaf_entry(entry)))
+             cfg, total_bytes, left_bytes, sizeof_leaf_entry(entry)))
    {
-      left_bytes += sizeof(table_entry) + sizeof_leaf_entry(entry);
+      left_bytes += btree_table_entry_size(cfg) + sizeof_leaf_entry(entry);
       plan->split_idx++;
    }
    return left_bytes;
@@ -819,7 +1066,7 @@ btree_build_leaf_splitting_plan(const btree_config          *cfg, // IN
    }
    uint64 new_num_entries = num_entries;
    new_num_entries += spec->old_entry_state == ENTRY_STILL_EXISTS ? 0 : 1;
-   total_bytes += new_num_entries * sizeof(table_entry);
+   total_bytes += new_num_entries * btree_table_entry_size(cfg);
 
    /* Now figure out the number of entries to move, and figure out how
     * much free space will be created in the left_hdr by the split.
@@ -837,9 +1084,10 @@ btree_build_leaf_splitting_plan(const btree_config          *cfg, // IN
     * can't, then no subsequent entries can, either, so we're done.
     */
    if (plan.split_idx == spec->idx
-       && most_of_entry_is_on_left_side(total_bytes, left_bytes, entry_size))
+       && most_of_entry_is_on_left_side(
+          cfg, total_bytes, left_bytes, entry_size))
    {
-      left_bytes += sizeof(table_entry) + entry_size;
+      left_bytes += btree_table_entry_size(cfg) + entry_size;
       plan.insertion_goes_left = TRUE;
    } else {
       return plan;
@@ -945,7 +1193,7 @@ static inline bool32
 btree_index_is_full(const btree_config *cfg, // IN
                     const btree_hdr    *hdr)    // IN
 {
-   return hdr->next_entry < diff_ptr(hdr, &hdr->offsets[hdr->num_entries + 2])
+   return hdr->next_entry < btree_table_end(cfg, hdr->num_entries + 2)
                                + sizeof(index_entry)
                                + MAX_INLINE_KEY_SIZE(btree_page_size(cfg));
 }
@@ -1037,8 +1285,8 @@ btree_truncate_index(const btree_config *cfg, // IN
 {
    uint64 new_next_entry = btree_page_size(cfg);
    for (uint64 i = 0; i < target_entries; i++) {
-      if (hdr->offsets[i] < new_next_entry) {
-         new_next_entry = hdr->offsets[i];
+      if (btree_get_entry_offset(cfg, hdr, i) < new_next_entry) {
+         new_next_entry = btree_get_entry_offset(cfg, hdr, i);
       }
    }
 
@@ -1660,8 +1908,8 @@ accumulate_node_ranks(const btree_config *cfg,
    if (btree_height(hdr) == 0) {
       for (int i = from; i < to; i++) {
          leaf_entry *entry = btree_get_leaf_entry(cfg, hdr, i);
-         stats->key_bytes =
-            add_unknown(stats->key_bytes, leaf_entry_key_size(entry));
+         stats->key_bytes = add_unknown(
+            stats->key_bytes, hdr->prefix_length + leaf_entry_key_size(entry));
          stats->message_bytes =
             add_unknown(stats->message_bytes, leaf_entry_message_size(entry));
       }
@@ -1723,6 +1971,106 @@ btree_grow_root(cache              *cc,   // IN
    return 0;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * btree_try_insert_optimistic --
+ *
+ *      Inserts the tuple into the dynamic btree with optimistic lock coupling.
+ *      The index nodes are not locked: each is copied into scratch and the
+ *      copy is used only if the node's page version is unchanged after the
+ *      copy (see cache_get_pinned). Only the leaf is claimed and locked. It is
+ *      the leaf for the key if its parent is still unchanged once the leaf is
+ *      locked, because splitting the leaf would have locked the parent.
+ *
+ *      Returns FALSE, having changed nothing, if the insert has to change an
+ *      index node or to split or defragment the leaf. btree_insert then
+ *      inserts with lock coupling.
+ *-----------------------------------------------------------------------------
+ */
+static bool32
+btree_try_insert_optimistic(cache              *cc,         // IN
+                            const btree_config *cfg,        // IN
+                            platform_heap_id    heap_id,    // IN
+                            btree_scratch      *scratch,    // IN
+                            uint64              root_addr,  // IN
+                            key                 tuple_key,  // IN
+                            message             msg,        // IN
+                            uint64             *generation, // OUT
+                            bool32             *was_unique) // OUT
+{
+   btree_hdr *snapshot = (btree_hdr *)scratch->defragment_node.scratch_node;
+   uint64     wait     = 1;
+
+start_over:
+   if (wait != 1) {
+      platform_sleep_ns(wait);
+   }
+   wait = wait > 2048 ? wait : 2 * wait;
+
+   page_handle *parent         = NULL;
+   uint64       parent_version = 0;
+   uint64       child_addr     = root_addr;
+   do {
+      page_handle *page    = cache_get_pinned(cc, child_addr);
+      uint64       version = cache_page_version(page);
+      if (version & 1) {
+         goto start_over;
+      }
+      // page is the child of parent as of version
+      if (parent != NULL && !cache_page_validate(parent, parent_version)) {
+         goto start_over;
+      }
+      memcpy(snapshot, page->data, btree_page_size(cfg));
+      if (!cache_page_validate(page, version)) {
+         goto start_over;
+      }
+      if (btree_height(snapshot) == 0) {
+         // the root is a leaf
+         return FALSE;
+      }
+
+      bool32 found;
+      int64  child_idx = btree_find_pivot(cfg, snapshot, tuple_key, &found);
+      if (child_idx < 0) {
+         // the min key of the node needs to be lowered
+         return FALSE;
+      }
+      index_entry *entry = btree_get_index_entry(cfg, snapshot, child_idx);
+      child_addr         = index_entry_child_addr(entry);
+      parent             = page;
+      parent_version     = version;
+   } while (btree_height(snapshot) > 1);
+
+   btree_node leaf;
+   leaf.addr = child_addr;
+   btree_node_get(cc, cfg, &leaf, PAGE_TYPE_MEMTABLE);
+   if (!btree_node_claim(cc, cfg, &leaf)) {
+      btree_node_unget(cc, cfg, &leaf);
+      goto start_over;
+   }
+   btree_node_lock(cc, cfg, &leaf);
+   if (!cache_page_validate(parent, parent_version)) {
+      btree_node_full_unlock(cc, cfg, &leaf);
+      goto start_over;
+   }
+
+   leaf_incorporate_spec spec;
+   platform_status       rc = btree_create_leaf_incorporate_spec(
+      cfg, heap_id, leaf.hdr, tuple_key, msg, &spec);
+   if (!SUCCESS(rc)) {
+      btree_node_full_unlock(cc, cfg, &leaf);
+      return FALSE;
+   }
+   bool32 incorporated =
+      btree_try_perform_leaf_incorporate_spec(cfg, leaf.hdr, &spec, generation);
+   btree_node_full_unlock(cc, cfg, &leaf);
+   if (incorporated) {
+      *was_unique = spec.old_entry_state == ENTRY_DID_NOT_EXIST;
+   }
+   destroy_leaf_incorporate_spec(&spec);
+   return incorporated;
+}
+
 /*
  *-----------------------------------------------------------------------------
  * btree_insert --
@@ -1758,6 +2106,20 @@ btree_insert(cache              *cc,         // IN
       return STATUS_BAD_PARAM;
    }
 
+   if (cfg->optimistic_inserts
+       && btree_try_insert_optimistic(cc,
+                                      cfg,
+                                      heap_id,
+                                      scratch,
+                                      root_addr,
+                                      tuple_key,
+                                      msg,
+                                      generation,
+                                      was_unique))
+   {
+      return STATUS_OK;
+   }
+
    btree_node root_node;
    root_node.addr = root_addr;
 
@@ -2512,12 +2874,17 @@ btree_iterator_curr(iterator *base_itor, key *curr_key, message *data)
    cache_validate_page(itor->cc, itor->curr.page, itor->curr.addr);
    if (itor->curr.hdr->height == 0) {
       *curr_key = btree_get_tuple_key(itor->cfg, itor->curr.hdr, itor->idx);
-      *data     = btree_get_tuple_message(itor->cfg, itor->curr.hdr, itor->idx);
+      *curr_key = btree_entry_full_key(
+         itor->cfg, itor->curr.hdr, *curr_key, &itor->curr_key_buffer);
+      *data = btree_get_tuple_message(itor->cfg, itor->curr.hdr, itor->idx);
       log_trace_key(*curr_key, "btree_iterator_get_curr");
    } else {
       index_entry *entry =
          btree_get_index_entry(itor->cfg, itor->curr.hdr, itor->idx);
-      *curr_key = index_entry_key(entry);
+      *curr_key = btree_entry_full_key(itor->cfg,
+                                       itor->curr.hdr,
+                                       index_entry_key(entry),
+                                       &itor->curr_key_buffer);
       *data     = message_create(
          MESSAGE_TYPE_PIVOT_DATA,
          slice_create(sizeof(entry->pivot_data), &entry->pivot_data));
@@ -2595,6 +2962,128 @@ btree_iterator_find_end(btree_iterator *itor)
    btree_node_unget(itor->cc, itor->cfg, &end);
 }
 
+static inline bool32
+btree_iterator_readahead_allowed(btree_iterator *itor)
+{
+   uint64 budget = itor->cfg->readahead_budget_extents;
+   return budget == 0 || itor->ra_issued < budget;
+}
+
+static inline void
+btree_iterator_reset_readahead(btree_iterator *itor)
+{
+   itor->ra_window = 1;
+   itor->ra_ahead  = 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ * Adaptive readahead for iterators with do_prefetch set.
+ *
+ * The iterator keeps up to ra_window extents prefetched ahead of curr. The
+ * window starts at one extent, doubles each time the scan moves forward into
+ * a new extent (up to cfg->readahead_max_extents) and collapses back to one
+ * on a seek or a step backwards. The upcoming extents of a branch are found
+ * through the index entries of curr's parent, so nothing at or beyond
+ * max_key is read and short scans issue no more IO than they consume.
+ *
+ * Memtables and single-level trees fall back to prefetching
+ * next_extent_addr.
+ * ----------------------------------------------------------------------------
+ */
+static void
+btree_iterator_readahead(btree_iterator *itor)
+{
+   cache        *cc  = itor->cc;
+   btree_config *cfg = itor->cfg;
+   btree_node    parent;
+
+   if (!itor->do_prefetch
+       || btree_addrs_share_extent(cc, itor->curr.addr, itor->end_addr))
+   {
+      return;
+   }
+
+   DECLARE_AUTO_WRITABLE_BUFFER(first_key_buffer, PROCESS_PRIVATE_HEAP_ID);
+   key first_key = itor->height ? btree_get_pivot(cfg, itor->curr.hdr, 0)
+                                : btree_get_tuple_key(cfg, itor->curr.hdr, 0);
+   first_key =
+      btree_entry_full_key(cfg, itor->curr.hdr, first_key, &first_key_buffer);
+   if (itor->page_type == PAGE_TYPE_BRANCH) {
+      btree_lookup_node(cc,
+                        cfg,
+                        itor->root_addr,
+                        first_key,
+                        itor->height + 1,
+                        itor->page_type,
+                        &parent,
+                        NULL);
+      if (btree_height(parent.hdr) != itor->height + 1) {
+         btree_node_unget(cc, cfg, &parent);
+         parent.addr = 0;
+      }
+   } else {
+      parent.addr = 0;
+   }
+
+   if (parent.addr == 0) {
+      uint64 next_extent_addr = itor->curr.hdr->next_extent_addr;
+      if (itor->ra_ahead == 0 && next_extent_addr != 0
+          && btree_iterator_readahead_allowed(itor))
+      {
+         cache_prefetch(cc, next_extent_addr, itor->page_type);
+         itor->ra_ahead = 1;
+         itor->ra_issued++;
+      }
+      return;
+   }
+
+   /*
+    * Walk the children following curr, counting each new extent. The first
+    * ra_ahead of them have already been prefetched.
+    */
+   allocator_config *al_cfg = allocator_get_config(cache_get_allocator(cc));
+   bool32            found;
+
+   int64  idx         = btree_find_pivot(cfg, parent.hdr, first_key, &found);
+   uint64 last_addr   = itor->curr.addr;
+   uint64 num_extents = 0;
+   while (num_extents < itor->ra_window
+          && btree_iterator_readahead_allowed(itor))
+   {
+      if (++idx == btree_num_entries(parent.hdr)) {
+         uint64 next_addr = parent.hdr->next_addr;
+         if (next_addr == 0) {
+            break;
+         }
+         btree_node_unget(cc, cfg, &parent);
+         parent.addr = next_addr;
+         btree_node_get(cc, cfg, &parent, itor->page_type);
+         idx = 0;
+      }
+      key pivot = btree_get_pivot(cfg, parent.hdr, idx);
+      if (btree_entry_key_compare(cfg, parent.hdr, pivot, itor->max_key) >= 0)
+      {
+         break;
+      }
+      index_entry *entry      = btree_get_index_entry(cfg, parent.hdr, idx);
+      uint64       child_addr = index_entry_child_addr(entry);
+      if (btree_addrs_share_extent(cc, last_addr, child_addr)) {
+         continue;
+      }
+      last_addr = child_addr;
+      if (++num_extents <= itor->ra_ahead) {
+         continue;
+      }
+      cache_prefetch(cc,
+                     allocator_config_extent_base_addr(al_cfg, child_addr),
+                     itor->page_type);
+      itor->ra_ahead = num_extents;
+      itor->ra_issued++;
+   }
+   btree_node_unget(cc, cfg, &parent);
+}
+
 /*
  * ----------------------------------------------------------------------------
  * Move to the next leaf when we've reached the end of one leaf but
@@ -2647,16 +3136,16 @@ btree_iterator_next_leaf(btree_iterator *itor)
       btree_node_get(itor->cc, itor->cfg, &itor->curr, itor->page_type);
    }
 
-   // To prefetch:
-   // 1. we just moved from one extent to the next
-   // 2. this can't be the last extent
+   // Moving forward into the next extent means the scan is sequential, so
+   // consume one extent of readahead and widen the window
    if (itor->do_prefetch
-       && !btree_addrs_share_extent(cc, last_addr, itor->curr.addr)
-       && itor->curr.hdr->next_extent_addr != 0
-       && !btree_addrs_share_extent(cc, itor->curr.addr, itor->end_addr))
+       && !btree_addrs_share_extent(cc, last_addr, itor->curr.addr))
    {
-      // IO prefetch the next extent
-      cache_prefetch(cc, itor->curr.hdr->next_extent_addr, itor->page_type);
+      if (itor->ra_ahead > 0) {
+         itor->ra_ahead--;
+      }
+      itor->ra_window = MIN(2 * itor->ra_window, cfg->readahead_max_extents);
+      btree_iterator_readahead(itor);
    }
 }
 
@@ -2694,7 +3183,9 @@ btree_iterator_prev_leaf(btree_iterator *itor)
    /* Do a quick check whether this entire leaf is within the range. */
    key first_key = itor->height ? btree_get_pivot(cfg, itor->curr.hdr, 0)
                                 : btree_get_tuple_key(cfg, itor->curr.hdr, 0);
-   if (btree_key_compare(cfg, itor->min_key, first_key) < 0) {
+   if (btree_entry_key_compare(cfg, itor->curr.hdr, first_key, itor->min_key)
+       > 0)
+   {
       itor->curr_min_idx = -1;
    } else {
       bool32 found;
@@ -2710,6 +3201,9 @@ btree_iterator_prev_leaf(btree_iterator *itor)
       itor->curr_min_idx = 0;
    }
 
+   // readahead only runs forward, so stepping back collapses it
+   btree_iterator_reset_readahead(itor);
+
    // FIXME: To prefetch:
    // 1. we just moved from one extent to the next
    // 2. this can't be the last extent
@@ -2879,8 +3373,10 @@ btree_iterator_seek(iterator *base_itor, key seek_key, comparison seek_type)
          ? btree_get_pivot(itor->cfg, itor->curr.hdr, itor->end_idx - 1)
          : btree_get_tuple_key(itor->cfg, itor->curr.hdr, itor->end_idx - 1);
 
-   if (btree_key_compare(itor->cfg, seek_key, first_key) >= 0
-       && btree_key_compare(itor->cfg, seek_key, last_key) <= 0)
+   if (btree_entry_key_compare(itor->cfg, itor->curr.hdr, first_key, seek_key)
+          <= 0
+       && btree_entry_key_compare(itor->cfg, itor->curr.hdr, last_key, seek_key)
+             >= 0)
    {
       // seek_key is within our current leaf. So just directly search for it
       bool32 found;
@@ -2889,7 +3385,9 @@ btree_iterator_seek(iterator *base_itor, key seek_key, comparison seek_type)
       platform_assert(0 <= itor->idx);
    } else {
       // seek key is not within our current leaf. So find the correct leaf
+      btree_iterator_reset_readahead(itor);
       find_btree_node_and_get_idx_bounds(itor, seek_key, seek_type);
+      btree_iterator_readahead(itor);
    }
 
    return STATUS_OK;
@@ -2973,16 +3471,12 @@ btree_iterator_init(cache          *cc,
    itor->min_key     = min_key;
    itor->max_key     = max_key;
    itor->page_type   = page_type;
+   itor->ra_window   = 1;
    itor->super.ops   = &btree_iterator_ops;
+   writable_buffer_init(&itor->curr_key_buffer, PROCESS_PRIVATE_HEAP_ID);
 
    find_btree_node_and_get_idx_bounds(itor, start_key, start_type);
-
-   if (itor->do_prefetch && itor->curr.hdr->next_extent_addr != 0
-       && !btree_addrs_share_extent(cc, itor->curr.addr, itor->end_addr))
-   {
-      // IO prefetch the next extent
-      cache_prefetch(cc, itor->curr.hdr->next_extent_addr, itor->page_type);
-   }
+   btree_iterator_readahead(itor);
 
    debug_assert(!iterator_can_curr((iterator *)itor)
                 || itor->idx < btree_num_entries(itor->curr.hdr));
@@ -2993,6 +3487,7 @@ btree_iterator_deinit(btree_iterator *itor)
 {
    debug_assert(itor != NULL);
    btree_node_unget(itor->cc, itor->cfg, &itor->curr);
+   writable_buffer_deinit(&itor->curr_key_buffer);
 }
 
 /****************************
@@ -3050,8 +3545,174 @@ btree_pack_get_current_node_stats(btree_pack_req *req, uint64 height)
 static inline btree_node *
 btree_pack_create_next_node(btree_pack_req *req, uint64 height, key pivot);
 
+/*
+ * Called when next_key does not fit in the full node hdr. If prefix
+ * compression is enabled and the node's first key shares a prefix with
+ * next_key (and so, as keys are sorted, with every key in between), rebuilds
+ * the node with that prefix stripped from its keys, and returns the stored
+ * form of next_key in *stored_key.
+ */
+static bool32
+btree_pack_compress_node(btree_pack_req *req,
+                         btree_hdr      *hdr,
+                         key             next_key,
+                         key            *stored_key)
+{
+   btree_config *cfg = req->cfg;
+
+   if (!cfg->prefix_compression || hdr->prefix_length != 0
+       || btree_num_entries(hdr) == 0)
+   {
+      return FALSE;
+   }
+
+   key first_key = btree_height(hdr) ? btree_get_pivot(cfg, hdr, 0)
+                                     : btree_get_tuple_key(cfg, hdr, 0);
+   if (!key_is_user_key(first_key) || !key_is_user_key(next_key)) {
+      return FALSE;
+   }
+
+   const char *first_bytes   = key_data(first_key);
+   const char *next_bytes    = key_data(next_key);
+   uint64      max_length    = MIN(key_length(first_key), key_length(next_key));
+   uint64      prefix_length = 0;
+   while (prefix_length < max_length
+          && first_bytes[prefix_length] == next_bytes[prefix_length])
+   {
+      prefix_length++;
+   }
+   if (prefix_length == 0) {
+      return FALSE;
+   }
+
+   btree_hdr *new_hdr = (btree_hdr *)req->scratch_node;
+   btree_pack_node_init_hdr(cfg, new_hdr, hdr->next_extent_addr, hdr->height);
+   new_hdr->prev_addr     = hdr->prev_addr;
+   new_hdr->next_addr     = hdr->next_addr;
+   new_hdr->prefix_length = prefix_length;
+   new_hdr->next_entry -= prefix_length;
+   memcpy(pointer_byte_offset(new_hdr, new_hdr->next_entry),
+          first_bytes,
+          prefix_length);
+
+   for (uint64 i = 0; i < btree_num_entries(hdr); i++) {
+      bool32 success;
+      if (btree_height(hdr)) {
+         index_entry *entry = btree_get_index_entry(cfg, hdr, i);
+         key          pivot = index_entry_key(entry);
+         key          suffix =
+            key_create(key_length(pivot) - prefix_length,
+                       (const char *)key_data(pivot) + prefix_length);
+         success = btree_set_index_entry(cfg,
+                                         new_hdr,
+                                         i,
+                                         suffix,
+                                         index_entry_child_addr(entry),
+                                         entry->pivot_data.stats);
+      } else {
+         leaf_entry *entry     = btree_get_leaf_entry(cfg, hdr, i);
+         key         tuple_key = leaf_entry_key(entry);
+         key         suffix =
+            key_create(key_length(tuple_key) - prefix_length,
+                       (const char *)key_data(tuple_key) + prefix_length);
+         success = btree_set_leaf_entry(
+            cfg, new_hdr, i, suffix, leaf_entry_message(entry));
+      }
+      platform_assert(success);
+   }
+   memcpy(hdr, new_hdr, btree_page_size(cfg));
+
+   *stored_key = key_create(key_length(next_key) - prefix_length,
+                            next_bytes + prefix_length);
+   return TRUE;
+}
+
+/*
+ * Appends a tuple to the leaf being packed. Returns FALSE if the leaf is
+ * full, or if it is prefix-compressed and tuple_key lacks its prefix.
+ */
+static bool32
+btree_pack_append_leaf_entry(btree_pack_req *req,
+                             btree_hdr      *hdr,
+                             key             tuple_key,
+                             message         msg)
+{
+   btree_config *cfg = req->cfg;
+   key           stored_key;
+
+   if (btree_strip_node_prefix(cfg, hdr, tuple_key, &stored_key) != 0) {
+      return FALSE;
+   }
+   if (btree_set_leaf_entry(
+          cfg, hdr, btree_num_entries(hdr), stored_key, msg))
+   {
+      return TRUE;
+   }
+   return btree_pack_compress_node(req, hdr, tuple_key, &stored_key)
+          && btree_set_leaf_entry(
+             cfg, hdr, btree_num_entries(hdr), stored_key, msg);
+}
+
+/* Same as btree_pack_append_leaf_entry, for the index nodes being packed. */
+static bool32
+btree_pack_append_index_entry(btree_pack_req   *req,
+                              btree_hdr        *hdr,
+                              key               pivot,
+                              uint64            child_addr,
+                              btree_pivot_stats stats)
+{
+   btree_config *cfg = req->cfg;
+   key           stored_key;
+
+   if (btree_strip_node_prefix(cfg, hdr, pivot, &stored_key) != 0) {
+      return FALSE;
+   }
+   if (btree_set_index_entry(
+          cfg, hdr, btree_num_entries(hdr), stored_key, child_addr, stats))
+   {
+      return TRUE;
+   }
+   return btree_pack_compress_node(req, hdr, pivot, &stored_key)
+          && btree_set_index_entry(cfg,
+                                   hdr,
+                                   btree_num_entries(hdr),
+                                   stored_key,
+                                   child_addr,
+                                   stats);
+}
+
+/*
+ * Appends the child at child_addr, whose first key is pivot, to the current
+ * node at height + 1. Creates that node if necessary.
+ */
+static inline void
+btree_pack_append_to_parent(btree_pack_req   *req,
+                            uint64            height,
+                            key               pivot,
+                            uint64            child_addr,
+                            btree_pivot_stats stats)
+{
+   btree_node *parent = btree_pack_get_current_node(req, height + 1);
+
+   if (!parent
+       || !btree_pack_append_index_entry(
+          req, parent->hdr, pivot, child_addr, stats))
+   {
+      btree_pack_create_next_node(req, height + 1, pivot);
+      parent         = btree_pack_get_current_node(req, height + 1);
+      bool32 success = btree_set_index_entry(
+         req->cfg, parent->hdr, 0, pivot, child_addr, stats);
+      platform_assert(success);
+   }
+
+   btree_accumulate_pivot_stats(
+      btree_pack_get_current_node_stats(req, height + 1), stats);
+}
+
 /*
  * Add the specified node to its parent. Creates a parent if necessary.
+ *
+ * The leaves of a partition are left unlinked, see btree_pack_partition.
  */
 static inline void
 btree_pack_link_node(btree_pack_req *req,
@@ -3061,32 +3722,24 @@ btree_pack_link_node(btree_pack_req *req,
 {
    btree_node        *edge       = &req->edge[height][offset];
    btree_pivot_stats *edge_stats = &req->edge_stats[height][offset];
-   key                pivot = height ? btree_get_pivot(req->cfg, edge->hdr, 0)
-                                     : btree_get_tuple_key(req->cfg, edge->hdr, 0);
+
+   if (req->leaves_only) {
+      edge->hdr->next_extent_addr = next_extent_addr;
+      btree_node_full_unlock(req->cc, req->cfg, edge);
+      memset(edge_stats, 0, sizeof(*edge_stats));
+      return;
+   }
+
+   key pivot = height ? btree_get_pivot(req->cfg, edge->hdr, 0)
+                      : btree_get_tuple_key(req->cfg, edge->hdr, 0);
+   DECLARE_AUTO_WRITABLE_BUFFER(pivot_buffer, PROCESS_PRIVATE_HEAP_ID);
+   pivot = btree_entry_full_key(req->cfg, edge->hdr, pivot, &pivot_buffer);
    edge->hdr->next_extent_addr = next_extent_addr;
    btree_node_unlock(req->cc, req->cfg, edge);
    btree_node_unclaim(req->cc, req->cfg, edge);
    // Cannot fully unlock edge yet because the key "pivot" may point into it.
 
-   btree_node *parent = btree_pack_get_current_node(req, height + 1);
-
-   if (!parent
-       || !btree_set_index_entry(req->cfg,
-                                 parent->hdr,
-                                 btree_num_entries(parent->hdr),
-                                 pivot,
-                                 edge->addr,
-                                 *edge_stats))
-   {
-      btree_pack_create_next_node(req, height + 1, pivot);
-      parent         = btree_pack_get_current_node(req, height + 1);
-      bool32 success = btree_set_index_entry(
-         req->cfg, parent->hdr, 0, pivot, edge->addr, *edge_stats);
-      platform_assert(success);
-   }
-
-   btree_accumulate_pivot_stats(
-      btree_pack_get_current_node_stats(req, height + 1), *edge_stats);
+   btree_pack_append_to_parent(req, height, pivot, edge->addr, *edge_stats);
 
    btree_node_unget(req->cc, req->cfg, edge);
    memset(edge_stats, 0, sizeof(*edge_stats));
@@ -3150,8 +3803,7 @@ btree_pack_loop(btree_pack_req *req,       // IN/OUT
    btree_node *leaf = btree_pack_get_current_node(req, 0);
 
    if (!leaf
-       || !btree_set_leaf_entry(
-          req->cfg, leaf->hdr, btree_num_entries(leaf->hdr), tuple_key, msg))
+       || !btree_pack_append_leaf_entry(req, leaf->hdr, tuple_key, msg))
    {
       leaf = btree_pack_create_next_node(req, 0, tuple_key);
       bool32 result =
@@ -3287,6 +3939,174 @@ btree_pack(btree_pack_req *req)
    return STATUS_OK;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * btree_pack_partition --
+ *
+ *      Packs the leaves of one key range of a larger pack. The leaves come
+ *      from a mini_allocator of their own and are not linked into a tree;
+ *      btree_pack_stitch builds the tree above the leaves of all the ranges.
+ *      Ranges may be packed concurrently.
+ *
+ *      On error, the leaves packed so far are kept, so the partition can
+ *      still be stitched and the result discarded.
+ *-----------------------------------------------------------------------------
+ */
+platform_status
+btree_pack_partition(btree_pack_req *req)
+{
+   btree_pack_setup_start(req);
+   req->leaves_only     = TRUE;
+   req->first_leaf_addr = 0;
+
+   platform_status rc        = STATUS_OK;
+   key             tuple_key = NEGATIVE_INFINITY_KEY;
+   message         data;
+
+   while (iterator_can_next(req->itor)) {
+      iterator_curr(req->itor, &tuple_key, &data);
+      if (!btree_pack_can_fit_tuple(req, tuple_key, data)) {
+         platform_error_log("%s(): req->num_tuples=%lu exceeded output size "
+                            "limit, req->max_tuples=%lu\n",
+                            __func__,
+                            req->num_tuples,
+                            req->max_tuples);
+         rc = STATUS_LIMIT_EXCEEDED;
+         break;
+      }
+      rc = btree_pack_loop(req, tuple_key, data);
+      if (!SUCCESS(rc)) {
+         break;
+      }
+      if (req->first_leaf_addr == 0) {
+         req->first_leaf_addr = btree_pack_get_current_node(req, 0)->addr;
+      }
+      rc = iterator_next(req->itor);
+      if (!SUCCESS(rc)) {
+         break;
+      }
+   }
+
+   if (req->num_tuples == 0) {
+      mini_destroy_unused(&req->mini);
+   } else {
+      btree_pack_link_extent(req, 0, 0);
+      mini_release(&req->mini, tuple_key);
+   }
+   // the root is never built, its extent is freed with the meta pages
+   req->root_addr = 0;
+   return rc;
+}
+
+/*
+ * Links the last leaf of one partition to the first leaf of the next.
+ */
+static void
+btree_pack_link_leaves(btree_pack_req *req, uint64 left_addr, uint64 right_addr)
+{
+   cache        *cc  = req->cc;
+   btree_config *cfg = req->cfg;
+   btree_node    left, right;
+
+   left.addr = left_addr;
+   btree_node_get(cc, cfg, &left, PAGE_TYPE_BRANCH);
+   debug_only bool32 success = btree_node_claim(cc, cfg, &left);
+   debug_assert(success);
+   btree_node_lock(cc, cfg, &left);
+   left.hdr->next_addr = right_addr;
+   btree_node_full_unlock(cc, cfg, &left);
+
+   right.addr = right_addr;
+   btree_node_get(cc, cfg, &right, PAGE_TYPE_BRANCH);
+   success = btree_node_claim(cc, cfg, &right);
+   debug_assert(success);
+   btree_node_lock(cc, cfg, &right);
+   right.hdr->prev_addr = left_addr;
+   btree_node_full_unlock(cc, cfg, &right);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * btree_pack_stitch --
+ *
+ *      Builds one tree above the leaves of the partitions in parts, packed by
+ *      btree_pack_partition over increasing, disjoint key ranges.
+ *      The extents of the partitions move to the mini_allocator of the tree,
+ *      and if req has a hash function, the fingerprints of the partitions are
+ *      concatenated into its fingerprint_arr.
+ *
+ *      req is initialized with btree_pack_req_init, and its itor is not used.
+ *      Only the index nodes are written here, so stitching costs a small
+ *      fraction of packing the partitions.
+ *-----------------------------------------------------------------------------
+ */
+void
+btree_pack_stitch(btree_pack_req *req,
+                  btree_pack_req *parts[],
+                  uint64          num_parts)
+{
+   cache        *cc  = req->cc;
+   btree_config *cfg = req->cfg;
+
+   btree_pack_setup_start(req);
+
+   key_buffer last_key;
+   key_buffer_init(&last_key, PROCESS_PRIVATE_HEAP_ID);
+   uint64 prev_leaf_addr = 0;
+
+   for (uint64 part_no = 0; part_no < num_parts; part_no++) {
+      btree_pack_req *part = parts[part_no];
+      if (part->num_tuples == 0) {
+         continue;
+      }
+
+      mini_keyed_splice(&req->mini, 0, part->mini.meta_head);
+      if (req->hash) {
+         platform_assert(req->num_tuples + part->num_tuples <= req->max_tuples);
+         memcpy(&req->fingerprint_arr[req->num_tuples],
+                part->fingerprint_arr,
+                part->num_tuples * sizeof(*part->fingerprint_arr));
+      }
+      req->num_tuples += part->num_tuples;
+      req->key_bytes += part->key_bytes;
+      req->message_bytes += part->message_bytes;
+
+      if (prev_leaf_addr != 0) {
+         btree_pack_link_leaves(req, prev_leaf_addr, part->first_leaf_addr);
+      }
+
+      uint64 leaf_addr = part->first_leaf_addr;
+      while (leaf_addr != 0) {
+         btree_node leaf;
+         leaf.addr = leaf_addr;
+         btree_node_get(cc, cfg, &leaf, PAGE_TYPE_BRANCH);
+
+         btree_pivot_stats stats;
+         ZERO_STRUCT(stats);
+         uint64 num_entries = btree_num_entries(leaf.hdr);
+         accumulate_node_ranks(cfg, leaf.hdr, 0, num_entries, &stats);
+
+         DECLARE_AUTO_WRITABLE_BUFFER(pivot_buffer, PROCESS_PRIVATE_HEAP_ID);
+         key pivot = btree_get_tuple_key(cfg, leaf.hdr, 0);
+         pivot     = btree_entry_full_key(cfg, leaf.hdr, pivot, &pivot_buffer);
+         btree_pack_append_to_parent(req, 0, pivot, leaf.addr, stats);
+
+         prev_leaf_addr = leaf.addr;
+         leaf_addr      = leaf.hdr->next_addr;
+         if (leaf_addr == 0) {
+            key last = btree_get_tuple_key(cfg, leaf.hdr, num_entries - 1);
+            last     = btree_entry_full_key(cfg, leaf.hdr, last, &pivot_buffer);
+            platform_status rc = key_buffer_copy_key(&last_key, last);
+            platform_assert_status_ok(rc);
+         }
+         btree_node_unget(cc, cfg, &leaf);
+      }
+   }
+
+   btree_pack_post_loop(req, key_buffer_key(&last_key));
+   key_buffer_deinit(&last_key);
+}
+
 /*
  * Returns the number of kv pairs (k,v ) w/ k < key.  Also returns
  * the total size of all such keys and messages.
@@ -3382,7 +4202,9 @@ btree_count_in_range_by_iterator(cache             *cc,
 
 /* Print offset table entries, 4 entries per line, w/ auto-indentation. */
 static void
-btree_print_offset_table(platform_log_handle *log_handle, btree_hdr *hdr)
+btree_print_offset_table(platform_log_handle *log_handle,
+                         const btree_config  *cfg,
+                         btree_hdr           *hdr)
 {
    platform_log(log_handle, "-------------------\n");
    platform_log(log_handle, "Offset Table num_entries=%d\n", hdr->num_entries);
@@ -3397,7 +4219,7 @@ btree_print_offset_table(platform_log_handle *log_handle, btree_hdr *hdr)
       if (i && ((i % 4) == 0)) {
          platform_log(log_handle, "\n");
       }
-      platform_log(log_handle, fmtstr, i, btree_get_table_entry(hdr, i));
+      platform_log(log_handle, fmtstr, i, btree_get_table_entry(cfg, hdr, i));
    }
    platform_log(log_handle, "\n");
 }
@@ -3472,8 +4294,15 @@ btree_print_index_node(platform_log_handle *log_handle,
    platform_log(log_handle, "**  height: %u \n", btree_height(hdr));
    platform_log(log_handle, "**  next_entry: %u \n", hdr->next_entry);
    platform_log(log_handle, "**  num_entries: %u \n", btree_num_entries(hdr));
+   if (hdr->prefix_length != 0) {
+      platform_log(log_handle,
+                   "**  key prefix: %s \n",
+                   key_string(cfg->data_cfg,
+                              key_create_from_slice(
+                                 btree_node_key_prefix(cfg, hdr))));
+   }
 
-   btree_print_offset_table(log_handle, hdr);
+   btree_print_offset_table(log_handle, cfg, hdr);
 
    platform_log(log_handle, "-------------------\n");
    platform_log(
@@ -3517,8 +4346,15 @@ btree_print_leaf_node(platform_log_handle *log_handle,
    platform_log(log_handle, "**  height: %u \n", btree_height(hdr));
    platform_log(log_handle, "**  next_entry: %u \n", hdr->next_entry);
    platform_log(log_handle, "**  num_entries: %u \n", btree_num_entries(hdr));
+   if (hdr->prefix_length != 0) {
+      platform_log(log_handle,
+                   "**  key prefix: %s \n",
+                   key_string(cfg->data_cfg,
+                              key_create_from_slice(
+                                 btree_node_key_prefix(cfg, hdr))));
+   }
 
-   btree_print_offset_table(log_handle, hdr);
+   btree_print_offset_table(log_handle, cfg, hdr);
 
    platform_log(log_handle, "-------------------\n");
    platform_log(
@@ -3701,6 +4537,9 @@ btree_verify_node(cache        *cc,
    table_index idx;
    bool32      result = FALSE;
 
+   // child keys are compared to node's pivots in full
+   DECLARE_AUTO_WRITABLE_BUFFER(child_key_buffer, PROCESS_PRIVATE_HEAP_ID);
+
    for (idx = 0; idx < node.hdr->num_entries; idx++) {
       if (node.hdr->height == 0) {
          // leaf node
@@ -3744,10 +4583,16 @@ btree_verify_node(cache        *cc,
          }
          if (child.hdr->height == 0) {
             // child leaf
+            key child_key = btree_entry_full_key(
+               cfg,
+               child.hdr,
+               btree_get_tuple_key(cfg, child.hdr, 0),
+               &child_key_buffer);
             if (0 < idx
-                && btree_key_compare(cfg,
-                                     btree_get_pivot(cfg, node.hdr, idx),
-                                     btree_get_tuple_key(cfg, child.hdr, 0))
+                && btree_entry_key_compare(cfg,
+                                           node.hdr,
+                                           btree_get_pivot(cfg, node.hdr, idx),
+                                           child_key)
                       != 0)
             {
                platform_error_log(
@@ -3761,12 +4606,18 @@ btree_verify_node(cache        *cc,
          }
          if (child.hdr->height == 0) {
             // child leaf
+            key child_key = btree_entry_full_key(
+               cfg,
+               child.hdr,
+               btree_get_tuple_key(
+                  cfg, child.hdr, btree_num_entries(child.hdr) - 1),
+               &child_key_buffer);
             if (idx != btree_num_entries(node.hdr) - 1
-                && btree_key_compare(
+                && btree_entry_key_compare(
                       cfg,
+                      node.hdr,
                       btree_get_pivot(cfg, node.hdr, idx + 1),
-                      btree_get_tuple_key(
-                         cfg, child.hdr, btree_num_entries(child.hdr) - 1))
+                      child_key)
                       < 0)
             {
                platform_error_log("child tuple larger than parent bound\n");
@@ -3783,12 +4634,18 @@ btree_verify_node(cache        *cc,
             }
          } else {
             // child index
+            key child_key = btree_entry_full_key(
+               cfg,
+               child.hdr,
+               btree_get_pivot(
+                  cfg, child.hdr, btree_num_entries(child.hdr) - 1),
+               &child_key_buffer);
             if (idx != btree_num_entries(node.hdr) - 1
-                && btree_key_compare(
+                && btree_entry_key_compare(
                       cfg,
+                      node.hdr,
                       btree_get_pivot(cfg, node.hdr, idx + 1),
-                      btree_get_pivot(
-                         cfg, child.hdr, btree_num_entries(child.hdr) - 1))
+                      child_key)
                       < 0)
             {
                platform_error_log("child pivot larger than parent bound\n");
@@ -3873,13 +4730,19 @@ btree_config_init(btree_config *btree_cfg,
                   cache_config *cache_cfg,
                   data_config  *data_cfg)
 {
-   btree_cfg->cache_cfg = cache_cfg;
-   btree_cfg->data_cfg  = data_cfg;
+   btree_cfg->cache_cfg          = cache_cfg;
+   btree_cfg->data_cfg           = data_cfg;
+   btree_cfg->key_prefix_slots   = FALSE;
+   btree_cfg->prefix_compression = FALSE;
+   btree_cfg->optimistic_inserts = FALSE;
+
+   btree_cfg->readahead_max_extents    = BTREE_DEFAULT_READAHEAD_EXTENTS;
+   btree_cfg->readahead_budget_extents = 0;
 
    uint64 page_size           = btree_page_size(btree_cfg);
    uint64 max_inline_key_size = MAX_INLINE_KEY_SIZE(page_size);
    uint64 max_inline_msg_size = MAX_INLINE_MESSAGE_SIZE(page_size);
    uint64 max_entry_space     = sizeof(leaf_entry) + max_inline_key_size
-                            + max_inline_msg_size + sizeof(table_entry);
+                            + max_inline_msg_size + sizeof(btree_prefix_slot);
    platform_assert(max_entry_space < (page_size - sizeof(btree_hdr)) / 2);
 }
@@ -78,6 +78,23 @@ _Static_assert(BTREE_MAX_HEIGHT == MINI_MAX_BATCHES,
 typedef struct btree_config {
    cache_config *cache_cfg;
    data_config  *data_cfg;
+
+   // Keep key prefixes in the offset table (see btree_prefix_slot). Changes
+   // the node format, and requires keys ordered like slice_lex_cmp.
+   bool32 key_prefix_slots;
+
+   // Let btree_pack strip the key prefix shared by the entries of a full
+   // branch node (see btree_hdr.prefix_length). Also requires keys ordered
+   // like slice_lex_cmp; memtable nodes are never compressed.
+   bool32 prefix_compression;
+
+   // Insert into memtables with optimistic lock coupling (see
+   // btree_try_insert_optimistic)
+   bool32 optimistic_inserts;
+
+   // Readahead of branch iterators, in extents (see btree_iterator_readahead)
+   uint64 readahead_max_extents;    // largest readahead window
+   uint64 readahead_budget_extents; // per-iterator limit, 0 for unlimited
 } btree_config;
 
 typedef struct ONDISK btree_hdr btree_hdr;
@@ -143,6 +160,14 @@ typedef struct btree_iterator {
    uint64     end_addr;
    uint64     end_idx;
    uint64     end_generation;
+
+   // readahead state, used when do_prefetch is set
+   uint64 ra_window; // extents to keep prefetched ahead of curr
+   uint64 ra_ahead;  // extents currently prefetched ahead of curr
+   uint64 ra_issued; // extents prefetched by this iterator
+
+   // holds the curr key when it comes from a prefix-compressed node
+   writable_buffer curr_key_buffer;
 } btree_iterator;
 
 typedef struct btree_pack_req {
@@ -162,6 +187,11 @@ typedef struct btree_pack_req {
    uint32            num_edges[BTREE_MAX_HEIGHT];
 
    mini_allocator mini;
+   char          *scratch_node; // for prefix compression, if enabled
+
+   // set when packing a partition, see btree_pack_partition
+   bool32 leaves_only;
+   uint64 first_leaf_addr;
 
    // output of the compaction
    uint64 root_addr;     // root address of the output tree
@@ -355,6 +385,16 @@ btree_pack_req_init(btree_pack_req  *req,
          return STATUS_NO_MEMORY;
       }
    }
+   if (cfg->prefix_compression) {
+      req->scratch_node = TYPED_MANUAL_MALLOC(
+         hid, req->scratch_node, cache_config_page_size(cfg->cache_cfg));
+      if (!req->scratch_node) {
+         if (req->fingerprint_arr) {
+            platform_free(hid, req->fingerprint_arr);
+         }
+         return STATUS_NO_MEMORY;
+      }
+   }
    return STATUS_OK;
 }
 
@@ -364,11 +404,26 @@ btree_pack_req_deinit(btree_pack_req *req, platform_heap_id hid)
    if (req->fingerprint_arr) {
       platform_free(hid, req->fingerprint_arr);
    }
+   if (req->scratch_node) {
+      platform_free(hid, req->scratch_node);
+   }
 }
 
 platform_status
 btree_pack(btree_pack_req *req);
 
+/*
+ * A large pack can be split into key ranges, packed concurrently by
+ * btree_pack_partition and then stitched into one tree by btree_pack_stitch.
+ */
+platform_status
+btree_pack_partition(btree_pack_req *req);
+
+void
+btree_pack_stitch(btree_pack_req *req,
+                  btree_pack_req *parts[],
+                  uint64          num_parts);
+
 void
 btree_count_in_range(cache             *cc,
                      btree_config      *cfg,
@@ -29,7 +29,11 @@ typedef node_offset table_entry;
  * Stored on pages of Page Type == PAGE_TYPE_MEMTABLE, PAGE_TYPE_BRANCH
  * See btree.c for a description of the layout of this page format.
  * The byte offset of the k'th entry from the start of the page is given by
- * the offsets[k]'th value.
+ * the offsets[k]'th value, or by the k'th btree_prefix_slot when the tree
+ * uses key prefix slots (see below).
+ * A non-zero prefix_length marks a prefix-compressed packed node, whose
+ * entries store their keys without the prefix_length bytes kept at the
+ * end of the page.
  * *************************************************************************
  */
 struct ONDISK btree_hdr {
@@ -40,9 +44,29 @@ struct ONDISK btree_hdr {
    uint8       height;
    node_offset next_entry;
    table_index num_entries;
+   node_offset prefix_length;
    table_entry offsets[];
 };
 
+/*
+ * *************************************************************************
+ * BTree Node key prefix slots: Disk-resident structure
+ *
+ * With btree_config.key_prefix_slots set, the offset table holds one
+ * btree_prefix_slot per entry instead of a table_entry: the entry's offset
+ * in the low 16 bits, and the first BTREE_KEY_PREFIX_BYTES bytes of its key,
+ * big-endian and zero-padded, above them. For keys ordered like
+ * slice_lex_cmp, unequal prefixes order their keys, so binary searches only
+ * follow the offset into the node to break ties. Negative and positive
+ * infinity get the smallest and largest prefixes.
+ * *************************************************************************
+ */
+typedef uint64 btree_prefix_slot;
+
+#define BTREE_KEY_PREFIX_BYTES (6)
+#define BTREE_KEY_PREFIX_SHIFT (bitsizeof(node_offset))
+#define BTREE_KEY_PREFIX_MAX   ((1ULL << (8 * BTREE_KEY_PREFIX_BYTES)) - 1)
+
 /*
  * *************************************************************************
  * BTree Node index entries: Disk-resident structure
@@ -164,6 +188,87 @@ btree_extent_size(const btree_config *cfg)
    return cache_config_extent_size(cfg->cache_cfg);
 }
 
+static inline uint64
+btree_table_entry_size(const btree_config *cfg)
+{
+   return cfg->key_prefix_slots ? sizeof(btree_prefix_slot)
+                                : sizeof(table_entry);
+}
+
+/* Byte offset from the start of the node to the end of a table of n slots */
+static inline uint64
+btree_table_end(const btree_config *cfg, uint64 num_entries)
+{
+   return offsetof(btree_hdr, offsets)
+          + num_entries * btree_table_entry_size(cfg);
+}
+
+static inline uint64
+btree_key_prefix(key k)
+{
+   if (key_is_negative_infinity(k)) {
+      return 0;
+   }
+   if (key_is_positive_infinity(k)) {
+      return BTREE_KEY_PREFIX_MAX;
+   }
+   const uint8 *bytes  = key_data(k);
+   uint64       len    = MIN(key_length(k), BTREE_KEY_PREFIX_BYTES);
+   uint64       prefix = 0;
+   for (uint64 i = 0; i < BTREE_KEY_PREFIX_BYTES; i++) {
+      prefix = (prefix << 8) | (i < len ? bytes[i] : 0);
+   }
+   return prefix;
+}
+
+static inline btree_prefix_slot
+btree_get_prefix_slot(const btree_hdr *hdr, uint64 k)
+{
+   btree_prefix_slot slot;
+   memcpy(&slot,
+          const_pointer_byte_offset(hdr->offsets, k * sizeof(slot)),
+          sizeof(slot));
+   return slot;
+}
+
+static inline node_offset
+btree_get_entry_offset(const btree_config *cfg,
+                       const btree_hdr    *hdr,
+                       uint64              k)
+{
+   if (cfg->key_prefix_slots) {
+      return (node_offset)btree_get_prefix_slot(hdr, k);
+   }
+   return hdr->offsets[k];
+}
+
+static inline uint64
+btree_get_entry_prefix(const btree_hdr *hdr, uint64 k)
+{
+   return btree_get_prefix_slot(hdr, k) >> BTREE_KEY_PREFIX_SHIFT;
+}
+
+/*
+ * Points slot k at the entry at offset, whose key is entry_key.
+ */
+static inline void
+btree_set_table_slot(const btree_config *cfg,
+                     btree_hdr          *hdr,
+                     uint64              k,
+                     node_offset         offset,
+                     key                 entry_key)
+{
+   if (cfg->key_prefix_slots) {
+      btree_prefix_slot slot =
+         (btree_key_prefix(entry_key) << BTREE_KEY_PREFIX_SHIFT) | offset;
+      memcpy(pointer_byte_offset(hdr->offsets, k * sizeof(slot)),
+             &slot,
+             sizeof(slot));
+   } else {
+      hdr->offsets[k] = offset;
+   }
+}
+
 static inline void
 btree_init_hdr(const btree_config *cfg, btree_hdr *hdr)
 {
@@ -171,6 +276,16 @@ btree_init_hdr(const btree_config *cfg, btree_hdr *hdr)
    hdr->next_entry = btree_page_size(cfg);
 }
 
+/* The key bytes shared by all entries of a prefix-compressed node */
+static inline slice
+btree_node_key_prefix(const btree_config *cfg, const btree_hdr *hdr)
+{
+   uint64 page_size = btree_page_size(cfg);
+   return slice_create(
+      hdr->prefix_length,
+      const_pointer_byte_offset(hdr, page_size - hdr->prefix_length));
+}
+
 static inline uint64
 sizeof_index_entry(const index_entry *entry)
 {
@@ -221,13 +336,12 @@ btree_get_leaf_entry(const btree_config *cfg,
    /* Ensure that the kth entry's header is after the end of the table and
     * before the end of the page.
     */
-   debug_assert(diff_ptr(hdr, &hdr->offsets[hdr->num_entries])
-                <= hdr->offsets[k]);
+   node_offset offset = btree_get_entry_offset(cfg, hdr, k);
+   debug_assert(btree_table_end(cfg, hdr->num_entries) <= offset);
    debug_code(uint64 bt_page_size = btree_page_size(cfg));
-   debug_assert(hdr->offsets[k] + sizeof(leaf_entry) <= bt_page_size);
-   leaf_entry *entry =
-      (leaf_entry *)const_pointer_byte_offset(hdr, hdr->offsets[k]);
-   debug_assert(hdr->offsets[k] + sizeof_leaf_entry(entry) <= bt_page_size);
+   debug_assert(offset + sizeof(leaf_entry) <= bt_page_size);
+   leaf_entry *entry = (leaf_entry *)const_pointer_byte_offset(hdr, offset);
+   debug_assert(offset + sizeof_leaf_entry(entry) <= bt_page_size);
    return entry;
 }
 
@@ -268,27 +382,26 @@ btree_get_index_entry(const btree_config *cfg,
    /* Ensure that the kth entry's header is after the end of the table and
     * before the end of the page.
     */
-   debug_assert(diff_ptr(hdr, &hdr->offsets[hdr->num_entries])
-                <= hdr->offsets[k]);
+   node_offset offset = btree_get_entry_offset(cfg, hdr, k);
+   debug_assert(btree_table_end(cfg, hdr->num_entries) <= offset);
    debug_code(uint64 bt_page_size = btree_page_size(cfg));
-   debug_assert((hdr->offsets[k] + sizeof(index_entry) <= bt_page_size),
+   debug_assert((offset + sizeof(index_entry) <= bt_page_size),
                 "k=%d, offsets[k]=%d, sizeof(index_entry)=%lu"
                 ", btree_page_size=%lu.",
                 k,
-                hdr->offsets[k],
+                offset,
                 sizeof(index_entry),
                 bt_page_size);
 
-   index_entry *entry =
-      (index_entry *)const_pointer_byte_offset(hdr, hdr->offsets[k]);
+   index_entry *entry = (index_entry *)const_pointer_byte_offset(hdr, offset);
 
    /* Now ensure that the entire entry fits in the page. */
-   debug_assert((hdr->offsets[k] + sizeof_index_entry(entry) <= bt_page_size),
+   debug_assert((offset + sizeof_index_entry(entry) <= bt_page_size),
                 "Offsets entry at index k=%d does not fit in the page."
                 " offsets[k]=%d, sizeof_index_entry()=%lu"
                 ", btree_page_size=%lu.",
                 k,
-                hdr->offsets[k],
+                offset,
                 sizeof_index_entry(entry),
                 bt_page_size);
    return entry;
@@ -14,8 +14,9 @@
 #include "io.h"
 
 typedef struct page_handle {
-   char  *data;
-   uint64 disk_addr;
+   char           *data;
+   uint64          disk_addr;
+   volatile uint64 version; // odd while write locked, see cache_get_pinned
 } page_handle;
 
 typedef struct cache_config cache_config;
@@ -33,6 +34,12 @@ typedef struct cache_stats {
    uint64 page_writes[NUM_PAGE_TYPES];
    uint64 page_reads[NUM_PAGE_TYPES];
    uint64 prefetches_issued[NUM_PAGE_TYPES];
+   uint64 prefetch_hits[NUM_PAGE_TYPES];   // prefetched pages later read
+   uint64 prefetch_unused[NUM_PAGE_TYPES]; // evicted before being read
+   uint64 compressed_hits[NUM_PAGE_TYPES];
+   uint64 compressed_stores[NUM_PAGE_TYPES];
+   uint64 write_bytes_saved[NUM_PAGE_TYPES]; // not written, by the codec
+   uint64 disk_bytes_freed[NUM_PAGE_TYPES];  // holes punched, by the codec
    uint64 writes_issued;
    uint64 syncs_issued;
 } PLATFORM_CACHELINE_ALIGNED cache_stats;
@@ -139,6 +146,7 @@ typedef page_handle *(*page_get_fn)(cache    *cc,
                                     uint64    addr,
                                     bool32    blocking,
                                     page_type type);
+typedef page_handle *(*page_get_pinned_fn)(cache *cc, uint64 addr);
 typedef cache_async_result (*page_get_async_fn)(cache            *cc,
                                                 uint64            addr,
                                                 page_type         type,
@@ -176,6 +184,7 @@ typedef struct cache_ops {
    page_alloc_fn        page_alloc;
    extent_discard_fn    extent_discard;
    page_get_fn          page_get;
+   page_get_pinned_fn   page_get_pinned;
    page_get_async_fn    page_get_async;
    page_async_done_fn   page_async_done;
    page_generic_fn      page_unget;
@@ -283,6 +292,42 @@ cache_get(cache *cc, uint64 addr, bool32 blocking, page_type type)
    return cc->ops->page_get(cc, addr, blocking, type);
 }
 
+/*
+ *----------------------------------------------------------------------
+ * cache_get_pinned
+ *
+ * Returns a pointer to the page_handle for the pinned page with address addr,
+ * without taking a read lock.
+ *
+ * The page may be written while the caller reads it, so it must be read
+ * optimistically: take cache_page_version() before reading, which is odd
+ * while the page is write locked, and check it with cache_page_validate()
+ * after. What was read is only meaningful if the check succeeds.
+ *
+ * The caller must keep the page pinned, e.g. by holding a memtable open.
+ *----------------------------------------------------------------------
+ */
+static inline page_handle *
+cache_get_pinned(cache *cc, uint64 addr)
+{
+   return cc->ops->page_get_pinned(cc, addr);
+}
+
+static inline uint64
+cache_page_version(page_handle *page)
+{
+   uint64 version = page->version;
+   __sync_synchronize();
+   return version;
+}
+
+static inline bool32
+cache_page_validate(page_handle *page, uint64 version)
+{
+   __sync_synchronize();
+   return page->version == version;
+}
+
 /*
  *----------------------------------------------------------------------
  * cache_ctxt_init
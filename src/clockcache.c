@@ -37,6 +37,21 @@
 // Number of batches that the cleaner hand is ahead of the evictor hand
 #define CC_CLEANER_GAP 512
 
+/*
+ * Number of full passes of the clock during which get_free_page honors the
+ * per-page-type minimum shares and trunk pinning, respectively. Once a
+ * thread has cycled through the cache this many times without finding a
+ * free page, the protections are dropped so that the cache cannot lock up.
+ */
+#define CC_MIN_SHARE_PASSES 1
+#define CC_PIN_TRUNK_PASSES 2
+
+// Pass number used when every evictable page must go, e.g. evict_all
+#define CC_UNPROTECTED_PASS UINT64_MAX
+
+// How long the background cleaner sleeps when it finds nothing to do
+#define CC_CLEANER_IDLE_NS (200 * THOUSAND)
+
 /* number of events to poll for during clockcache_wait */
 #define CC_DEFAULT_MAX_IO_EVENTS 32
 
@@ -143,6 +158,9 @@ clockcache_get_allocator_ref(clockcache *cc, uint64 addr);
 page_handle *
 clockcache_get(clockcache *cc, uint64 addr, bool32 blocking, page_type type);
 
+page_handle *
+clockcache_get_pinned(clockcache *cc, uint64 addr);
+
 void
 clockcache_unget(clockcache *cc, page_handle *page);
 
@@ -295,6 +313,13 @@ clockcache_get_virtual(cache *c, uint64 addr, bool32 blocking, page_type type)
    return clockcache_get(cc, addr, blocking, type);
 }
 
+page_handle *
+clockcache_get_pinned_virtual(cache *c, uint64 addr)
+{
+   clockcache *cc = (clockcache *)c;
+   return clockcache_get_pinned(cc, addr);
+}
+
 void
 clockcache_unget_virtual(cache *c, page_handle *page)
 {
@@ -508,6 +533,7 @@ static cache_ops clockcache_ops = {
    .page_alloc        = clockcache_alloc_virtual,
    .extent_discard    = clockcache_extent_discard_virtual,
    .page_get          = clockcache_get_virtual,
+   .page_get_pinned   = clockcache_get_pinned_virtual,
    .page_get_async    = clockcache_get_async_virtual,
    .page_async_done   = clockcache_async_done_virtual,
    .page_unget        = clockcache_unget_virtual,
@@ -758,6 +784,253 @@ clockcache_extent_size(const clockcache *cc)
    return clockcache_config_extent_size(cc->cfg);
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * per-page-type accounting
+ *
+ *      clockcache_entry_set_type is called once an entry has been mapped to
+ *      a disk address, and clockcache_entry_clear_type when it is unmapped,
+ *      so that cc->type_pages tracks the number of resident pages by type.
+ *-----------------------------------------------------------------------------
+ */
+static inline void
+clockcache_entry_set_type(clockcache *cc, clockcache_entry *entry, page_type type)
+{
+   entry->type = type;
+   __sync_fetch_and_add(&cc->type_pages[type], 1);
+}
+
+static inline void
+clockcache_entry_clear_type(clockcache *cc, clockcache_entry *entry)
+{
+   debug_only int64 type_pages =
+      __sync_fetch_and_sub(&cc->type_pages[entry->type], 1);
+   debug_assert(type_pages > 0);
+}
+
+/*
+ * Counts the first read of a page brought in by clockcache_prefetch. Pages
+ * evicted with the marker still set are counted as prefetch_unused.
+ */
+static inline void
+clockcache_note_prefetch_hit(clockcache       *cc,
+                             clockcache_entry *entry,
+                             page_type         type,
+                             threadid          tid)
+{
+   if (entry->prefetched
+       && __sync_bool_compare_and_swap(&entry->prefetched, TRUE, FALSE)
+       && cc->cfg->use_stats)
+   {
+      cc->stats[tid].prefetch_hits[type]++;
+   }
+}
+
+/*
+ * Returns TRUE if the evictor should skip pages of the given type on the
+ * given pass of the clock.
+ */
+static inline bool32
+clockcache_type_protected(clockcache *cc, page_type type, uint64 pass)
+{
+   if (cc->cfg->pin_trunk_pages && type == PAGE_TYPE_TRUNK
+       && pass < CC_PIN_TRUNK_PASSES)
+   {
+      return TRUE;
+   }
+   uint64 min_pages = cc->cfg->type_min_pages[type];
+   return pass < CC_MIN_SHARE_PASSES && min_pages != 0
+          && cc->type_pages[type] <= min_pages;
+}
+
+/*
+ * Returns TRUE if pages of the given type exceed their maximum share, in
+ * which case they are evicted regardless of their access bit.
+ */
+static inline bool32
+clockcache_type_over_share(clockcache *cc, page_type type)
+{
+   uint64 max_pages = cc->cfg->type_max_pages[type];
+   return max_pages != 0 && cc->type_pages[type] > max_pages;
+}
+
+/*
+ * Returns TRUE if evicted pages of the given type are kept in the compressed
+ * tier.
+ */
+static inline bool32
+clockcache_zcache_eligible(clockcache *cc, page_type type)
+{
+   return cc->cfg->compressed_capacity != 0 && type == PAGE_TYPE_BRANCH;
+}
+
+/*
+ * Called on eviction of a clean page, before its lookup is cleared, so that
+ * a concurrent miss on the page finds it in the compressed tier.
+ */
+static inline void
+clockcache_zcache_store(clockcache *cc, clockcache_entry *entry)
+{
+   if (!clockcache_zcache_eligible(cc, entry->type)) {
+      return;
+   }
+   bool32 stored = zcache_put(&cc->zc, entry->page.disk_addr, entry->page.data);
+   if (stored && cc->cfg->use_stats) {
+      cc->stats[platform_get_tid()].compressed_stores[entry->type]++;
+   }
+}
+
+/*
+ * Fills a page being loaded from the compressed tier, if it is there.
+ * Returns FALSE if the page must be read from disk.
+ */
+static inline bool32
+clockcache_zcache_load(clockcache *cc, clockcache_entry *entry)
+{
+   if (!clockcache_zcache_eligible(cc, entry->type)
+       || !zcache_take(&cc->zc, entry->page.disk_addr, entry->page.data))
+   {
+      return FALSE;
+   }
+   if (cc->cfg->use_stats) {
+      cc->stats[platform_get_tid()].compressed_hits[entry->type]++;
+   }
+   return TRUE;
+}
+
+/*
+ * Drops any compressed copy of the page at addr, whose contents are about to
+ * change.
+ */
+static inline void
+clockcache_zcache_invalidate(clockcache *cc, uint64 addr)
+{
+   if (cc->cfg->compressed_capacity != 0) {
+      zcache_invalidate(&cc->zc, addr);
+   }
+}
+
+/*
+ * Returns TRUE if the page in entry is compressed when it is written back.
+ * Such pages are always written by themselves.
+ */
+static inline bool32
+clockcache_codec_eligible(clockcache *cc, clockcache_entry *entry)
+{
+   return cc->cfg->branch_codec != NULL && entry->type == PAGE_TYPE_BRANCH;
+}
+
+static inline char *
+clockcache_codec_scratch(clockcache *cc)
+{
+   return cc->codec_scratch
+          + clockcache_multiply_by_page_size(cc, platform_get_tid());
+}
+
+/*
+ * Compresses the page in entry into buf. Returns the number of bytes of buf
+ * to write, or 0 if the page should be written uncompressed.
+ *
+ * Punches a hole over the rest of the page's slot, so that whatever whole
+ * device blocks the compressed page leaves unused take no space. The written
+ * bytes and the hole do not share a block, so the write may be in flight.
+ */
+static uint64
+clockcache_codec_encode(clockcache *cc, clockcache_entry *entry, char *buf)
+{
+   uint64 page_size = clockcache_page_size(cc);
+   uint64 bytes     = page_codec_encode(
+      cc->cfg->branch_codec, entry->page.data, page_size, buf);
+   if (bytes == 0) {
+      return 0;
+   }
+   uint64 freed =
+      io_discard(cc->io, page_size - bytes, entry->page.disk_addr + bytes);
+   if (cc->cfg->use_stats) {
+      threadid tid = platform_get_tid();
+      cc->stats[tid].write_bytes_saved[entry->type] += page_size - bytes;
+      cc->stats[tid].disk_bytes_freed[entry->type] += freed;
+   }
+   return bytes;
+}
+
+/*
+ * Points iovec at the data to write for the page in entry_no, compressing it
+ * into a codec buffer if it is eligible. Must be called with the IO request
+ * for the write held, so that a codec buffer is free, see struct clockcache.
+ *
+ * Returns the number of bytes to write.
+ */
+static uint64
+clockcache_codec_prepare_write(clockcache   *cc,
+                               uint32        entry_no,
+                               struct iovec *iovec)
+{
+   clockcache_entry *entry = clockcache_get_entry(cc, entry_no);
+   iovec->iov_base         = entry->page.data;
+   if (!clockcache_codec_eligible(cc, entry)) {
+      return clockcache_page_size(cc);
+   }
+
+   uint64 buf_no;
+   do {
+      buf_no = __sync_fetch_and_add(&cc->codec_buf_hand, 1) % cc->codec_bufs;
+   } while (!__sync_bool_compare_and_swap(
+      &cc->codec_buf_entry[buf_no], CC_UNMAPPED_ENTRY, entry_no));
+
+   char  *buf   = cc->codec_buf + clockcache_multiply_by_page_size(cc, buf_no);
+   uint64 bytes = clockcache_codec_encode(cc, entry, buf);
+   if (bytes == 0) {
+      cc->codec_buf_entry[buf_no] = CC_UNMAPPED_ENTRY;
+      return clockcache_page_size(cc);
+   }
+   iovec->iov_base = buf;
+   iovec->iov_len  = bytes;
+   return bytes;
+}
+
+/*
+ * Returns the entry number of the page written from iovec, releasing the
+ * codec buffer it was compressed into, if any.
+ */
+static uint32
+clockcache_codec_finish_write(clockcache *cc, struct iovec *iovec)
+{
+   char  *data        = (char *)iovec->iov_base;
+   uint64 codec_bytes = clockcache_multiply_by_page_size(cc, cc->codec_bufs);
+   if (cc->codec_buf == NULL || data < cc->codec_buf
+       || data >= cc->codec_buf + codec_bytes)
+   {
+      return clockcache_data_to_entry_number(cc, data);
+   }
+   uint64 buf_no   = clockcache_divide_by_page_size(cc, data - cc->codec_buf);
+   uint32 entry_no = cc->codec_buf_entry[buf_no];
+   iovec->iov_len  = clockcache_page_size(cc);
+   cc->codec_buf_entry[buf_no] = CC_UNMAPPED_ENTRY;
+   return entry_no;
+}
+
+/*
+ * Expands the page just read into entry if it was written compressed.
+ */
+static inline void
+clockcache_codec_decode(clockcache *cc, clockcache_entry *entry)
+{
+   if (cc->cfg->branch_codec == NULL
+       || !page_codec_is_encoded(entry->page.data))
+   {
+      return;
+   }
+   uint64 page_size = clockcache_page_size(cc);
+   char  *scratch   = clockcache_codec_scratch(cc);
+   memcpy(scratch, entry->page.data, page_size);
+   bool32 decoded = page_codec_decode(
+      cc->cfg->branch_codec, scratch, page_size, entry->page.data);
+   platform_assert(decoded,
+                   "Corrupt compressed page at addr %lu\n",
+                   entry->page.disk_addr);
+}
+
 /*
  *-----------------------------------------------------------------------------
  * clockcache_wait --
@@ -1275,13 +1548,12 @@ clockcache_write_callback(void           *metadata,
 
    platform_assert_status_ok(status);
    platform_assert(count > 0);
-   platform_assert(count <= cc->cfg->pages_per_extent);
+   platform_assert(count <= cc->cfg->io_cfg->async_max_pages);
 
    for (i = 0; i < count; i++) {
-      entry_number =
-         clockcache_data_to_entry_number(cc, (char *)iovec[i].iov_base);
-      entry = clockcache_get_entry(cc, entry_number);
-      addr  = entry->page.disk_addr;
+      entry_number = clockcache_codec_finish_write(cc, &iovec[i]);
+      entry        = clockcache_get_entry(cc, entry_number);
+      addr         = entry->page.disk_addr;
 
       clockcache_log(addr,
                      entry_number,
@@ -1297,6 +1569,116 @@ clockcache_write_callback(void           *metadata,
    }
 }
 
+/*
+ *----------------------------------------------------------------------
+ * clockcache_entry_start_writeback --
+ *
+ *      Issues writeback for the page in the given entry if it is
+ *      cleanable. Where possible, the write is extended to the neighboring
+ *      cleanable pages on disk, in this or adjacent extents, up to
+ *      io_cfg->async_max_pages pages.
+ *
+ *      If is_urgent is set, pages with CC_ACCESSED are written back, otherwise
+ *      they are not.
+ *
+ *      Returns the number of pages written.
+ *----------------------------------------------------------------------
+ */
+static uint64
+clockcache_entry_start_writeback(clockcache *cc,
+                                 uint32      entry_no,
+                                 bool32      is_urgent)
+{
+   uint32            next_entry_no;
+   uint64            addr, first_addr, end_addr, i, req_count;
+   const threadid    tid   = platform_get_tid();
+   clockcache_entry *entry = &cc->entry[entry_no];
+   clockcache_entry *next_entry;
+   platform_status   status;
+
+   addr = entry->page.disk_addr;
+   // test and test and set
+   if (!clockcache_ok_to_writeback(cc, entry_no, is_urgent)
+       || !clockcache_try_set_writeback(cc, entry_no, is_urgent))
+   {
+      return 0;
+   }
+
+   uint64 page_size = clockcache_page_size(cc);
+   uint64 max_pages = cc->cfg->io_cfg->async_max_pages;
+   uint64 disk_size = allocator_get_capacity(cc->al);
+
+   debug_assert(clockcache_lookup(cc, addr) == entry_no);
+   /*
+    * Grow the write backwards and then forwards through cleanable pages at
+    * adjacent addresses, which may cross extent and batch boundaries.
+    * Pages compressed by the branch codec are written by themselves.
+    */
+   if (clockcache_codec_eligible(cc, entry)) {
+      max_pages = 1;
+   }
+   req_count  = 1;
+   first_addr = entry->page.disk_addr;
+   while (req_count < max_pages && first_addr >= page_size) {
+      next_entry_no = clockcache_lookup(cc, first_addr - page_size);
+      if (next_entry_no == CC_UNMAPPED_ENTRY
+          || clockcache_codec_eligible(cc, &cc->entry[next_entry_no])
+          || !clockcache_try_set_writeback(cc, next_entry_no, is_urgent))
+      {
+         break;
+      }
+      first_addr -= page_size;
+      req_count++;
+   }
+   end_addr = entry->page.disk_addr + page_size;
+   while (req_count < max_pages && end_addr < disk_size) {
+      next_entry_no = clockcache_lookup(cc, end_addr);
+      if (next_entry_no == CC_UNMAPPED_ENTRY
+          || clockcache_codec_eligible(cc, &cc->entry[next_entry_no])
+          || !clockcache_try_set_writeback(cc, next_entry_no, is_urgent))
+      {
+         break;
+      }
+      end_addr += page_size;
+      req_count++;
+   }
+   debug_assert(req_count
+                == clockcache_divide_by_page_size(cc, end_addr - first_addr));
+
+   io_async_req *req            = io_get_async_req(cc->io, TRUE);
+   void         *req_metadata   = io_get_metadata(cc->io, req);
+   *(clockcache **)req_metadata = cc;
+   struct iovec *iovec          = io_get_iovec(cc->io, req);
+
+   req->bytes = clockcache_multiply_by_page_size(cc, req_count);
+
+   if (cc->cfg->use_stats) {
+      cc->stats[tid].page_writes[entry->type] += req_count;
+      cc->stats[tid].writes_issued++;
+   }
+
+   for (i = 0; i < req_count; i++) {
+      addr          = first_addr + clockcache_multiply_by_page_size(cc, i);
+      next_entry    = clockcache_lookup_entry(cc, addr);
+      next_entry_no = clockcache_lookup(cc, addr);
+
+      clockcache_log_stream(addr,
+                            next_entry_no,
+                            "flush: entry %u addr %lu\n",
+                            next_entry_no,
+                            addr);
+      iovec[i].iov_base = next_entry->page.data;
+   }
+   if (req_count == 1) {
+      req->bytes = clockcache_codec_prepare_write(cc, entry_no, &iovec[0]);
+   }
+
+   status = io_write_async(
+      cc->io, req, clockcache_write_callback, req_count, first_addr);
+   platform_assert_status_ok(status);
+   return req_count;
+}
+
 /*
  *----------------------------------------------------------------------
  * clockcache_batch_start_writeback --
@@ -1314,14 +1696,10 @@ clockcache_write_callback(void           *metadata,
 void
 clockcache_batch_start_writeback(clockcache *cc, uint64 batch, bool32 is_urgent)
 {
-   uint32          entry_no, next_entry_no;
-   uint64          addr, first_addr, end_addr, i;
-   const threadid  tid            = platform_get_tid();
-   uint64          start_entry_no = batch * CC_ENTRIES_PER_BATCH;
-   uint64          end_entry_no   = start_entry_no + CC_ENTRIES_PER_BATCH;
-   platform_status status;
+   uint64 start_entry_no = batch * CC_ENTRIES_PER_BATCH;
+   uint64 end_entry_no   = start_entry_no + CC_ENTRIES_PER_BATCH;
 
-   clockcache_entry *entry, *next_entry;
+   debug_only const threadid tid = platform_get_tid();
 
    debug_assert((tid < MAX_THREADS), "Invalid tid=%lu\n", tid);
    debug_assert(cc != NULL);
@@ -1335,76 +1713,169 @@ clockcache_batch_start_writeback(clockcache *cc, uint64 batch, bool32 is_urgent)
                          start_entry_no,
                          end_entry_no - 1);
 
-   uint64 page_size = clockcache_page_size(cc);
-
-   allocator_config *allocator_cfg = allocator_get_config(cc->al);
    // Iterate through the entries in the batch and try to write out the extents.
-   for (entry_no = start_entry_no; entry_no < end_entry_no; entry_no++) {
-      entry = &cc->entry[entry_no];
-      addr  = entry->page.disk_addr;
-      // test and test and set in the if condition
-      if (clockcache_ok_to_writeback(cc, entry_no, is_urgent)
-          && clockcache_try_set_writeback(cc, entry_no, is_urgent))
+   for (uint32 entry_no = start_entry_no; entry_no < end_entry_no; entry_no++) {
+      clockcache_entry_start_writeback(cc, entry_no, is_urgent);
+   }
+   clockcache_close_log_stream();
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * background cleaner
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+clockcache_cleaner_slot_compare(const void *a, const void *b, void *unused)
+{
+   const clockcache_cleaner_slot *slot_a = a;
+   const clockcache_cleaner_slot *slot_b = b;
+   if (slot_a->addr < slot_b->addr) {
+      return -1;
+   }
+   return slot_a->addr > slot_b->addr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * clockcache_cleaner_pass --
+ *
+ *      Looks at the cleaner window, the cc->cleaner_gap batches following
+ *      the next batch the evictor will clean itself, and if fewer than
+ *      cfg->cleaner_clean_share percent of the pages the hand could evict
+ *      there are clean, writes back enough of the dirty ones to make up the
+ *      difference. Pages with CC_ACCESSED set are left alone, since the
+ *      hand will only clear the bit on its way past. Dirty pages are written
+ *      in address order so that neighbors coalesce into larger writes.
+ *
+ *      Returns the number of pages written.
+ *----------------------------------------------------------------------
+ */
+static uint64
+clockcache_cleaner_pass(clockcache *cc)
+{
+   uint64 batch_capacity = cc->cfg->batch_capacity;
+   uint64 window         = MIN(cc->cleaner_gap, batch_capacity - 1);
+   uint64 first_batch    = cc->evict_hand + cc->cleaner_gap + 1;
+   uint64 num_candidates = 0;
+   uint64 num_clean      = 0;
+   uint64 num_dirty      = 0;
+
+   for (uint64 b = 0; b < window; b++) {
+      uint64 batch          = (first_batch + b) % batch_capacity;
+      uint32 start_entry_no = batch * CC_ENTRIES_PER_BATCH;
+      for (uint32 entry_no = start_entry_no;
+           entry_no < start_entry_no + CC_ENTRIES_PER_BATCH;
+           entry_no++)
       {
-         debug_assert(clockcache_lookup(cc, addr) == entry_no);
-         first_addr = entry->page.disk_addr;
-         // walk backwards through extent to find first cleanable entry
-         do {
-            first_addr -= page_size;
-            if (allocator_config_pages_share_extent(
-                   allocator_cfg, first_addr, addr))
-               next_entry_no = clockcache_lookup(cc, first_addr);
-            else
-               next_entry_no = CC_UNMAPPED_ENTRY;
-         } while (
-            next_entry_no != CC_UNMAPPED_ENTRY
-            && clockcache_try_set_writeback(cc, next_entry_no, is_urgent));
-         first_addr += page_size;
-         end_addr = entry->page.disk_addr;
-         // walk forwards through extent to find last cleanable entry
-         do {
-            end_addr += page_size;
-            if (allocator_config_pages_share_extent(
-                   allocator_cfg, end_addr, addr))
-               next_entry_no = clockcache_lookup(cc, end_addr);
-            else
-               next_entry_no = CC_UNMAPPED_ENTRY;
-         } while (
-            next_entry_no != CC_UNMAPPED_ENTRY
-            && clockcache_try_set_writeback(cc, next_entry_no, is_urgent));
-
-         io_async_req *req            = io_get_async_req(cc->io, TRUE);
-         void         *req_metadata   = io_get_metadata(cc->io, req);
-         *(clockcache **)req_metadata = cc;
-         struct iovec *iovec          = io_get_iovec(cc->io, req);
-         uint64        req_count =
-            clockcache_divide_by_page_size(cc, end_addr - first_addr);
-         req->bytes = clockcache_multiply_by_page_size(cc, req_count);
-
-         if (cc->cfg->use_stats) {
-            cc->stats[tid].page_writes[entry->type] += req_count;
-            cc->stats[tid].writes_issued++;
+         uint32 status = clockcache_get_status(cc, entry_no);
+         if (status & CC_ACCESSED) {
+            /* survives the next pass of the hand whether clean or not */
+            continue;
          }
-
-         for (i = 0; i < req_count; i++) {
-            addr       = first_addr + clockcache_multiply_by_page_size(cc, i);
-            next_entry = clockcache_lookup_entry(cc, addr);
-            next_entry_no = clockcache_lookup(cc, addr);
-
-            clockcache_log_stream(addr,
-                                  next_entry_no,
-                                  "flush: entry %u addr %lu\n",
-                                  next_entry_no,
-                                  addr);
-            iovec[i].iov_base = next_entry->page.data;
+         num_candidates++;
+         if (status & (CC_FREE | CC_CLEAN | CC_WRITEBACK)) {
+            num_clean++;
+         } else if (clockcache_ok_to_writeback(cc, entry_no, FALSE)) {
+            clockcache_cleaner_slot *slot = &cc->cleaner_slot[num_dirty++];
+            slot->addr     = cc->entry[entry_no].page.disk_addr;
+            slot->entry_no = entry_no;
          }
-
-         status = io_write_async(
-            cc->io, req, clockcache_write_callback, req_count, first_addr);
-         platform_assert_status_ok(status);
       }
    }
+
+   uint64 target = num_candidates * cc->cfg->cleaner_clean_share / 100;
+   if (num_clean >= target || num_dirty == 0) {
+      return 0;
+   }
+
+   platform_sort_slow(cc->cleaner_slot,
+                      num_dirty,
+                      sizeof(*cc->cleaner_slot),
+                      clockcache_cleaner_slot_compare,
+                      NULL,
+                      NULL);
+
+   uint64 pages_written = 0;
+   clockcache_open_log_stream();
+   for (uint64 i = 0; i < num_dirty && num_clean + pages_written < target; i++)
+   {
+      pages_written += clockcache_entry_start_writeback(
+         cc, cc->cleaner_slot[i].entry_no, FALSE);
+   }
    clockcache_close_log_stream();
+   return pages_written;
+}
+
+static void
+clockcache_cleaner_thread(void *arg)
+{
+   clockcache *cc = (clockcache *)arg;
+
+   while (!cc->cleaner_stop) {
+      uint64 pages_written = clockcache_cleaner_pass(cc);
+      clockcache_wait(cc);
+      if (pages_written == 0) {
+         platform_sleep_ns(CC_CLEANER_IDLE_NS);
+      }
+   }
+   io_cleanup(cc->io, 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ * clockcache_start_cleaner --
+ *
+ *      Starts the background cleaner, if cfg->cleaner_clean_share is set.
+ *      It runs until clockcache_deinit.
+ *----------------------------------------------------------------------
+ */
+platform_status
+clockcache_start_cleaner(clockcache *cc, task_system *ts)
+{
+   if (cc->cfg->cleaner_clean_share == 0) {
+      return STATUS_OK;
+   }
+   platform_assert(!cc->cleaner_running);
+
+   uint64 window = MIN(cc->cleaner_gap, cc->cfg->batch_capacity - 1);
+   cc->cleaner_slot =
+      TYPED_ARRAY_MALLOC(cc->heap_id,
+                         cc->cleaner_slot,
+                         MAX(1, window * CC_ENTRIES_PER_BATCH));
+   if (cc->cleaner_slot == NULL) {
+      return STATUS_NO_MEMORY;
+   }
+
+   cc->cleaner_stop   = FALSE;
+   platform_status rc = task_thread_create("clockcache_cleaner",
+                                           clockcache_cleaner_thread,
+                                           cc,
+                                           0,
+                                           ts,
+                                           cc->heap_id,
+                                           &cc->cleaner_thread);
+   if (!SUCCESS(rc)) {
+      platform_free(cc->heap_id, cc->cleaner_slot);
+      return rc;
+   }
+   cc->cleaner_running = TRUE;
+   return STATUS_OK;
+}
+
+static void
+clockcache_stop_cleaner(clockcache *cc)
+{
+   if (!cc->cleaner_running) {
+      return;
+   }
+   cc->cleaner_stop = TRUE;
+   platform_thread_join(cc->cleaner_thread);
+   cc->cleaner_running = FALSE;
+   platform_free(cc->heap_id, cc->cleaner_slot);
 }
 
 /*
@@ -1419,17 +1890,33 @@ clockcache_batch_start_writeback(clockcache *cc, uint64 batch, bool32 is_urgent)
  *----------------------------------------------------------------------
  * clockcache_try_evict
  *
- *      Attempts to evict the page if it is evictable
+ *      Attempts to evict the page if it is evictable.
+ *
+ *      pass is the number of full passes the calling thread has made over
+ *      the cache; it determines whether per-page-type protections apply.
  *----------------------------------------------------------------------
  */
 static void
-clockcache_try_evict(clockcache *cc, uint32 entry_number)
+clockcache_try_evict(clockcache *cc, uint32 entry_number, uint64 pass)
 {
    clockcache_entry *entry = clockcache_get_entry(cc, entry_number);
    const threadid    tid   = platform_get_tid();
 
    /* store status for testing, then clear CC_ACCESSED */
    uint32 status = entry->status;
+   if (status & CC_FREE) {
+      goto out;
+   }
+
+   page_type type = entry->type;
+   if (clockcache_type_protected(cc, type, pass)) {
+      goto out;
+   }
+   /* pages of a type over its share lose the benefit of the access bit */
+   if (clockcache_type_over_share(cc, type)) {
+      status &= ~CC_ACCESSED;
+   }
+
    /* T&T&S */
    if (clockcache_test_flag(cc, entry_number, CC_ACCESSED)) {
       clockcache_clear_flag(cc, entry_number, CC_ACCESSED);
@@ -1495,9 +1982,14 @@ clockcache_try_evict(clockcache *cc, uint32 entry_number)
    /* 5. clear lookup, disk addr */
    uint64 addr = entry->page.disk_addr;
    if (addr != CC_UNMAPPED_ADDR) {
+      if (entry->prefetched && cc->cfg->use_stats) {
+         cc->stats[tid].prefetch_unused[type]++;
+      }
+      clockcache_zcache_store(cc, entry);
       uint64 lookup_no      = clockcache_divide_by_page_size(cc, addr);
       cc->lookup[lookup_no] = CC_UNMAPPED_ENTRY;
       entry->page.disk_addr = CC_UNMAPPED_ADDR;
+      clockcache_entry_clear_type(cc, entry);
    }
    debug_only uint32 debug_status =
       clockcache_test_flag(cc, entry_number, CC_WRITELOCKED | CC_CLAIMED);
@@ -1527,11 +2019,12 @@ out:
  *----------------------------------------------------------------------
  * clockcache_evict_batch --
  *
- *      Evicts all evictable pages in the batch.
+ *      Evicts all evictable pages in the batch, subject to the per-page-type
+ *      protections for the given pass (see clockcache_try_evict).
  *----------------------------------------------------------------------
  */
 void
-clockcache_evict_batch(clockcache *cc, uint32 batch)
+clockcache_evict_batch(clockcache *cc, uint32 batch, uint64 pass)
 {
    debug_assert(cc != NULL);
    debug_assert(batch < cc->cfg->page_capacity / CC_ENTRIES_PER_BATCH);
@@ -1547,7 +2040,7 @@ clockcache_evict_batch(clockcache *cc, uint32 batch)
                   end_entry_no - 1);
 
    for (uint32 entry_no = start_entry_no; entry_no < end_entry_no; entry_no++) {
-      clockcache_try_evict(cc, entry_no);
+      clockcache_try_evict(cc, entry_no, pass);
    }
 }
 
@@ -1555,15 +2048,17 @@ clockcache_evict_batch(clockcache *cc, uint32 batch)
  *----------------------------------------------------------------------
  * clockcache_move_hand --
  *
- *      Moves the clock hand forward cleaning and evicting a batch. Cleans
- *      "accessed" pages if is_urgent is set, for example when get_free_page
- *      has cycled through the cache already.
+ *      Moves the clock hand forward cleaning and evicting a batch. pass is
+ *      the number of times get_free_page has cycled through the cache. Once
+ *      it has cycled through at least once, the move is urgent and
+ *      "accessed" pages are cleaned as well.
  *----------------------------------------------------------------------
  */
 void
-clockcache_move_hand(clockcache *cc, bool32 is_urgent)
+clockcache_move_hand(clockcache *cc, uint64 pass)
 {
-   const threadid   tid = platform_get_tid();
+   const threadid   tid       = platform_get_tid();
+   bool32           is_urgent = pass != 0;
    volatile bool32 *evict_batch_busy;
    volatile bool32 *clean_batch_busy;
    uint64           cleaner_hand;
@@ -1590,7 +2085,7 @@ clockcache_move_hand(clockcache *cc, bool32 is_urgent)
       }
    } while (!__sync_bool_compare_and_swap(evict_batch_busy, FALSE, TRUE));
 
-   clockcache_evict_batch(cc, evict_hand % cc->cfg->batch_capacity);
+   clockcache_evict_batch(cc, evict_hand % cc->cfg->batch_capacity, pass);
    cc->per_thread[tid].free_hand = evict_hand % cc->cfg->batch_capacity;
 }
 
@@ -1617,7 +2112,7 @@ clockcache_get_free_page(clockcache *cc,
 
    debug_assert((tid < MAX_THREADS), "Invalid tid=%lu\n", tid);
    if (cc->per_thread[tid].free_hand == CC_UNMAPPED_ENTRY) {
-      clockcache_move_hand(cc, FALSE);
+      clockcache_move_hand(cc, 0);
    }
 
    /*
@@ -1639,13 +2134,14 @@ clockcache_get_free_page(clockcache *cc,
             if (refcount) {
                clockcache_inc_ref(cc, entry_no, tid);
             }
-            entry->status = status;
+            entry->status     = status;
+            entry->prefetched = FALSE;
             debug_assert(entry->page.disk_addr == CC_UNMAPPED_ADDR);
             return entry_no;
          }
       }
 
-      clockcache_move_hand(cc, num_passes != 0);
+      clockcache_move_hand(cc, num_passes);
       if (cc->per_thread[tid].free_hand < max_hand) {
          num_passes++;
          /*
@@ -1726,9 +2222,9 @@ clockcache_evict_all(clockcache *cc, bool32 ignore_pinned_pages)
 
    // evict all the pages
    for (evict_hand = 0; evict_hand < cc->cfg->batch_capacity; evict_hand++) {
-      clockcache_evict_batch(cc, evict_hand);
+      clockcache_evict_batch(cc, evict_hand, CC_UNPROTECTED_PASS);
       // Do it again for access bits
-      clockcache_evict_batch(cc, evict_hand);
+      clockcache_evict_batch(cc, evict_hand, CC_UNPROTECTED_PASS);
    }
 
    for (i = 0; i < cc->cfg->page_capacity; i++) {
@@ -1803,6 +2299,38 @@ clockcache_init(clockcache        *cc,   // OUT
    platform_assert(cc->cfg->capacity == debug_capacity);
    platform_assert(cc->cfg->page_capacity % CC_ENTRIES_PER_BATCH == 0);
 
+   uint64 total_min_share = 0;
+   for (page_type type = 0; type < NUM_PAGE_TYPES; type++) {
+      uint64 min_share = cc->cfg->type_min_share[type];
+      uint64 max_share = cc->cfg->type_max_share[type];
+      if (min_share > 100 || max_share > 100
+          || (max_share != 0 && min_share > max_share))
+      {
+         platform_error_log("clockcache: invalid share for page type %s: "
+                            "min=%lu%% max=%lu%%\n",
+                            page_type_str[type],
+                            min_share,
+                            max_share);
+         return STATUS_BAD_PARAM;
+      }
+      total_min_share += min_share;
+      cc->cfg->type_min_pages[type] =
+         cc->cfg->page_capacity * min_share / 100;
+      cc->cfg->type_max_pages[type] =
+         cc->cfg->page_capacity * max_share / 100;
+   }
+   if (total_min_share > 100) {
+      platform_error_log("clockcache: minimum page type shares sum to "
+                         "%lu%% of the cache\n",
+                         total_min_share);
+      return STATUS_BAD_PARAM;
+   }
+   if (cc->cfg->cleaner_clean_share > 100) {
+      platform_error_log("clockcache: invalid cleaner clean share %lu%%\n",
+                         cc->cfg->cleaner_clean_share);
+      return STATUS_BAD_PARAM;
+   }
+
    cc->cleaner_gap = CC_CLEANER_GAP;
 
 #if defined(CC_LOG) || defined(ADDR_TRACING)
@@ -1881,6 +2409,38 @@ clockcache_init(clockcache        *cc,   // OUT
       goto alloc_error;
    }
 
+   if (cc->cfg->compressed_capacity != 0) {
+      rc = zcache_init(&cc->zc,
+                       cc->cfg->compressed_capacity,
+                       clockcache_page_size(cc),
+                       cc->heap_id);
+      if (!SUCCESS(rc)) {
+         goto alloc_error;
+      }
+   }
+
+   if (cc->cfg->branch_codec != NULL) {
+      /* codec buffers for async writes, followed by per-thread scratch */
+      cc->codec_bufs = cc->cfg->io_cfg->async_queue_size;
+      rc             = platform_buffer_init(
+         &cc->codec_bh,
+         clockcache_multiply_by_page_size(cc, cc->codec_bufs + MAX_THREADS));
+      if (!SUCCESS(rc)) {
+         goto alloc_error;
+      }
+      cc->codec_buf = platform_buffer_getaddr(&cc->codec_bh);
+      cc->codec_scratch =
+         cc->codec_buf + clockcache_multiply_by_page_size(cc, cc->codec_bufs);
+      cc->codec_buf_entry =
+         TYPED_ARRAY_MALLOC(cc->heap_id, cc->codec_buf_entry, cc->codec_bufs);
+      if (!cc->codec_buf_entry) {
+         goto alloc_error;
+      }
+      for (i = 0; i < cc->codec_bufs; i++) {
+         cc->codec_buf_entry[i] = CC_UNMAPPED_ENTRY;
+      }
+   }
+
    return STATUS_OK;
 
 alloc_error:
@@ -1899,6 +2459,8 @@ clockcache_deinit(clockcache *cc) // IN/OUT
 {
    platform_assert(cc != NULL);
 
+   clockcache_stop_cleaner(cc);
+
    if (cc->logfile) {
       clockcache_log(0, 0, "deinit %s\n", "");
 #if defined(CC_LOG) || defined(ADDR_TRACING)
@@ -1935,6 +2497,17 @@ clockcache_deinit(clockcache *cc) // IN/OUT
    if (cc->batch_busy) {
       platform_free_volatile(cc->heap_id, cc->batch_busy);
    }
+   if (cc->cfg->compressed_capacity != 0) {
+      zcache_deinit(&cc->zc);
+   }
+   if (cc->codec_buf) {
+      rc = platform_buffer_deinit(&cc->codec_bh);
+      debug_assert(SUCCESS(rc), "rc=%s", platform_status_to_string(rc));
+      cc->codec_buf = NULL;
+   }
+   if (cc->codec_buf_entry) {
+      platform_free_volatile(cc->heap_id, cc->codec_buf_entry);
+   }
 }
 
 /*
@@ -1954,7 +2527,9 @@ clockcache_alloc(clockcache *cc, uint64 addr, page_type type)
                                               TRUE); // blocking
    clockcache_entry *entry    = &cc->entry[entry_no];
    entry->page.disk_addr      = addr;
-   entry->type                = type;
+   entry->page.version |= 1; // returned write locked
+   clockcache_entry_set_type(cc, entry, type);
+   clockcache_zcache_invalidate(cc, addr);
    uint64 lookup_no = clockcache_divide_by_page_size(cc, entry->page.disk_addr);
    cc->lookup[lookup_no] = entry_no;
 
@@ -1980,6 +2555,7 @@ clockcache_try_page_discard(clockcache *cc, uint64 addr)
    while (TRUE) {
       uint32 entry_number = clockcache_lookup(cc, addr);
       if (entry_number == CC_UNMAPPED_ENTRY) {
+         clockcache_zcache_invalidate(cc, addr);
          clockcache_log(addr,
                         entry_number,
                         "try_discard_page (uncached): entry %u addr %lu\n",
@@ -2043,6 +2619,7 @@ clockcache_try_page_discard(clockcache *cc, uint64 addr)
       cc->lookup[lookup_no] = CC_UNMAPPED_ENTRY;
       debug_assert(entry->page.disk_addr == addr);
       entry->page.disk_addr = CC_UNMAPPED_ADDR;
+      clockcache_entry_clear_type(cc, entry);
 
       /* 6. set status to CC_FREE_STATUS (clears claim and write lock) */
       entry->status = CC_FREE_STATUS;
@@ -2052,6 +2629,7 @@ clockcache_try_page_discard(clockcache *cc, uint64 addr)
 
       /* 8. release read lock */
       clockcache_dec_ref(cc, entry_number, tid);
+      clockcache_zcache_invalidate(cc, addr);
       return;
    }
 }
@@ -2191,6 +2769,7 @@ clockcache_get_internal(clockcache   *cc,       // IN
       if (cc->cfg->use_stats) {
          cc->stats[tid].cache_hits[type]++;
       }
+      clockcache_note_prefetch_hit(cc, entry, type, tid);
       clockcache_log(addr,
                      entry_number,
                      "get (cached): entry %u addr %lu rc %u\n",
@@ -2228,12 +2807,17 @@ clockcache_get_internal(clockcache   *cc,       // IN
 
    /* Set up the page */
    entry->page.disk_addr = addr;
+   clockcache_entry_set_type(cc, entry, type);
+   if (clockcache_zcache_load(cc, entry)) {
+      goto loaded;
+   }
    if (cc->cfg->use_stats) {
       start = platform_get_timestamp();
    }
 
    status = io_read(cc->io, entry->page.data, page_size, addr);
    platform_assert_status_ok(status);
+   clockcache_codec_decode(cc, entry);
 
    if (cc->cfg->use_stats) {
       elapsed = platform_timestamp_elapsed(start);
@@ -2242,6 +2826,7 @@ clockcache_get_internal(clockcache   *cc,       // IN
       cc->stats[tid].cache_miss_time_ns[type] += elapsed;
    }
 
+loaded:
    clockcache_log(addr,
                   entry_number,
                   "get (load): entry %u addr %lu\n",
@@ -2283,6 +2868,24 @@ clockcache_get(clockcache *cc, uint64 addr, bool32 blocking, page_type type)
    }
 }
 
+/*
+ *----------------------------------------------------------------------
+ * clockcache_get_pinned --
+ *
+ *      Returns a pointer to the page_handle for the pinned page with address
+ *      addr, without a read lock. The page is read optimistically, see
+ *      cache_get_pinned.
+ *----------------------------------------------------------------------
+ */
+page_handle *
+clockcache_get_pinned(clockcache *cc, uint64 addr)
+{
+   uint32 entry_number = clockcache_lookup(cc, addr);
+   debug_assert(entry_number != CC_UNMAPPED_ENTRY);
+   debug_assert(clockcache_get_pin(cc, entry_number));
+   return &clockcache_get_entry(cc, entry_number)->page;
+}
+
 /*
  *----------------------------------------------------------------------
  * clockcache_read_async_callback --
@@ -2307,6 +2910,7 @@ clockcache_read_async_callback(void           *metadata,
    clockcache_entry *entry = clockcache_get_entry(cc, entry_number);
    uint64            addr  = entry->page.disk_addr;
    debug_assert(addr != CC_UNMAPPED_ADDR);
+   clockcache_codec_decode(cc, entry);
 
    if (cc->cfg->use_stats) {
       threadid tid = platform_get_tid();
@@ -2410,6 +3014,7 @@ clockcache_get_async(clockcache       *cc,   // IN
       if (cc->cfg->use_stats) {
          cc->stats[tid].cache_hits[type]++;
       }
+      clockcache_note_prefetch_hit(cc, entry, type, tid);
       clockcache_log(addr,
                      entry_number,
                      "get (cached): entry %u addr %lu rc %u\n",
@@ -2455,7 +3060,17 @@ clockcache_get_async(clockcache       *cc,   // IN
 
    /* Set up the page */
    entry->page.disk_addr = addr;
-   entry->type           = type;
+   clockcache_entry_set_type(cc, entry, type);
+   if (clockcache_zcache_load(cc, entry)) {
+      clockcache_clear_flag(cc, entry_number, CC_LOADING);
+      clockcache_log(addr,
+                     entry_number,
+                     "async_get (compressed): entry %u addr %lu\n",
+                     entry_number,
+                     addr);
+      ctxt->page = &entry->page;
+      return async_success;
+   }
    if (cc->cfg->use_stats) {
       ctxt->stats.issue_ts = platform_get_timestamp();
    }
@@ -2464,6 +3079,7 @@ clockcache_get_async(clockcache       *cc,   // IN
    if (req == NULL) {
       cc->lookup[lookup_no] = CC_UNMAPPED_ENTRY;
       entry->page.disk_addr = CC_UNMAPPED_ADDR;
+      clockcache_entry_clear_type(cc, entry);
       entry->status         = CC_FREE_STATUS;
       clockcache_dec_ref(cc, entry_number, tid);
       clockcache_log(addr,
@@ -2600,6 +3216,9 @@ clockcache_lock(clockcache *cc, page_handle *page)
                   entry_number,
                   page->disk_addr);
    clockcache_get_write(cc, entry_number);
+   // odd while write locked, for optimistic readers, see cache_get_pinned
+   page->version |= 1;
+   __sync_synchronize();
 }
 
 void
@@ -2613,6 +3232,8 @@ clockcache_unlock(clockcache *cc, page_handle *page)
                   "unlock: entry %u addr %lu\n",
                   entry_number,
                   page->disk_addr);
+   __sync_synchronize();
+   page->version = (page->version | 1) + 1;
    debug_only uint32 was_writing =
       clockcache_clear_flag(cc, entry_number, CC_WRITELOCKED);
    debug_assert(was_writing);
@@ -2715,14 +3336,24 @@ clockcache_page_sync(clockcache  *cc,
       void *req_metadata           = io_get_metadata(cc->io, req);
       *(clockcache **)req_metadata = cc;
       uint64 req_count             = 1;
-      req->bytes        = clockcache_multiply_by_page_size(cc, req_count);
-      iovec             = io_get_iovec(cc->io, req);
-      iovec[0].iov_base = page->data;
-      status            = io_write_async(
+      iovec                        = io_get_iovec(cc->io, req);
+      req->bytes = clockcache_codec_prepare_write(cc, entry_number, &iovec[0]);
+      status     = io_write_async(
          cc->io, req, clockcache_write_callback, req_count, addr);
       platform_assert_status_ok(status);
    } else {
-      status = io_write(cc->io, page->data, clockcache_page_size(cc), addr);
+      clockcache_entry *entry = clockcache_get_entry(cc, entry_number);
+      char             *data  = page->data;
+      uint64            bytes = clockcache_page_size(cc);
+      if (clockcache_codec_eligible(cc, entry)) {
+         char  *scratch = clockcache_codec_scratch(cc);
+         uint64 encoded = clockcache_codec_encode(cc, entry, scratch);
+         if (encoded != 0) {
+            data  = scratch;
+            bytes = encoded;
+         }
+      }
+      status = io_write(cc->io, data, bytes, addr);
       platform_assert_status_ok(status);
       clockcache_log(addr,
                      entry_number,
@@ -2762,9 +3393,9 @@ clockcache_sync_callback(void           *arg,
                          platform_status status)
 {
    clockcache_sync_callback_req *req = (clockcache_sync_callback_req *)arg;
-   uint64 pages_written = clockcache_divide_by_page_size(req->cc, count);
-   clockcache_write_callback(req->cc, iovec, count, status);
-   __sync_fetch_and_sub(req->pages_outstanding, pages_written);
+   // req starts with the clockcache pointer clockcache_write_callback expects
+   clockcache_write_callback(&req->cc, iovec, count, status);
+   __sync_fetch_and_sub(req->pages_outstanding, count);
 }
 
 /*
@@ -2791,41 +3422,56 @@ clockcache_extent_sync(clockcache *cc, uint64 addr, uint64 *pages_outstanding)
    io_async_req   *io_req;
    struct iovec   *iovec;
    platform_status status;
+   bool32          writable, alone;
 
    for (i = 0; i < cc->cfg->pages_per_extent; i++) {
       page_addr    = addr + clockcache_multiply_by_page_size(cc, i);
       entry_number = clockcache_lookup(cc, page_addr);
-      if (entry_number != CC_UNMAPPED_ENTRY
-          && clockcache_try_set_writeback(cc, entry_number, TRUE))
-      {
-         if (req_count == 0) {
-            req_addr = page_addr;
-            io_req   = io_get_async_req(cc->io, TRUE);
-            clockcache_sync_callback_req *cc_req =
-               (clockcache_sync_callback_req *)io_get_metadata(cc->io, io_req);
-            cc_req->cc                = cc;
-            cc_req->pages_outstanding = pages_outstanding;
-            iovec                     = io_get_iovec(cc->io, io_req);
-         }
-         iovec[req_count++].iov_base =
-            clockcache_get_entry(cc, entry_number)->page.data;
-      } else {
+      writable     = entry_number != CC_UNMAPPED_ENTRY
+                 && clockcache_try_set_writeback(cc, entry_number, TRUE);
+      // pages compressed by the branch codec are written by themselves
+      alone = writable
+              && clockcache_codec_eligible(
+                 cc, clockcache_get_entry(cc, entry_number));
+      if (req_count != 0 && (!writable || alone)) {
+         __sync_fetch_and_add(pages_outstanding, req_count);
+         io_req->bytes = clockcache_multiply_by_page_size(cc, req_count);
+         status        = io_write_async(
+            cc->io, io_req, clockcache_sync_callback, req_count, req_addr);
+         platform_assert_status_ok(status);
+         req_count = 0;
+      }
+      if (!writable) {
          // ALEX: There is maybe a race with eviction with this assertion
          debug_assert(entry_number == CC_UNMAPPED_ENTRY
                       || clockcache_test_flag(cc, entry_number, CC_CLEAN));
-         if (req_count != 0) {
-            __sync_fetch_and_add(pages_outstanding, req_count);
-            io_req->bytes = clockcache_multiply_by_page_size(cc, req_count);
-            status        = io_write_async(
-               cc->io, io_req, clockcache_sync_callback, req_count, req_addr);
-            platform_assert_status_ok(status);
-            req_count = 0;
-         }
+         continue;
+      }
+      if (req_count == 0) {
+         req_addr = page_addr;
+         io_req   = io_get_async_req(cc->io, TRUE);
+         clockcache_sync_callback_req *cc_req =
+            (clockcache_sync_callback_req *)io_get_metadata(cc->io, io_req);
+         cc_req->cc                = cc;
+         cc_req->pages_outstanding = pages_outstanding;
+         iovec                     = io_get_iovec(cc->io, io_req);
+      }
+      if (alone) {
+         __sync_fetch_and_add(pages_outstanding, 1);
+         io_req->bytes =
+            clockcache_codec_prepare_write(cc, entry_number, &iovec[0]);
+         status = io_write_async(
+            cc->io, io_req, clockcache_sync_callback, 1, req_addr);
+         platform_assert_status_ok(status);
+         continue;
       }
+      iovec[req_count++].iov_base =
+         clockcache_get_entry(cc, entry_number)->page.data;
    }
    if (req_count != 0) {
       __sync_fetch_and_add(pages_outstanding, req_count);
-      status = io_write_async(
+      io_req->bytes = clockcache_multiply_by_page_size(cc, req_count);
+      status        = io_write_async(
          cc->io, io_req, clockcache_sync_callback, req_count, req_addr);
       platform_assert_status_ok(status);
    }
@@ -2868,6 +3514,7 @@ clockcache_prefetch_callback(void           *metadata,
       } else {
          type = entry->type;
       }
+      clockcache_codec_decode(cc, entry);
       debug_only uint32 was_loading =
          clockcache_clear_flag(cc, entry_no, CC_LOADING);
       debug_assert(was_loading);
@@ -2887,6 +3534,29 @@ clockcache_prefetch_callback(void           *metadata,
    }
 }
 
+/*
+ * Issues the pending prefetch IO request, if one was started.
+ */
+static void
+clockcache_prefetch_issue(clockcache   *cc,
+                          io_async_req *req,
+                          uint64       *pages_in_req,
+                          uint64       *req_start_addr)
+{
+   if (*pages_in_req == 0) {
+      return;
+   }
+   req->bytes         = clockcache_multiply_by_page_size(cc, *pages_in_req);
+   platform_status rc = io_read_async(cc->io,
+                                      req,
+                                      clockcache_prefetch_callback,
+                                      *pages_in_req,
+                                      *req_start_addr);
+   platform_assert_status_ok(rc);
+   *pages_in_req   = 0;
+   *req_start_addr = CC_UNMAPPED_ADDR;
+}
+
 /*
  *-----------------------------------------------------------------------------
  * clockcache_prefetch --
@@ -2897,7 +3567,7 @@ clockcache_prefetch_callback(void           *metadata,
 void
 clockcache_prefetch(clockcache *cc, uint64 base_addr, page_type type)
 {
-   io_async_req *req;
+   io_async_req *req              = NULL;
    struct iovec *iovec;
    uint64        pages_per_extent = cc->cfg->pages_per_extent;
    uint64        pages_in_req     = 0;
@@ -2923,17 +3593,7 @@ clockcache_prefetch(clockcache *cc, uint64 base_addr, page_type type)
             // fallthrough
          case GET_RC_CONFLICT:
             // in cache, issue IO req if started
-            if (pages_in_req != 0) {
-               req->bytes = clockcache_multiply_by_page_size(cc, pages_in_req);
-               platform_status rc = io_read_async(cc->io,
-                                                  req,
-                                                  clockcache_prefetch_callback,
-                                                  pages_in_req,
-                                                  req_start_addr);
-               platform_assert_status_ok(rc);
-               pages_in_req   = 0;
-               req_start_addr = CC_UNMAPPED_ADDR;
-            }
+            clockcache_prefetch_issue(cc, req, &pages_in_req, &req_start_addr);
             clockcache_log(addr,
                            entry_no,
                            "prefetch (cached): entry %u addr %lu\n",
@@ -2947,11 +3607,24 @@ clockcache_prefetch(clockcache *cc, uint64 base_addr, page_type type)
                cc, CC_READ_LOADING_STATUS, FALSE, TRUE);
             clockcache_entry *entry = &cc->entry[free_entry_no];
             entry->page.disk_addr   = addr;
-            entry->type             = type;
             uint64 lookup_no        = clockcache_divide_by_page_size(cc, addr);
             if (__sync_bool_compare_and_swap(
                    &cc->lookup[lookup_no], CC_UNMAPPED_ENTRY, free_entry_no))
             {
+               clockcache_entry_set_type(cc, entry, type);
+               entry->prefetched = TRUE;
+               if (clockcache_zcache_load(cc, entry)) {
+                  // loaded from the compressed tier, issue IO req if started
+                  clockcache_clear_flag(cc, free_entry_no, CC_LOADING);
+                  clockcache_prefetch_issue(
+                     cc, req, &pages_in_req, &req_start_addr);
+                  clockcache_log(addr,
+                                 free_entry_no,
+                                 "prefetch (compressed): entry %u addr %lu\n",
+                                 free_entry_no,
+                                 addr);
+                  break;
+               }
                if (pages_in_req == 0) {
                   debug_assert(req_start_addr == CC_UNMAPPED_ADDR);
                   // start a new IO req
@@ -2983,17 +3656,7 @@ clockcache_prefetch(clockcache *cc, uint64 base_addr, page_type type)
       }
    }
    // issue IO req if started
-   if (pages_in_req != 0) {
-      req->bytes         = clockcache_multiply_by_page_size(cc, pages_in_req);
-      platform_status rc = io_read_async(cc->io,
-                                         req,
-                                         clockcache_prefetch_callback,
-                                         pages_in_req,
-                                         req_start_addr);
-      pages_in_req       = 0;
-      req_start_addr     = CC_UNMAPPED_ADDR;
-      platform_assert_status_ok(rc);
-   }
+   clockcache_prefetch_issue(cc, req, &pages_in_req, &req_start_addr);
 }
 
 /*
@@ -3105,6 +3768,17 @@ clockcache_print_stats(platform_log_handle *log_handle, clockcache *cc)
          global_stats.page_reads[type] += cc->stats[i].page_reads[type];
          global_stats.prefetches_issued[type] +=
             cc->stats[i].prefetches_issued[type];
+         global_stats.prefetch_hits[type] += cc->stats[i].prefetch_hits[type];
+         global_stats.prefetch_unused[type] +=
+            cc->stats[i].prefetch_unused[type];
+         global_stats.compressed_hits[type] +=
+            cc->stats[i].compressed_hits[type];
+         global_stats.compressed_stores[type] +=
+            cc->stats[i].compressed_stores[type];
+         global_stats.write_bytes_saved[type] +=
+            cc->stats[i].write_bytes_saved[type];
+         global_stats.disk_bytes_freed[type] +=
+            cc->stats[i].disk_bytes_freed[type];
       }
       global_stats.writes_issued += cc->stats[i].writes_issued;
       global_stats.syncs_issued += cc->stats[i].syncs_issued;
@@ -3167,6 +3841,55 @@ clockcache_print_stats(platform_log_handle *log_handle, clockcache *cc)
          global_stats.page_reads[PAGE_TYPE_FILTER],
          global_stats.page_reads[PAGE_TYPE_LOG],
          global_stats.page_reads[PAGE_TYPE_SUPERBLOCK]);
+   platform_log(log_handle, "prefetch hits   | %10lu | %10lu | %10lu | %10lu | %10lu | %10lu |\n",
+         global_stats.prefetch_hits[PAGE_TYPE_TRUNK],
+         global_stats.prefetch_hits[PAGE_TYPE_BRANCH],
+         global_stats.prefetch_hits[PAGE_TYPE_MEMTABLE],
+         global_stats.prefetch_hits[PAGE_TYPE_FILTER],
+         global_stats.prefetch_hits[PAGE_TYPE_LOG],
+         global_stats.prefetch_hits[PAGE_TYPE_SUPERBLOCK]);
+   platform_log(log_handle, "prefetch unused | %10lu | %10lu | %10lu | %10lu | %10lu | %10lu |\n",
+         global_stats.prefetch_unused[PAGE_TYPE_TRUNK],
+         global_stats.prefetch_unused[PAGE_TYPE_BRANCH],
+         global_stats.prefetch_unused[PAGE_TYPE_MEMTABLE],
+         global_stats.prefetch_unused[PAGE_TYPE_FILTER],
+         global_stats.prefetch_unused[PAGE_TYPE_LOG],
+         global_stats.prefetch_unused[PAGE_TYPE_SUPERBLOCK]);
+   platform_log(log_handle, "compressed hits | %10lu | %10lu | %10lu | %10lu | %10lu | %10lu |\n",
+         global_stats.compressed_hits[PAGE_TYPE_TRUNK],
+         global_stats.compressed_hits[PAGE_TYPE_BRANCH],
+         global_stats.compressed_hits[PAGE_TYPE_MEMTABLE],
+         global_stats.compressed_hits[PAGE_TYPE_FILTER],
+         global_stats.compressed_hits[PAGE_TYPE_LOG],
+         global_stats.compressed_hits[PAGE_TYPE_SUPERBLOCK]);
+   platform_log(log_handle, "compressed pgs  | %10lu | %10lu | %10lu | %10lu | %10lu | %10lu |\n",
+         global_stats.compressed_stores[PAGE_TYPE_TRUNK],
+         global_stats.compressed_stores[PAGE_TYPE_BRANCH],
+         global_stats.compressed_stores[PAGE_TYPE_MEMTABLE],
+         global_stats.compressed_stores[PAGE_TYPE_FILTER],
+         global_stats.compressed_stores[PAGE_TYPE_LOG],
+         global_stats.compressed_stores[PAGE_TYPE_SUPERBLOCK]);
+   platform_log(log_handle, "bytes unwritten | %10lu | %10lu | %10lu | %10lu | %10lu | %10lu |\n",
+         global_stats.write_bytes_saved[PAGE_TYPE_TRUNK],
+         global_stats.write_bytes_saved[PAGE_TYPE_BRANCH],
+         global_stats.write_bytes_saved[PAGE_TYPE_MEMTABLE],
+         global_stats.write_bytes_saved[PAGE_TYPE_FILTER],
+         global_stats.write_bytes_saved[PAGE_TYPE_LOG],
+         global_stats.write_bytes_saved[PAGE_TYPE_SUPERBLOCK]);
+   platform_log(log_handle, "bytes punched   | %10lu | %10lu | %10lu | %10lu | %10lu | %10lu |\n",
+         global_stats.disk_bytes_freed[PAGE_TYPE_TRUNK],
+         global_stats.disk_bytes_freed[PAGE_TYPE_BRANCH],
+         global_stats.disk_bytes_freed[PAGE_TYPE_MEMTABLE],
+         global_stats.disk_bytes_freed[PAGE_TYPE_FILTER],
+         global_stats.disk_bytes_freed[PAGE_TYPE_LOG],
+         global_stats.disk_bytes_freed[PAGE_TYPE_SUPERBLOCK]);
+   platform_log(log_handle, "resident pages  | %10ld | %10ld | %10ld | %10ld | %10ld | %10ld |\n",
+         cc->type_pages[PAGE_TYPE_TRUNK],
+         cc->type_pages[PAGE_TYPE_BRANCH],
+         cc->type_pages[PAGE_TYPE_MEMTABLE],
+         cc->type_pages[PAGE_TYPE_FILTER],
+         cc->type_pages[PAGE_TYPE_LOG],
+         cc->type_pages[PAGE_TYPE_SUPERBLOCK]);
    platform_log(log_handle, "avg prefetch pg |  " FRACTION_FMT(9, 2)" |  "
                 FRACTION_FMT(9, 2)" |  "FRACTION_FMT(9, 2)" |  "
                 FRACTION_FMT(9, 2)" |  "FRACTION_FMT(9, 2)" |  "
@@ -3197,6 +3920,12 @@ clockcache_reset_stats(clockcache *cc)
       memset(stats->cache_misses, 0, sizeof(stats->cache_misses));
       memset(stats->cache_miss_time_ns, 0, sizeof(stats->cache_miss_time_ns));
       memset(stats->page_writes, 0, sizeof(stats->page_writes));
+      memset(stats->prefetch_hits, 0, sizeof(stats->prefetch_hits));
+      memset(stats->prefetch_unused, 0, sizeof(stats->prefetch_unused));
+      memset(stats->compressed_hits, 0, sizeof(stats->compressed_hits));
+      memset(stats->compressed_stores, 0, sizeof(stats->compressed_stores));
+      memset(stats->write_bytes_saved, 0, sizeof(stats->write_bytes_saved));
+      memset(stats->disk_bytes_freed, 0, sizeof(stats->disk_bytes_freed));
    }
 }
 
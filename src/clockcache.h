@@ -12,6 +12,9 @@
 #include "allocator.h"
 #include "cache.h"
 #include "io.h"
+#include "task.h"
+#include "zcache.h"
+#include "page_codec.h"
 
 //#define ADDR_TRACING
 #define TRACE_ADDR  (UINT64_MAX - 1)
@@ -32,6 +35,36 @@ typedef struct clockcache_config {
    bool32       use_stats;
    char         logfile[MAX_STRING_LENGTH];
 
+   /*
+    * Per-page-type cache shares, in percent of capacity (0 = no limit).
+    * Pages of a type at or below its minimum share are skipped by the
+    * evictor; pages of a type above its maximum share are evicted even if
+    * they were recently accessed. If pin_trunk_pages is set, trunk pages
+    * are not evicted by the clock at all.
+    */
+   uint64 type_min_share[NUM_PAGE_TYPES];
+   uint64 type_max_share[NUM_PAGE_TYPES];
+   bool32 pin_trunk_pages;
+
+   /*
+    * Size in bytes of the compressed second tier, which keeps clean branch
+    * pages evicted from the cache (0 = disabled).
+    */
+   uint64 compressed_capacity;
+
+   /*
+    * If set, a background thread keeps this percentage of the evictable
+    * pages ahead of the cleaning hand clean (0 = disabled). See
+    * clockcache_start_cleaner.
+    */
+   uint64 cleaner_clean_share;
+
+   /*
+    * If set, branch pages are compressed with this codec when written back
+    * and decompressed when read (NULL = disabled). See page_codec.h.
+    */
+   const page_codec *branch_codec;
+
    // computed
    uint64 log_page_size;
    uint64 extent_mask;
@@ -39,6 +72,8 @@ typedef struct clockcache_config {
    uint64 batch_capacity;
    uint64 cacheline_capacity;
    uint64 pages_per_extent;
+   uint64 type_min_pages[NUM_PAGE_TYPES];
+   uint64 type_max_pages[NUM_PAGE_TYPES];
 } clockcache_config;
 
 typedef struct clockcache       clockcache;
@@ -59,6 +94,12 @@ typedef struct history_record {
 
 typedef uint32 entry_status; // Saved in clockcache_entry->status
 
+// Dirty page found by the background cleaner, sorted by address
+typedef struct clockcache_cleaner_slot {
+   uint64 addr;
+   uint32 entry_no;
+} clockcache_cleaner_slot;
+
 /*
  *-----------------------------------------------------------------------------
  * clockcache_entry --
@@ -71,6 +112,7 @@ struct clockcache_entry {
    page_handle           page;
    volatile entry_status status;
    page_type             type;
+   volatile bool32       prefetched; // loaded by prefetch, not yet read
 #ifdef RECORD_ACQUISITION_STACKS
    int            next_history_record;
    history_record history[NUM_HISTORY_RECORDS];
@@ -89,7 +131,7 @@ struct clockcache_entry {
  *      Each page in the cache has an entry cc->entry[entry_number] with:
  *         --status: flags, e.g. free, write locked, flushing, etc.
  *         --page: disk address and pointer to the page data
- *         --type: used for stats
+ *         --type: used for stats and per-page-type shares
  *
  *      Each page has a distributed ref count, accessed by
  *      clockcache_[get,inc,dec]_ref(cc, entry_number, tid) and stored in
@@ -106,6 +148,27 @@ struct clockcache_entry {
  *      cc->cleaner_gap batches ahead of the current evictor head, so that
  *      cleaned pages have time to flush before eviction. Both cleaning and
  *      eviction use cc->batch_busy to avoid conflicts and contention.
+ *
+ *      cc->type_pages[type] counts the resident pages of each page type, so
+ *      that the evictor can enforce cc->cfg->type_{min,max}_pages.
+ *
+ *      If cc->cfg->compressed_capacity is set, clean branch pages are
+ *      compressed into cc->zc as they are evicted, and misses are served
+ *      from there before going to disk. A page is never in both cc->zc and
+ *      the cache: loading it from cc->zc removes it, and allocating or
+ *      discarding an address drops its compressed copy.
+ *
+ *      If cc->cfg->cleaner_clean_share is set, a background thread also
+ *      writes back dirty pages, in address order, in the batches just past
+ *      the one to be cleaned next, so that allocating threads mostly find
+ *      them clean already.
+ *
+ *      If cc->cfg->branch_codec is set, branch pages are compressed into
+ *      cc->codec_buf on writeback, one page per write, and expanded in
+ *      place when they are read. The rest of the page's slot is discarded
+ *      on the io handle. A codec buffer is claimed after the IO request for
+ *      its write and released in the write callback, so there is always one
+ *      free for each IO request.
  *----------------------------------------------------------------------
  */
 struct clockcache {
@@ -132,6 +195,26 @@ struct clockcache {
    volatile bool32 *batch_busy;
    uint64           cleaner_gap;
 
+   // Resident pages per page type
+   volatile int64 type_pages[NUM_PAGE_TYPES];
+
+   // Compressed second tier for evicted pages
+   zcache zc;
+
+   // Buffers for compressed writes of branch pages, see branch_codec
+   buffer_handle    codec_bh;
+   char            *codec_buf;
+   volatile uint32 *codec_buf_entry; // entry being written, or free
+   uint64           codec_bufs;
+   volatile uint64  codec_buf_hand;
+   char            *codec_scratch; // one page per thread, for reads
+
+   // Background cleaner
+   platform_thread          cleaner_thread;
+   volatile bool32          cleaner_stop;
+   bool32                   cleaner_running;
+   clockcache_cleaner_slot *cleaner_slot;
+
    volatile struct {
       volatile uint32 free_hand;
       bool32          enable_sync_get;
@@ -166,3 +249,6 @@ clockcache_init(clockcache        *cc,   // OUT
 
 void
 clockcache_deinit(clockcache *cc); // IN
+
+platform_status
+clockcache_start_cleaner(clockcache *cc, task_system *ts);
@@ -26,7 +26,11 @@ typedef struct io_config {
    int    flags;
    uint32 perms;
 
-   // computed
+   /*
+    * Largest number of pages in a single async IO. io_config_init sets it
+    * to one extent; it may be raised to let the cache coalesce writeback of
+    * adjacent dirty extents into fewer, larger writes.
+    */
    uint64 async_max_pages;
 } io_config;
 
@@ -61,6 +65,7 @@ typedef void (*io_wait_all_fn)(io_handle *io);
 typedef void (*io_register_thread_fn)(io_handle *io);
 typedef void (*io_deregister_thread_fn)(io_handle *io);
 typedef bool32 (*io_max_latency_elapsed_fn)(io_handle *io, timestamp ts);
+typedef uint64 (*io_discard_fn)(io_handle *io, uint64 bytes, uint64 addr);
 
 typedef void *(*io_get_context_fn)(io_handle *io);
 
@@ -80,6 +85,7 @@ typedef struct io_ops {
    io_register_thread_fn     register_thread;
    io_deregister_thread_fn   deregister_thread;
    io_max_latency_elapsed_fn max_latency_elapsed;
+   io_discard_fn             discard;
    io_get_context_fn         get_context;
 } io_ops;
 
@@ -184,6 +190,20 @@ io_max_latency_elapsed(io_handle *io, timestamp ts)
    return TRUE;
 }
 
+/*
+ * Releases the storage backing the whole device blocks in [addr, addr +
+ * bytes), which then read as zeros. Returns the number of bytes released,
+ * which is 0 if the device cannot release storage.
+ */
+static inline uint64
+io_discard(io_handle *io, uint64 bytes, uint64 addr)
+{
+   if (io->ops->discard) {
+      return io->ops->discard(io, bytes, addr);
+   }
+   return 0;
+}
+
 /*
  *-----------------------------------------------------------------------------
  * io_config_init --
@@ -215,7 +235,5 @@ io_config_init(io_config  *io_cfg,
    io_cfg->perms             = perms;
    io_cfg->async_queue_size  = async_queue_depth;
    io_cfg->kernel_queue_size = async_queue_depth;
-
-   // computed values
-   io_cfg->async_max_pages = extent_size / page_size;
+   io_cfg->async_max_pages   = extent_size / page_size;
 }
@@ -0,0 +1,234 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * lz.c --
+ *
+ *     This file contains the implementation of the built-in LZ77 codec.
+ */
+
+#include "lz.h"
+
+#include "poison.h"
+
+#define LZ_HASH_LOG     12
+#define LZ_HASH_SIZE    (1 << LZ_HASH_LOG)
+#define LZ_MAX_OFFSET   UINT16_MAX
+#define LZ_NIBBLE_MAX   15
+#define LZ_SKIP_TRIGGER 6
+
+static inline uint32
+lz_read32(const uint8 *p)
+{
+   uint32 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static inline uint32
+lz_hash(uint32 v)
+{
+   return (v * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+/*
+ * Number of bytes needed to encode a length that overflows its nibble.
+ */
+static inline uint64
+lz_length_bytes(uint64 len)
+{
+   return len < LZ_NIBBLE_MAX ? 0 : (len - LZ_NIBBLE_MAX) / 255 + 1;
+}
+
+static inline uint8 *
+lz_write_length(uint8 *op, uint64 len)
+{
+   if (len < LZ_NIBBLE_MAX) {
+      return op;
+   }
+   len -= LZ_NIBBLE_MAX;
+   while (len >= 255) {
+      *op++ = 255;
+      len -= 255;
+   }
+   *op++ = (uint8)len;
+   return op;
+}
+
+/*
+ * Reads the continuation bytes of a length whose nibble was 15. Returns FALSE
+ * if the input runs out first.
+ */
+static inline bool32
+lz_read_length(const uint8 **ip, const uint8 *iend, uint64 *len)
+{
+   uint8 b;
+   do {
+      if (*ip >= iend) {
+         return FALSE;
+      }
+      b = *(*ip)++;
+      *len += b;
+   } while (b == 255);
+   return TRUE;
+}
+
+/*
+ * Emits one sequence. A match_len of 0 marks the final, literals-only
+ * sequence. Returns NULL if the sequence does not fit before oend.
+ */
+static inline uint8 *
+lz_write_sequence(uint8       *op,
+                  uint8       *oend,
+                  const uint8 *literals,
+                  uint64       literal_len,
+                  uint64       offset,
+                  uint64       match_len)
+{
+   uint64 match_code = match_len == 0 ? 0 : match_len - LZ_MIN_MATCH;
+   uint64 needed     = 1 + lz_length_bytes(literal_len) + literal_len;
+   if (match_len != 0) {
+      needed += sizeof(uint16) + lz_length_bytes(match_code);
+   }
+   if (needed > (uint64)(oend - op)) {
+      return NULL;
+   }
+
+   *op++ = (uint8)((MIN(literal_len, LZ_NIBBLE_MAX) << 4)
+                   | MIN(match_code, LZ_NIBBLE_MAX));
+   op    = lz_write_length(op, literal_len);
+   memcpy(op, literals, literal_len);
+   op += literal_len;
+   if (match_len != 0) {
+      *op++ = (uint8)(offset & 0xff);
+      *op++ = (uint8)(offset >> 8);
+      op    = lz_write_length(op, match_code);
+   }
+   return op;
+}
+
+uint64
+lz_compress(const void *src, uint64 src_len, void *dst, uint64 dst_len)
+{
+   const uint8 *base   = src;
+   const uint8 *ip     = base;
+   const uint8 *anchor = base;
+   const uint8 *iend   = base + src_len;
+   uint8       *op     = dst;
+   uint8       *oend   = op + dst_len;
+   uint32       table[LZ_HASH_SIZE];
+   uint64       misses = 0;
+
+   platform_assert(src_len <= UINT32_MAX);
+   memset(table, 0, sizeof(table));
+
+   while (src_len >= LZ_MIN_MATCH && ip <= iend - LZ_MIN_MATCH) {
+      uint32       seq = lz_read32(ip);
+      uint32       h   = lz_hash(seq);
+      const uint8 *ref = base + table[h];
+      table[h]         = (uint32)(ip - base);
+
+      if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != seq) {
+         /* skip faster through incompressible data */
+         ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+         continue;
+      }
+      misses = 0;
+
+      const uint8 *mp = ip + LZ_MIN_MATCH;
+      const uint8 *rp = ref + LZ_MIN_MATCH;
+      while (mp < iend && *mp == *rp) {
+         mp++;
+         rp++;
+      }
+
+      op = lz_write_sequence(op, oend, anchor, ip - anchor, ip - ref, mp - ip);
+      if (op == NULL) {
+         return 0;
+      }
+      ip = anchor = mp;
+   }
+
+   op = lz_write_sequence(op, oend, anchor, iend - anchor, 0, 0);
+   if (op == NULL) {
+      return 0;
+   }
+   return op - (uint8 *)dst;
+}
+
+bool32
+lz_decompress(const void *src, uint64 src_len, void *dst, uint64 dst_len)
+{
+   const uint8 *ip   = src;
+   const uint8 *iend = ip + src_len;
+   uint8       *base = dst;
+   uint8       *op   = base;
+   uint8       *oend = base + dst_len;
+
+   while (TRUE) {
+      /* every block ends with a literals-only sequence */
+      if (ip == iend) {
+         return FALSE;
+      }
+      uint8  token       = *ip++;
+      uint64 literal_len = token >> 4;
+      if (literal_len == LZ_NIBBLE_MAX
+          && !lz_read_length(&ip, iend, &literal_len))
+      {
+         return FALSE;
+      }
+      if (literal_len > (uint64)(iend - ip)
+          || literal_len > (uint64)(oend - op))
+      {
+         return FALSE;
+      }
+      memcpy(op, ip, literal_len);
+      op += literal_len;
+      ip += literal_len;
+
+      if (ip == iend) {
+         break;
+      }
+
+      if (iend - ip < (int64)sizeof(uint16)) {
+         return FALSE;
+      }
+      uint64 offset = ip[0] | ((uint64)ip[1] << 8);
+      ip += sizeof(uint16);
+      uint64 match_len = token & LZ_NIBBLE_MAX;
+      if (match_len == LZ_NIBBLE_MAX
+          && !lz_read_length(&ip, iend, &match_len))
+      {
+         return FALSE;
+      }
+      match_len += LZ_MIN_MATCH;
+      if (offset == 0 || offset > (uint64)(op - base)
+          || match_len > (uint64)(oend - op))
+      {
+         return FALSE;
+      }
+
+      const uint8 *mp = op - offset;
+      if (offset == 1) {
+         memset(op, *mp, match_len);
+         op += match_len;
+      } else if (offset >= match_len) {
+         memcpy(op, mp, match_len);
+         op += match_len;
+      } else {
+         /* overlapping copy, in chunks that never overrun their source */
+         uint64 remaining = match_len;
+         while (remaining >= offset) {
+            memcpy(op, mp, offset);
+            op += offset;
+            mp += offset;
+            remaining -= offset;
+         }
+         while (remaining--) {
+            *op++ = *mp++;
+         }
+      }
+   }
+
+   return op == oend;
+}
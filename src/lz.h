@@ -0,0 +1,49 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * lz.h --
+ *
+ *     A small, dependency-free LZ77 block codec, tuned for speed rather than
+ *     ratio. It is used to compress pages held in DRAM, so both sides only
+ *     ever see a single, self-contained block.
+ *
+ *     A compressed block is a sequence of
+ *        token | [literal length bytes] | literals | offset | [match bytes]
+ *     where the token holds the literal length in its high nibble and the
+ *     match length (minus LZ_MIN_MATCH) in its low nibble; a nibble of 15 is
+ *     continued by bytes of 255 terminated by a byte < 255. The last sequence
+ *     has literals only.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+#define LZ_MIN_MATCH 4
+
+/*
+ * Worst-case compressed size of a block of src_len bytes. Callers that want
+ * lz_compress to only succeed on blocks that actually shrink can pass a
+ * smaller dst_len.
+ */
+static inline uint64
+lz_compress_bound(uint64 src_len)
+{
+   return src_len + src_len / 255 + 16;
+}
+
+/*
+ * Compresses src_len bytes of src into dst. Returns the compressed size, or
+ * 0 if the result would not fit in dst_len bytes.
+ */
+uint64
+lz_compress(const void *src, uint64 src_len, void *dst, uint64 dst_len);
+
+/*
+ * Decompresses the block of src_len bytes in src into exactly dst_len bytes
+ * of dst. Returns FALSE if the block is malformed or does not decompress to
+ * dst_len bytes.
+ */
+bool32
+lz_decompress(const void *src, uint64 src_len, void *dst, uint64 dst_len);
@@ -19,9 +19,18 @@
 #define MEMTABLE_INSERT_LOCK_IDX 0
 #define MEMTABLE_LOOKUP_LOCK_IDX 1
 
+#define MEMTABLE_INDEX_SEED 0x1dea
+// the index is sized for tuples this small, and overflows on smaller ones
+#define MEMTABLE_INDEX_BYTES_PER_TUPLE 32
+
 bool32
 memtable_is_full(const memtable_config *cfg, memtable *mt)
 {
+   if (memtable_is_skiplist(mt)) {
+      uint64 extent_size = cache_config_extent_size(cfg->btree_cfg->cache_cfg);
+      return cfg->max_extents_per_memtable * extent_size
+             <= skiplist_bytes(&mt->sl);
+   }
    return cfg->max_extents_per_memtable <= mini_num_extents(&mt->mini);
 }
 
@@ -184,6 +193,149 @@ memtable_maybe_rotate_and_begin_insert(memtable_context *ctxt,
    }
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * memtable_index
+ *
+ * Open addressing with linear probing over 64-bit fingerprints: a 32-bit
+ * key hash, with bit 32 set so no key maps to an empty slot. Two keys may
+ * share a fingerprint, in which case they share a slot, which then only
+ * says that one of them may be present.
+ *-----------------------------------------------------------------------------
+ */
+static inline uint64
+memtable_index_fingerprint(const memtable *mt, key tuple_key)
+{
+   uint32 hash =
+      data_key_hash(mt->cfg->data_cfg, tuple_key, MEMTABLE_INDEX_SEED);
+   return (1ULL << 32) | hash;
+}
+
+static inline bool32
+memtable_index_enabled(const memtable_index *index)
+{
+   return index->num_slots != 0 && !index->overflowed;
+}
+
+/* Returns the slot for fp, or NULL if fp is not in the index */
+static memtable_index_slot *
+memtable_index_find(memtable_index *index, uint64 fp)
+{
+   uint64 mask = index->num_slots - 1;
+   for (uint64 i = fp & mask;; i = (i + 1) & mask) {
+      uint64 slot_fp = index->slots[i].fp;
+      if (slot_fp == fp) {
+         return &index->slots[i];
+      }
+      if (slot_fp == 0) {
+         return NULL;
+      }
+   }
+}
+
+/*
+ * Returns the slot for fp, adding fp if it is not in the index yet, or NULL
+ * if the index has overflowed. The index is kept at most 3/4 full, so
+ * probes always end at an empty slot.
+ */
+static memtable_index_slot *
+memtable_index_add(memtable_index *index, uint64 fp)
+{
+   if (!memtable_index_enabled(index)) {
+      return NULL;
+   }
+
+   uint64 mask     = index->num_slots - 1;
+   bool32 reserved = FALSE;
+   for (uint64 i = fp & mask;; i = (i + 1) & mask) {
+      memtable_index_slot *slot    = &index->slots[i];
+      uint64               slot_fp = slot->fp;
+      if (slot_fp == fp) {
+         return slot;
+      }
+      if (slot_fp != 0) {
+         continue;
+      }
+      if (!reserved) {
+         // may overcount when another thread adds fp first, which is safe
+         uint64 max_entries = index->num_slots / 4 * 3;
+         if (__sync_fetch_and_add(&index->num_entries, 1) >= max_entries) {
+            // lookups must see this before the tuple is inserted
+            index->overflowed = TRUE;
+            __sync_synchronize();
+            return NULL;
+         }
+         reserved = TRUE;
+      }
+      slot_fp = __sync_val_compare_and_swap(&slot->fp, 0, fp);
+      if (slot_fp == 0 || slot_fp == fp) {
+         return slot;
+      }
+   }
+}
+
+static void
+memtable_index_init(memtable_index  *index,
+                    platform_heap_id hid,
+                    memtable_config *cfg)
+{
+   ZERO_CONTENTS(index);
+   if (!cfg->hash_index) {
+      return;
+   }
+   index->heap_id   = hid;
+   index->num_slots = cfg->index_slots;
+   index->slots     = TYPED_ARRAY_ZALLOC(hid, index->slots, index->num_slots);
+   platform_assert(index->slots != NULL);
+}
+
+static void
+memtable_index_reset(memtable_index *index)
+{
+   if (index->num_slots == 0) {
+      return;
+   }
+   memset(index->slots, 0, index->num_slots * sizeof(*index->slots));
+   index->num_entries = 0;
+   index->overflowed  = FALSE;
+}
+
+static void
+memtable_index_deinit(memtable_index *index)
+{
+   if (index->slots != NULL) {
+      platform_free(index->heap_id, index->slots);
+   }
+}
+
+/*
+ * Returns FALSE if target is certainly not in the memtable. Otherwise, sets
+ * *slot to the index slot for target, or NULL if the memtable has no index
+ * to look in.
+ */
+static inline bool32
+memtable_index_lookup(memtable *mt, key target, memtable_index_slot **slot)
+{
+   *slot = NULL;
+   if (!memtable_index_enabled(&mt->index)) {
+      return TRUE;
+   }
+   *slot = memtable_index_find(&mt->index,
+                               memtable_index_fingerprint(mt, target));
+   return *slot != NULL;
+}
+
+/*
+ * Returns FALSE if target is certainly not in the memtable. Lookups in a
+ * memtable which has been compacted use this to skip its branch.
+ */
+bool32
+memtable_may_contain(memtable *mt, key target)
+{
+   memtable_index_slot *slot;
+   return memtable_index_lookup(mt, target, &slot);
+}
+
 /*
  *-----------------------------------------------------------------------------
  * Increments the distributed tuple counter.  Must hold a read lock on
@@ -216,30 +368,104 @@ memtable_insert(memtable_context *ctxt,
                 message           msg,
                 uint64           *leaf_generation)
 {
-   const threadid tid = platform_get_tid();
-   bool32         was_unique;
-
-   platform_status rc = btree_insert(ctxt->cc,
-                                     ctxt->cfg.btree_cfg,
-                                     heap_id,
-                                     &ctxt->scratch[tid],
-                                     mt->root_addr,
-                                     &mt->mini,
-                                     tuple_key,
-                                     msg,
-                                     leaf_generation,
-                                     &was_unique);
+   const threadid       tid = platform_get_tid();
+   bool32               was_unique;
+   platform_status      rc;
+   memtable_index_slot *slot = NULL;
+
+   if (mt->index.num_slots != 0) {
+      // before the insert, so lookups which miss in the index may skip mt
+      slot = memtable_index_add(&mt->index,
+                                memtable_index_fingerprint(mt, tuple_key));
+   }
+
+   if (memtable_is_skiplist(mt)) {
+      // the tuple has to fit in a branch leaf when the skiplist is packed
+      uint64 page_size = cache_config_page_size(mt->cfg->cache_cfg);
+      if (MAX_INLINE_KEY_SIZE(page_size) < key_length(tuple_key)
+          || MAX_INLINE_MESSAGE_SIZE(page_size) < message_length(msg)
+          || message_is_invalid_user_type(msg))
+      {
+         return STATUS_BAD_PARAM;
+      }
+      skiplist_node *node;
+      rc = skiplist_insert(
+         &mt->sl, tuple_key, msg, leaf_generation, &was_unique, &node);
+      if (SUCCESS(rc) && slot != NULL && slot->pos == NULL) {
+         __sync_bool_compare_and_swap(&slot->pos, NULL, node);
+      }
+   } else {
+      rc = btree_insert(ctxt->cc,
+                        ctxt->cfg.btree_cfg,
+                        heap_id,
+                        &ctxt->scratch[tid],
+                        mt->root_addr,
+                        &mt->mini,
+                        tuple_key,
+                        msg,
+                        leaf_generation,
+                        &was_unique);
+   }
    if (!SUCCESS(rc)) {
       return rc;
    }
 
    if (was_unique) {
       memtable_add_tuple(ctxt);
+   } else {
+      __sync_fetch_and_add(&ctxt->tuples_merged, 1);
    }
 
    return rc;
 }
 
+/*
+ * Looks up target in a memtable which has not been compacted yet, merging
+ * what it finds into data.
+ */
+platform_status
+memtable_lookup(memtable_context  *ctxt,
+                memtable          *mt,
+                key                target,
+                merge_accumulator *data)
+{
+   bool32               local_found;
+   memtable_index_slot *slot;
+   if (!memtable_index_lookup(mt, target, &slot)) {
+      return STATUS_OK;
+   }
+
+   if (memtable_is_skiplist(mt)) {
+      skiplist_node *node = slot != NULL ? slot->pos : NULL;
+      if (node != NULL) {
+         platform_status rc = skiplist_node_lookup_and_merge(
+            &mt->sl, node, target, data, &local_found);
+         if (!SUCCESS(rc) || local_found) {
+            return rc;
+         }
+         // node holds another key with the same fingerprint
+      }
+      return skiplist_lookup_and_merge(&mt->sl, target, data, &local_found);
+   }
+   return btree_lookup_and_merge(ctxt->cc,
+                                 mt->cfg,
+                                 mt->root_addr,
+                                 PAGE_TYPE_MEMTABLE,
+                                 target,
+                                 data,
+                                 &local_found);
+}
+
+void
+memtable_inc_ref(memtable_context *ctxt, memtable *mt)
+{
+   if (memtable_is_skiplist(mt)) {
+      __sync_fetch_and_add(&mt->ref_count, 1);
+   } else {
+      allocator_inc_ref(cache_get_allocator(ctxt->cc), mt->root_addr);
+   }
+}
+
 /*
  * if there are no outstanding refs, then destroy and reinit memtable and
  * transition to READY
@@ -248,11 +474,23 @@ bool32
 memtable_dec_ref_maybe_recycle(memtable_context *ctxt, memtable *mt)
 {
    cache *cc = ctxt->cc;
+   bool32 freed;
 
-   bool32 freed = btree_dec_ref(cc, mt->cfg, mt->root_addr, PAGE_TYPE_MEMTABLE);
+   if (memtable_is_skiplist(mt)) {
+      freed = __sync_sub_and_fetch(&mt->ref_count, 1) == 0;
+   } else {
+      freed = btree_dec_ref(cc, mt->cfg, mt->root_addr, PAGE_TYPE_MEMTABLE);
+   }
    if (freed) {
       platform_assert(mt->state == MEMTABLE_STATE_INCORPORATED);
-      mt->root_addr = btree_create(cc, mt->cfg, &mt->mini, PAGE_TYPE_MEMTABLE);
+      if (memtable_is_skiplist(mt)) {
+         skiplist_reset(&mt->sl);
+         mt->ref_count = 1;
+      } else {
+         mt->root_addr =
+            btree_create(cc, mt->cfg, &mt->mini, PAGE_TYPE_MEMTABLE);
+      }
+      memtable_index_reset(&mt->index);
       memtable_lock_incorporation_lock(ctxt);
       mt->generation += ctxt->cfg.max_memtables;
       memtable_unlock_incorporation_lock(ctxt);
@@ -281,12 +519,23 @@ memtable_force_finalize(memtable_context *ctxt)
 }
 
 void
-memtable_init(memtable *mt, cache *cc, memtable_config *cfg, uint64 generation)
+memtable_init(memtable         *mt,
+              platform_heap_id  hid,
+              cache            *cc,
+              memtable_config  *cfg,
+              uint64            generation)
 {
    ZERO_CONTENTS(mt);
-   mt->cfg       = cfg->btree_cfg;
-   mt->root_addr = btree_create(cc, mt->cfg, &mt->mini, PAGE_TYPE_MEMTABLE);
-   mt->state     = MEMTABLE_STATE_READY;
+   mt->cfg    = cfg->btree_cfg;
+   mt->engine = cfg->engine;
+   if (memtable_is_skiplist(mt)) {
+      skiplist_init(&mt->sl, hid, mt->cfg->data_cfg);
+      mt->ref_count = 1;
+   } else {
+      mt->root_addr = btree_create(cc, mt->cfg, &mt->mini, PAGE_TYPE_MEMTABLE);
+   }
+   memtable_index_init(&mt->index, hid, cfg);
+   mt->state = MEMTABLE_STATE_READY;
    platform_assert(generation < UINT64_MAX);
    mt->generation = generation;
 }
@@ -294,6 +543,11 @@ memtable_init(memtable *mt, cache *cc, memtable_config *cfg, uint64 generation)
 void
 memtable_deinit(cache *cc, memtable *mt)
 {
+   memtable_index_deinit(&mt->index);
+   if (memtable_is_skiplist(mt)) {
+      skiplist_deinit(&mt->sl);
+      return;
+   }
    mini_release(&mt->mini, NULL_KEY);
    debug_only bool32 freed =
       btree_dec_ref(cc, mt->cfg, mt->root_addr, PAGE_TYPE_MEMTABLE);
@@ -319,7 +573,7 @@ memtable_context_create(platform_heap_id hid,
 
    for (uint64 mt_no = 0; mt_no < cfg->max_memtables; mt_no++) {
       uint64 generation = mt_no;
-      memtable_init(&ctxt->mt[mt_no], cc, cfg, generation);
+      memtable_init(&ctxt->mt[mt_no], hid, cc, cfg, generation);
    }
 
    ctxt->generation                = 0;
@@ -360,4 +614,10 @@ memtable_config_init(memtable_config *cfg,
    cfg->max_extents_per_memtable =
       MEMTABLE_SPACE_OVERHEAD_FACTOR * memtable_capacity
       / cache_config_extent_size(btree_cfg->cache_cfg);
+
+   uint64 max_entries = memtable_capacity / MEMTABLE_INDEX_BYTES_PER_TUPLE;
+   cfg->index_slots   = 4;
+   while (cfg->index_slots / 4 * 3 < max_entries) {
+      cfg->index_slots *= 2;
+   }
 }
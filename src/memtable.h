@@ -13,6 +13,7 @@
 #include "task.h"
 #include "cache.h"
 #include "btree.h"
+#include "skiplist.h"
 
 #define MEMTABLE_SPACE_OVERHEAD_FACTOR (2)
 
@@ -28,14 +29,63 @@ typedef enum memtable_state {
    NUM_MEMTABLE_STATES,
 } memtable_state;
 
+/*
+ * How a memtable holds its tuples until it is compacted into a branch.
+ */
+typedef enum memtable_engine {
+   // a btree on PAGE_TYPE_MEMTABLE pages in the cache
+   MEMTABLE_ENGINE_BTREE = 0,
+   // a skiplist in a heap arena, outside the cache (see skiplist.h)
+   MEMTABLE_ENGINE_SKIPLIST,
+} memtable_engine;
+
+/*
+ * An optional hash index over the keys of a memtable, so point lookups can
+ * skip a memtable without the key and go straight to the key's skiplist
+ * node. It lives until the memtable is incorporated and recycled.
+ *
+ * Slots are claimed with a CAS on their fingerprint and never cleared while
+ * the memtable is live. A key is added to the index before it is inserted,
+ * so a lookup which doesn't find its fingerprint can skip the memtable. Once
+ * the index is too full to add to, it is marked overflowed, and lookups go
+ * back to searching the memtable.
+ */
+typedef struct memtable_index_slot {
+   volatile uint64 fp;  // 0 when empty
+   void *volatile  pos; // the key's skiplist node, NULL if unknown
+} memtable_index_slot;
+
+typedef struct memtable_index {
+   platform_heap_id     heap_id;
+   uint64               num_slots; // a power of 2, 0 when there is no index
+   memtable_index_slot *slots;
+   volatile uint64      num_entries;
+   volatile bool32      overflowed;
+} memtable_index;
+
 typedef struct memtable {
    volatile memtable_state state;
    uint64                  generation;
-   uint64                  root_addr;
-   mini_allocator          mini;
-   btree_config           *cfg;
+   memtable_engine         engine;
+
+   // MEMTABLE_ENGINE_BTREE, ref counted through the root's extent
+   uint64         root_addr;
+   mini_allocator mini;
+   btree_config  *cfg;
+
+   // MEMTABLE_ENGINE_SKIPLIST
+   skiplist        sl;
+   volatile uint64 ref_count;
+
+   memtable_index index;
 } PLATFORM_CACHELINE_ALIGNED memtable;
 
+static inline bool32
+memtable_is_skiplist(const memtable *mt)
+{
+   return mt->engine == MEMTABLE_ENGINE_SKIPLIST;
+}
+
 static inline bool32
 memtable_try_transition(memtable      *mt,
                         memtable_state old_state,
@@ -102,9 +152,12 @@ memtable_transition(memtable      *mt,
 typedef void (*process_fn)(void *arg, uint64 generation);
 
 typedef struct memtable_config {
-   uint64        max_extents_per_memtable;
-   uint64        max_memtables;
-   btree_config *btree_cfg;
+   uint64          max_extents_per_memtable;
+   uint64          max_memtables;
+   btree_config   *btree_cfg;
+   memtable_engine engine;
+   bool32          hash_index;  // whether to keep a memtable_index
+   uint64          index_slots; // slots per memtable_index
 } memtable_config;
 
 typedef struct memtable_context {
@@ -133,6 +186,9 @@ typedef struct memtable_context {
 
    bool32 is_empty;
 
+   // inserts which merged with a tuple already in their memtable
+   volatile uint64 tuples_merged;
+
    // Effectively thread local, no locking at all:
    btree_scratch scratch[MAX_THREADS];
 
@@ -166,6 +222,18 @@ memtable_insert(memtable_context *ctxt,
                 message           msg,
                 uint64           *generation);
 
+platform_status
+memtable_lookup(memtable_context  *ctxt,
+                memtable          *mt,
+                key                target,
+                merge_accumulator *data);
+
+bool32
+memtable_may_contain(memtable *mt, key target);
+
+void
+memtable_inc_ref(memtable_context *ctxt, memtable *mt);
+
 bool32
 memtable_dec_ref_maybe_recycle(memtable_context *ctxt, memtable *mt);
 
@@ -173,7 +241,11 @@ uint64
 memtable_force_finalize(memtable_context *ctxt);
 
 void
-memtable_init(memtable *mt, cache *cc, memtable_config *cfg, uint64 generation);
+memtable_init(memtable         *mt,
+              platform_heap_id  hid,
+              cache            *cc,
+              memtable_config  *cfg,
+              uint64            generation);
 
 void
 memtable_deinit(cache *cc, memtable *mt);
@@ -257,6 +329,10 @@ memtable_unlock_incorporation_lock(memtable_context *ctxt)
 static inline void
 memtable_zap(cache *cc, memtable *mt)
 {
+   if (memtable_is_skiplist(mt)) {
+      __sync_fetch_and_sub(&mt->ref_count, 1);
+      return;
+   }
    btree_dec_ref(cc, mt->cfg, mt->root_addr, PAGE_TYPE_MEMTABLE);
 }
 
@@ -280,17 +356,31 @@ memtable_is_empty(memtable_context *mt_ctxt);
 static inline bool32
 memtable_verify(cache *cc, memtable *mt)
 {
+   if (memtable_is_skiplist(mt)) {
+      return skiplist_verify(&mt->sl);
+   }
    return btree_verify_tree(cc, mt->cfg, mt->root_addr, PAGE_TYPE_MEMTABLE);
 }
 
 static inline void
 memtable_print(platform_log_handle *log_handle, cache *cc, memtable *mt)
 {
+   if (memtable_is_skiplist(mt)) {
+      skiplist_print(log_handle, &mt->sl);
+      return;
+   }
    btree_print_memtable_tree(log_handle, cc, mt->cfg, mt->root_addr);
 }
 
 static inline void
 memtable_print_stats(platform_log_handle *log_handle, cache *cc, memtable *mt)
 {
+   if (memtable_is_skiplist(mt)) {
+      platform_log(log_handle,
+                   "skiplist memtable: %lu tuples, %lu bytes\n",
+                   skiplist_num_tuples(&mt->sl),
+                   skiplist_bytes(&mt->sl));
+      return;
+   }
    btree_print_tree_stats(log_handle, cc, mt->cfg, mt->root_addr);
 }
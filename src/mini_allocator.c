@@ -732,6 +732,54 @@ mini_destroy_unused(mini_allocator *mini)
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ * mini_keyed_splice --
+ *
+ *      Moves the extents of batch of the released keyed mini_allocator at
+ *      src_meta_head to the end of the same batch of mini, and deallocates
+ *      the metadata extents of the source. The extents keep their start keys,
+ *      so they must follow those already in the batch in key order.
+ *
+ *      Used to gather the extents of a tree packed in parts, see
+ *      btree_pack_stitch.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Disk deallocation, standard cache side effects.
+ *-----------------------------------------------------------------------------
+ */
+void
+mini_keyed_splice(mini_allocator *mini, uint64 batch, uint64 src_meta_head)
+{
+   debug_assert(mini->keyed);
+   debug_assert(batch < mini->num_batches);
+
+   uint64 meta_addr = src_meta_head;
+   do {
+      page_handle *meta_page = cache_get(mini->cc, meta_addr, TRUE, mini->type);
+      keyed_meta_entry *entry = keyed_first_entry(meta_page);
+      for (uint64 i = 0; i < mini_num_entries(meta_page); i++) {
+         if (entry->batch == batch
+             && entry->extent_addr != TERMINAL_EXTENT_ADDR)
+         {
+            mini_append_entry(mini,
+                              batch,
+                              keyed_meta_entry_start_key(entry),
+                              entry->extent_addr);
+            mini->num_extents++;
+         }
+         entry = keyed_next_entry(entry);
+      }
+      meta_addr = mini_get_next_meta_addr(meta_page);
+      cache_unget(mini->cc, meta_page);
+   } while (meta_addr != 0);
+
+   mini_deinit(mini->cc, src_meta_head, mini->type, FALSE);
+}
+
 /*
  *-----------------------------------------------------------------------------
  * mini_[keyed,unkeyed]_for_each(_self_exclusive) --
@@ -1022,6 +1070,22 @@ mini_dealloc_extent(cache *cc, page_type type, uint64 base_addr, void *out)
 
 uint8
 mini_unkeyed_dec_ref(cache *cc, uint64 meta_head, page_type type, bool32 pinned)
+{
+   return mini_unkeyed_dec_ref_last(cc, meta_head, type, pinned, NULL, NULL);
+}
+
+/*
+ * Same as mini_unkeyed_dec_ref, and when the last external ref is dropped,
+ * calls last_ref before the extents are deallocated, when meta_head can't
+ * yet be handed out again.
+ */
+uint8
+mini_unkeyed_dec_ref_last(cache           *cc,
+                          uint64           meta_head,
+                          page_type        type,
+                          bool32           pinned,
+                          mini_last_ref_fn last_ref,
+                          void            *arg)
 {
    if (type == PAGE_TYPE_MEMTABLE) {
       platform_assert(pinned);
@@ -1037,6 +1101,10 @@ mini_unkeyed_dec_ref(cache *cc, uint64 meta_head, page_type type, bool32 pinned)
       return ref - MINI_NO_REFS;
    }
 
+   if (last_ref != NULL) {
+      last_ref(meta_head, arg);
+   }
+
    // need to deallocate and clean up the mini allocator
    mini_unkeyed_for_each(cc, meta_head, type, FALSE, mini_dealloc_extent, NULL);
    mini_deinit(cc, meta_head, type, pinned);
@@ -67,6 +67,9 @@ mini_release(mini_allocator *mini, key end_key);
 void
 mini_destroy_unused(mini_allocator *mini);
 
+void
+mini_keyed_splice(mini_allocator *mini, uint64 batch, uint64 src_meta_head);
+
 uint64
 mini_alloc(mini_allocator *mini,
            uint64          batch,
@@ -82,6 +85,16 @@ mini_unkeyed_dec_ref(cache    *cc,
                      page_type type,
                      bool32    pinned);
 
+typedef void (*mini_last_ref_fn)(uint64 meta_head, void *arg);
+
+uint8
+mini_unkeyed_dec_ref_last(cache           *cc,
+                          uint64           meta_head,
+                          page_type        type,
+                          bool32           pinned,
+                          mini_last_ref_fn last_ref,
+                          void            *arg);
+
 void
 mini_keyed_inc_ref(cache       *cc,
                    data_config *data_cfg,
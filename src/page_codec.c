@@ -0,0 +1,80 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * page_codec.c --
+ *
+ *     This file contains the encoding of compressed pages and the built-in
+ *     codecs.
+ */
+
+#include "page_codec.h"
+#include "lz.h"
+
+#include "poison.h"
+
+const page_codec page_codec_lz = {
+   .id         = 1,
+   .name       = "lz",
+   .compress   = lz_compress,
+   .decompress = lz_decompress,
+};
+
+/*
+ *----------------------------------------------------------------------
+ * page_codec_encode --
+ *
+ *      Compresses page into buf, which must hold page_size bytes, with a
+ *      page_codec_hdr in front and zeros up to the next multiple of
+ *      PAGE_CODEC_ALIGNMENT.
+ *
+ *      Returns the number of bytes of buf to write, or 0 if the page does
+ *      not shrink by at least PAGE_CODEC_ALIGNMENT, in which case it should
+ *      be written as is.
+ *----------------------------------------------------------------------
+ */
+uint64
+page_codec_encode(const page_codec *codec,
+                  const char       *page,
+                  uint64            page_size,
+                  char             *buf)
+{
+   page_codec_hdr *hdr     = (page_codec_hdr *)buf;
+   uint64          max_len = page_size - PAGE_CODEC_ALIGNMENT - sizeof(*hdr);
+   uint64          length =
+      codec->compress(page, page_size, buf + sizeof(*hdr), max_len);
+   if (length == 0) {
+      return 0;
+   }
+   hdr->magic    = PAGE_CODEC_MAGIC;
+   hdr->codec_id = codec->id;
+   hdr->length   = length;
+
+   uint64 bytes = ROUNDUP(sizeof(*hdr) + length, PAGE_CODEC_ALIGNMENT);
+   memset(buf + sizeof(*hdr) + length, 0, bytes - sizeof(*hdr) - length);
+   return bytes;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * page_codec_decode --
+ *
+ *      Decompresses the page encoded in buf into page, which must not
+ *      overlap buf. Returns FALSE if buf was not encoded by codec or is
+ *      corrupt.
+ *----------------------------------------------------------------------
+ */
+bool32
+page_codec_decode(const page_codec *codec,
+                  const char       *buf,
+                  uint64            page_size,
+                  char             *page)
+{
+   const page_codec_hdr *hdr = (const page_codec_hdr *)buf;
+   if (!page_codec_is_encoded(buf) || hdr->codec_id != codec->id
+       || hdr->length > page_size - sizeof(*hdr))
+   {
+      return FALSE;
+   }
+   return codec->decompress(buf + sizeof(*hdr), hdr->length, page, page_size);
+}
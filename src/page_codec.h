@@ -0,0 +1,80 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * page_codec.h --
+ *
+ *     This file contains the interface for codecs used to compress pages on
+ *     disk, and the on-disk format of a compressed page.
+ *
+ *     A compressed page starts with a page_codec_hdr and is padded to a
+ *     multiple of PAGE_CODEC_ALIGNMENT, so it can be written with O_DIRECT
+ *     into the start of the page's slot on disk. The rest of the slot is not
+ *     written.
+ */
+
+#pragma once
+
+#include "platform.h"
+#include "util.h"
+
+/* granularity of compressed writes, the logical block size for O_DIRECT */
+#define PAGE_CODEC_ALIGNMENT 512
+
+/*
+ * Marks a compressed page. A btree node starts with a page-aligned address,
+ * so its low byte is never that of the magic.
+ */
+#define PAGE_CODEC_MAGIC 0x31636570676e7073ULL
+
+/*
+ * Compresses src_len bytes of src into dst. Returns the compressed size, or
+ * 0 if the result would not fit in dst_len bytes.
+ */
+typedef uint64 (*page_codec_compress_fn)(const void *src,
+                                         uint64      src_len,
+                                         void       *dst,
+                                         uint64      dst_len);
+
+/*
+ * Decompresses the src_len bytes in src into exactly dst_len bytes of dst.
+ * Returns FALSE if the block is malformed.
+ */
+typedef bool32 (*page_codec_decompress_fn)(const void *src,
+                                           uint64      src_len,
+                                           void       *dst,
+                                           uint64      dst_len);
+
+typedef struct page_codec {
+   uint32                   id; // recorded in each page it compresses
+   const char              *name;
+   page_codec_compress_fn   compress;
+   page_codec_decompress_fn decompress;
+} page_codec;
+
+typedef struct ONDISK page_codec_hdr {
+   uint64 magic;
+   uint32 codec_id;
+   uint32 length; // of the compressed data following the header
+} page_codec_hdr;
+
+/* The built-in codec, see lz.h */
+extern const page_codec page_codec_lz;
+
+uint64
+page_codec_encode(const page_codec *codec,
+                  const char       *page,
+                  uint64            page_size,
+                  char             *buf);
+
+static inline bool32
+page_codec_is_encoded(const char *buf)
+{
+   return ((const page_codec_hdr *)buf)->magic == PAGE_CODEC_MAGIC;
+}
+
+bool32
+page_codec_decode(const page_codec *codec,
+                  const char       *buf,
+                  uint64            page_size,
+                  char             *page);
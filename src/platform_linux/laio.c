@@ -25,6 +25,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 
 #define LAIO_HAND_BATCH_SIZE 32
@@ -70,6 +71,9 @@ laio_register_thread(io_handle *ioh);
 static void
 laio_deregister_thread(io_handle *ioh);
 
+static uint64
+laio_discard(io_handle *ioh, uint64 bytes, uint64 addr);
+
 static io_async_req *
 laio_get_kth_req(laio_handle *io, uint64 k);
 
@@ -88,6 +92,7 @@ static io_ops laio_ops = {
    .wait_all          = laio_wait_all,
    .register_thread   = laio_register_thread,
    .deregister_thread = laio_deregister_thread,
+   .discard           = laio_discard,
 };
 
 static void
@@ -193,6 +198,8 @@ io_handle_init(laio_handle *io, io_config *cfg, platform_heap_id hid)
       return STATUS_IO_ERROR;
    }
 
+   io->block_size = statbuf.st_blksize;
+
    if (S_ISREG(statbuf.st_mode) && statbuf.st_size < 128 * 1024) {
       r = fallocate(io->fd, 0, 0, 128 * 1024);
       if (r) {
@@ -264,6 +271,10 @@ io_handle_deinit(laio_handle *io)
 
 /*
  * laio_read() - Basically a wrapper around pread().
+ *
+ * A read that starts within the file but runs past its end is completed with
+ * zeros, as if the file were sparse there. This happens when the last page
+ * of the file was written short, e.g. compressed.
  */
 static platform_status
 laio_read(io_handle *ioh, void *buf, uint64 bytes, uint64 addr)
@@ -276,6 +287,10 @@ laio_read(io_handle *ioh, void *buf, uint64 bytes, uint64 addr)
    if (ret == bytes) {
       return STATUS_OK;
    }
+   if (ret > 0) {
+      memset((char *)buf + ret, 0, bytes - ret);
+      return STATUS_OK;
+   }
    return STATUS_IO_ERROR;
 }
 
@@ -296,6 +311,29 @@ laio_write(io_handle *ioh, void *buf, uint64 bytes, uint64 addr)
    return STATUS_IO_ERROR;
 }
 
+/*
+ * laio_discard() - Punches a hole over the whole file system blocks in the
+ * range. Devices and file systems which cannot punch holes release nothing.
+ */
+static uint64
+laio_discard(io_handle *ioh, uint64 bytes, uint64 addr)
+{
+   laio_handle *io    = (laio_handle *)ioh;
+   uint64       start = ROUNDUP(addr, io->block_size);
+   uint64       end   = ROUNDDOWN(addr + bytes, io->block_size);
+   if (end <= start) {
+      return 0;
+   }
+   int ret = fallocate(io->fd,
+                       FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                       start,
+                       end - start);
+   if (ret != 0) {
+      return 0;
+   }
+   return end - start;
+}
+
 /*
  * Return a ptr to the k'th Async IO request structure, accounting
  * for a nested array of 'async_max_pages' pages of IO vector structures
@@ -618,6 +656,17 @@ laio_config_valid_extent_size(io_config *cfg)
    return (cfg->extent_size == LAIO_DEFAULT_EXTENT_SIZE);
 }
 
+/*
+ * An async IO must hold at least one extent, and its iovec must not exceed
+ * what preadv/pwritev accept.
+ */
+static inline bool32
+laio_config_valid_async_max_pages(io_config *cfg)
+{
+   return (cfg->async_max_pages >= cfg->extent_size / cfg->page_size)
+          && (cfg->async_max_pages <= IOV_MAX);
+}
+
 /*
  * Do basic validation of IO configuration so we don't have to deal
  * with unsupported configurations that may creep through there.
@@ -637,5 +686,11 @@ laio_config_valid(io_config *cfg)
          cfg->extent_size);
       return STATUS_BAD_PARAM;
    }
+   if (!laio_config_valid_async_max_pages(cfg)) {
+      platform_error_log(
+         "Async max pages, %lu, is an invalid IO configuration.\n",
+         cfg->async_max_pages);
+      return STATUS_BAD_PARAM;
+   }
    return STATUS_OK;
 }
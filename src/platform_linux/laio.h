@@ -66,6 +66,7 @@ typedef struct laio_handle {
    uint64             req_hand[MAX_THREADS];
    platform_heap_id   heap_id;
    int                fd; // File descriptor to Splinter device/file.
+   uint64             block_size; // Granularity of laio_discard()
 } laio_handle;
 
 platform_status
@@ -37,87 +37,187 @@ typedef struct ONDISK routing_hdr {
 
 /*
  *----------------------------------------------------------------------
- * RadixSort --
+ * routing_sort_fingerprints --
  *
- *      A fast integer sort based on https://stackoverflow.com/a/44792724
+ *      Turns the count hashes in fp_arr into fingerprints tagged with value
+ *      and sorts them, using temp, of the same length, as scratch. Returns
+ *      whichever of fp_arr and temp holds the result.
+ *
+ *      An LSD radix sort by bytes, based on
+ *      https://stackoverflow.com/a/44792724. All the fingerprints carry the
+ *      same value, so only their fingerprint_size high bits are sorted on.
+ *      Large arrays are first split into 256 buckets by their top byte, so
+ *      that the remaining rounds of each bucket run in cache.
  *----------------------------------------------------------------------
  */
 
-// A 4x256 matrix is used for RadixSort
+// A 4x256 matrix of byte histograms is used for sorting
 #define MATRIX_ROWS sizeof(uint32)
 #define MATRIX_COLS (UINT8_MAX + 1)
 
-// XXX Change arguments to struct
-static uint32 *
-RadixSort(uint32 *pData,
-          uint32  mBuf[static MATRIX_ROWS * MATRIX_COLS],
-          uint32 *pTemp,
-          uint32  count,
-          uint32  fp_size,
-          uint32  value_size)
-{
-   uint32 *mIndex[MATRIX_ROWS]; // index matrix
-   uint32 *pDst, *pSrc, *pTmp;
-   uint32  i, j, m, n;
-   uint32  u;
-   uint32  fpover = value_size % 8;
-   if (fp_size == 0) {
-      fp_size = 1;
-   }
-   uint32 rounds = (fp_size + fpover - 1) / 8 + 1;
-   uint8  c;
-   uint32 fpshift = value_size / 8;
-   value_size     = value_size / 8 * 8;
-
-   for (i = 0; i < MATRIX_ROWS; i++) {
-      mIndex[i] = &mBuf[i * MATRIX_COLS];
-      for (ptrdiff_t j = 0; j < MATRIX_COLS; j++) {
-         platform_assert(mIndex[i][j] == 0);
+// Below this many fingerprints, the buckets would be too small to pay off
+#define ROUTING_SORT_BUCKETED_MIN (1 << 19)
+
+// How many fingerprints ahead the scatter prefetches its destinations
+#define ROUTING_SORT_PREFETCH_DISTANCE 16
+
+static inline uint32
+routing_sort_byte(uint32 fp, uint32 shift)
+{
+   return (fp >> shift) & UINT8_MAX;
+}
+
+/*
+ * Stably scatters the count fingerprints in src to dst by their byte at
+ * shift, where offset holds the start in dst of each byte's fingerprints.
+ */
+static inline void
+routing_sort_scatter(uint32 *src,
+                     uint32 *dst,
+                     uint32  count,
+                     uint32  shift,
+                     uint32  offset[static MATRIX_COLS])
+{
+   uint32 i = 0;
+   for (; i + ROUTING_SORT_PREFETCH_DISTANCE < count; i++) {
+      uint32 ahead = src[i + ROUTING_SORT_PREFETCH_DISTANCE];
+      __builtin_prefetch(&dst[offset[routing_sort_byte(ahead, shift)]], 1);
+      dst[offset[routing_sort_byte(src[i], shift)]++] = src[i];
+   }
+   for (; i < count; i++) {
+      dst[offset[routing_sort_byte(src[i], shift)]++] = src[i];
+   }
+}
+
+/*
+ * Turns the histograms of the rounds rows of matrix into the offsets
+ * routing_sort_scatter takes.
+ */
+static inline void
+routing_sort_offsets(uint32 matrix[static MATRIX_ROWS * MATRIX_COLS],
+                     uint32 rounds)
+{
+   for (uint32 round = 0; round < rounds; round++) {
+      uint32 *row = &matrix[round * MATRIX_COLS];
+      uint32  sum = 0;
+      for (uint32 c = 0; c < MATRIX_COLS; c++) {
+         uint32 hist_count = row[c];
+         row[c]            = sum;
+         sum += hist_count;
       }
    }
-   for (i = 0; i < count; i++) { // generate histograms
-      u = pData[i] >> value_size;
-      for (j = 0; j < rounds; j++) {
-         c = ((uint8 *)&u)[j];
-         mIndex[j][c]++;
-         debug_assert(mIndex[j][c] <= count);
+}
+
+/*
+ * Sorts the count fingerprints in src by the bits bits above shift, one
+ * round per byte, ending in src if the number of rounds is even and in dst
+ * otherwise.
+ */
+static void
+routing_sort_rounds(uint32 *src,
+                    uint32 *dst,
+                    uint32  count,
+                    uint32  shift,
+                    uint32  bits,
+                    uint32  matrix[static MATRIX_ROWS * MATRIX_COLS])
+{
+   uint32 rounds = (bits + 7) / 8;
+   memset(matrix, 0, rounds * MATRIX_COLS * sizeof(uint32));
+   for (uint32 i = 0; i < count; i++) {
+      uint32 fp = src[i] >> shift;
+      for (uint32 round = 0; round < rounds; round++) {
+         matrix[round * MATRIX_COLS + routing_sort_byte(fp, 8 * round)]++;
       }
    }
+   routing_sort_offsets(matrix, rounds);
+
+   for (uint32 round = 0; round < rounds; round++) {
+      uint32 *offset = &matrix[round * MATRIX_COLS];
+      routing_sort_scatter(src, dst, count, shift + 8 * round, offset);
+      uint32 *swap = src;
+      src          = dst;
+      dst          = swap;
+   }
+}
 
-   for (j = 0; j < rounds; j++) { // convert to indices
-      n = 0;
-      for (i = 0; i < MATRIX_COLS; i++) {
-         m            = mIndex[j][i];
-         mIndex[j][i] = n;
-         platform_assert(mIndex[j][i] <= count);
-         n += m;
+static uint32 *
+routing_sort_fingerprints(uint32 *fp_arr,
+                          uint32 *temp,
+                          uint32  count,
+                          uint32  fingerprint_size,
+                          uint32  value_size,
+                          uint32  value,
+                          uint32  matrix[static MATRIX_ROWS * MATRIX_COLS])
+{
+   debug_assert(0 < fingerprint_size);
+   debug_assert(fingerprint_size + value_size <= 32);
+   uint32 hash_shift = 32 - fingerprint_size;
+
+   if (count < ROUTING_SORT_BUCKETED_MIN) {
+      for (uint32 i = 0; i < count; i++) {
+         fp_arr[i] = fp_arr[i] >> hash_shift << value_size | value;
       }
+      uint32 rounds = (fingerprint_size + 7) / 8;
+      routing_sort_rounds(
+         fp_arr, temp, count, value_size, fingerprint_size, matrix);
+      return rounds % 2 == 0 ? fp_arr : temp;
    }
 
-   pDst = pTemp; // radix sort
-   pSrc = pData;
-   for (j = 0; j < rounds; j++) {
-      for (i = 0; i < count; i++) {
-         u = pSrc[i];
-         c = ((uint8 *)&u)[j + fpshift];
-         platform_assert((mIndex[j][c] < count),
-                         "OS-pid=%d, thread-ID=%lu, i=%u, j=%u, c=%d"
-                         ", mIndex[j][c]=%d, count=%u\n",
-                         platform_getpid(),
-                         platform_get_tid(),
-                         i,
-                         j,
-                         c,
-                         mIndex[j][c],
-                         count);
-         pDst[mIndex[j][c]++] = u;
+   // split by the top byte of the fingerprints into temp
+   uint32 low_bits   = fingerprint_size - MIN(fingerprint_size, 8);
+   uint32 top_shift  = value_size + low_bits;
+   uint32 bucket_start[MATRIX_COLS + 1];
+   uint32 offset[MATRIX_COLS];
+   memset(offset, 0, sizeof(offset));
+   for (uint32 i = 0; i < count; i++) {
+      uint32 fp = fp_arr[i] >> hash_shift << value_size | value;
+      fp_arr[i] = fp;
+      offset[routing_sort_byte(fp, top_shift)]++;
+   }
+   uint32 sum = 0;
+   for (uint32 c = 0; c < MATRIX_COLS; c++) {
+      uint32 bucket_count = offset[c];
+      bucket_start[c]     = sum;
+      offset[c]           = sum;
+      sum += bucket_count;
+   }
+   bucket_start[MATRIX_COLS] = count;
+   routing_sort_scatter(fp_arr, temp, count, top_shift, offset);
+
+   // then sort each bucket on the remaining bits, back and forth between
+   // temp and fp_arr, so all of them end up in the same one
+   uint32 rounds = (low_bits + 7) / 8;
+   for (uint32 c = 0; c < MATRIX_COLS; c++) {
+      uint32 start        = bucket_start[c];
+      uint32 bucket_count = bucket_start[c + 1] - start;
+      if (rounds % 2 == 1 && bucket_count == 1) {
+         fp_arr[start] = temp[start];
+      } else if (1 < bucket_count) {
+         routing_sort_rounds(&temp[start],
+                             &fp_arr[start],
+                             bucket_count,
+                             value_size,
+                             low_bits,
+                             matrix);
       }
-      pTmp = pSrc;
-      pSrc = pDst;
-      pDst = pTmp;
    }
+   return rounds % 2 == 0 ? temp : fp_arr;
+}
 
-   return (pSrc);
+static void
+debug_verify_sorted_fingerprints(debug_only const uint32 *fp_arr,
+                                 debug_only uint32        count)
+{
+#if SPLINTER_DEBUG
+   for (uint32 i = 1; i < count; i++) {
+      debug_assert(fp_arr[i - 1] <= fp_arr[i],
+                   "fingerprint %u of %u out of order: 0x%x > 0x%x\n",
+                   i,
+                   count,
+                   fp_arr[i - 1],
+                   fp_arr[i]);
+   }
+#endif
 }
 
 
@@ -165,6 +265,102 @@ routing_filter_get_remainder_and_value(routing_config *cfg,
    *remainder_and_value = PackedArray_get(data, pos, remainder_value_size);
 }
 
+/*
+ * Size in bytes of a packed block of num_remainders remainder/value pairs
+ * as laid out by routing_filter_add. num_remainders must be non-zero.
+ */
+static inline uint64
+routing_remainder_block_size(uint64 num_remainders,
+                             size_t remainder_and_value_size)
+{
+   return (num_remainders * remainder_and_value_size - 1) / 8 + 4;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * routing_find_remainder --
+ *
+ *      Scans positions [start, end) of a packed remainder block for
+ *      entries whose remainder matches and returns the bitmask of their
+ *      values.
+ *
+ *      Rather than extracting entries one at a time with PackedArray_get,
+ *      each entry is read with an unaligned 8-byte load at its byte offset
+ *      and shifted into place, so nothing branches on whether an entry
+ *      straddles two words. With AVX2, long buckets are unpacked and
+ *      compared 8 entries at a time. Loads never reach past block_size;
+ *      entries too close to the end of the block go through
+ *      PackedArray_get.
+ *----------------------------------------------------------------------
+ */
+static inline uint64
+routing_find_remainder(const char *block,
+                       uint64      block_size,
+                       uint64      start,
+                       uint64      end,
+                       size_t      remainder_and_value_size,
+                       size_t      value_size,
+                       uint32      remainder)
+{
+   platform_assert(value_size <= 6);
+   const uint64 entry_mask = (1ULL << remainder_and_value_size) - 1;
+   const uint64 value_mask = (1ULL << value_size) - 1;
+
+   // entries before safe_end can be read with a single 8-byte load
+   uint64 safe_end = 0;
+   if (block_size >= sizeof(uint64)) {
+      safe_end = ((block_size - sizeof(uint64)) * 8 + 7)
+                    / remainder_and_value_size
+                 + 1;
+   }
+   safe_end = MIN(safe_end, end);
+
+   uint64 found_values = 0;
+   uint64 pos          = start;
+#ifdef __AVX2__
+   if (remainder_and_value_size <= PACKEDARRAY_AVX2_MAX_BITS) {
+      const __m256i target = _mm256_set1_epi32(remainder);
+      const __m256i vshift = _mm256_set1_epi32(value_size);
+      // PackedArray_get8_avx2 reads 8 cells from the one holding pos
+      while (pos + 8 <= end
+             && (pos * remainder_and_value_size / 32 + 8) * sizeof(uint32)
+                   <= block_size)
+      {
+         __m256i entry = PackedArray_get8_avx2(
+            (const uint32 *)block, pos, remainder_and_value_size);
+         __m256i match =
+            _mm256_cmpeq_epi32(_mm256_srlv_epi32(entry, vshift), target);
+         uint32 match_mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+         if (match_mask != 0) {
+            uint32 entries[8];
+            _mm256_storeu_si256((__m256i *)entries, entry);
+            while (match_mask != 0) {
+               uint32 lane = __builtin_ctz(match_mask);
+               found_values |= 1ULL << (entries[lane] & value_mask);
+               match_mask &= match_mask - 1;
+            }
+         }
+         pos += 8;
+      }
+   }
+#endif
+   for (; pos < safe_end; pos++) {
+      uint64 bit_off = pos * remainder_and_value_size;
+      uint64 word;
+      memcpy(&word, block + bit_off / 8, sizeof(word));
+      uint64 entry = (word >> (bit_off % 8)) & entry_mask;
+      found_values |= (uint64)((entry >> value_size) == remainder)
+                      << (entry & value_mask);
+   }
+   for (; pos < end; pos++) {
+      uint32 entry =
+         PackedArray_get((const uint32 *)block, pos, remainder_and_value_size);
+      found_values |= (uint64)((entry >> value_size) == remainder)
+                      << (entry & value_mask);
+   }
+   return found_values;
+}
+
 static inline routing_hdr *
 routing_get_header(cache          *cc,
                    routing_config *cfg,
@@ -303,6 +499,494 @@ routing_get_bucket_counts(routing_config *cfg, routing_hdr *hdr, uint32 *count)
  *----------------------------------------------------------------------
  */
 
+/*
+ *----------------------------------------------------------------------
+ * routing_alloc_index
+ *
+ *      Allocates and claims the extent of index pages of a new filter
+ *      from mini and returns its address, which becomes filter->addr. The
+ *      index maps each index number to the address of its data.
+ *----------------------------------------------------------------------
+ */
+static uint64
+routing_alloc_index(cache          *cc,
+                    mini_allocator *mini,
+                    page_handle   **index_page)
+{
+   uint64 page_size        = cache_page_size(cc);
+   uint64 extent_size      = cache_extent_size(cc);
+   uint64 pages_per_extent = extent_size / page_size;
+
+   uint64 index_addr = mini_alloc(mini, 0, NULL_KEY, NULL);
+   platform_assert(index_addr % extent_size == 0);
+   index_page[0] = cache_alloc(cc, index_addr, PAGE_TYPE_FILTER);
+   for (uint64 i = 1; i < pages_per_extent; i++) {
+      uint64 next_index_addr = mini_alloc(mini, 0, NULL_KEY, NULL);
+      platform_assert(next_index_addr == index_addr + i * page_size);
+      index_page[i] = cache_alloc(cc, next_index_addr, PAGE_TYPE_FILTER);
+   }
+   return index_addr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * Unique-key sketches
+ *
+ *      A filter's routing_sketch has a page of its own, allocated from the
+ *      filter's mini allocator after its index extent, so it is freed with
+ *      the filter and the index keeps the whole extent. A hash goes to the
+ *      register picked by its top bits, which keeps the largest rank, 1 +
+ *      the number of leading zeros, of the rest of the hashes it sees.
+ *      Extending a filter merges the old filter's sketch into the new one,
+ *      so it covers all the keys of the filter.
+ *----------------------------------------------------------------------
+ */
+
+/*
+ * The most index entries a filter can have, one extent of them.
+ */
+static inline uint64
+routing_max_indices(routing_config *cfg)
+{
+   uint64 extent_size = cache_config_extent_size(cfg->cache_cfg);
+   return extent_size / sizeof(uint64);
+}
+
+static inline void
+routing_sketch_add(routing_sketch *sketch, uint32 *hash_arr, uint64 num_hashes)
+{
+   for (uint64 i = 0; i < num_hashes; i++) {
+      uint32 hash = hash_arr[i];
+      uint32 reg  = hash >> (32 - ROUTING_SKETCH_LOG_REGISTERS);
+      // the low bit set bounds the rank by the bits left of the hash
+      uint32 rest = hash << ROUTING_SKETCH_LOG_REGISTERS
+                    | 1U << (ROUTING_SKETCH_LOG_REGISTERS - 1);
+      uint8 rank       = __builtin_clz(rest) + 1;
+      sketch->reg[reg] = MAX(sketch->reg[reg], rank);
+   }
+}
+
+/*
+ * Writes the sketch of the new filter to a page from mini and sets
+ * filter->sketch_addr. The sketch is the union of old_filter's sketch and
+ * the hashes in new_fp_arr, which must not have been turned into
+ * fingerprints yet.
+ */
+static void
+routing_sketch_write(cache          *cc,
+                     routing_config *cfg,
+                     mini_allocator *mini,
+                     routing_filter *old_filter,
+                     uint32         *new_fp_arr,
+                     uint64          num_new_fp,
+                     routing_filter *filter)
+{
+   routing_sketch sketch;
+   ZERO_CONTENTS(&sketch);
+   routing_filter_sketch_merge(cc, cfg, old_filter, &sketch);
+   routing_sketch_add(&sketch, new_fp_arr, num_new_fp);
+
+   uint64       addr = mini_alloc(mini, 0, NULL_KEY, NULL);
+   page_handle *page = cache_alloc(cc, addr, PAGE_TYPE_FILTER);
+   memmove(page->data, &sketch, sizeof(sketch));
+   routing_unlock_and_unget_page(cc, page);
+   filter->sketch_addr = addr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * routing_filter_sketch_merge
+ *
+ *      Merges the sketch of filter into sketch, which then covers the keys
+ *      of both. Reads a single page of filter. Returns FALSE, leaving
+ *      sketch as it was, if filter was written without a sketch.
+ *----------------------------------------------------------------------
+ */
+bool32
+routing_filter_sketch_merge(cache          *cc,
+                            routing_config *cfg,
+                            routing_filter *filter,
+                            routing_sketch *sketch)
+{
+   if (filter->addr == 0) {
+      return TRUE;
+   }
+   if (filter->sketch_addr == 0) {
+      return FALSE;
+   }
+   page_handle *page =
+      cache_get(cc, filter->sketch_addr, TRUE, PAGE_TYPE_FILTER);
+   routing_sketch *filter_sketch = (routing_sketch *)page->data;
+   for (uint32 reg = 0; reg < ROUTING_SKETCH_REGISTERS; reg++) {
+      sketch->reg[reg] = MAX(sketch->reg[reg], filter_sketch->reg[reg]);
+   }
+   cache_unget(cc, page);
+   return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * routing_sketch_estimate_unique_keys
+ *
+ *      The HyperLogLog estimate of the number of unique keys whose hashes
+ *      sketch has seen, with the standard corrections for small and large
+ *      counts. Its standard error is about 1.04 / sqrt(registers), 6.5%.
+ *----------------------------------------------------------------------
+ */
+uint64
+routing_sketch_estimate_unique_keys(routing_sketch *sketch)
+{
+   const double num_regs   = ROUTING_SKETCH_REGISTERS;
+   const double hash_space = 4294967296.0; // 2^32
+   double       sum        = 0;
+   uint32       num_zero   = 0;
+   for (uint32 reg = 0; reg < ROUTING_SKETCH_REGISTERS; reg++) {
+      sum += ldexp(1.0, -sketch->reg[reg]);
+      num_zero += sketch->reg[reg] == 0;
+   }
+   double alpha    = 0.7213 / (1.0 + 1.079 / num_regs);
+   double estimate = alpha * num_regs * num_regs / sum;
+   if (estimate <= 2.5 * num_regs && num_zero != 0) {
+      estimate = num_regs * log(num_regs / num_zero);
+   } else if (estimate > hash_space / 30) {
+      estimate = -hash_space * log(1.0 - estimate / hash_space);
+   }
+   return estimate;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Blocked Bloom filters
+ *
+ *      A ROUTING_FILTER_BLOOM filter is an array of 64-byte blocks,
+ *      page_size / 64 to a page, with the pages found through an index
+ *      extent like that of a quotient filter. A key hashes to a block by the
+ *      top bits of its hash, so a probe reads one cache line, and each
+ *      (key, value) pair sets num_probes bits of the block, picked by mixing
+ *      the hash with the value. A probe tests the bits of every value in
+ *      value_mask, so it never returns a value which was not added.
+ *
+ *      The old keys of a filter are not known when it is extended, so its
+ *      blocks can't be split. Instead the blocks form segments, the first
+ *      of 2^log_num_blocks blocks sized for the keys the filter is built
+ *      with and each later one twice the size of the one before. Keys are
+ *      added to the last segment until it holds its capacity at
+ *      bits_per_key, and then to a new segment, and a lookup probes every
+ *      segment.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define ROUTING_BLOOM_BLOCK_SIZE  64
+#define ROUTING_BLOOM_BLOCK_WORDS (ROUTING_BLOOM_BLOCK_SIZE / sizeof(uint64))
+#define ROUTING_BLOOM_BLOCK_BITS  (ROUTING_BLOOM_BLOCK_SIZE * 8)
+#define ROUTING_BLOOM_MAX_PROBES  7 // 9 bits of mixed hash each
+
+static inline uint32
+routing_bloom_num_probes(uint32 bits_per_key)
+{
+   // ln(2) bits per key is optimal for an unblocked Bloom filter
+   uint32 num_probes = (bits_per_key * 69 + 50) / 100;
+   return MAX(1, MIN(num_probes, ROUTING_BLOOM_MAX_PROBES));
+}
+
+static inline uint64
+routing_bloom_blocks_per_page(cache_config *cache_cfg)
+{
+   return cache_config_page_size(cache_cfg) / ROUTING_BLOOM_BLOCK_SIZE;
+}
+
+// first block of segment_no, also the number of blocks before it
+static inline uint64
+routing_bloom_segment_start(uint32 log_num_blocks, uint32 segment_no)
+{
+   return ((1ULL << segment_no) - 1) << log_num_blocks;
+}
+
+// number of keys segment_no holds at bits_per_key
+static inline uint64
+routing_bloom_segment_capacity(uint32 log_num_blocks,
+                               uint32 segment_no,
+                               uint32 bits_per_key)
+{
+   return (ROUTING_BLOOM_BLOCK_BITS << (log_num_blocks + segment_no))
+          / bits_per_key;
+}
+
+// the block key_hash probes in segment_no
+static inline uint64
+routing_bloom_block(uint32 key_hash, uint32 log_num_blocks, uint32 segment_no)
+{
+   uint32 log_segment_blocks = log_num_blocks + segment_no;
+   uint64 block_off =
+      log_segment_blocks == 0 ? 0 : key_hash >> (32 - log_segment_blocks);
+   return routing_bloom_segment_start(log_num_blocks, segment_no) + block_off;
+}
+
+// fmix64 from MurmurHash3, the bits of value in the block of key_hash
+static inline uint64
+routing_bloom_mix(uint32 key_hash, uint32 value)
+{
+   uint64 h = ((uint64)value << 32) | key_hash;
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+   h *= 0xc4ceb9fe1a85ec53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+static inline void
+routing_bloom_set(uint64 *block,
+                  uint32  key_hash,
+                  uint32  value,
+                  uint32  num_probes)
+{
+   uint64 h = routing_bloom_mix(key_hash, value);
+   for (uint32 i = 0; i < num_probes; i++) {
+      uint32 bit = h % ROUTING_BLOOM_BLOCK_BITS;
+      block[bit / 64] |= 1ULL << (bit % 64);
+      h /= ROUTING_BLOOM_BLOCK_BITS;
+   }
+}
+
+static inline uint64
+routing_bloom_find(const uint64 *block,
+                   uint32        key_hash,
+                   uint64        value_mask,
+                   uint32        num_probes)
+{
+   uint64 found_values = 0;
+   for (uint32 value = 0; value < 64 && value_mask >> value != 0; value++) {
+      if (!((value_mask >> value) & 1)) {
+         continue;
+      }
+      uint64 h     = routing_bloom_mix(key_hash, value);
+      uint64 found = 1;
+      for (uint32 i = 0; i < num_probes; i++) {
+         uint32 bit = h % ROUTING_BLOOM_BLOCK_BITS;
+         found &= block[bit / 64] >> (bit % 64);
+         h /= ROUTING_BLOOM_BLOCK_BITS;
+      }
+      found_values |= found << value;
+   }
+   return found_values;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * routing_bloom_add
+ *
+ *      routing_filter_add for ROUTING_FILTER_BLOOM filters. The filter is
+ *      built in memory and then written out a page at a time.
+ *----------------------------------------------------------------------
+ */
+static platform_status
+routing_bloom_add(cache          *cc,
+                  routing_config *cfg,
+                  routing_filter *old_filter,
+                  routing_filter *filter,
+                  uint32         *new_fp_arr,
+                  uint64          num_new_fp,
+                  uint16          value)
+{
+   uint64 page_size        = cache_config_page_size(cfg->cache_cfg);
+   uint64 pages_per_extent = cache_config_pages_per_extent(cfg->cache_cfg);
+   uint64 addrs_per_page   = page_size / sizeof(uint64);
+   uint64 blocks_per_page  = routing_bloom_blocks_per_page(cfg->cache_cfg);
+
+   filter->family           = ROUTING_FILTER_BLOOM;
+   filter->num_fingerprints = num_new_fp + old_filter->num_fingerprints;
+   filter->value_size       = value == 0 ? 0 : 32 - __builtin_clz(value);
+
+   uint32 bits_per_key, log_num_blocks, old_num_segments;
+   uint64 old_segment_keys; // in the last segment of old_filter
+   if (old_filter->addr != 0) {
+      debug_assert(old_filter->family == ROUTING_FILTER_BLOOM);
+      mini_unkeyed_prefetch(cc, PAGE_TYPE_FILTER, old_filter->meta_head);
+      filter->value_size = MAX(filter->value_size, old_filter->value_size);
+      bits_per_key       = old_filter->bits_per_key;
+      log_num_blocks     = old_filter->log_num_blocks;
+      old_num_segments   = old_filter->num_segments;
+      old_segment_keys   = old_filter->num_fingerprints;
+      for (uint32 i = 0; i < old_num_segments - 1; i++) {
+         old_segment_keys -=
+            routing_bloom_segment_capacity(log_num_blocks, i, bits_per_key);
+      }
+   } else {
+      bits_per_key = cfg->bloom_bits_per_key;
+      platform_assert(0 < bits_per_key && bits_per_key <= UINT8_MAX);
+      uint64 min_num_blocks =
+         (MAX(num_new_fp, 1) * bits_per_key - 1) / ROUTING_BLOOM_BLOCK_BITS
+         + 1;
+      log_num_blocks =
+         min_num_blocks == 1 ? 0 : 64 - __builtin_clzll(min_num_blocks - 1);
+      old_num_segments = 1;
+      old_segment_keys = 0;
+   }
+   platform_assert(value < 64);
+
+   // the segments the new keys go into
+   uint32 num_segments = old_num_segments;
+   uint64 segment_keys = old_segment_keys;
+   uint64 keys_left    = num_new_fp;
+   uint64 capacity     = routing_bloom_segment_capacity(
+      log_num_blocks, num_segments - 1, bits_per_key);
+   while (segment_keys + keys_left > capacity) {
+      keys_left -= capacity - segment_keys;
+      segment_keys = 0;
+      num_segments++;
+      capacity = routing_bloom_segment_capacity(
+         log_num_blocks, num_segments - 1, bits_per_key);
+   }
+   filter->log_num_blocks = log_num_blocks;
+   filter->num_segments   = num_segments;
+   filter->bits_per_key   = bits_per_key;
+
+   uint64 num_blocks =
+      routing_bloom_segment_start(log_num_blocks, num_segments);
+   uint64 num_pages = (num_blocks - 1) / blocks_per_page + 1;
+   platform_assert(log_num_blocks + num_segments < 32
+                      && num_pages <= routing_max_indices(cfg),
+                   "bloom filter of %lu blocks is too large\n",
+                   num_blocks);
+
+   uint64 *blocks = TYPED_ARRAY_ZALLOC(
+      PROCESS_PRIVATE_HEAP_ID, blocks, num_blocks * ROUTING_BLOOM_BLOCK_WORDS);
+   if (blocks == NULL) {
+      return STATUS_NO_MEMORY;
+   }
+
+   // copy the old filter, its segments are unchanged
+   if (old_filter->addr != 0) {
+      uint64 old_num_blocks =
+         routing_bloom_segment_start(log_num_blocks, old_num_segments);
+      uint64 old_num_pages  = (old_num_blocks - 1) / blocks_per_page + 1;
+      uint64 bytes_per_page = blocks_per_page * ROUTING_BLOOM_BLOCK_SIZE;
+      uint64 bytes_left     = old_num_blocks * ROUTING_BLOOM_BLOCK_SIZE;
+      char  *dst            = (char *)blocks;
+      for (uint64 page_no = 0; page_no < old_num_pages; page_no++) {
+         page_handle *old_page;
+         char        *old_data = (char *)routing_get_header(
+            cc, cfg, old_filter->addr, page_no, &old_page);
+         uint64 len = MIN(bytes_per_page, bytes_left);
+         memmove(dst, old_data, len);
+         dst += len;
+         bytes_left -= len;
+         routing_unget_header(cc, old_page);
+      }
+   }
+
+   uint32 segment_no = old_num_segments - 1;
+   segment_keys      = old_segment_keys;
+   capacity =
+      routing_bloom_segment_capacity(log_num_blocks, segment_no, bits_per_key);
+   uint32 num_probes = routing_bloom_num_probes(bits_per_key);
+   for (uint64 fp_no = 0; fp_no < num_new_fp; fp_no++) {
+      if (segment_keys == capacity) {
+         segment_no++;
+         segment_keys = 0;
+         capacity     = routing_bloom_segment_capacity(
+            log_num_blocks, segment_no, bits_per_key);
+      }
+      uint32 key_hash = new_fp_arr[fp_no];
+      uint64 block =
+         routing_bloom_block(key_hash, log_num_blocks, segment_no);
+      routing_bloom_set(&blocks[block * ROUTING_BLOOM_BLOCK_WORDS],
+                        key_hash,
+                        value,
+                        num_probes);
+      segment_keys++;
+   }
+   debug_assert(segment_no == num_segments - 1);
+
+   /*
+    * Estimate the number of distinct keys in each segment from the fraction
+    * of its bits set, n = -(m / k) ln(1 - X / m).
+    */
+   double est_unique = 0;
+   for (uint32 i = 0; i < num_segments; i++) {
+      uint64 start    = routing_bloom_segment_start(log_num_blocks, i);
+      uint64 end      = routing_bloom_segment_start(log_num_blocks, i + 1);
+      uint64 bits_set = 0;
+      for (uint64 w = start * ROUTING_BLOOM_BLOCK_WORDS;
+           w < end * ROUTING_BLOOM_BLOCK_WORDS;
+           w++)
+      {
+         bits_set += __builtin_popcountll(blocks[w]);
+      }
+      double num_bits = (end - start) * ROUTING_BLOOM_BLOCK_BITS;
+      double fill     = MIN(bits_set / num_bits, 1.0 - 1.0 / num_bits);
+      est_unique += -num_bits / num_probes * log(1.0 - fill);
+   }
+   filter->num_unique = MIN(est_unique, filter->num_fingerprints);
+
+   // write it out, with an unkeyed mini allocator as for quotient filters
+   allocator      *al = cache_get_allocator(cc);
+   uint64          meta_head;
+   platform_status rc = allocator_alloc(al, &meta_head, PAGE_TYPE_FILTER);
+   platform_assert_status_ok(rc);
+   filter->meta_head = meta_head;
+   mini_allocator mini;
+   mini_init(&mini, cc, NULL, filter->meta_head, 0, 1, PAGE_TYPE_FILTER, FALSE);
+
+   page_handle *index_page[MAX_PAGES_PER_EXTENT];
+   filter->addr = routing_alloc_index(cc, &mini, index_page);
+   routing_sketch_write(
+      cc, cfg, &mini, old_filter, new_fp_arr, num_new_fp, filter);
+
+   uint64 bytes_per_page = blocks_per_page * ROUTING_BLOOM_BLOCK_SIZE;
+   uint64 bytes_left     = num_blocks * ROUTING_BLOOM_BLOCK_SIZE;
+   char  *src            = (char *)blocks;
+   for (uint64 page_no = 0; page_no < num_pages; page_no++) {
+      uint64       addr = mini_alloc(&mini, 0, NULL_KEY, NULL);
+      page_handle *page = cache_alloc(cc, addr, PAGE_TYPE_FILTER);
+      uint64       len  = MIN(bytes_per_page, bytes_left);
+      memmove(page->data, src, len);
+      src += len;
+      bytes_left -= len;
+      routing_unlock_and_unget_page(cc, page);
+
+      uint64 *index_cursor =
+         (uint64 *)index_page[page_no / addrs_per_page]->data;
+      index_cursor[page_no % addrs_per_page] = addr;
+   }
+
+   for (uint64 i = 0; i < pages_per_extent; i++) {
+      routing_unlock_and_unget_page(cc, index_page[i]);
+   }
+   mini_release(&mini, NULL_KEY);
+
+   platform_free(PROCESS_PRIVATE_HEAP_ID, blocks);
+   return STATUS_OK;
+}
+
+static platform_status
+routing_bloom_lookup(cache          *cc,
+                     routing_config *cfg,
+                     routing_filter *filter,
+                     uint32          key_hash,
+                     uint64         *found_values)
+{
+   uint64 blocks_per_page = routing_bloom_blocks_per_page(cfg->cache_cfg);
+   uint32 num_probes      = routing_bloom_num_probes(filter->bits_per_key);
+
+   *found_values = 0;
+   for (uint32 i = 0; i < filter->num_segments; i++) {
+      uint64 block = routing_bloom_block(key_hash, filter->log_num_blocks, i);
+      page_handle *page;
+      char        *data = (char *)routing_get_header(
+         cc, cfg, filter->addr, block / blocks_per_page, &page);
+      const uint64 *block_words =
+         (uint64 *)(data + block % blocks_per_page * ROUTING_BLOOM_BLOCK_SIZE);
+      *found_values |= routing_bloom_find(
+         block_words, key_hash, filter->value_mask, num_probes);
+      routing_unget_header(cc, page);
+   }
+   return STATUS_OK;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -320,6 +1004,9 @@ routing_get_bucket_counts(routing_config *cfg, routing_hdr *hdr, uint32 *count)
  *      filter_addr.
  *
  *      meta_head should be passed to routing_filter_zap
+ *
+ *      The new filter is of old_filter's family, or of cfg->family when
+ *      old_filter is empty.
  *----------------------------------------------------------------------
  */
 platform_status
@@ -332,6 +1019,25 @@ routing_filter_add(cache          *cc,
                    uint16          value)
 {
    ZERO_CONTENTS(filter);
+   if (old_filter->addr != 0) {
+      filter->value_mask = old_filter->value_mask;
+   }
+   if (num_new_fp != 0 && value < 64) {
+      filter->value_mask |= 1ULL << value;
+   }
+
+   routing_filter_family family =
+      old_filter->addr != 0 ? old_filter->family : cfg->family;
+   if (family == ROUTING_FILTER_BLOOM) {
+      return routing_bloom_add(
+         cc, cfg, old_filter, filter, new_fp_arr, num_new_fp, value);
+   }
+
+   // the old fingerprints can't be lengthened, so extensions keep their size
+   uint32 fingerprint_size = old_filter->addr != 0
+                                ? old_filter->fingerprint_size
+                                : cfg->fingerprint_size;
+   filter->fingerprint_size = fingerprint_size;
 
    // old filter
    uint32 old_log_num_buckets          = 0;
@@ -348,11 +1054,11 @@ routing_filter_add(cache          *cc,
       }
       uint32 old_log_num_indices = old_log_num_buckets - cfg->log_index_size;
       old_num_indices            = 1UL << old_log_num_indices;
-      old_remainder_size         = cfg->fingerprint_size - old_log_num_buckets;
+      old_remainder_size         = fingerprint_size - old_log_num_buckets;
       old_value_size             = old_filter->value_size;
       old_value_mask             = (1UL << old_value_size) - 1;
       old_remainder_and_value_size = old_value_size + old_remainder_size;
-      platform_assert(cfg->fingerprint_size + old_value_size <= 32);
+      platform_assert(fingerprint_size + old_value_size <= 32);
    }
 
    // compute parameters
@@ -366,7 +1072,7 @@ routing_filter_add(cache          *cc,
    uint32 log_num_indices = log_num_buckets - cfg->log_index_size;
    uint32 num_indices     = 1UL << log_num_indices;
    debug_assert(num_indices > 0);
-   uint32 remainder_size           = cfg->fingerprint_size - log_num_buckets;
+   uint32 remainder_size           = fingerprint_size - log_num_buckets;
    size_t value_size               = value == 0 ? 0 : 32 - __builtin_clz(value);
    filter->value_size              = value_size;
    size_t remainder_and_value_size = value_size + remainder_size;
@@ -374,11 +1080,13 @@ routing_filter_add(cache          *cc,
    size_t index_remainder_and_value_size =
       remainder_and_value_size + cfg->log_index_size;
    uint32 new_indices_per_old_index = num_indices / old_num_indices;
-   platform_assert(cfg->fingerprint_size + value_size <= 32);
+   platform_assert(fingerprint_size + value_size <= 32);
+   platform_assert(num_indices <= routing_max_indices(cfg),
+                   "filter of %u fingerprints is too large\n",
+                   filter->num_fingerprints);
 
    // for convenience
    uint64 page_size        = cache_config_page_size(cfg->cache_cfg);
-   uint64 extent_size      = cache_config_extent_size(cfg->cache_cfg);
    uint64 pages_per_extent = cache_config_pages_per_extent(cfg->cache_cfg);
    uint64 index_size       = cfg->index_size;
 
@@ -427,15 +1135,9 @@ routing_filter_add(cache          *cc,
    // set up the index pages
    uint64       addrs_per_page = page_size / sizeof(uint64);
    page_handle *index_page[MAX_PAGES_PER_EXTENT];
-   uint64       index_addr = mini_alloc(&mini, 0, NULL_KEY, NULL);
-   platform_assert(index_addr % extent_size == 0);
-   index_page[0] = cache_alloc(cc, index_addr, PAGE_TYPE_FILTER);
-   for (uint64 i = 1; i < pages_per_extent; i++) {
-      uint64 next_index_addr = mini_alloc(&mini, 0, NULL_KEY, NULL);
-      platform_assert(next_index_addr == index_addr + i * page_size);
-      index_page[i] = cache_alloc(cc, next_index_addr, PAGE_TYPE_FILTER);
-   }
-   filter->addr = index_addr;
+   filter->addr = routing_alloc_index(cc, &mini, index_page);
+   routing_sketch_write(
+      cc, cfg, &mini, old_filter, new_fp_arr, num_new_fp, filter);
 
    // we write to the filter with the filter cursor
    uint64       addr          = mini_alloc(&mini, 0, NULL_KEY, NULL);
@@ -443,14 +1145,14 @@ routing_filter_add(cache          *cc,
    char        *filter_cursor = filter_page->data;
    uint64       bytes_remaining_on_page = page_size;
 
-   for (uint32 new_fp_no = 0; new_fp_no < num_new_fp; new_fp_no++) {
-      new_fp_arr[new_fp_no] >>= 32 - cfg->fingerprint_size;
-      new_fp_arr[new_fp_no] <<= value_size;
-      new_fp_arr[new_fp_no] |= value;
-   }
-
-   uint32 *fp_arr = RadixSort(
-      new_fp_arr, matrix, temp, num_new_fp, cfg->fingerprint_size, value_size);
+   uint32 *fp_arr = routing_sort_fingerprints(new_fp_arr,
+                                              temp,
+                                              num_new_fp,
+                                              fingerprint_size,
+                                              value_size,
+                                              value,
+                                              matrix);
+   debug_verify_sorted_fingerprints(fp_arr, num_new_fp);
 
    uint32 dst_fp_no         = 0;
    uint64 num_new_unique_fp = num_new_fp;
@@ -679,6 +1381,28 @@ routing_filter_prefetch(cache          *cc,
    }
 }
 
+/*
+ * The expected number of unique keys whose fingerprint_size-bit fingerprints
+ * take num_unique values.
+ */
+static uint32
+routing_estimate_unique_keys(uint32 fingerprint_size, uint64 num_unique)
+{
+   double universe_size = 1UL << fingerprint_size;
+   double unseen_fp     = universe_size - num_unique;
+   /*
+    * Compute the difference H_|U| - H_{|U| - #unique_fp}, where U is the fp
+    * universe.
+    */
+   double harmonic_diff =
+      log(universe_size) - log(unseen_fp)
+      + 1 / 2.0 * (1 / universe_size - 1 / unseen_fp)
+      - 1 / 12.0 * (1 / pow(universe_size, 2) - 1 / pow(unseen_fp, 2))
+      + 1 / 120.0 * (1 / pow(universe_size, 4) - 1 / pow(unseen_fp, 4));
+   uint32 estimated_input_keys = universe_size * harmonic_diff;
+   return estimated_input_keys;
+}
+
 uint32
 routing_filter_estimate_unique_fp(cache           *cc,
                                   routing_config  *cfg,
@@ -696,24 +1420,43 @@ routing_filter_estimate_unique_fp(cache           *cc,
    uint32 *fp_arr = local;
    uint32 *count  = local + buffer_size;
 
+   /*
+    * Fingerprints of different sizes are compared at the smallest size, and
+    * counted as if they were of cfg's size.
+    */
+   uint32 fingerprint_size = cfg->fingerprint_size;
+   for (uint64 i = 0; i != num_filters; i++) {
+      if (filter[i].addr != 0 && filter[i].family == ROUTING_FILTER_QUOTIENT) {
+         fingerprint_size = MIN(fingerprint_size, filter[i].fingerprint_size);
+      }
+   }
+
    uint32 src_fp_no             = 0;
    uint32 dst_fp_no             = 0;
    uint32 fp_start[MAX_FILTERS] = {0};
+   uint32 bloom_unique          = 0;
    for (uint64 i = 0; i != num_filters; i++) {
       if (filter[i].addr == 0) {
          fp_start[i + 1] = dst_fp_no;
          continue;
       }
+      if (filter[i].family == ROUTING_FILTER_BLOOM) {
+         // keys can't be recovered, so assume they are distinct
+         bloom_unique += filter[i].num_unique;
+         fp_start[i + 1] = dst_fp_no;
+         continue;
+      }
       uint32 log_num_buckets = 31 - __builtin_clz(filter[i].num_fingerprints);
       if (log_num_buckets < cfg->log_index_size) {
          log_num_buckets = cfg->log_index_size;
       }
       uint32 log_num_indices          = log_num_buckets - cfg->log_index_size;
       uint32 num_indices              = 1UL << log_num_indices;
-      uint32 remainder_size           = cfg->fingerprint_size - log_num_buckets;
-      uint32 value_size               = filter[i].value_size;
+      uint32 remainder_size = filter[i].fingerprint_size - log_num_buckets;
+      uint32 value_size     = filter[i].value_size;
       uint32 remainder_and_value_size = value_size + remainder_size;
-      platform_assert(cfg->fingerprint_size + value_size <= 32);
+      uint32 fp_shift = filter[i].fingerprint_size - fingerprint_size;
+      platform_assert(filter[i].fingerprint_size + value_size <= 32);
       uint32 index_size = cfg->index_size;
 
       if (num_indices >= 16) {
@@ -756,7 +1499,7 @@ routing_filter_estimate_unique_fp(cache           *cc,
                   uint32 bucket = index_bucket_start + bucket_off;
                   for (uint32 i = 0; i < count[bucket_off]; i++) {
                      fp_arr[src_fp_no] |= bucket << remainder_and_value_size;
-                     fp_arr[src_fp_no] >>= value_size;
+                     fp_arr[src_fp_no] >>= value_size + fp_shift;
                      if (fp_arr[src_fp_no] == last_fp) {
                         src_fp_no++;
                      } else {
@@ -806,7 +1549,14 @@ routing_filter_estimate_unique_fp(cache           *cc,
    }
 
    platform_free(hid, local);
-   return num_unique * 16;
+   num_unique *= 16;
+   if (fingerprint_size < cfg->fingerprint_size) {
+      double num_keys =
+         routing_estimate_unique_keys(fingerprint_size, num_unique);
+      double universe_size = 1UL << cfg->fingerprint_size;
+      num_unique = universe_size * -expm1(-num_keys / universe_size);
+   }
+   return num_unique + bloom_unique;
 }
 
 /*
@@ -829,23 +1579,42 @@ routing_filter_lookup(cache          *cc,
 {
    debug_assert(key_is_user_key(target));
 
+   return routing_filter_lookup_hash(
+      cc, cfg, filter, routing_filter_hash(cfg, target), found_values);
+}
+
+/*
+ *----------------------------------------------------------------------
+ * routing_filter_lookup_hash
+ *
+ *      Same as routing_filter_lookup, for a key whose routing_filter_hash
+ *      is key_hash.
+ *----------------------------------------------------------------------
+ */
+platform_status
+routing_filter_lookup_hash(cache          *cc,
+                           routing_config *cfg,
+                           routing_filter *filter,
+                           uint32          key_hash,
+                           uint64         *found_values)
+{
    if (filter->addr == 0) {
       *found_values = 0;
       return STATUS_OK;
    }
+   if (filter->family == ROUTING_FILTER_BLOOM) {
+      return routing_bloom_lookup(cc, cfg, filter, key_hash, found_values);
+   }
 
-   hash_fn hash       = cfg->hash;
-   uint64  seed       = cfg->seed;
-   uint64  index_size = cfg->index_size;
+   uint64 index_size = cfg->index_size;
 
-   uint32 fp = hash(key_data(target), key_length(target), seed);
-   fp >>= 32 - cfg->fingerprint_size;
+   uint32 fp = key_hash >> (32 - filter->fingerprint_size);
    size_t value_size      = filter->value_size;
    uint32 log_num_buckets = 31 - __builtin_clz(filter->num_fingerprints);
    if (log_num_buckets < cfg->log_index_size) {
       log_num_buckets = cfg->log_index_size;
    }
-   uint32 remainder_size           = cfg->fingerprint_size - log_num_buckets;
+   uint32 remainder_size           = filter->fingerprint_size - log_num_buckets;
    size_t remainder_and_value_size = remainder_size + value_size;
    uint32 bucket =
       routing_get_bucket(fp << value_size, remainder_and_value_size);
@@ -878,29 +1647,474 @@ routing_filter_lookup(cache          *cc,
       return STATUS_OK;
    }
 
-   uint64 found_values_int = 0;
-   for (uint32 i = 0; i < end - start; i++) {
-      uint32 pos = end - i - 1;
-      uint32 found_remainder_and_value;
-      routing_filter_get_remainder_and_value(cfg,
-                                             (uint32 *)remainder_block_start,
-                                             pos,
-                                             &found_remainder_and_value,
-                                             remainder_and_value_size);
-      uint32 found_remainder = found_remainder_and_value >> value_size;
-      if (found_remainder == remainder) {
-         uint32 value_mask  = (1UL << value_size) - 1;
-         uint16 found_value = found_remainder_and_value & value_mask;
-         platform_assert(found_value < 64);
-         found_values_int |= (1UL << found_value);
+   uint64 block_size = routing_remainder_block_size(hdr->num_remainders,
+                                                    remainder_and_value_size);
+   *found_values     = routing_find_remainder(remainder_block_start,
+                                          block_size,
+                                          start,
+                                          end,
+                                          remainder_and_value_size,
+                                          value_size,
+                                          remainder);
+
+   routing_unget_header(cc, filter_node);
+   return STATUS_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Decoded filter cache
+ *
+ *      A routing_filter_cache holds filters decoded into DRAM, looked up
+ *      by meta_head in a hash table with a spinlock per bucket. Decoding
+ *      a quotient filter precomputes the bounds of every bucket and
+ *      unpacks its remainders, so a probe reads two bounds and scans the
+ *      entries between them. A decoded Bloom filter is a copy of its
+ *      blocks.
+ *
+ *      When a filter doesn't fit, a clock hand sweeps the buckets,
+ *      evicting the filters not probed since it last passed them, so the
+ *      cache keeps the filters probed most often. A filter is also evicted
+ *      when its last reference is dropped (see routing_filter_zap_cached).
+ *
+ *      Lookups hold a reference to the decoded filter they probe, so an
+ *      evicted filter is freed when the last of them is done with it.
+ *----------------------------------------------------------------------
+ */
+
+#define ROUTING_FILTER_CACHE_LOG_BUCKETS 10
+#define ROUTING_FILTER_CACHE_BUCKETS     (1 << ROUTING_FILTER_CACHE_LOG_BUCKETS)
+
+typedef struct routing_decoded_filter {
+   struct routing_decoded_filter *next;
+   uint64                         meta_head;
+   volatile uint64                refs; // the cache's and its lookups'
+   uint64                         size; // charged against the capacity
+   volatile bool32                referenced; // since the clock hand passed
+   routing_filter                 filter;
+   // ROUTING_FILTER_QUOTIENT only
+   uint32  fingerprint_size;
+   uint32  remainder_size;
+   uint32 *bucket_start; // num_buckets + 1 of them
+   uint32 *entries;      // remainder and value, sorted by bucket
+   // the entries and bucket starts, or the blocks of a Bloom filter
+   uint64 data[];
+} routing_decoded_filter;
+
+typedef struct routing_filter_cache_bucket {
+   platform_spinlock       lock;
+   routing_decoded_filter *head;
+} routing_filter_cache_bucket;
+
+struct routing_filter_cache {
+   platform_heap_id            heap_id;
+   uint64                      capacity;
+   volatile uint64             size;
+   volatile uint64             clock_hand; // next bucket swept
+   routing_filter_cache_bucket bucket[ROUTING_FILTER_CACHE_BUCKETS];
+   routing_filter_cache_stats  stats[MAX_THREADS];
+};
+
+static inline uint32
+routing_log_num_buckets(routing_config *cfg, routing_filter *filter)
+{
+   uint32 log_num_buckets = 31 - __builtin_clz(filter->num_fingerprints);
+   return MAX(log_num_buckets, cfg->log_index_size);
+}
+
+static inline routing_filter_cache_bucket *
+routing_filter_cache_get_bucket(routing_filter_cache *fcache,
+                                uint64                meta_head)
+{
+   // meta_heads are page aligned, so their low bits are all zero
+   uint64 hash = meta_head * 0x9e3779b97f4a7c15ULL;
+   return &fcache->bucket[hash >> (64 - ROUTING_FILTER_CACHE_LOG_BUCKETS)];
+}
+
+static uint64
+routing_decoded_size(routing_config *cfg, routing_filter *filter)
+{
+   uint64 num_words;
+   if (filter->family == ROUTING_FILTER_BLOOM) {
+      uint64 num_blocks = routing_bloom_segment_start(filter->log_num_blocks,
+                                                      filter->num_segments);
+      num_words         = num_blocks * ROUTING_BLOOM_BLOCK_WORDS;
+   } else {
+      uint64 num_buckets = 1ULL << routing_log_num_buckets(cfg, filter);
+      uint64 num_uint32s = num_buckets + 1 + filter->num_fingerprints;
+      num_words          = (num_uint32s + 1) / 2;
+   }
+   return sizeof(routing_decoded_filter) + num_words * sizeof(uint64);
+}
+
+static void
+routing_decode_quotient(cache                  *cc,
+                        routing_config         *cfg,
+                        routing_decoded_filter *decoded)
+{
+   routing_filter *filter          = &decoded->filter;
+   uint32          log_num_buckets = routing_log_num_buckets(cfg, filter);
+   uint32          num_indices = 1UL << (log_num_buckets - cfg->log_index_size);
+   uint64          num_buckets = 1ULL << log_num_buckets;
+   decoded->fingerprint_size   = filter->fingerprint_size;
+   decoded->remainder_size     = filter->fingerprint_size - log_num_buckets;
+   decoded->bucket_start       = (uint32 *)decoded->data;
+   decoded->entries            = decoded->bucket_start + num_buckets + 1;
+   size_t remainder_and_value_size =
+      decoded->remainder_size + filter->value_size;
+
+   uint32 num_entries = 0;
+   for (uint32 index_no = 0; index_no < num_indices; index_no++) {
+      page_handle *filter_page;
+      routing_hdr *hdr =
+         routing_get_header(cc, cfg, filter->addr, index_no, &filter_page);
+      platform_assert(num_entries + hdr->num_remainders
+                      <= filter->num_fingerprints);
+      if (hdr->num_remainders != 0) {
+         char *remainder_block_start =
+            (char *)hdr + routing_header_length(cfg, hdr);
+         PackedArray_unpack((uint32 *)remainder_block_start,
+                            0,
+                            decoded->entries + num_entries,
+                            hdr->num_remainders,
+                            remainder_and_value_size);
+      }
+      // turn the counts of the buckets of the index into their starts
+      uint32 *bucket_start = decoded->bucket_start + index_no * cfg->index_size;
+      routing_get_bucket_counts(cfg, hdr, bucket_start);
+      for (uint32 bucket_off = 0; bucket_off < cfg->index_size; bucket_off++) {
+         uint32 count             = bucket_start[bucket_off];
+         bucket_start[bucket_off] = num_entries;
+         num_entries += count;
       }
+      routing_unget_header(cc, filter_page);
    }
+   decoded->bucket_start[num_buckets] = num_entries;
+}
 
-   routing_unget_header(cc, filter_node);
-   *found_values = found_values_int;
+static void
+routing_decode_bloom(cache                  *cc,
+                     routing_config         *cfg,
+                     routing_decoded_filter *decoded)
+{
+   routing_filter *filter = &decoded->filter;
+   uint64 blocks_per_page = routing_bloom_blocks_per_page(cfg->cache_cfg);
+   uint64 num_blocks      = routing_bloom_segment_start(filter->log_num_blocks,
+                                                   filter->num_segments);
+   for (uint64 block = 0; block < num_blocks; block += blocks_per_page) {
+      page_handle *page;
+      char        *data = (char *)routing_get_header(
+         cc, cfg, filter->addr, block / blocks_per_page, &page);
+      uint64 num_page_blocks = MIN(blocks_per_page, num_blocks - block);
+      memmove(decoded->data + block * ROUTING_BLOOM_BLOCK_WORDS,
+              data,
+              num_page_blocks * ROUTING_BLOOM_BLOCK_SIZE);
+      routing_unget_header(cc, page);
+   }
+}
+
+static uint64
+routing_decoded_lookup(routing_decoded_filter *decoded, uint32 key_hash)
+{
+   routing_filter *filter = &decoded->filter;
+   if (filter->family == ROUTING_FILTER_BLOOM) {
+      uint32 num_probes   = routing_bloom_num_probes(filter->bits_per_key);
+      uint64 found_values = 0;
+      for (uint32 i = 0; i < filter->num_segments; i++) {
+         uint64 block =
+            routing_bloom_block(key_hash, filter->log_num_blocks, i);
+         uint64 *block_words =
+            decoded->data + block * ROUTING_BLOOM_BLOCK_WORDS;
+         found_values |= routing_bloom_find(
+            block_words, key_hash, filter->value_mask, num_probes);
+      }
+      return found_values;
+   }
+
+   uint32 fp         = key_hash >> (32 - decoded->fingerprint_size);
+   uint32 bucket     = fp >> decoded->remainder_size;
+   uint32 remainder  = fp & ((1UL << decoded->remainder_size) - 1);
+   uint32 value_size = filter->value_size;
+   uint32 value_mask = (1UL << value_size) - 1;
+   uint32 end        = decoded->bucket_start[bucket + 1];
+
+   uint64 found_values = 0;
+   for (uint32 pos = decoded->bucket_start[bucket]; pos < end; pos++) {
+      uint32 entry = decoded->entries[pos];
+      found_values |= (uint64)((entry >> value_size) == remainder)
+                      << (entry & value_mask);
+   }
+   return found_values;
+}
+
+static void
+routing_decoded_filter_unget(routing_filter_cache   *fcache,
+                             routing_decoded_filter *decoded)
+{
+   if (__sync_sub_and_fetch(&decoded->refs, 1) == 0) {
+      platform_free(fcache->heap_id, decoded);
+   }
+}
+
+/*
+ * Returns the decoded filter, with a reference the caller must unget, or NULL
+ * if it isn't cached.
+ */
+static routing_decoded_filter *
+routing_filter_cache_get(routing_filter_cache *fcache, routing_filter *filter)
+{
+   routing_filter_cache_bucket *bucket =
+      routing_filter_cache_get_bucket(fcache, filter->meta_head);
+   platform_spin_lock(&bucket->lock);
+   routing_decoded_filter *decoded = bucket->head;
+   while (decoded != NULL && decoded->meta_head != filter->meta_head) {
+      decoded = decoded->next;
+   }
+   if (decoded != NULL) {
+      __sync_fetch_and_add(&decoded->refs, 1);
+      if (!decoded->referenced) {
+         decoded->referenced = TRUE;
+      }
+   }
+   platform_spin_unlock(&bucket->lock);
+   return decoded;
+}
+
+/*
+ * Evicts the decoded filters of bucket not probed since the clock hand last
+ * passed it, and clears the referenced bit of the others.
+ */
+static void
+routing_filter_cache_sweep(routing_filter_cache        *fcache,
+                           routing_filter_cache_bucket *bucket)
+{
+   routing_decoded_filter *evicted = NULL;
+   platform_spin_lock(&bucket->lock);
+   routing_decoded_filter **link = &bucket->head;
+   while (*link != NULL) {
+      routing_decoded_filter *decoded = *link;
+      if (decoded->referenced) {
+         decoded->referenced = FALSE;
+         link                = &decoded->next;
+      } else {
+         *link         = decoded->next;
+         decoded->next = evicted;
+         evicted       = decoded;
+      }
+   }
+   platform_spin_unlock(&bucket->lock);
+
+   while (evicted != NULL) {
+      routing_decoded_filter *decoded = evicted;
+      evicted                         = decoded->next;
+      __sync_fetch_and_sub(&fcache->size, decoded->size);
+      routing_decoded_filter_unget(fcache, decoded);
+      fcache->stats[platform_get_tid()].evictions++;
+   }
+}
+
+/*
+ * Charges size bytes against the capacity of fcache, advancing the clock hand
+ * until they fit or it has gone around twice, after which every filter cached
+ * when it started has been evicted or probed since. Returns whether they fit.
+ */
+static bool32
+routing_filter_cache_reserve(routing_filter_cache *fcache, uint64 size)
+{
+   if (size > fcache->capacity) {
+      return FALSE;
+   }
+   for (uint64 swept = 0; swept <= 2 * ROUTING_FILTER_CACHE_BUCKETS; swept++) {
+      if (fcache->size + size <= fcache->capacity) {
+         if (__sync_add_and_fetch(&fcache->size, size) <= fcache->capacity) {
+            return TRUE;
+         }
+         __sync_fetch_and_sub(&fcache->size, size);
+      }
+      uint64 hand = __sync_fetch_and_add(&fcache->clock_hand, 1);
+      routing_filter_cache_sweep(
+         fcache, &fcache->bucket[hand % ROUTING_FILTER_CACHE_BUCKETS]);
+   }
+   return FALSE;
+}
+
+routing_filter_cache *
+routing_filter_cache_create(platform_heap_id hid, uint64 capacity)
+{
+   routing_filter_cache *fcache = TYPED_ZALLOC(hid, fcache);
+   if (fcache == NULL) {
+      return NULL;
+   }
+   fcache->heap_id  = hid;
+   fcache->capacity = capacity;
+   for (uint64 i = 0; i < ROUTING_FILTER_CACHE_BUCKETS; i++) {
+      platform_status rc = platform_spinlock_init(
+         &fcache->bucket[i].lock, platform_get_module_id(), hid);
+      platform_assert_status_ok(rc);
+   }
+   return fcache;
+}
+
+/*
+ * Frees the cache and its decoded filters, which no lookup may be using.
+ */
+void
+routing_filter_cache_destroy(routing_filter_cache *fcache)
+{
+   for (uint64 i = 0; i < ROUTING_FILTER_CACHE_BUCKETS; i++) {
+      routing_filter_cache_bucket *bucket = &fcache->bucket[i];
+      while (bucket->head != NULL) {
+         routing_decoded_filter *decoded = bucket->head;
+         bucket->head                    = decoded->next;
+         debug_assert(decoded->refs == 1);
+         platform_free(fcache->heap_id, decoded);
+      }
+      platform_spinlock_destroy(&bucket->lock);
+   }
+   platform_free(fcache->heap_id, fcache);
+}
+
+void
+routing_filter_cache_get_stats(routing_filter_cache       *fcache,
+                               routing_filter_cache_stats *stats)
+{
+   ZERO_CONTENTS(stats);
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      stats->hits += fcache->stats[tid].hits;
+      stats->decodes += fcache->stats[tid].decodes;
+      stats->uncached += fcache->stats[tid].uncached;
+      stats->evictions += fcache->stats[tid].evictions;
+   }
+}
+
+/*
+ *----------------------------------------------------------------------
+ * routing_filter_cache_lookup
+ *
+ *      Probes filter if it is decoded in fcache and returns TRUE, or
+ *      returns FALSE without doing any I/O.
+ *----------------------------------------------------------------------
+ */
+bool32
+routing_filter_cache_lookup(routing_filter_cache *fcache,
+                            routing_filter       *filter,
+                            uint32                key_hash,
+                            uint64               *found_values)
+{
+   if (filter->addr == 0) {
+      *found_values = 0;
+      return TRUE;
+   }
+   routing_decoded_filter *decoded = routing_filter_cache_get(fcache, filter);
+   if (decoded == NULL) {
+      return FALSE;
+   }
+   *found_values = routing_decoded_lookup(decoded, key_hash);
+   routing_decoded_filter_unget(fcache, decoded);
+   fcache->stats[platform_get_tid()].hits++;
+   return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * routing_filter_lookup_cached
+ *
+ *      routing_filter_lookup_hash through fcache. A filter that isn't
+ *      cached is decoded and added to it, evicting filters not probed
+ *      recently to make room. If there is still no room, it is probed on
+ *      its pages.
+ *----------------------------------------------------------------------
+ */
+platform_status
+routing_filter_lookup_cached(cache                *cc,
+                             routing_config       *cfg,
+                             routing_filter_cache *fcache,
+                             routing_filter       *filter,
+                             uint32                key_hash,
+                             uint64               *found_values)
+{
+   if (routing_filter_cache_lookup(fcache, filter, key_hash, found_values)) {
+      return STATUS_OK;
+   }
+
+   // reserve room for the decoded filter before decoding it
+   uint64                  size    = routing_decoded_size(cfg, filter);
+   routing_decoded_filter *decoded = NULL;
+   if (routing_filter_cache_reserve(fcache, size)) {
+      decoded = TYPED_MANUAL_MALLOC(fcache->heap_id, decoded, size);
+      if (decoded == NULL) {
+         __sync_fetch_and_sub(&fcache->size, size);
+      }
+   }
+   threadid tid = platform_get_tid();
+   if (decoded == NULL) {
+      fcache->stats[tid].uncached++;
+      return routing_filter_lookup_hash(
+         cc, cfg, filter, key_hash, found_values);
+   }
+   fcache->stats[tid].decodes++;
+   decoded->meta_head  = filter->meta_head;
+   decoded->size       = size;
+   decoded->referenced = TRUE;
+   decoded->filter     = *filter;
+   if (filter->family == ROUTING_FILTER_BLOOM) {
+      routing_decode_bloom(cc, cfg, decoded);
+   } else {
+      routing_decode_quotient(cc, cfg, decoded);
+   }
+
+   // another lookup may have decoded it meanwhile, in which case ours goes
+   routing_filter_cache_bucket *bucket =
+      routing_filter_cache_get_bucket(fcache, filter->meta_head);
+   platform_spin_lock(&bucket->lock);
+   routing_decoded_filter *other = bucket->head;
+   while (other != NULL && other->meta_head != filter->meta_head) {
+      other = other->next;
+   }
+   if (other == NULL) {
+      decoded->refs = 2;
+      decoded->next = bucket->head;
+      bucket->head  = decoded;
+   } else {
+      decoded->refs = 1;
+   }
+   platform_spin_unlock(&bucket->lock);
+   if (other != NULL) {
+      __sync_fetch_and_sub(&fcache->size, size);
+   }
+
+   *found_values = routing_decoded_lookup(decoded, key_hash);
+   routing_decoded_filter_unget(fcache, decoded);
    return STATUS_OK;
 }
 
+/*
+ * Removes the filter at meta_head from fcache, the mini_last_ref_fn of
+ * routing_filter_zap_cached.
+ */
+static void
+routing_filter_cache_evict(uint64 meta_head, void *arg)
+{
+   routing_filter_cache        *fcache = (routing_filter_cache *)arg;
+   routing_filter_cache_bucket *bucket =
+      routing_filter_cache_get_bucket(fcache, meta_head);
+   platform_spin_lock(&bucket->lock);
+   routing_decoded_filter **link = &bucket->head;
+   while (*link != NULL && (*link)->meta_head != meta_head) {
+      link = &(*link)->next;
+   }
+   routing_decoded_filter *decoded = *link;
+   if (decoded != NULL) {
+      *link = decoded->next;
+   }
+   platform_spin_unlock(&bucket->lock);
+   if (decoded != NULL) {
+      __sync_fetch_and_sub(&fcache->size, decoded->size);
+      routing_decoded_filter_unget(fcache, decoded);
+   }
+}
+
 /*
  *-----------------------------------------------------------------------------
  * routing_async_set_state --
@@ -966,6 +2180,7 @@ routing_filter_async_callback(cache_async_ctxt *cache_ctxt)
  * routing_filter_lookup_async --
  *
  *      Async filter lookup api. Returns if lookup found a key in *found_values.
+ *      The key is given by its routing_filter_hash.
  *      The ctxt should've been initialized using routing_filter_ctxt_init().
  *      The return value can be either of:
  *      async_locked: A page needed by lookup is locked. User should retry
@@ -992,33 +2207,43 @@ cache_async_result
 routing_filter_lookup_async(cache              *cc,
                             routing_config     *cfg,
                             routing_filter     *filter,
-                            key                 target,
+                            uint32              key_hash,
                             uint64             *found_values,
                             routing_async_ctxt *ctxt)
 {
    cache_async_result res  = 0;
    bool32             done = FALSE;
 
-   debug_assert(key_is_user_key(target));
-
    uint64 page_size = cache_config_page_size(cfg->cache_cfg);
    do {
       switch (ctxt->state) {
          case routing_async_state_start:
          {
-            // Calculate filter parameters for the key
-            hash_fn hash = cfg->hash;
-            uint64  seed = cfg->seed;
+            uint64 addrs_per_page = (page_size / sizeof(uint64));
+            if (filter->family == ROUTING_FILTER_BLOOM) {
+               // the bucket is the block, the index is its page
+               ctxt->bucket = routing_bloom_block(
+                  key_hash, filter->log_num_blocks, ctxt->segment);
+               ctxt->index = ctxt->bucket
+                             / routing_bloom_blocks_per_page(cfg->cache_cfg);
+               ctxt->page_addr =
+                  filter->addr + page_size * (ctxt->index / addrs_per_page);
+               if (ctxt->segment == 0) {
+                  *found_values = 0;
+               }
+               routing_async_set_state(ctxt, routing_async_state_get_index);
+               break;
+            }
 
-            uint32 fp = hash(key_data(target), key_length(target), seed);
-            fp >>= 32 - cfg->fingerprint_size;
+            // Calculate filter parameters for the key
+            uint32 fp = key_hash >> (32 - filter->fingerprint_size);
             size_t value_size = filter->value_size;
             uint32 log_num_buckets =
                31 - __builtin_clz(filter->num_fingerprints);
             if (log_num_buckets < cfg->log_index_size) {
                log_num_buckets = cfg->log_index_size;
             }
-            ctxt->remainder_size = cfg->fingerprint_size - log_num_buckets;
+            ctxt->remainder_size = filter->fingerprint_size - log_num_buckets;
             size_t remainder_and_value_size = ctxt->remainder_size + value_size;
             ctxt->bucket =
                routing_get_bucket(fp << value_size, remainder_and_value_size);
@@ -1029,7 +2254,6 @@ routing_filter_lookup_async(cache              *cc,
                                             index_remainder_and_value_size);
             ctxt->remainder       = fp & remainder_mask;
 
-            uint64 addrs_per_page = (page_size / sizeof(uint64));
             ctxt->page_addr =
                filter->addr + page_size * (ctxt->index / addrs_per_page);
             routing_async_set_state(ctxt, routing_async_state_get_index);
@@ -1109,6 +2333,27 @@ routing_filter_lookup_async(cache              *cc,
             if (ctxt->was_async) {
                cache_async_done(cc, PAGE_TYPE_FILTER, cache_ctxt);
             }
+            if (filter->family == ROUTING_FILTER_BLOOM) {
+               uint64 block_off =
+                  ctxt->bucket % routing_bloom_blocks_per_page(cfg->cache_cfg);
+               const uint64 *block =
+                  (uint64 *)(cache_ctxt->page->data
+                             + block_off * ROUTING_BLOOM_BLOCK_SIZE);
+               *found_values |= routing_bloom_find(
+                  block,
+                  key_hash,
+                  filter->value_mask,
+                  routing_bloom_num_probes(filter->bits_per_key));
+               cache_unget(cc, cache_ctxt->page);
+               if (++ctxt->segment < filter->num_segments) {
+                  // probe the next segment
+                  routing_async_set_state(ctxt, routing_async_state_start);
+                  break;
+               }
+               res  = async_success;
+               done = TRUE;
+               break;
+            }
             routing_hdr *hdr =
                (routing_hdr *)(cache_ctxt->page->data
                                + (ctxt->header_addr % page_size));
@@ -1121,28 +2366,21 @@ routing_filter_lookup_async(cache              *cc,
                hdr->encoding, header_length, bucket_off, &start, &end);
             char *remainder_block_start = (char *)hdr + header_length;
 
-            uint64 found_values_int = 0;
-            for (uint32 i = 0; i < end - start; i++) {
-               uint32 pos = end - i - 1;
-               uint32 found_remainder_and_value;
+            *found_values = 0;
+            if (start != end) {
                size_t value_size = filter->value_size;
                size_t remainder_and_value_size =
                   ctxt->remainder_size + value_size;
-               routing_filter_get_remainder_and_value(
-                  cfg,
-                  (uint32 *)remainder_block_start,
-                  pos,
-                  &found_remainder_and_value,
-                  remainder_and_value_size);
-               uint32 found_remainder = found_remainder_and_value >> value_size;
-               if (found_remainder == ctxt->remainder) {
-                  uint32 value_mask  = (1UL << value_size) - 1;
-                  uint16 found_value = found_remainder_and_value & value_mask;
-                  platform_assert(found_value < 64);
-                  found_values_int |= (1UL << found_value);
-               }
+               uint64 block_size = routing_remainder_block_size(
+                  hdr->num_remainders, remainder_and_value_size);
+               *found_values = routing_find_remainder(remainder_block_start,
+                                                      block_size,
+                                                      start,
+                                                      end,
+                                                      remainder_and_value_size,
+                                                      value_size,
+                                                      ctxt->remainder);
             }
-            *found_values = found_values_int;
             cache_unget(cc, cache_ctxt->page);
             res  = async_success;
             done = TRUE;
@@ -1174,6 +2412,38 @@ routing_filter_zap(cache *cc, routing_filter *filter)
    mini_unkeyed_dec_ref(cc, meta_head, PAGE_TYPE_FILTER, FALSE);
 }
 
+/*
+ *----------------------------------------------------------------------
+ * routing_filter_zap_cached
+ *
+ *      routing_filter_zap, which also evicts filter from fcache when it
+ *      drops the last reference. Since filters are cached by meta_head,
+ *      the eviction comes before the filter is deallocated, after which
+ *      a new filter may be allocated at the same address.
+ *----------------------------------------------------------------------
+ */
+void
+routing_filter_zap_cached(cache                *cc,
+                          routing_filter_cache *fcache,
+                          routing_filter       *filter)
+{
+   if (fcache == NULL) {
+      routing_filter_zap(cc, filter);
+      return;
+   }
+   if (filter->num_fingerprints == 0) {
+      return;
+   }
+
+   uint64 meta_head = filter->meta_head;
+   mini_unkeyed_dec_ref_last(cc,
+                             meta_head,
+                             PAGE_TYPE_FILTER,
+                             FALSE,
+                             routing_filter_cache_evict,
+                             fcache);
+}
+
 /*
  *----------------------------------------------------------------------
  * routing_filter_estimate_unique_keys
@@ -1186,27 +2456,19 @@ uint32
 routing_filter_estimate_unique_keys_from_count(routing_config *cfg,
                                                uint64          num_unique)
 {
-   double universe_size = 1UL << cfg->fingerprint_size;
-   double unseen_fp     = universe_size - num_unique;
-   /*
-    * Compute the difference H_|U| - H_{|U| - #unique_fp}, where U is the fp
-    * universe.
-    */
-   double harmonic_diff =
-      log(universe_size) - log(unseen_fp)
-      + 1 / 2.0 * (1 / universe_size - 1 / unseen_fp)
-      - 1 / 12.0 * (1 / pow(universe_size, 2) - 1 / pow(unseen_fp, 2))
-      + 1 / 120.0 * (1 / pow(universe_size, 4) - 1 / pow(unseen_fp, 4));
-   uint32 estimated_input_keys = universe_size * harmonic_diff;
-   return estimated_input_keys;
+   return routing_estimate_unique_keys(cfg->fingerprint_size, num_unique);
 }
 
 uint32
 routing_filter_estimate_unique_keys(routing_filter *filter, routing_config *cfg)
 {
    // platform_default_log("unique fp %u\n", filter->num_unique);
-   return routing_filter_estimate_unique_keys_from_count(cfg,
-                                                         filter->num_unique);
+   if (filter->family == ROUTING_FILTER_BLOOM) {
+      // already estimated from the bits set
+      return filter->num_unique;
+   }
+   return routing_estimate_unique_keys(filter->fingerprint_size,
+                                       filter->num_unique);
 }
 
 /*
@@ -1316,6 +2578,18 @@ routing_filter_print_remainders(routing_config *cfg,
 void
 routing_filter_print(cache *cc, routing_config *cfg, routing_filter *filter)
 {
+   if (filter->family == ROUTING_FILTER_BLOOM) {
+      platform_default_log("bloom filter: %u fingerprints, %u unique, "
+                           "%u segments from %lu blocks, %u bits per key, "
+                           "value size %u\n",
+                           filter->num_fingerprints,
+                           filter->num_unique,
+                           filter->num_segments,
+                           1UL << filter->log_num_blocks,
+                           filter->bits_per_key,
+                           filter->value_size);
+      return;
+   }
    uint64 filter_addr     = filter->addr;
    uint32 log_num_buckets = 31 - __builtin_clz(filter->num_fingerprints);
    if (log_num_buckets < cfg->log_index_size) {
@@ -1324,7 +2598,7 @@ routing_filter_print(cache *cc, routing_config *cfg, routing_filter *filter)
    uint32 log_num_indices = log_num_buckets - cfg->log_index_size;
    uint32 num_indices     = 1UL << log_num_indices;
    debug_assert(num_indices > 0);
-   uint32 remainder_size = cfg->fingerprint_size - log_num_buckets;
+   uint32 remainder_size = filter->fingerprint_size - log_num_buckets;
 
    routing_filter_print_index(cc, cfg, filter_addr, num_indices);
    uint64 i;
@@ -26,6 +26,44 @@
 #define ROUTING_NOT_FOUND (UINT16_MAX)
 
 
+/*
+ * The implementations behind the routing filter interface.
+ *
+ * ROUTING_FILTER_QUOTIENT filters store a sorted, bucketed array of
+ * fingerprint remainders, fingerprint_size bits of hash per key in total,
+ * and can be enumerated (see routing_filter_estimate_unique_fp).
+ *
+ * ROUTING_FILTER_BLOOM filters are cache-line-blocked Bloom filters with
+ * bloom_bits_per_key bits per key. Building one needs no sort and a lookup
+ * reads one 64-byte block per segment, a segment of twice the size being
+ * added each time the filter is extended past its capacity. For the same
+ * space their false positive rate is higher, and the number of unique keys
+ * in them is estimated from their bit density.
+ *
+ * A filter always extends in its own family and with its own
+ * fingerprint_size, so a config's family and fingerprint_size apply to
+ * filters built from scratch.
+ */
+typedef enum routing_filter_family {
+   ROUTING_FILTER_QUOTIENT = 0,
+   ROUTING_FILTER_BLOOM,
+} routing_filter_family;
+
+#define ROUTING_BLOOM_DEFAULT_BITS_PER_KEY 10
+
+/*
+ * A HyperLogLog sketch of the hashes of a filter's keys. Every filter keeps
+ * one on a page of its own, so the unique keys of several filters together
+ * can be estimated from one page of each rather than from all of their
+ * fingerprints (see routing_filter_sketch_merge).
+ */
+#define ROUTING_SKETCH_LOG_REGISTERS 8
+#define ROUTING_SKETCH_REGISTERS     (1 << ROUTING_SKETCH_LOG_REGISTERS)
+
+typedef struct ONDISK routing_sketch {
+   uint8 reg[ROUTING_SKETCH_REGISTERS];
+} routing_sketch;
+
 /*
  * Routing Filters Configuration structure - used to setup routing filters.
  */
@@ -38,6 +76,9 @@ typedef struct routing_config {
 
    hash_fn      hash;
    unsigned int seed;
+
+   routing_filter_family family; // of filters built from scratch
+   uint32                bloom_bits_per_key;
 } routing_config;
 
 /*
@@ -49,9 +90,18 @@ typedef struct routing_config {
 typedef struct ONDISK routing_filter {
    uint64 addr;
    uint64 meta_head;
+   uint64 sketch_addr; // 0 for filters written without a routing_sketch
    uint32 num_fingerprints;
    uint32 num_unique;
    uint32 value_size;
+   uint64 value_mask; // bit v is set when keys were added with value v
+   uint8  family;     // routing_filter_family
+   // ROUTING_FILTER_QUOTIENT only, kept when the filter is extended
+   uint8 fingerprint_size;
+   // ROUTING_FILTER_BLOOM only
+   uint8 log_num_blocks; // of the first segment
+   uint8 num_segments;
+   uint8 bits_per_key;
 } routing_filter;
 
 struct routing_async_ctxt;
@@ -84,6 +134,7 @@ typedef struct routing_async_ctxt {
    uint32              remainder;   // remainder
    uint32              bucket;      // hash bucket
    uint32              index;       // hash index
+   uint32              segment;     // ROUTING_FILTER_BLOOM segment
    uint64              page_addr;   // Can be index or filter
    uint64              header_addr; // header address in filter page
    cache_async_ctxt   *cache_ctxt;  // cache ctxt for async get
@@ -98,6 +149,17 @@ routing_filter_add(cache          *cc,
                    uint64          num_new_fingerprints,
                    uint16          value);
 
+/*
+ * The hash the filters take their fingerprints from. It depends only on the
+ * key and cfg, so a lookup that probes many filters computes it once and
+ * passes it to routing_filter_lookup_hash and routing_filter_lookup_async.
+ */
+static inline uint32
+routing_filter_hash(const routing_config *cfg, key target)
+{
+   return cfg->hash(key_data(target), key_length(target), cfg->seed);
+}
+
 platform_status
 routing_filter_lookup(cache          *cc,
                       routing_config *cfg,
@@ -105,6 +167,56 @@ routing_filter_lookup(cache          *cc,
                       key             target,
                       uint64         *found_values);
 
+platform_status
+routing_filter_lookup_hash(cache          *cc,
+                           routing_config *cfg,
+                           routing_filter *filter,
+                           uint32          key_hash,
+                           uint64         *found_values);
+
+/*
+ * A cache of filters decoded into DRAM, up to a capacity in bytes, evicting
+ * those not probed recently to make room. Probing a decoded filter reads a
+ * few words and no cache pages. Filters are cached by meta_head, so their
+ * references must be dropped with routing_filter_zap_cached.
+ */
+typedef struct routing_filter_cache routing_filter_cache;
+
+/*
+ * Decoded filter cache statistics, kept per thread and summed by
+ * routing_filter_cache_get_stats.
+ */
+typedef struct routing_filter_cache_stats {
+   uint64 hits;      // probes of decoded filters
+   uint64 decodes;   // filters decoded into the cache on a probe
+   uint64 uncached;  // probes on a filter's pages for lack of room
+   uint64 evictions; // decoded filters evicted to make room
+} PLATFORM_CACHELINE_ALIGNED routing_filter_cache_stats;
+
+routing_filter_cache *
+routing_filter_cache_create(platform_heap_id hid, uint64 capacity);
+
+void
+routing_filter_cache_destroy(routing_filter_cache *fcache);
+
+void
+routing_filter_cache_get_stats(routing_filter_cache       *fcache,
+                               routing_filter_cache_stats *stats);
+
+bool32
+routing_filter_cache_lookup(routing_filter_cache *fcache,
+                            routing_filter       *filter,
+                            uint32                key_hash,
+                            uint64               *found_values);
+
+platform_status
+routing_filter_lookup_cached(cache                *cc,
+                             routing_config       *cfg,
+                             routing_filter_cache *fcache,
+                             routing_filter       *filter,
+                             uint32                key_hash,
+                             uint64               *found_values);
+
 static inline uint16
 routing_filter_get_next_value(uint64 found_values, uint16 last_value)
 {
@@ -124,6 +236,21 @@ routing_filter_is_value_found(uint64 found_values, uint16 value)
    return ((found_values & (1 << value)) != 0);
 }
 
+/*
+ * Whether keys may have been added to filter with value. Unlike a lookup it
+ * has no false positives for values below 64 and needs no I/O, so it serves
+ * as a range filter: the keys a filter covers hold none with a value it
+ * doesn't hold.
+ */
+static inline bool32
+routing_filter_holds_value(const routing_filter *filter, uint16 value)
+{
+   if (filter->addr == 0) {
+      return FALSE;
+   }
+   return value >= 64 || (filter->value_mask >> value) & 1;
+}
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -144,6 +271,7 @@ routing_filter_ctxt_init(routing_async_ctxt *ctxt,       // OUT
                          routing_async_cb    cb)            // IN
 {
    ctxt->state      = routing_async_state_start;
+   ctxt->segment    = 0;
    ctxt->cb         = cb;
    ctxt->cache_ctxt = cache_ctxt;
 }
@@ -152,13 +280,18 @@ cache_async_result
 routing_filter_lookup_async(cache              *cc,
                             routing_config     *cfg,
                             routing_filter     *filter,
-                            key                 target,
+                            uint32              key_hash,
                             uint64             *found_values,
                             routing_async_ctxt *ctxt);
 
 void
 routing_filter_zap(cache *cc, routing_filter *filter);
 
+void
+routing_filter_zap_cached(cache                *cc,
+                          routing_filter_cache *fcache,
+                          routing_filter       *filter);
+
 uint32
 routing_filter_estimate_unique_keys_from_count(routing_config *cfg,
                                                uint64          num_unique);
@@ -174,6 +307,15 @@ routing_filter_estimate_unique_fp(cache           *cc,
                                   routing_filter  *filter,
                                   uint64           num_filters);
 
+bool32
+routing_filter_sketch_merge(cache          *cc,
+                            routing_config *cfg,
+                            routing_filter *filter,
+                            routing_sketch *sketch);
+
+uint64
+routing_sketch_estimate_unique_keys(routing_sketch *sketch);
+
 // Debug functions
 
 void
@@ -0,0 +1,727 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ *-----------------------------------------------------------------------------
+ * skiplist.c --
+ *
+ *     This file contains the implementation for the skiplist memtable
+ *     engine.
+ *-----------------------------------------------------------------------------
+ */
+
+#include "platform.h"
+#include "skiplist.h"
+
+#include "poison.h"
+
+#define SKIPLIST_HEIGHT_SEED 0x5eed
+
+/*
+ *-----------------------------------------------------------------------------
+ * Arena
+ *
+ * Allocations bump the offset of the current chunk. The thread whose
+ * allocation overflows the chunk moves the skiplist on to the next one,
+ * reusing chunks from before the last reset before allocating new ones.
+ *-----------------------------------------------------------------------------
+ */
+static skiplist_arena_chunk *
+skiplist_arena_chunk_create(skiplist *sl)
+{
+   skiplist_arena_chunk *chunk = TYPED_MANUAL_MALLOC(
+      sl->heap_id, chunk, sizeof(*chunk) + SKIPLIST_ARENA_CHUNK_SIZE);
+   if (chunk != NULL) {
+      chunk->next = NULL;
+      chunk->used = 0;
+   }
+   return chunk;
+}
+
+static void *
+skiplist_arena_alloc(skiplist *sl, uint64 size)
+{
+   size = ROUNDUP(size, sizeof(void *));
+   platform_assert(size <= SKIPLIST_ARENA_CHUNK_SIZE);
+
+   while (TRUE) {
+      skiplist_arena_chunk *chunk  = sl->curr_chunk;
+      uint64                offset = __sync_fetch_and_add(&chunk->used, size);
+      if (offset + size <= SKIPLIST_ARENA_CHUNK_SIZE) {
+         __sync_fetch_and_add(&sl->bytes_allocated, size);
+         return chunk->data + offset;
+      }
+
+      platform_mutex_lock(&sl->arena_mutex);
+      if (sl->curr_chunk == chunk) {
+         skiplist_arena_chunk *next = chunk->next;
+         if (next == NULL) {
+            next = skiplist_arena_chunk_create(sl);
+            if (next == NULL) {
+               platform_mutex_unlock(&sl->arena_mutex);
+               return NULL;
+            }
+            chunk->next = next;
+         }
+         next->used = 0;
+         __sync_synchronize();
+         sl->curr_chunk = next;
+      }
+      platform_mutex_unlock(&sl->arena_mutex);
+   }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * Nodes and messages
+ *-----------------------------------------------------------------------------
+ */
+static inline char *
+skiplist_node_key_data(const skiplist_node *node)
+{
+   return (char *)node + sizeof(skiplist_node)
+          + node->height * sizeof(skiplist_node *);
+}
+
+static inline key
+skiplist_node_key(const skiplist_node *node)
+{
+   return key_create(node->key_length, skiplist_node_key_data(node));
+}
+
+static inline message
+skiplist_node_message(const skiplist_node *node)
+{
+   const skiplist_message *value = node->value;
+   return message_create(value->type,
+                         slice_create(value->length, value->data));
+}
+
+static inline int
+skiplist_key_compare(const skiplist *sl, key key1, key key2)
+{
+   return data_key_compare(sl->data_cfg, key1, key2);
+}
+
+static skiplist_message *
+skiplist_message_create(skiplist *sl, message msg)
+{
+   skiplist_message *value = skiplist_arena_alloc(
+      sl, sizeof(skiplist_message) + message_length(msg));
+   if (value != NULL) {
+      value->type   = message_class(msg);
+      value->length = message_length(msg);
+      memmove(value->data, message_data(msg), message_length(msg));
+   }
+   return value;
+}
+
+/*
+ * Heights are drawn from the key's hash with a branching factor of 4, which
+ * needs no random state shared between inserting threads.
+ */
+static uint8
+skiplist_height(const skiplist *sl, key tuple_key)
+{
+   uint32 hash   = data_key_hash(sl->data_cfg, tuple_key, SKIPLIST_HEIGHT_SEED);
+   uint8  height = 1;
+   while (height < SKIPLIST_MAX_HEIGHT && (hash & 3) == 0) {
+      height++;
+      hash >>= 2;
+   }
+   return height;
+}
+
+static skiplist_node *
+skiplist_node_create(skiplist *sl, key tuple_key, message msg)
+{
+   uint8  height = skiplist_height(sl, tuple_key);
+   uint64 size   = sizeof(skiplist_node) + height * sizeof(skiplist_node *)
+                 + key_length(tuple_key);
+   skiplist_node *node = skiplist_arena_alloc(sl, size);
+   if (node == NULL) {
+      return NULL;
+   }
+   node->value = skiplist_message_create(sl, msg);
+   if (node->value == NULL) {
+      return NULL;
+   }
+   node->generation = 1;
+   node->lock       = 0;
+   node->height     = height;
+   node->key_length = key_length(tuple_key);
+   memmove(
+      skiplist_node_key_data(node), key_data(tuple_key), key_length(tuple_key));
+   return node;
+}
+
+static inline void
+skiplist_node_lock(skiplist_node *node)
+{
+   while (__sync_lock_test_and_set(&node->lock, 1)) {
+      platform_pause();
+   }
+}
+
+static inline void
+skiplist_node_unlock(skiplist_node *node)
+{
+   __sync_lock_release(&node->lock);
+}
+
+/*
+ * Merges msg into the message of node, which holds tuple_key. The merged
+ * message is built off to the side and published with a single store.
+ */
+static platform_status
+skiplist_node_merge(skiplist      *sl,
+                    skiplist_node *node,
+                    key            tuple_key,
+                    message        msg,
+                    uint64        *generation)
+{
+   platform_status   rc = STATUS_OK;
+   skiplist_message *value;
+
+   skiplist_node_lock(node);
+   if (message_is_definitive(msg)) {
+      value = skiplist_message_create(sl, msg);
+   } else {
+      merge_accumulator merged;
+      if (!merge_accumulator_init_from_message(&merged, sl->heap_id, msg)) {
+         rc = STATUS_NO_MEMORY;
+         goto unlock;
+      }
+      if (data_merge_tuples(
+             sl->data_cfg, tuple_key, skiplist_node_message(node), &merged))
+      {
+         merge_accumulator_deinit(&merged);
+         rc = STATUS_NO_MEMORY;
+         goto unlock;
+      }
+      value =
+         skiplist_message_create(sl, merge_accumulator_to_message(&merged));
+      merge_accumulator_deinit(&merged);
+   }
+   if (value == NULL) {
+      rc = STATUS_NO_MEMORY;
+      goto unlock;
+   }
+
+   __sync_synchronize();
+   node->value = value;
+   *generation = node->generation++;
+
+unlock:
+   skiplist_node_unlock(node);
+   return rc;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * Search
+ *
+ * skiplist_find returns the last node whose key is less than target (or
+ * equal to it, if inclusive), or NULL if there is none. For every level it
+ * sets prev to the links holding that level's predecessor (the head or a
+ * node's next array) and next to what they point to, so next[0] is the
+ * first node past target.
+ *-----------------------------------------------------------------------------
+ */
+static inline bool32
+skiplist_node_is_before(const skiplist      *sl,
+                        const skiplist_node *node,
+                        key                  target,
+                        bool32               inclusive)
+{
+   int cmp = skiplist_key_compare(sl, skiplist_node_key(node), target);
+   return inclusive ? cmp <= 0 : cmp < 0;
+}
+
+static skiplist_node *
+skiplist_find(skiplist                 *sl,
+              key                       target,
+              bool32                    inclusive,
+              skiplist_node *volatile **prev,
+              skiplist_node           **next)
+{
+   skiplist_node           *before = NULL;
+   skiplist_node *volatile *links  = sl->head;
+   for (int64 level = SKIPLIST_MAX_HEIGHT - 1; level >= 0; level--) {
+      skiplist_node *node = links[level];
+      while (node != NULL
+             && skiplist_node_is_before(sl, node, target, inclusive))
+      {
+         before = node;
+         links  = node->next;
+         node   = links[level];
+      }
+      prev[level] = links;
+      next[level] = node;
+   }
+   return before;
+}
+
+/*
+ * Moves prev[level] and next[level] forward past nodes inserted since they
+ * were found. Nodes are never removed, so the old predecessor is still a
+ * valid place to restart from.
+ */
+static inline void
+skiplist_refind_level(skiplist                 *sl,
+                      key                       target,
+                      uint64                    level,
+                      skiplist_node *volatile **prev,
+                      skiplist_node           **next)
+{
+   skiplist_node *volatile *links = prev[level];
+   skiplist_node           *node  = links[level];
+   while (node != NULL && skiplist_node_is_before(sl, node, target, FALSE)) {
+      links = node->next;
+      node  = links[level];
+   }
+   prev[level] = links;
+   next[level] = node;
+}
+
+static inline bool32
+skiplist_node_has_key(const skiplist      *sl,
+                      const skiplist_node *node,
+                      key                  target)
+{
+   return node != NULL
+          && skiplist_key_compare(sl, skiplist_node_key(node), target) == 0;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * skiplist_insert --
+ *
+ *     Inserts (tuple_key, msg), merging msg into the existing message if
+ *     tuple_key is already present. generation orders the inserts into each
+ *     key, as the leaf generation does for the btree.
+ *
+ *     A new node becomes visible once it is linked at level 0; linking it
+ *     at the levels above only speeds up searches.
+ *
+ *     On success, *out_node (when not NULL) is the node holding tuple_key,
+ *     which stays valid until the skiplist is reset.
+ *-----------------------------------------------------------------------------
+ */
+platform_status
+skiplist_insert(skiplist       *sl,
+                key             tuple_key,
+                message         msg,
+                uint64         *generation,
+                bool32         *was_unique,
+                skiplist_node **out_node)
+{
+   skiplist_node *volatile *prev[SKIPLIST_MAX_HEIGHT];
+   skiplist_node           *next[SKIPLIST_MAX_HEIGHT];
+
+   skiplist_find(sl, tuple_key, FALSE, prev, next);
+   if (skiplist_node_has_key(sl, next[0], tuple_key)) {
+      *was_unique = FALSE;
+      if (out_node != NULL) {
+         *out_node = next[0];
+      }
+      return skiplist_node_merge(sl, next[0], tuple_key, msg, generation);
+   }
+
+   skiplist_node *node = skiplist_node_create(sl, tuple_key, msg);
+   if (node == NULL) {
+      return STATUS_NO_MEMORY;
+   }
+
+   while (TRUE) {
+      node->next[0] = next[0];
+      if (__sync_bool_compare_and_swap(&prev[0][0], next[0], node)) {
+         break;
+      }
+      skiplist_refind_level(sl, tuple_key, 0, prev, next);
+      if (skiplist_node_has_key(sl, next[0], tuple_key)) {
+         // lost a race with an insert of the same key, node stays unlinked
+         *was_unique = FALSE;
+         if (out_node != NULL) {
+            *out_node = next[0];
+         }
+         return skiplist_node_merge(sl, next[0], tuple_key, msg, generation);
+      }
+   }
+
+   for (uint64 level = 1; level < node->height; level++) {
+      while (TRUE) {
+         node->next[level] = next[level];
+         if (__sync_bool_compare_and_swap(
+                &prev[level][level], next[level], node))
+         {
+            break;
+         }
+         skiplist_refind_level(sl, tuple_key, level, prev, next);
+      }
+   }
+
+   __sync_fetch_and_add(&sl->num_tuples, 1);
+   *generation = 0;
+   *was_unique = TRUE;
+   if (out_node != NULL) {
+      *out_node = node;
+   }
+   return STATUS_OK;
+}
+
+static platform_status
+skiplist_node_merge_into(skiplist          *sl,
+                         skiplist_node     *node,
+                         key                target,
+                         merge_accumulator *data)
+{
+   message local_data = skiplist_node_message(node);
+   if (merge_accumulator_is_null(data)) {
+      bool32 success = merge_accumulator_copy_message(data, local_data);
+      return success ? STATUS_OK : STATUS_NO_MEMORY;
+   } else if (data_merge_tuples(sl->data_cfg, target, local_data, data)) {
+      return STATUS_NO_MEMORY;
+   }
+   return STATUS_OK;
+}
+
+platform_status
+skiplist_lookup_and_merge(skiplist          *sl,
+                          key                target,
+                          merge_accumulator *data,
+                          bool32            *local_found)
+{
+   skiplist_node *volatile *prev[SKIPLIST_MAX_HEIGHT];
+   skiplist_node           *next[SKIPLIST_MAX_HEIGHT];
+
+   skiplist_find(sl, target, FALSE, prev, next);
+   *local_found = skiplist_node_has_key(sl, next[0], target);
+   if (!*local_found) {
+      return STATUS_OK;
+   }
+   return skiplist_node_merge_into(sl, next[0], target, data);
+}
+
+/*
+ * Like skiplist_lookup_and_merge, but looks only at node, which came from
+ * skiplist_insert. Finds nothing if node holds some other key.
+ */
+platform_status
+skiplist_node_lookup_and_merge(skiplist          *sl,
+                               skiplist_node     *node,
+                               key                target,
+                               merge_accumulator *data,
+                               bool32            *local_found)
+{
+   *local_found = skiplist_node_has_key(sl, node, target);
+   if (!*local_found) {
+      return STATUS_OK;
+   }
+   return skiplist_node_merge_into(sl, node, target, data);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * Lifecycle
+ *-----------------------------------------------------------------------------
+ */
+void
+skiplist_init(skiplist *sl, platform_heap_id hid, const data_config *data_cfg)
+{
+   ZERO_CONTENTS(sl);
+   sl->heap_id  = hid;
+   sl->data_cfg = data_cfg;
+   platform_mutex_init(&sl->arena_mutex, platform_get_module_id(), hid);
+   sl->first_chunk = skiplist_arena_chunk_create(sl);
+   platform_assert(sl->first_chunk != NULL);
+   sl->curr_chunk = sl->first_chunk;
+}
+
+/*
+ * Empties the skiplist, keeping its arena chunks for reuse. The caller must
+ * ensure there are no concurrent inserts, lookups or iterators.
+ */
+void
+skiplist_reset(skiplist *sl)
+{
+   for (uint64 level = 0; level < SKIPLIST_MAX_HEIGHT; level++) {
+      sl->head[level] = NULL;
+   }
+   sl->num_tuples        = 0;
+   sl->bytes_allocated   = 0;
+   sl->first_chunk->used = 0;
+   sl->curr_chunk        = sl->first_chunk;
+}
+
+void
+skiplist_deinit(skiplist *sl)
+{
+   skiplist_arena_chunk *chunk = sl->first_chunk;
+   while (chunk != NULL) {
+      skiplist_arena_chunk *next = chunk->next;
+      platform_free(sl->heap_id, chunk);
+      chunk = next;
+   }
+   sl->first_chunk = NULL;
+   sl->curr_chunk  = NULL;
+   platform_mutex_destroy(&sl->arena_mutex);
+}
+
+/*
+ * Checks that every level is sorted and that level 0 holds num_tuples
+ * nodes. Must not run concurrently with inserts.
+ */
+bool32
+skiplist_verify(skiplist *sl)
+{
+   for (uint64 level = 0; level < SKIPLIST_MAX_HEIGHT; level++) {
+      uint64         count = 0;
+      skiplist_node *prev  = NULL;
+      for (skiplist_node *node = sl->head[level]; node != NULL;
+           node                = node->next[level])
+      {
+         if (node->height <= level) {
+            platform_error_log("skiplist_verify: node %p of height %u on "
+                               "level %lu\n",
+                               node,
+                               node->height,
+                               level);
+            return FALSE;
+         }
+         if (prev != NULL
+             && skiplist_key_compare(
+                   sl, skiplist_node_key(prev), skiplist_node_key(node))
+                   >= 0)
+         {
+            platform_error_log(
+               "skiplist_verify: out of order on level %lu: %s >= %s\n",
+               level,
+               key_string(sl->data_cfg, skiplist_node_key(prev)),
+               key_string(sl->data_cfg, skiplist_node_key(node)));
+            return FALSE;
+         }
+         prev = node;
+         count++;
+      }
+      if (level == 0 && count != sl->num_tuples) {
+         platform_error_log("skiplist_verify: %lu nodes, num_tuples %lu\n",
+                            count,
+                            sl->num_tuples);
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+void
+skiplist_print(platform_log_handle *log_handle, skiplist *sl)
+{
+   platform_log(log_handle,
+                "skiplist: %lu tuples, %lu bytes\n",
+                sl->num_tuples,
+                sl->bytes_allocated);
+   for (skiplist_node *node = sl->head[0]; node != NULL; node = node->next[0])
+   {
+      platform_log(log_handle,
+                   "   %s -- %s (height %u)\n",
+                   key_string(sl->data_cfg, skiplist_node_key(node)),
+                   message_string(sl->data_cfg, skiplist_node_message(node)),
+                   node->height);
+   }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * skiplist_iterator
+ *
+ * The iterator is on a node in [min_key, max_key), or off one end of the
+ * range with curr NULL. It can step prev unless it is before the start, and
+ * next unless it is after the end; like a btree_iterator, it can do neither
+ * over an empty range. Stepping prev searches for the predecessor, since
+ * nodes only link forwards.
+ *-----------------------------------------------------------------------------
+ */
+static inline bool32
+skiplist_iterator_in_range(skiplist_iterator *itor, skiplist_node *node)
+{
+   if (node == NULL) {
+      return FALSE;
+   }
+   key node_key = skiplist_node_key(node);
+   return skiplist_key_compare(itor->sl, node_key, itor->min_key) >= 0
+          && skiplist_key_compare(itor->sl, node_key, itor->max_key) < 0;
+}
+
+/* Lands on node, or past the end if node is out of range */
+static inline void
+skiplist_iterator_set_forward(skiplist_iterator *itor, skiplist_node *node)
+{
+   itor->curr     = skiplist_iterator_in_range(itor, node) ? node : NULL;
+   itor->at_start = FALSE;
+}
+
+/* Lands on node, or before the start if node is out of range */
+static inline void
+skiplist_iterator_set_backward(skiplist_iterator *itor, skiplist_node *node)
+{
+   itor->curr     = skiplist_iterator_in_range(itor, node) ? node : NULL;
+   itor->at_start = itor->curr == NULL;
+}
+
+static platform_status
+skiplist_iterator_seek(iterator *base_itor, key seek_key, comparison seek_type)
+{
+   skiplist_iterator       *itor = (skiplist_iterator *)base_itor;
+   skiplist                *sl   = itor->sl;
+   skiplist_node *volatile *prev[SKIPLIST_MAX_HEIGHT];
+   skiplist_node           *next[SKIPLIST_MAX_HEIGHT];
+
+   if (skiplist_key_compare(sl, seek_key, itor->min_key) < 0
+       || skiplist_key_compare(sl, seek_key, itor->max_key) > 0)
+   {
+      return STATUS_BAD_PARAM;
+   }
+
+   switch (seek_type) {
+      case greater_than_or_equal:
+      case greater_than:
+         skiplist_find(sl, seek_key, seek_type == greater_than, prev, next);
+         skiplist_iterator_set_forward(itor, next[0]);
+         break;
+      case less_than_or_equal:
+      case less_than:
+      {
+         // max_key is exclusive, so seeking to it is always strict
+         bool32 inclusive =
+            seek_type == less_than_or_equal
+            && skiplist_key_compare(sl, seek_key, itor->max_key) < 0;
+         skiplist_iterator_set_backward(
+            itor, skiplist_find(sl, seek_key, inclusive, prev, next));
+         break;
+      }
+   }
+   return STATUS_OK;
+}
+
+static void
+skiplist_iterator_curr(iterator *base_itor, key *curr_key, message *msg)
+{
+   skiplist_iterator *itor = (skiplist_iterator *)base_itor;
+   debug_assert(itor->curr != NULL);
+   *curr_key = skiplist_node_key(itor->curr);
+   *msg      = skiplist_node_message(itor->curr);
+}
+
+static bool32
+skiplist_iterator_can_prev(iterator *base_itor)
+{
+   skiplist_iterator *itor = (skiplist_iterator *)base_itor;
+   return itor->curr != NULL || (!itor->at_start && !itor->empty);
+}
+
+static bool32
+skiplist_iterator_can_next(iterator *base_itor)
+{
+   skiplist_iterator *itor = (skiplist_iterator *)base_itor;
+   return itor->curr != NULL || (itor->at_start && !itor->empty);
+}
+
+static platform_status
+skiplist_iterator_next(iterator *base_itor)
+{
+   skiplist_iterator *itor = (skiplist_iterator *)base_itor;
+   debug_assert(skiplist_iterator_can_next(base_itor));
+
+   if (itor->curr != NULL) {
+      skiplist_iterator_set_forward(itor, itor->curr->next[0]);
+      return STATUS_OK;
+   }
+   return skiplist_iterator_seek(
+      base_itor, itor->min_key, greater_than_or_equal);
+}
+
+static platform_status
+skiplist_iterator_prev(iterator *base_itor)
+{
+   skiplist_iterator *itor = (skiplist_iterator *)base_itor;
+   debug_assert(skiplist_iterator_can_prev(base_itor));
+
+   key target = itor->curr != NULL ? skiplist_node_key(itor->curr)
+                                   : itor->max_key;
+   return skiplist_iterator_seek(base_itor, target, less_than);
+}
+
+static void
+skiplist_iterator_print(iterator *base_itor)
+{
+   skiplist_iterator *itor = (skiplist_iterator *)base_itor;
+   platform_default_log("########################################\n");
+   platform_default_log("## skiplist_itor: %p\n", itor);
+   platform_default_log("## skiplist: %p\n", itor->sl);
+   if (itor->curr != NULL) {
+      platform_default_log(
+         "## curr %s\n",
+         key_string(itor->sl->data_cfg, skiplist_node_key(itor->curr)));
+   } else {
+      platform_default_log("## curr NULL at_start %d\n", itor->at_start);
+   }
+}
+
+const static iterator_ops skiplist_iterator_ops = {
+   .curr     = skiplist_iterator_curr,
+   .can_prev = skiplist_iterator_can_prev,
+   .can_next = skiplist_iterator_can_next,
+   .next     = skiplist_iterator_next,
+   .prev     = skiplist_iterator_prev,
+   .seek     = skiplist_iterator_seek,
+   .print    = skiplist_iterator_print,
+};
+
+/*
+ *-----------------------------------------------------------------------------
+ * Caller must guarantee:
+ *    min_key and max_key need to be valid until iterator deinitialized
+ *-----------------------------------------------------------------------------
+ */
+void
+skiplist_iterator_init(skiplist          *sl,
+                       skiplist_iterator *itor,
+                       key                min_key,
+                       key                max_key,
+                       key                start_key,
+                       comparison         start_type)
+{
+   debug_assert(!key_is_null(min_key) && !key_is_null(max_key)
+                && !key_is_null(start_key));
+
+   if (skiplist_key_compare(sl, min_key, max_key) > 0) {
+      max_key = min_key;
+   }
+   if (skiplist_key_compare(sl, start_key, min_key) < 0) {
+      start_key = min_key;
+   }
+   if (skiplist_key_compare(sl, start_key, max_key) > 0) {
+      start_key = max_key;
+   }
+
+   ZERO_CONTENTS(itor);
+   itor->super.ops = &skiplist_iterator_ops;
+   itor->sl        = sl;
+   itor->min_key   = min_key;
+   itor->max_key   = max_key;
+
+   platform_status rc =
+      skiplist_iterator_seek(&itor->super, min_key, greater_than_or_equal);
+   platform_assert_status_ok(rc);
+   itor->empty = itor->curr == NULL;
+
+   rc = skiplist_iterator_seek(&itor->super, start_key, start_type);
+   platform_assert_status_ok(rc);
+}
+
+void
+skiplist_iterator_deinit(skiplist_iterator *itor)
+{
+   itor->curr = NULL;
+}
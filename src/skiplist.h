@@ -0,0 +1,148 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * skiplist.h --
+ *
+ *     This file contains the interface for the skiplist, an in-memory
+ *     ordered map used as a memtable engine (see memtable.h).
+ *
+ *     The skiplist is insert-only and lock-free for readers. Nodes, keys and
+ *     messages are carved out of an arena of large heap chunks, so an insert
+ *     costs a few cache misses on the search path plus one CAS per level,
+ *     and none of it touches the page cache. Nothing is freed until the
+ *     whole skiplist is reset, which is what makes lock-free readers safe.
+ *
+ *     A key is inserted once. Later inserts of the same key merge into its
+ *     message under a per-node lock and publish the merged message with a
+ *     single pointer store, so readers always see a whole message.
+ */
+
+#pragma once
+
+#include "platform.h"
+#include "data_internal.h"
+#include "iterator.h"
+
+#define SKIPLIST_MAX_HEIGHT       16
+#define SKIPLIST_ARENA_CHUNK_SIZE MiB_TO_B(1)
+
+typedef struct skiplist_arena_chunk skiplist_arena_chunk;
+
+struct skiplist_arena_chunk {
+   skiplist_arena_chunk *next;
+   volatile uint64       used; // may overshoot the chunk when it fills
+   char                  data[];
+};
+
+/*
+ * A message as stored in the arena. Once published in a node it is never
+ * modified.
+ */
+typedef struct skiplist_message {
+   message_type type;
+   uint32       length;
+   char         data[];
+} skiplist_message;
+
+typedef struct skiplist_node skiplist_node;
+
+struct skiplist_node {
+   skiplist_message *volatile value;
+   uint64                     generation; // protected by lock
+   volatile uint8             lock;
+   uint8                      height;
+   uint16                     key_length;
+   skiplist_node *volatile    next[]; // height links, followed by the key
+};
+
+typedef struct skiplist {
+   platform_heap_id   heap_id;
+   const data_config *data_cfg;
+
+   skiplist_node *volatile head[SKIPLIST_MAX_HEIGHT];
+   volatile uint64         num_tuples;
+
+   // arena, chunks are kept across resets and freed by skiplist_deinit
+   platform_mutex                 arena_mutex; // serializes chunk changes
+   skiplist_arena_chunk          *first_chunk;
+   skiplist_arena_chunk *volatile curr_chunk;
+   volatile uint64                bytes_allocated;
+} skiplist;
+
+void
+skiplist_init(skiplist *sl, platform_heap_id hid, const data_config *data_cfg);
+
+void
+skiplist_deinit(skiplist *sl);
+
+void
+skiplist_reset(skiplist *sl);
+
+platform_status
+skiplist_insert(skiplist       *sl,
+                key             tuple_key,
+                message         msg,
+                uint64         *generation,
+                bool32         *was_unique,
+                skiplist_node **out_node);
+
+platform_status
+skiplist_lookup_and_merge(skiplist          *sl,
+                          key                target,
+                          merge_accumulator *data,
+                          bool32            *local_found);
+
+platform_status
+skiplist_node_lookup_and_merge(skiplist          *sl,
+                               skiplist_node     *node,
+                               key                target,
+                               merge_accumulator *data,
+                               bool32            *local_found);
+
+static inline uint64
+skiplist_bytes(const skiplist *sl)
+{
+   return sl->bytes_allocated;
+}
+
+static inline uint64
+skiplist_num_tuples(const skiplist *sl)
+{
+   return sl->num_tuples;
+}
+
+bool32
+skiplist_verify(skiplist *sl);
+
+void
+skiplist_print(platform_log_handle *log_handle, skiplist *sl);
+
+/*
+ *-----------------------------------------------------------------------------
+ * skiplist_iterator --
+ *
+ *     Iterates over the tuples with min_key <= key < max_key. Inserts may run
+ *     concurrently; the iterator sees some of those landing ahead of it.
+ *-----------------------------------------------------------------------------
+ */
+typedef struct skiplist_iterator {
+   iterator       super;
+   skiplist      *sl;
+   key            min_key;
+   key            max_key;
+   skiplist_node *curr;     // NULL when before the start or after the end
+   bool32         at_start; // when curr is NULL, whether before the start
+   bool32         empty;    // no tuples in range when initialized
+} skiplist_iterator;
+
+void
+skiplist_iterator_init(skiplist          *sl,
+                       skiplist_iterator *itor,
+                       key                min_key,
+                       key                max_key,
+                       key                start_key,
+                       comparison         start_type);
+
+void
+skiplist_iterator_deinit(skiplist_iterator *itor);
@@ -21,6 +21,7 @@
 #include "trunk.h"
 #include "btree_private.h"
 #include "shard_log.h"
+#include "value_log.h"
 #include "splinterdb_tests_private.h"
 #include "poison.h"
 
@@ -50,6 +51,9 @@ typedef struct splinterdb {
    allocator_root_id  trunk_id;
    trunk_config       trunk_cfg;
    trunk_handle      *spl;
+   value_log_config   vlog_cfg;
+   value_log          vlog_handle;
+   value_log         *vlog; // NULL without a value log
    platform_heap_id   heap_id;
    data_config       *data_cfg;
    bool               we_created_heap;
@@ -111,6 +115,9 @@ splinterdb_config_set_defaults(splinterdb_config *cfg)
    if (!cfg->reclaim_threshold) {
       cfg->reclaim_threshold = UINT64_MAX;
    }
+   if (!cfg->value_log_gc_percent) {
+      cfg->value_log_gc_percent = 50;
+   }
 }
 
 static platform_status
@@ -121,6 +128,7 @@ splinterdb_validate_app_data_config(const data_config *cfg)
    platform_assert(cfg->key_hash != NULL);
    platform_assert(cfg->key_to_string != NULL);
    platform_assert(cfg->message_to_string != NULL);
+   platform_assert(cfg->fixed_key_size <= cfg->max_key_size);
 
    return STATUS_OK;
 }
@@ -174,6 +182,9 @@ splinterdb_init_config(const splinterdb_config *kvs_cfg, // IN
                   cfg.io_perms,
                   cfg.io_async_queue_depth,
                   cfg.filename);
+   if (cfg.io_async_max_pages != 0) {
+      kvs->io_cfg.async_max_pages = cfg.io_async_max_pages;
+   }
 
    // Validate IO-configuration parameters
    rc = laio_config_valid(&kvs->io_cfg);
@@ -188,6 +199,16 @@ splinterdb_init_config(const splinterdb_config *kvs_cfg, // IN
                           cfg.cache_size,
                           cfg.cache_logfile,
                           cfg.use_stats);
+   kvs->cache_cfg.type_min_share[PAGE_TYPE_TRUNK]  = cfg.cache_trunk_min_share;
+   kvs->cache_cfg.type_min_share[PAGE_TYPE_FILTER] = cfg.cache_filter_min_share;
+   kvs->cache_cfg.type_max_share[PAGE_TYPE_BRANCH] = cfg.cache_branch_max_share;
+   kvs->cache_cfg.pin_trunk_pages                  = cfg.cache_pin_trunk_pages;
+   kvs->cache_cfg.compressed_capacity              = cfg.cache_compressed_size;
+
+   kvs->cache_cfg.cleaner_clean_share = cfg.cache_cleaner_clean_share;
+   if (cfg.cache_branch_compression) {
+      kvs->cache_cfg.branch_codec = &page_codec_lz;
+   }
 
    shard_log_config_init(&kvs->log_cfg, &kvs->cache_cfg.super, kvs->data_cfg);
 
@@ -220,10 +241,85 @@ splinterdb_init_config(const splinterdb_config *kvs_cfg, // IN
    if (!SUCCESS(rc)) {
       return rc;
    }
+   if (cfg.btree_readahead_max_extents != 0) {
+      kvs->trunk_cfg.btree_cfg.readahead_max_extents =
+         cfg.btree_readahead_max_extents;
+   }
+   kvs->trunk_cfg.btree_cfg.readahead_budget_extents =
+      cfg.btree_readahead_budget;
+   kvs->trunk_cfg.btree_cfg.key_prefix_slots   = cfg.btree_key_prefix_slots;
+   kvs->trunk_cfg.btree_cfg.prefix_compression = cfg.btree_prefix_compression;
+   kvs->trunk_cfg.btree_cfg.optimistic_inserts = cfg.btree_optimistic_inserts;
+   kvs->trunk_cfg.mt_cfg.engine = cfg.memtable_skiplist
+                                     ? MEMTABLE_ENGINE_SKIPLIST
+                                     : MEMTABLE_ENGINE_BTREE;
+   kvs->trunk_cfg.mt_cfg.hash_index = cfg.memtable_hash_index;
+   kvs->trunk_cfg.bloom_filter_heights = cfg.filter_bloom_heights;
+   kvs->trunk_cfg.filter_cache_size    = cfg.filter_cache_size;
+   kvs->trunk_cfg.filter_cache_heights =
+      cfg.filter_cache_heights != 0 ? cfg.filter_cache_heights : ~1ULL;
+   kvs->trunk_cfg.filter_adaptive_fingerprints =
+      cfg.filter_adaptive_fingerprints;
+   if (cfg.filter_bloom_bits_per_key != 0) {
+      kvs->trunk_cfg.bloom_filter_cfg.bloom_bits_per_key =
+         cfg.filter_bloom_bits_per_key;
+   }
+
+   // Inline values carry a tag byte, see splinterdb_value_tag
+   if (cfg.value_log_threshold + 1 > MAX_INLINE_MESSAGE_SIZE(cfg.page_size)) {
+      platform_error_log("value_log_threshold must be less than %lu.\n",
+                         MAX_INLINE_MESSAGE_SIZE(cfg.page_size));
+      return STATUS_BAD_PARAM;
+   }
+   value_log_config_init(&kvs->vlog_cfg,
+                         &kvs->cache_cfg.super,
+                         cfg.value_log_threshold,
+                         cfg.value_log_gc_percent);
 
    return STATUS_OK;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * splinterdb_value_log_init --
+ *
+ *      Creates or mounts the value log, if configured. Its address is kept
+ *      in the trunk super block, which also records whether the database
+ *      was created with one.
+ *-----------------------------------------------------------------------------
+ */
+static platform_status
+splinterdb_value_log_init(splinterdb *kvs, bool open_existing)
+{
+   bool32 enabled = kvs->vlog_cfg.threshold != 0;
+   if (open_existing && enabled != (kvs->spl->value_log_addr != 0)) {
+      platform_error_log("SplinterDB device was created %s a value log.\n",
+                         enabled ? "without" : "with");
+      return STATUS_BAD_PARAM;
+   }
+   if (!enabled) {
+      return STATUS_OK;
+   }
+
+   platform_status rc;
+   if (open_existing) {
+      rc = value_log_mount(&kvs->vlog_handle,
+                           &kvs->vlog_cfg,
+                           (cache *)&kvs->cache_handle,
+                           kvs->heap_id,
+                           kvs->spl->value_log_addr);
+   } else {
+      rc = value_log_init(&kvs->vlog_handle,
+                          &kvs->vlog_cfg,
+                          (cache *)&kvs->cache_handle,
+                          kvs->heap_id);
+   }
+   if (SUCCESS(rc)) {
+      kvs->vlog = &kvs->vlog_handle;
+   }
+   return rc;
+}
+
 
 /*
  * Internal function for create or open
@@ -340,6 +436,13 @@ splinterdb_create_or_open(const splinterdb_config *kvs_cfg,      // IN
       goto deinit_allocator;
    }
 
+   status = clockcache_start_cleaner(&kvs->cache_handle, kvs->task_sys);
+   if (!SUCCESS(status)) {
+      platform_error_log("Failed to start SplinterDB cache cleaner: %s\n",
+                         platform_status_to_string(status));
+      goto deinit_cache;
+   }
+
    kvs->trunk_id = 1;
    if (open_existing) {
       kvs->spl = trunk_mount(&kvs->trunk_cfg,
@@ -365,9 +468,19 @@ splinterdb_create_or_open(const splinterdb_config *kvs_cfg,      // IN
       goto deinit_cache;
    }
 
+   status = splinterdb_value_log_init(kvs, open_existing);
+   if (!SUCCESS(status)) {
+      platform_error_log("Failed to %s SplinterDB value log: %s\n",
+                         (open_existing ? "mount existing" : "initialize"),
+                         platform_status_to_string(status));
+      goto deinit_trunk;
+   }
+
    *kvs_out = kvs;
    return platform_status_to_int(status);
 
+deinit_trunk:
+   trunk_unmount(&kvs->spl);
 deinit_cache:
    clockcache_deinit(&kvs->cache_handle);
 deinit_allocator:
@@ -443,6 +556,9 @@ splinterdb_close(splinterdb **kvs_in) // IN
     * order when these sub-systems were init'ed when a Splinter device was
     * created or re-opened. Otherwise, asserts will trip.
     */
+   if (kvs->vlog != NULL) {
+      kvs->spl->value_log_addr = value_log_unmount(kvs->vlog);
+   }
    trunk_unmount(&kvs->spl);
    clockcache_deinit(&kvs->cache_handle);
    rc_allocator_unmount(&kvs->allocator_handle);
@@ -511,6 +627,111 @@ splinterdb_deregister_thread(splinterdb *kvs)
    task_deregister_this_thread(kvs->task_sys);
 }
 
+/*
+ * With a value log, each value in the trunk starts with a tag saying whether
+ * the rest of it is the value or a splinterdb_logged_value.
+ */
+typedef enum splinterdb_value_tag {
+   SPLINTERDB_VALUE_INLINE = 0,
+   SPLINTERDB_VALUE_LOGGED = 1,
+} splinterdb_value_tag;
+
+typedef struct ONDISK splinterdb_logged_value {
+   uint8         tag;
+   value_log_ref ref;
+} splinterdb_logged_value;
+
+/*
+ * With a value log, inserts into the trunk are serialized per key with
+ * value log collection, which must not re-insert a value it found to be
+ * live after it has been overwritten.
+ */
+static platform_mutex *
+splinterdb_key_lock(const splinterdb *kvs, slice user_key)
+{
+   uint32 hash =
+      data_key_hash(kvs->data_cfg, key_create_from_slice(user_key), 0);
+   return value_log_key_lock(kvs->vlog, hash);
+}
+
+/*
+ * Replaces the tagged value in value by the user's value.
+ */
+static platform_status
+splinterdb_value_log_resolve(const splinterdb *kvs, writable_buffer *value)
+{
+   char  *data   = writable_buffer_data(value);
+   uint64 length = writable_buffer_length(value);
+   debug_assert(length != 0);
+   if (data[0] == SPLINTERDB_VALUE_INLINE) {
+      memmove(data, data + 1, length - 1);
+      return writable_buffer_resize(value, length - 1);
+   }
+
+   splinterdb_logged_value logged;
+   debug_assert(length == sizeof(logged));
+   memmove(&logged, data, sizeof(logged));
+   return value_log_read(kvs->vlog, logged.ref, value);
+}
+
+/*
+ * value_log_relocate_fn for splinterdb_value_log_gc: re-appends the value
+ * at ref if the trunk still refers to it.
+ */
+static bool32
+splinterdb_value_log_relocate(void *arg, key tuple_key, value_log_ref ref)
+{
+   const splinterdb *kvs  = arg;
+   platform_mutex   *lock = splinterdb_key_lock(kvs, key_slice(tuple_key));
+   merge_accumulator current;
+   merge_accumulator_init(&current, kvs->heap_id);
+
+   platform_mutex_lock(lock);
+   platform_status rc = trunk_lookup(kvs->spl, tuple_key, &current);
+   platform_assert_status_ok(rc);
+   bool32 live = FALSE;
+   if (trunk_lookup_found(&current)) {
+      splinterdb_logged_value *logged = writable_buffer_data(&current.data);
+      live = logged->tag == SPLINTERDB_VALUE_LOGGED
+             && logged->ref.addr == ref.addr;
+   }
+   if (live) {
+      DECLARE_AUTO_WRITABLE_BUFFER(value, kvs->heap_id);
+      rc = value_log_read(kvs->vlog, ref, &value);
+      platform_assert_status_ok(rc);
+      splinterdb_logged_value logged = {.tag = SPLINTERDB_VALUE_LOGGED};
+      rc                             = value_log_append(
+         kvs->vlog, tuple_key, writable_buffer_to_slice(&value), &logged.ref);
+      platform_assert_status_ok(rc);
+      message msg = message_create(MESSAGE_TYPE_INSERT,
+                                   slice_create(sizeof(logged), &logged));
+      rc          = trunk_insert(kvs->spl, tuple_key, msg);
+      platform_assert_status_ok(rc);
+   }
+   platform_mutex_unlock(lock);
+
+   merge_accumulator_deinit(&current);
+   return live;
+}
+
+/*
+ * Collects the oldest extent of the value log once enough of the tuples
+ * referring to it may have been overwritten, see value_log_needs_gc. Tuples
+ * are reclaimed by compaction, or merged away in the memtable.
+ */
+static void
+splinterdb_value_log_gc(const splinterdb *kvs)
+{
+   uint64 tuples_reclaimed = kvs->spl->compaction_tuples_reclaimed
+                             + kvs->spl->mt_ctxt->tuples_merged;
+   if (value_log_needs_gc(kvs->vlog, tuples_reclaimed)) {
+      value_log_gc(kvs->vlog,
+                   tuples_reclaimed,
+                   splinterdb_value_log_relocate,
+                   (void *)kvs);
+   }
+}
+
 /*
  *-----------------------------------------------------------------------------
  * splinterdb_insert_raw_message --
@@ -532,13 +753,67 @@ splinterdb_insert_message(const splinterdb *kvs,      // IN
 {
    key tuple_key = key_create_from_slice(user_key);
    platform_assert(kvs != NULL);
+   if (!data_key_size_is_valid(kvs->data_cfg, slice_length(user_key))) {
+      return platform_status_to_int(STATUS_BAD_PARAM);
+   }
+   if (kvs->vlog == NULL) {
+      platform_status status = trunk_insert(kvs->spl, tuple_key, msg);
+      return platform_status_to_int(status);
+   }
+
+   platform_mutex *lock = splinterdb_key_lock(kvs, user_key);
+   platform_mutex_lock(lock);
    platform_status status = trunk_insert(kvs->spl, tuple_key, msg);
+   platform_mutex_unlock(lock);
+   value_log_tuple_written(kvs->vlog);
+   splinterdb_value_log_gc(kvs);
    return platform_status_to_int(status);
 }
 
+/*
+ * Tags value for the trunk, appending it to the value log if it is long.
+ */
+static int
+splinterdb_insert_logged(const splinterdb *kvs, slice user_key, slice value)
+{
+   if (!data_key_size_is_valid(kvs->data_cfg, slice_length(user_key))) {
+      return platform_status_to_int(STATUS_BAD_PARAM);
+   }
+
+   DECLARE_AUTO_WRITABLE_BUFFER(tagged, kvs->heap_id);
+   platform_status rc;
+   if (value_log_separates(kvs->vlog, slice_length(value))) {
+      splinterdb_logged_value logged = {.tag = SPLINTERDB_VALUE_LOGGED};
+      rc                             = value_log_append(
+         kvs->vlog, key_create_from_slice(user_key), value, &logged.ref);
+      if (!SUCCESS(rc)) {
+         return platform_status_to_int(rc);
+      }
+      rc = writable_buffer_copy_slice(&tagged,
+                                      slice_create(sizeof(logged), &logged));
+   } else {
+      rc = writable_buffer_resize(&tagged, 1 + slice_length(value));
+      if (SUCCESS(rc)) {
+         char *data = writable_buffer_data(&tagged);
+         data[0]    = SPLINTERDB_VALUE_INLINE;
+         memmove(data + 1, slice_data(value), slice_length(value));
+      }
+   }
+   if (!SUCCESS(rc)) {
+      return platform_status_to_int(rc);
+   }
+
+   message msg =
+      message_create(MESSAGE_TYPE_INSERT, writable_buffer_to_slice(&tagged));
+   return splinterdb_insert_message(kvs, user_key, msg);
+}
+
 int
 splinterdb_insert(const splinterdb *kvsb, slice user_key, slice value)
 {
+   if (kvsb->vlog != NULL) {
+      return splinterdb_insert_logged(kvsb, user_key, value);
+   }
    message msg = message_create(MESSAGE_TYPE_INSERT, value);
    return splinterdb_insert_message(kvsb, user_key, msg);
 }
@@ -552,11 +827,153 @@ splinterdb_delete(const splinterdb *kvsb, slice user_key)
 int
 splinterdb_update(const splinterdb *kvsb, slice user_key, slice update)
 {
+   if (kvsb->vlog != NULL) {
+      return platform_status_to_int(STATUS_BAD_PARAM);
+   }
    message msg = message_create(MESSAGE_TYPE_UPDATE, update);
    platform_assert(kvsb->data_cfg->merge_tuples);
    return splinterdb_insert_message(kvsb, user_key, msg);
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * splinterdb_bulk_load_iterator --
+ *
+ *      An iterator over the tuples of a splinterdb_bulk_load_next_fn, which
+ *      checks they are in order and fit in a branch leaf. btree_pack refers
+ *      to the last key of a branch after advancing past it, so the current
+ *      and previous keys are kept in turn.
+ *-----------------------------------------------------------------------------
+ */
+typedef struct splinterdb_bulk_load_iterator {
+   iterator                     super;
+   const splinterdb            *kvs;
+   splinterdb_bulk_load_next_fn next_fn;
+   void                        *arg;
+   bool32                       at_end;
+   platform_status              rc;
+   uint64                       num_tuples;
+   key_buffer                   key[2];
+   slice                        value;
+} splinterdb_bulk_load_iterator;
+
+static key
+splinterdb_bulk_load_iterator_key(splinterdb_bulk_load_iterator *bl_itor)
+{
+   return key_buffer_key(&bl_itor->key[bl_itor->num_tuples % 2]);
+}
+
+static void
+splinterdb_bulk_load_iterator_curr(iterator *itor, key *curr_key, message *msg)
+{
+   splinterdb_bulk_load_iterator *bl_itor =
+      (splinterdb_bulk_load_iterator *)itor;
+   debug_assert(!bl_itor->at_end);
+   *curr_key = splinterdb_bulk_load_iterator_key(bl_itor);
+   *msg      = message_create(MESSAGE_TYPE_INSERT, bl_itor->value);
+}
+
+/*
+ * An invalid tuple ends the iterator, with the error in rc, so that the
+ * branch being packed is completed with the tuples before it.
+ */
+static platform_status
+splinterdb_bulk_load_iterator_next(iterator *itor)
+{
+   splinterdb_bulk_load_iterator *bl_itor =
+      (splinterdb_bulk_load_iterator *)itor;
+   slice user_key;
+   if (!bl_itor->next_fn(bl_itor->arg, &user_key, &bl_itor->value)) {
+      bl_itor->at_end = TRUE;
+      return STATUS_OK;
+   }
+
+   const data_config *data_cfg  = bl_itor->kvs->data_cfg;
+   key                tuple_key = key_create_from_slice(user_key);
+   uint64             page_size = bl_itor->kvs->io_cfg.page_size;
+   if (!data_key_size_is_valid(data_cfg, slice_length(user_key))
+       || MAX_INLINE_MESSAGE_SIZE(page_size) < slice_length(bl_itor->value)
+       || (bl_itor->num_tuples != 0
+           && data_key_compare(data_cfg,
+                               splinterdb_bulk_load_iterator_key(bl_itor),
+                               tuple_key)
+                 >= 0))
+   {
+      bl_itor->rc = STATUS_BAD_PARAM;
+   } else {
+      bl_itor->rc = key_buffer_copy_key(
+         &bl_itor->key[(bl_itor->num_tuples + 1) % 2], tuple_key);
+   }
+   if (!SUCCESS(bl_itor->rc)) {
+      bl_itor->at_end = TRUE;
+      return STATUS_OK;
+   }
+   bl_itor->num_tuples++;
+   return STATUS_OK;
+}
+
+static bool32
+splinterdb_bulk_load_iterator_can_prev(iterator *itor)
+{
+   return FALSE;
+}
+
+static bool32
+splinterdb_bulk_load_iterator_can_next(iterator *itor)
+{
+   splinterdb_bulk_load_iterator *bl_itor =
+      (splinterdb_bulk_load_iterator *)itor;
+   return !bl_itor->at_end;
+}
+
+static void
+splinterdb_bulk_load_iterator_print(iterator *itor)
+{
+   splinterdb_bulk_load_iterator *bl_itor =
+      (splinterdb_bulk_load_iterator *)itor;
+   platform_default_log("splinterdb bulk load iterator: %p, tuples %lu\n",
+                        bl_itor,
+                        bl_itor->num_tuples);
+}
+
+const static iterator_ops splinterdb_bulk_load_iterator_ops = {
+   .curr     = splinterdb_bulk_load_iterator_curr,
+   .can_prev = splinterdb_bulk_load_iterator_can_prev,
+   .can_next = splinterdb_bulk_load_iterator_can_next,
+   .next     = splinterdb_bulk_load_iterator_next,
+   .print    = splinterdb_bulk_load_iterator_print,
+};
+
+int
+splinterdb_bulk_load(const splinterdb            *kvs,
+                     splinterdb_bulk_load_next_fn next,
+                     void                        *arg)
+{
+   if (kvs->vlog != NULL) {
+      return platform_status_to_int(STATUS_BAD_PARAM);
+   }
+
+   splinterdb_bulk_load_iterator bl_itor = {
+      .super   = {.ops = &splinterdb_bulk_load_iterator_ops},
+      .kvs     = kvs,
+      .next_fn = next,
+      .arg     = arg,
+   };
+   key_buffer_init(&bl_itor.key[0], kvs->heap_id);
+   key_buffer_init(&bl_itor.key[1], kvs->heap_id);
+
+   // position the iterator on the first tuple
+   splinterdb_bulk_load_iterator_next(&bl_itor.super);
+   platform_status rc = trunk_bulk_load(kvs->spl, &bl_itor.super);
+   if (SUCCESS(rc)) {
+      rc = bl_itor.rc;
+   }
+
+   key_buffer_deinit(&bl_itor.key[0]);
+   key_buffer_deinit(&bl_itor.key[1]);
+   return platform_status_to_int(rc);
+}
+
 /*
  *-----------------------------------------------------------------------------
  * _splinterdb_lookup_result structure --
@@ -648,15 +1065,47 @@ splinterdb_lookup(const splinterdb         *kvs, // IN
    key                        target  = key_create_from_slice(user_key);
 
    platform_assert(kvs != NULL);
+   if (kvs->vlog == NULL) {
+      status = trunk_lookup(kvs->spl, target, &_result->value);
+      return platform_status_to_int(status);
+   }
+
+   value_log_read_begin(kvs->vlog);
    status = trunk_lookup(kvs->spl, target, &_result->value);
+   if (SUCCESS(status) && trunk_lookup_found(&_result->value)) {
+      status = splinterdb_value_log_resolve(kvs, &_result->value.data);
+   }
+   value_log_read_end(kvs->vlog);
    return platform_status_to_int(status);
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * splinterdb_may_contain --
+ *
+ *      Check whether a key may be present without reading branch pages
+ *
+ * Results:
+ *      FALSE if the key is certainly absent, TRUE if it may be present.
+ *
+ * Side effects:
+ *      None.
+ *-----------------------------------------------------------------------------
+ */
+_Bool
+splinterdb_may_contain(const splinterdb *kvs, // IN
+                       slice             user_key)
+{
+   platform_assert(kvs != NULL);
+   return trunk_may_contain(kvs->spl, key_create_from_slice(user_key));
+}
+
 
 struct splinterdb_iterator {
    trunk_range_iterator sri;
    platform_status      last_rc;
    const splinterdb    *parent;
+   writable_buffer      value; // of the current tuple, if in the value log
 };
 
 int
@@ -693,6 +1142,10 @@ splinterdb_iterator_init(const splinterdb     *kvs,           // IN
       return platform_status_to_int(rc);
    }
    it->parent = kvs;
+   writable_buffer_init(&it->value, kvs->heap_id);
+   if (kvs->vlog != NULL) {
+      value_log_read_begin(kvs->vlog);
+   }
 
    *iter = it;
    return EXIT_SUCCESS;
@@ -703,6 +1156,10 @@ splinterdb_iterator_deinit(splinterdb_iterator *iter)
 {
    trunk_range_iterator *range_itor = &(iter->sri);
    trunk_range_iterator_deinit(range_itor);
+   if (iter->parent->vlog != NULL) {
+      value_log_read_end(iter->parent->vlog);
+   }
+   writable_buffer_deinit(&iter->value);
 
    trunk_handle *spl = range_itor->spl;
    platform_free(spl->heap_id, range_itor);
@@ -771,6 +1228,19 @@ splinterdb_iterator_get_current(splinterdb_iterator *iter,   // IN
    iterator_curr(itor, &result_key, &msg);
    *value  = message_slice(msg);
    *outkey = key_slice(result_key);
+
+   if (iter->parent->vlog != NULL) {
+      const char *data = slice_data(*value);
+      if (data[0] == SPLINTERDB_VALUE_INLINE) {
+         *value = slice_create(slice_length(*value) - 1, data + 1);
+         return;
+      }
+      splinterdb_logged_value logged;
+      memmove(&logged, data, sizeof(logged));
+      iter->last_rc =
+         value_log_read(iter->parent->vlog, logged.ref, &iter->value);
+      *value = writable_buffer_to_slice(&iter->value);
+   }
 }
 
 void
@@ -195,6 +195,13 @@ task_system_destroy(platform_heap_id hid, task_system **ts);
 void *
 task_system_get_thread_scratch(task_system *ts, threadid tid);
 
+/* Number of background threads performing tasks of the given type. */
+static inline uint64
+task_system_num_bg_threads(task_system *ts, task_type type)
+{
+   return ts->group[type].bg.num_threads;
+}
+
 platform_status
 task_enqueue(task_system *ts,
              task_type    type,
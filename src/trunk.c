@@ -18,6 +18,7 @@
 #include "task.h"
 #include "util.h"
 #include "srq.h"
+#include <math.h>
 
 #include "poison.h"
 
@@ -41,14 +42,6 @@ static const int64 latency_histo_buckets[LATENCYHISTO_SIZE] = {
    10000000000 // 10  s
 };
 
-/*
- * At any time, one Memtable is "active" for inserts / updates.
- * At any time, the most # of Memtables that can be active or in one of these
- * states, such as, compaction, incorporation, reclamation, is given by this
- * limit.
- */
-#define TRUNK_NUM_MEMTABLES (4)
-
 /*
  * These are hard-coded to values so that statically allocated
  * structures sized by these limits can fit within 4K byte pages.
@@ -89,6 +82,25 @@ static const int64 latency_histo_buckets[LATENCYHISTO_SIZE] = {
  */
 #define TRUNK_SINGLE_LEAF_THRESHOLD_PCT (75)
 
+/*
+ * Compactions of bundles with at least this many tuples per background thread
+ * are split into key ranges which are packed in parallel, see
+ * trunk_compact_bundle_num_partitions.
+ */
+#define TRUNK_COMPACTION_PARTITION_MIN_TUPLES (16384)
+
+/*
+ * Compactions whose filters take at least this many fingerprints build the
+ * filters of their pivots in parallel, see trunk_build_filters.
+ */
+#define TRUNK_FILTER_BUILD_PARALLEL_MIN_FPS (4096)
+
+/*
+ * Adaptive fingerprint sizes stay within this many bits of filter_cfg's, see
+ * trunk_filter_fingerprint_size.
+ */
+#define TRUNK_FILTER_FINGERPRINT_MAX_ADJUST (4)
+
 /*
  * Index of the trunk_root_lock batch rwlock used.
  */
@@ -453,6 +465,7 @@ typedef struct ONDISK trunk_super_block {
    uint64      meta_tail;
    uint64      log_addr;
    uint64      log_meta_addr;
+   uint64      value_log_addr;
    uint64      timestamp;
    bool32      checkpointed;
    bool32      unmounted;
@@ -768,6 +781,47 @@ typedef union {
    split_leaf_scratch     split_leaf;
 } trunk_task_scratch;
 
+/*
+ *-----------------------------------------------------------------------------
+ * Compaction Partitions
+ *
+ * A large compaction is split into key ranges, each packed by its own task
+ * into leaves which are then stitched into the output branch (see
+ * btree_pack_partition). The inputs are copied out of the node, so that the
+ * tasks can build their iterators without it.
+ *
+ * A task whose partition has already been claimed, by the compaction itself
+ * or another task, does nothing. refs counts the compaction and its queued
+ * tasks, and the last to finish frees the partitions.
+ *-----------------------------------------------------------------------------
+ */
+typedef struct trunk_compact_partitions trunk_compact_partitions;
+
+typedef struct trunk_compact_partition {
+   trunk_compact_partitions *parts;
+   key_buffer                start_key;
+   key_buffer                end_key;
+   uint64                    max_tuples; // of the inputs in the range
+   volatile bool32           claimed;
+   platform_status           rc;
+   btree_pack_req            pack_req;
+} trunk_compact_partition;
+
+struct trunk_compact_partitions {
+   trunk_handle  *spl;
+   merge_behavior merge_mode;
+   uint16         num_branches;
+   uint16         num_children;
+   trunk_branch   branch[TRUNK_RANGE_ITOR_MAX_BRANCHES];
+   uint64         live_pivots[TRUNK_RANGE_ITOR_MAX_BRANCHES]; // bit per pivot
+   key_buffer     pivot[TRUNK_MAX_PIVOTS];
+
+   volatile uint64         num_unpacked;
+   volatile uint64         refs;
+   uint64                  num_partitions;
+   trunk_compact_partition partition[];
+};
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -941,9 +995,10 @@ trunk_set_super_block(trunk_handle *spl,
          super->log_meta_addr = 0;
       }
    }
-   super->timestamp    = platform_get_real_time();
-   super->checkpointed = is_checkpoint;
-   super->unmounted    = is_unmount;
+   super->value_log_addr = spl->value_log_addr;
+   super->timestamp      = platform_get_real_time();
+   super->checkpointed   = is_checkpoint;
+   super->unmounted      = is_unmount;
    super->checksum =
       platform_checksum128(super,
                            sizeof(trunk_super_block) - sizeof(checksum128),
@@ -2468,7 +2523,6 @@ trunk_leaf_rebundle_all_branches(trunk_handle *spl,
       routing_filter   *filter = trunk_subbundle_filter(spl, node, sb, 0);
       trunk_pivot_data *pdata  = trunk_get_pivot_data(spl, node, 0);
       *filter                  = pdata->filter;
-      debug_assert(filter->addr != 0);
       ZERO_STRUCT(pdata->filter);
       debug_assert(trunk_subbundle_branch_count(spl, node, sb) != 0);
    }
@@ -3313,7 +3367,7 @@ static inline void
 trunk_memtable_inc_ref(trunk_handle *spl, uint64 mt_gen)
 {
    memtable *mt = trunk_get_memtable(spl, mt_gen);
-   allocator_inc_ref(spl->al, mt->root_addr);
+   memtable_inc_ref(spl->mt_ctxt, mt);
 }
 
 
@@ -3331,25 +3385,34 @@ trunk_memtable_dec_ref(trunk_handle *spl, uint64 generation)
 /*
  * Wrappers for creating/destroying memtable iterators. Increments/decrements
  * the memtable ref count and cleans up if ref count == 0
- */
-static void
-trunk_memtable_iterator_init(trunk_handle   *spl,
-                             btree_iterator *itor,
-                             uint64          root_addr,
-                             key             min_key,
-                             key             max_key,
-                             key             start_key,
-                             comparison      start_type,
-                             bool32          is_live,
-                             bool32          inc_ref)
+ *
+ * The iterator is built in btree_itor or skiplist_itor, depending on the
+ * memtable's engine, and returned.
+ */
+static iterator *
+trunk_memtable_iterator_init(trunk_handle      *spl,
+                             memtable          *mt,
+                             btree_iterator    *btree_itor,
+                             skiplist_iterator *skiplist_itor,
+                             key                min_key,
+                             key                max_key,
+                             key                start_key,
+                             comparison         start_type,
+                             bool32             is_live,
+                             bool32             inc_ref)
 {
    if (inc_ref) {
-      allocator_inc_ref(spl->al, root_addr);
+      memtable_inc_ref(spl->mt_ctxt, mt);
+   }
+   if (memtable_is_skiplist(mt)) {
+      skiplist_iterator_init(
+         &mt->sl, skiplist_itor, min_key, max_key, start_key, start_type);
+      return &skiplist_itor->super;
    }
    btree_iterator_init(spl->cc,
                        &spl->cfg.btree_cfg,
-                       itor,
-                       root_addr,
+                       btree_itor,
+                       mt->root_addr,
                        PAGE_TYPE_MEMTABLE,
                        min_key,
                        max_key,
@@ -3357,17 +3420,23 @@ trunk_memtable_iterator_init(trunk_handle   *spl,
                        start_type,
                        FALSE,
                        0);
+   return &btree_itor->super;
 }
 
 static void
-trunk_memtable_iterator_deinit(trunk_handle   *spl,
-                               btree_iterator *itor,
-                               uint64          mt_gen,
-                               bool32          dec_ref)
-{
-   btree_iterator_deinit(itor);
+trunk_memtable_iterator_deinit(trunk_handle      *spl,
+                               memtable          *mt,
+                               btree_iterator    *btree_itor,
+                               skiplist_iterator *skiplist_itor,
+                               bool32             dec_ref)
+{
+   if (memtable_is_skiplist(mt)) {
+      skiplist_iterator_deinit(skiplist_itor);
+   } else {
+      btree_iterator_deinit(btree_itor);
+   }
    if (dec_ref) {
-      trunk_memtable_dec_ref(spl, mt_gen);
+      memtable_dec_ref_maybe_recycle(spl->mt_ctxt, mt);
    }
 }
 
@@ -3433,26 +3502,29 @@ trunk_memtable_compact_and_build_filter(trunk_handle  *spl,
    memtable *mt = trunk_get_memtable(spl, generation);
 
    memtable_transition(mt, MEMTABLE_STATE_FINALIZED, MEMTABLE_STATE_COMPACTING);
-   mini_release(&mt->mini, NULL_KEY);
+   if (!memtable_is_skiplist(mt)) {
+      mini_release(&mt->mini, NULL_KEY);
+   }
 
    trunk_compacted_memtable *cmt =
       trunk_get_compacted_memtable(spl, generation);
    trunk_branch *new_branch = &cmt->branch;
    ZERO_CONTENTS(new_branch);
 
-   uint64         memtable_root_addr = mt->root_addr;
-   btree_iterator btree_itor;
-   iterator      *itor = &btree_itor.super;
-
-   trunk_memtable_iterator_init(spl,
-                                &btree_itor,
-                                memtable_root_addr,
-                                NEGATIVE_INFINITY_KEY,
-                                POSITIVE_INFINITY_KEY,
-                                NEGATIVE_INFINITY_KEY,
-                                greater_than_or_equal,
-                                FALSE,
-                                FALSE);
+   btree_iterator    btree_itor;
+   skiplist_iterator skiplist_itor;
+   iterator         *itor;
+
+   itor = trunk_memtable_iterator_init(spl,
+                                       mt,
+                                       &btree_itor,
+                                       &skiplist_itor,
+                                       NEGATIVE_INFINITY_KEY,
+                                       POSITIVE_INFINITY_KEY,
+                                       NEGATIVE_INFINITY_KEY,
+                                       greater_than_or_equal,
+                                       FALSE,
+                                       FALSE);
    btree_pack_req req;
    btree_pack_req_init(&req,
                        spl->cc,
@@ -3482,7 +3554,7 @@ trunk_memtable_compact_and_build_filter(trunk_handle  *spl,
          spl->stats[tid].root_compaction_max_tuples = req.num_tuples;
       }
    }
-   trunk_memtable_iterator_deinit(spl, &btree_itor, FALSE, FALSE);
+   trunk_memtable_iterator_deinit(spl, mt, &btree_itor, &skiplist_itor, FALSE);
 
    new_branch->root_addr = req.root_addr;
 
@@ -3830,6 +3902,202 @@ trunk_memtable_flush_virtual(void *arg, uint64 generation)
    trunk_memtable_flush(spl, generation);
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * Bulk Load Functions
+ *
+ *      A bulk load packs sorted tuples directly into branches of at most a
+ *      memtable's worth of data, and adds each to the root as a new compacted
+ *      bundle, as memtable incorporation does. Packing a branch and building
+ *      its filter take no locks, so loads of disjoint key ranges proceed in
+ *      parallel up to the installation of their branches.
+ *
+ *      Branches go in at the root rather than in the leaves covering them
+ *      because flushes move whole branches down by reference, so a loaded
+ *      tuple is rewritten only by the compaction of the leaf bundle it lands
+ *      in. Adding branches to leaves instead makes each leaf split, and so
+ *      rewrite its tuples, after every few branches.
+ *-----------------------------------------------------------------------------
+ */
+
+// an iterator which ends after a memtable's worth of the tuples of itor
+typedef struct trunk_bulk_load_iterator {
+   iterator  super;
+   iterator *itor;
+   uint64    num_tuples;
+   uint64    max_tuples;
+   uint64    kv_bytes;
+   uint64    max_kv_bytes;
+} trunk_bulk_load_iterator;
+
+static void
+trunk_bulk_load_iterator_curr(iterator *itor, key *curr_key, message *data)
+{
+   trunk_bulk_load_iterator *bl_itor = (trunk_bulk_load_iterator *)itor;
+   iterator_curr(bl_itor->itor, curr_key, data);
+}
+
+static platform_status
+trunk_bulk_load_iterator_next(iterator *itor)
+{
+   trunk_bulk_load_iterator *bl_itor = (trunk_bulk_load_iterator *)itor;
+   key                       curr_key;
+   message                   data;
+   iterator_curr(bl_itor->itor, &curr_key, &data);
+   bl_itor->num_tuples++;
+   bl_itor->kv_bytes += key_length(curr_key) + message_length(data);
+   return iterator_next(bl_itor->itor);
+}
+
+static bool32
+trunk_bulk_load_iterator_can_prev(iterator *itor)
+{
+   return FALSE;
+}
+
+static bool32
+trunk_bulk_load_iterator_can_next(iterator *itor)
+{
+   trunk_bulk_load_iterator *bl_itor = (trunk_bulk_load_iterator *)itor;
+   return bl_itor->num_tuples < bl_itor->max_tuples
+          && bl_itor->kv_bytes < bl_itor->max_kv_bytes
+          && iterator_can_next(bl_itor->itor);
+}
+
+static void
+trunk_bulk_load_iterator_print(iterator *itor)
+{
+   trunk_bulk_load_iterator *bl_itor = (trunk_bulk_load_iterator *)itor;
+   platform_default_log("bulk load iterator: %p, tuples %lu, kv bytes %lu\n",
+                        bl_itor,
+                        bl_itor->num_tuples,
+                        bl_itor->kv_bytes);
+   iterator_print(bl_itor->itor);
+}
+
+const static iterator_ops trunk_bulk_load_iterator_ops = {
+   .curr     = trunk_bulk_load_iterator_curr,
+   .can_prev = trunk_bulk_load_iterator_can_prev,
+   .can_next = trunk_bulk_load_iterator_can_next,
+   .next     = trunk_bulk_load_iterator_next,
+   .print    = trunk_bulk_load_iterator_print,
+};
+
+/*
+ * Adds a packed branch and its filter to a copy of the root, as
+ * trunk_memtable_incorporate_and_flush does with a compacted memtable, and
+ * enqueues building the filters of its bundle.
+ */
+static void
+trunk_bulk_load_install(trunk_handle             *spl,
+                        trunk_branch             *new_branch,
+                        routing_filter           *new_filter,
+                        trunk_compact_bundle_req *req)
+{
+   trunk_node new_root;
+   uint64     old_root_addr; // unused
+   trunk_claim_and_copy_root(spl, &new_root, &old_root_addr);
+   platform_assert(trunk_has_vacancy(spl, &new_root, 1));
+
+   trunk_install_new_compacted_subbundle(
+      spl, &new_root, new_branch, new_filter, req);
+
+   while (trunk_node_is_full(spl, &new_root)) {
+      trunk_flush_fullest(spl, &new_root);
+   }
+   if (trunk_needs_split(spl, &new_root)) {
+      trunk_split_root(spl, &new_root);
+   }
+   trunk_update_claimed_root_and_unlock(spl, &new_root);
+
+   trunk_default_log_if_enabled(
+      spl,
+      "bulk load: enqueuing build filter: range %s-%s, bundle %u\n",
+      key_string(trunk_data_config(spl), key_buffer_key(&req->start_key)),
+      key_string(trunk_data_config(spl), key_buffer_key(&req->end_key)),
+      req->bundle_no);
+   task_enqueue(
+      spl->ts, TASK_TYPE_NORMAL, trunk_bundle_build_filters, req, TRUE);
+}
+
+/*
+ * Loads the tuples of itor, which must be in strictly increasing key order,
+ * into the trunk. On failure, the tuples up to the last branch installed
+ * have been loaded.
+ */
+platform_status
+trunk_bulk_load(trunk_handle *spl, iterator *itor)
+{
+   const threadid  tid = platform_get_tid();
+   platform_status rc  = STATUS_OK;
+
+   while (iterator_can_next(itor)) {
+      trunk_bulk_load_iterator bl_itor = {
+         .super        = {.ops = &trunk_bulk_load_iterator_ops},
+         .itor         = itor,
+         .max_tuples   = spl->cfg.max_tuples_per_node,
+         .max_kv_bytes = spl->cfg.max_kv_bytes_per_node / spl->cfg.fanout,
+      };
+      btree_pack_req req;
+      rc = btree_pack_req_init(&req,
+                               spl->cc,
+                               &spl->cfg.btree_cfg,
+                               &bl_itor.super,
+                               spl->cfg.max_tuples_per_node,
+                               spl->cfg.filter_cfg.hash,
+                               spl->cfg.filter_cfg.seed,
+                               spl->heap_id);
+      if (SUCCESS(rc)) {
+         rc = btree_pack(&req);
+      }
+      if (!SUCCESS(rc)) {
+         btree_pack_req_deinit(&req, spl->heap_id);
+         break;
+      }
+      debug_assert(req.num_tuples > 0);
+
+      trunk_compact_bundle_req *cmp_req = TYPED_ZALLOC(spl->heap_id, cmp_req);
+      cmp_req->spl                      = spl;
+      cmp_req->type                     = TRUNK_COMPACTION_TYPE_MEMTABLE;
+      cmp_req->fp_arr =
+         TYPED_ARRAY_MALLOC(spl->heap_id, cmp_req->fp_arr, req.num_tuples);
+      memmove(cmp_req->fp_arr,
+              req.fingerprint_arr,
+              req.num_tuples * sizeof(uint32));
+
+      trunk_branch   new_branch   = {.root_addr = req.root_addr};
+      routing_filter empty_filter = {0};
+      routing_filter new_filter   = {0};
+
+      rc = routing_filter_add(spl->cc,
+                              &spl->cfg.filter_cfg,
+                              &empty_filter,
+                              &new_filter,
+                              req.fingerprint_arr,
+                              req.num_tuples,
+                              0);
+      platform_assert_status_ok(rc);
+      if (spl->cfg.use_stats) {
+         spl->stats[tid].bulk_load_branches++;
+         spl->stats[tid].bulk_load_tuples += req.num_tuples;
+      }
+      btree_pack_req_deinit(&req, spl->heap_id);
+
+      trunk_bulk_load_install(spl, &new_branch, &new_filter, cmp_req);
+
+      /*
+       * A branch is a memtable's worth of inserts, each of which would have
+       * performed a queued task if needed, so keep up in the same way.
+       */
+      platform_status task_rc;
+      do {
+         task_rc =
+            task_perform_one_if_needed(spl->ts, spl->cfg.queue_scale_percent);
+      } while (SUCCESS(task_rc));
+   }
+   return rc;
+}
+
 static inline uint64
 trunk_memtable_root_addr_for_lookup(trunk_handle *spl,
                                     uint64        generation,
@@ -3872,13 +4140,18 @@ trunk_memtable_lookup(trunk_handle      *spl,
    bool32              memtable_is_compacted;
    uint64              root_addr = trunk_memtable_root_addr_for_lookup(
       spl, generation, &memtable_is_compacted);
-   page_type type =
-      memtable_is_compacted ? PAGE_TYPE_BRANCH : PAGE_TYPE_MEMTABLE;
    platform_status rc;
    bool32          local_found;
 
+   memtable *mt = trunk_get_memtable(spl, generation);
+   if (!memtable_is_compacted) {
+      return memtable_lookup(spl->mt_ctxt, mt, target, data);
+   }
+   if (!memtable_may_contain(mt, target)) {
+      return STATUS_OK;
+   }
    rc = btree_lookup_and_merge(
-      cc, cfg, root_addr, type, target, data, &local_found);
+      cc, cfg, root_addr, PAGE_TYPE_BRANCH, target, data, &local_found);
    return rc;
 }
 
@@ -3894,16 +4167,139 @@ trunk_routing_cfg(trunk_handle *spl)
    return &spl->cfg.filter_cfg;
 }
 
+/*
+ * The config filters of nodes at height are built with. Lookups may use
+ * trunk_routing_cfg for all filters, which record their own family.
+ */
+static inline routing_config *
+trunk_filter_cfg_for_height(trunk_handle *spl, uint16 height)
+{
+   if (height < 64 && (spl->cfg.bloom_filter_heights >> height) & 1) {
+      return &spl->cfg.bloom_filter_cfg;
+   }
+   return &spl->cfg.filter_cfg;
+}
+
+/*
+ * Whether filters of nodes at height are probed through spl->filter_cache.
+ */
+static inline bool32
+trunk_filter_is_cached(trunk_handle *spl, uint16 height)
+{
+   return spl->filter_cache != NULL && height < 64
+          && (spl->cfg.filter_cache_heights >> height) & 1;
+}
+
+static inline platform_status
+trunk_filter_lookup_hash(trunk_handle   *spl,
+                         uint16          height,
+                         routing_config *cfg,
+                         routing_filter *filter,
+                         uint32          key_hash,
+                         uint64         *found_values)
+{
+   if (trunk_filter_is_cached(spl, height)) {
+      return routing_filter_lookup_cached(
+         spl->cc, cfg, spl->filter_cache, filter, key_hash, found_values);
+   }
+   return routing_filter_lookup_hash(
+      spl->cc, cfg, filter, key_hash, found_values);
+}
+
+/*
+ * Records a branch lookup at height that a filter probe sent in vain.
+ */
+static inline void
+trunk_filter_false_positive(trunk_handle *spl, uint16 height)
+{
+   threadid tid = platform_get_tid();
+   if (spl->cfg.use_stats) {
+      spl->stats[tid].filter_false_positives[height]++;
+   }
+   if (spl->cfg.filter_adaptive_fingerprints) {
+      spl->filter_feedback[tid].false_positives[height]++;
+   }
+}
+
+/*
+ * The fingerprint size of the quotient filters built from scratch at height.
+ *
+ * With cfg.filter_adaptive_fingerprints set, it is sized from the filters
+ * built and the false positives seen at each height. A false positive costs
+ * a branch lookup, about one page per level of the branch, and each bit of
+ * fingerprint halves the false positive rate. Spending the bits the filters
+ * would take at filter_cfg's fingerprint size so as to waste the least I/O
+ * gives height h
+ *
+ *    fingerprint_size + log2(w_h) - (the mean of log2(w) over all keys)
+ *
+ * bits, where w_h is the I/O per key the false positives seen at height h
+ * would have wasted with 0-bit fingerprints.
+ */
+static uint32
+trunk_filter_fingerprint_size(trunk_handle *spl, uint16 height)
+{
+   uint32 base_size = spl->cfg.filter_cfg.fingerprint_size;
+   if (!spl->cfg.filter_adaptive_fingerprints) {
+      return base_size;
+   }
+
+   double log_waste[TRUNK_MAX_HEIGHT];
+   uint64 num_keys[TRUNK_MAX_HEIGHT];
+   double total_keys      = 0;
+   double total_log_waste = 0;
+   for (uint16 h = 0; h < TRUNK_MAX_HEIGHT; h++) {
+      uint64 num_filters         = 0;
+      uint64 num_false_positives = 0;
+      num_keys[h]                = 0;
+      for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+         num_filters += spl->filter_feedback[tid].filters[h];
+         num_keys[h] += spl->filter_feedback[tid].fingerprints[h];
+         num_false_positives += spl->filter_feedback[tid].false_positives[h];
+      }
+      if (num_keys[h] == 0) {
+         continue;
+      }
+      uint32 size = spl->fingerprint_size[h];
+      if (size == 0) {
+         size = base_size;
+      }
+      // a branch of n tuples has about log_256(n) + 1 levels
+      double cost  = 1 + log2((double)num_keys[h] / num_filters) / 8;
+      log_waste[h] = log2(num_false_positives + 1) + size + log2(cost)
+                     - log2(num_keys[h]);
+      total_keys += num_keys[h];
+      total_log_waste += num_keys[h] * log_waste[h];
+   }
+   if (num_keys[height] == 0) {
+      return base_size;
+   }
+
+   int32 adjust = round(log_waste[height] - total_log_waste / total_keys);
+   adjust       = MAX(adjust, -TRUNK_FILTER_FINGERPRINT_MAX_ADJUST);
+   adjust       = MIN(adjust, TRUNK_FILTER_FINGERPRINT_MAX_ADJUST);
+
+   // keep 2 bits of remainder in the fullest filters and room for the values
+   uint64 max_fingerprints = spl->cfg.max_tuples_per_node;
+   uint32 min_size = MIN(base_size, 66 - __builtin_clzll(max_fingerprints));
+   uint64 max_value = spl->cfg.max_branches_per_node;
+   uint32 max_size  = 32 - (64 - __builtin_clzll(max_value));
+   uint32 size      = MAX(min_size, MIN(max_size, base_size + adjust));
+
+   spl->fingerprint_size[height] = size;
+   return size;
+}
+
 static inline void
 trunk_inc_filter_ref(trunk_handle *spl, routing_filter *filter, uint32 lineno)
 {
-   debug_assert((filter->addr != 0),
-                "From line=%d: addr=%lu, meta_head=%lu"
-                ", num_fingerprints=%u\n",
-                lineno,
-                filter->addr,
-                filter->meta_head,
-                filter->num_fingerprints);
+   /*
+    * A pivot whose whole branches hold none of its tuples has no filter, and
+    * flushing them carries the empty filter into the child's subbundle.
+    */
+   if (filter->addr == 0) {
+      return;
+   }
    mini_unkeyed_inc_ref(spl->cc, filter->meta_head);
 }
 
@@ -3913,8 +4309,7 @@ trunk_dec_filter(trunk_handle *spl, routing_filter *filter)
    if (filter->addr == 0) {
       return;
    }
-   cache *cc = spl->cc;
-   routing_filter_zap(cc, filter);
+   routing_filter_zap_cached(spl->cc, spl->filter_cache, filter);
 }
 
 /*
@@ -3928,6 +4323,7 @@ typedef struct trunk_filter_scratch {
    routing_filter old_filter[TRUNK_MAX_PIVOTS];
    uint16         value[TRUNK_MAX_PIVOTS];
    routing_filter filter[TRUNK_MAX_PIVOTS];
+   uint32         fingerprint_size; // of the filters built from scratch
    uint32        *fp_arr;
 } trunk_filter_scratch;
 
@@ -4094,6 +4490,126 @@ trunk_process_generation_to_fp_bounds(trunk_handle             *spl,
    *fp_end           = fp_end_int;
 }
 
+/*
+ * Builds the filter of the pivot at pos in filter_scratch. Filters of
+ * different pivots take disjoint ranges of fp_arr, so they may be built
+ * concurrently.
+ */
+static void
+trunk_build_filter(trunk_handle             *spl,
+                   trunk_compact_bundle_req *compact_req,
+                   trunk_filter_scratch     *filter_scratch,
+                   uint64                    pos)
+{
+   routing_filter old_filter = filter_scratch->old_filter[pos];
+   uint32         fp_start, fp_end;
+   uint64         generation = compact_req->pivot_generation[pos];
+   trunk_process_generation_to_fp_bounds(
+      spl, compact_req, generation, &fp_start, &fp_end);
+   uint32 *fp_arr           = filter_scratch->fp_arr + fp_start;
+   uint32  num_fingerprints = fp_end - fp_start;
+   if (num_fingerprints == 0) {
+      if (old_filter.addr != 0) {
+         trunk_inc_filter(spl, &old_filter);
+      }
+      filter_scratch->filter[pos] = old_filter;
+      return;
+   }
+   routing_filter new_filter;
+   routing_config filter_cfg =
+      *trunk_filter_cfg_for_height(spl, compact_req->height);
+   filter_cfg.fingerprint_size = filter_scratch->fingerprint_size;
+   uint16          value       = filter_scratch->value[pos];
+   platform_status rc          = routing_filter_add(spl->cc,
+                                           &filter_cfg,
+                                           &old_filter,
+                                           &new_filter,
+                                           fp_arr,
+                                           num_fingerprints,
+                                           value);
+   platform_assert(SUCCESS(rc));
+
+   filter_scratch->filter[pos]       = new_filter;
+   filter_scratch->should_build[pos] = FALSE;
+   threadid tid                      = platform_get_tid();
+   uint16   height                   = compact_req->height;
+   if (spl->cfg.use_stats) {
+      spl->stats[tid].filters_built[height]++;
+      spl->stats[tid].filter_tuples[height] += num_fingerprints;
+   }
+   if (spl->cfg.filter_adaptive_fingerprints) {
+      spl->filter_feedback[tid].filters[height]++;
+      spl->filter_feedback[tid].fingerprints[height] += num_fingerprints;
+   }
+}
+
+/*
+ * The pivot filters of one compaction being built in parallel. Like
+ * trunk_compact_partitions, it is refcounted by the tasks, which may run
+ * after the compaction has built all the filters itself.
+ *
+ * compact_req and filter_scratch belong to the compacting thread, which
+ * stops waiting once num_unbuilt drops to 0. So a task picks its filters
+ * from the positions copied into the build, and only touches the
+ * compaction's state once it has claimed one, which keeps num_unbuilt up.
+ */
+typedef struct trunk_filter_build {
+   trunk_handle             *spl;
+   trunk_compact_bundle_req *compact_req;
+   trunk_filter_scratch     *filter_scratch;
+   uint64                    num_to_build;
+   uint16                    pos[TRUNK_MAX_PIVOTS];
+   volatile bool32           claimed[TRUNK_MAX_PIVOTS];
+   volatile uint64           num_unbuilt;
+   volatile uint64           refs;
+} trunk_filter_build;
+
+static void
+trunk_filter_build_unref(trunk_filter_build *build)
+{
+   platform_heap_id hid = build->spl->heap_id;
+   if (__sync_sub_and_fetch(&build->refs, 1) == 0) {
+      platform_free(hid, build);
+   }
+}
+
+/*
+ * Builds the filters no thread has claimed yet. is_task is set when called
+ * from a trunk_filter_build_task rather than by the compacting thread.
+ */
+static void
+trunk_filter_build_claim(trunk_filter_build *build, bool32 is_task)
+{
+   trunk_handle *spl = build->spl;
+   for (uint64 i = 0; i < build->num_to_build; i++) {
+      if (__sync_bool_compare_and_swap(&build->claimed[i], FALSE, TRUE)) {
+         trunk_build_filter(
+            spl, build->compact_req, build->filter_scratch, build->pos[i]);
+         if (is_task && spl->cfg.use_stats) {
+            threadid tid    = platform_get_tid();
+            uint16   height = build->compact_req->height;
+            spl->stats[tid].filters_built_by_tasks[height]++;
+         }
+         __sync_fetch_and_sub(&build->num_unbuilt, 1);
+      }
+   }
+}
+
+static void
+trunk_filter_build_task(void *arg, void *scratch)
+{
+   trunk_filter_build *build = arg;
+   if (build->num_unbuilt != 0) {
+      trunk_filter_build_claim(build, TRUE);
+   }
+   trunk_filter_build_unref(build);
+}
+
+/*
+ * Builds the filters of the pivots the compaction output tuples to. When the
+ * compaction is large enough, up to one task per background thread builds
+ * them alongside this thread, a pivot at a time.
+ */
 static inline void
 trunk_build_filters(trunk_handle             *spl,
                     trunk_compact_bundle_req *compact_req,
@@ -4108,42 +4624,59 @@ trunk_build_filters(trunk_handle             *spl,
       filter_build_start = platform_get_timestamp();
    }
 
+   filter_scratch->fingerprint_size =
+      trunk_filter_fingerprint_size(spl, compact_req->height);
+
+   uint64 num_to_build = 0;
+   uint64 num_fps      = 0;
    for (uint64 pos = 0; pos < TRUNK_MAX_PIVOTS; pos++) {
-      if (!filter_scratch->should_build[pos]) {
-         continue;
+      if (filter_scratch->should_build[pos]) {
+         num_to_build++;
+         num_fps += compact_req->output_pivot_tuple_count[pos];
       }
-      routing_filter old_filter = filter_scratch->old_filter[pos];
-      uint32         fp_start, fp_end;
-      uint64         generation = compact_req->pivot_generation[pos];
-      trunk_process_generation_to_fp_bounds(
-         spl, compact_req, generation, &fp_start, &fp_end);
-      uint32 *fp_arr           = filter_scratch->fp_arr + fp_start;
-      uint32  num_fingerprints = fp_end - fp_start;
-      if (num_fingerprints == 0) {
-         if (old_filter.addr != 0) {
-            trunk_inc_filter(spl, &old_filter);
+   }
+   uint64 num_tasks = 0;
+   if (num_to_build > 1 && num_fps >= TRUNK_FILTER_BUILD_PARALLEL_MIN_FPS) {
+      num_tasks = MIN(num_to_build - 1,
+                      task_system_num_bg_threads(spl->ts, TASK_TYPE_NORMAL));
+   }
+
+   trunk_filter_build *build = NULL;
+   if (num_tasks != 0) {
+      build = TYPED_ZALLOC(spl->heap_id, build);
+   }
+   if (build == NULL) {
+      for (uint64 pos = 0; pos < TRUNK_MAX_PIVOTS; pos++) {
+         if (filter_scratch->should_build[pos]) {
+            trunk_build_filter(spl, compact_req, filter_scratch, pos);
          }
-         filter_scratch->filter[pos] = old_filter;
-         continue;
       }
-      routing_filter  new_filter;
-      routing_config *filter_cfg = &spl->cfg.filter_cfg;
-      uint16          value      = filter_scratch->value[pos];
-      platform_status rc         = routing_filter_add(spl->cc,
-                                              filter_cfg,
-                                              &old_filter,
-                                              &new_filter,
-                                              fp_arr,
-                                              num_fingerprints,
-                                              value);
-      platform_assert(SUCCESS(rc));
-
-      filter_scratch->filter[pos]       = new_filter;
-      filter_scratch->should_build[pos] = FALSE;
-      if (spl->cfg.use_stats) {
-         spl->stats[tid].filters_built[height]++;
-         spl->stats[tid].filter_tuples[height] += num_fingerprints;
+   } else {
+      build->spl            = spl;
+      build->compact_req    = compact_req;
+      build->filter_scratch = filter_scratch;
+      build->num_unbuilt    = num_to_build;
+      build->refs           = 1;
+      for (uint64 pos = 0; pos < TRUNK_MAX_PIVOTS; pos++) {
+         if (filter_scratch->should_build[pos]) {
+            build->pos[build->num_to_build++] = pos;
+         }
       }
+      for (uint64 task_no = 0; task_no < num_tasks; task_no++) {
+         __sync_fetch_and_add(&build->refs, 1);
+         platform_status rc = task_enqueue(
+            spl->ts, TASK_TYPE_NORMAL, trunk_filter_build_task, build, TRUE);
+         if (!SUCCESS(rc)) {
+            __sync_fetch_and_sub(&build->refs, 1);
+         }
+      }
+      trunk_filter_build_claim(build, FALSE);
+      uint64 wait = 1;
+      while (build->num_unbuilt != 0) {
+         platform_sleep_ns(wait);
+         wait = wait > 1024 ? wait : 2 * wait;
+      }
+      trunk_filter_build_unref(build);
    }
 
    if (spl->cfg.use_stats) {
@@ -4416,12 +4949,12 @@ static cache_async_result
 trunk_filter_lookup_async(trunk_handle       *spl,
                           routing_config     *cfg,
                           routing_filter     *filter,
-                          key                 target,
+                          uint32              key_hash,
                           uint64             *found_values,
                           routing_async_ctxt *ctxt)
 {
    return routing_filter_lookup_async(
-      spl->cc, cfg, filter, target, found_values, ctxt);
+      spl->cc, cfg, filter, key_hash, found_values, ctxt);
 }
 
 /*
@@ -4885,32 +5418,38 @@ trunk_branch_iterator_deinit(trunk_handle   *spl,
  *       an iterator which can skip over tuples in branches which aren't live
  *-----------------------------------------------------------------------------
  */
+
+/*
+ * Iterates over the tuples of branch in [range_start, range_end) which are in
+ * pivots the branch is live for: bit i of live_pivots is set if the branch is
+ * live for pivot i. Doesn't need the node, so the partitions of a compaction
+ * can build their inputs, see trunk_compact_partition_pack.
+ */
 static void
-trunk_btree_skiperator_init(trunk_handle           *spl,
-                            trunk_btree_skiperator *skip_itor,
-                            trunk_node             *node,
-                            uint16                  branch_idx,
-                            key_buffer pivots[static TRUNK_MAX_PIVOTS])
+trunk_btree_skiperator_init_range(trunk_handle           *spl,
+                                  trunk_btree_skiperator *skip_itor,
+                                  trunk_branch           *branch,
+                                  uint64                  live_pivots,
+                                  uint16                  num_children,
+                                  key_buffer              pivots[],
+                                  key                     range_start,
+                                  key                     range_end)
 {
    ZERO_CONTENTS(skip_itor);
    skip_itor->super.ops = &trunk_btree_skiperator_ops;
    uint16 min_pivot_no  = 0;
-   uint16 max_pivot_no  = trunk_num_children(spl, node);
-   debug_assert(
-      (max_pivot_no < TRUNK_MAX_PIVOTS), "max_pivot_no = %d", max_pivot_no);
+   uint16 max_pivot_no  = num_children;
 
    key min_key       = key_buffer_key(&pivots[min_pivot_no]);
    key max_key       = key_buffer_key(&pivots[max_pivot_no]);
-   skip_itor->branch = *trunk_get_branch(spl, node, branch_idx);
+   skip_itor->branch = *branch;
 
    uint16 first_pivot      = 0;
    bool32 iterator_started = FALSE;
 
    for (uint16 i = min_pivot_no; i < max_pivot_no + 1; i++) {
       bool32 branch_valid =
-         i == max_pivot_no
-            ? FALSE
-            : trunk_branch_live_for_pivot(spl, node, branch_idx, i);
+         i == max_pivot_no ? FALSE : (live_pivots >> i) & 1;
       if (branch_valid && !iterator_started) {
          first_pivot      = i;
          iterator_started = TRUE;
@@ -4922,16 +5461,24 @@ trunk_btree_skiperator_init(trunk_handle           *spl,
                                 : key_buffer_key(&pivots[first_pivot]);
          key pivot_max_key =
             i == max_pivot_no ? max_key : key_buffer_key(&pivots[i]);
-         btree_iterator *btree_itor = &skip_itor->itor[skip_itor->end++];
-         trunk_branch_iterator_init(spl,
-                                    btree_itor,
-                                    &skip_itor->branch,
-                                    pivot_min_key,
-                                    pivot_max_key,
-                                    pivot_min_key,
-                                    greater_than_or_equal,
-                                    TRUE,
-                                    TRUE);
+         if (trunk_key_compare(spl, pivot_min_key, range_start) < 0) {
+            pivot_min_key = range_start;
+         }
+         if (trunk_key_compare(spl, range_end, pivot_max_key) < 0) {
+            pivot_max_key = range_end;
+         }
+         if (trunk_key_compare(spl, pivot_min_key, pivot_max_key) < 0) {
+            btree_iterator *btree_itor = &skip_itor->itor[skip_itor->end++];
+            trunk_branch_iterator_init(spl,
+                                       btree_itor,
+                                       &skip_itor->branch,
+                                       pivot_min_key,
+                                       pivot_max_key,
+                                       pivot_min_key,
+                                       greater_than_or_equal,
+                                       TRUE,
+                                       TRUE);
+         }
          iterator_started = FALSE;
       }
    }
@@ -4952,6 +5499,37 @@ trunk_btree_skiperator_init(trunk_handle           *spl,
    }
 }
 
+/*
+ * Iterates over the tuples of the branch at branch_idx in node which are in
+ * pivots the branch is live for.
+ */
+static void
+trunk_btree_skiperator_init(trunk_handle           *spl,
+                            trunk_btree_skiperator *skip_itor,
+                            trunk_node             *node,
+                            uint16                  branch_idx,
+                            key_buffer pivots[static TRUNK_MAX_PIVOTS])
+{
+   uint16 num_children = trunk_num_children(spl, node);
+   debug_assert(
+      (num_children < TRUNK_MAX_PIVOTS), "max_pivot_no = %d", num_children);
+
+   uint64 live_pivots = 0;
+   for (uint16 pivot_no = 0; pivot_no < num_children; pivot_no++) {
+      if (trunk_branch_live_for_pivot(spl, node, branch_idx, pivot_no)) {
+         live_pivots |= 1ULL << pivot_no;
+      }
+   }
+   trunk_btree_skiperator_init_range(spl,
+                                     skip_itor,
+                                     trunk_get_branch(spl, node, branch_idx),
+                                     live_pivots,
+                                     num_children,
+                                     pivots,
+                                     key_buffer_key(&pivots[0]),
+                                     key_buffer_key(&pivots[num_children]));
+}
+
 void
 trunk_btree_skiperator_curr(iterator *itor, key *curr_key, message *data)
 {
@@ -5062,19 +5640,441 @@ trunk_compact_bundle_cleanup_iterators(trunk_handle           *spl,
 }
 
 /*
- * compact_bundle compacts a bundle of flushed branches into a single branch
- *
- * See "Interactions between Concurrent Processes"
- * (numbering here mirrors that section)
- *
- * Interacts with splitting in two ways:
- * 4. Internal node split occurs between job issue and this compact_bundle call:
- *    the bundle was split too, issue compact_bundle on the new siblings
- * 6. Leaf split occurs before this call or during compaction:
- *    the bundle will be compacted as part of the split, so this compaction is
- *    aborted if split occurred before this call or discarded if it occurred
- *    during compaction.
- *
+ * Returns the number of key ranges to pack a compaction of bundle in, at most
+ * one per background thread and the compaction itself. Small compactions are
+ * packed whole.
+ */
+static uint64
+trunk_compact_bundle_num_partitions(trunk_handle *spl, trunk_bundle *bundle)
+{
+   uint64 num_bg_threads =
+      task_system_num_bg_threads(spl->ts, TASK_TYPE_NORMAL);
+   uint64 num_partitions =
+      bundle->num_tuples / TRUNK_COMPACTION_PARTITION_MIN_TUPLES;
+   return MIN(num_partitions, num_bg_threads + 1);
+}
+
+/*
+ * Incs or decs the refs of the input branches on the ranges they are live
+ * for, which are the ranges the partitions read. Keeps the inputs alive from
+ * the release of the node until the partitions have built their iterators.
+ */
+static void
+trunk_compact_partitions_ref_inputs(trunk_compact_partitions *parts,
+                                    bool32                    inc)
+{
+   trunk_handle *spl = parts->spl;
+   for (uint16 branch_no = 0; branch_no < parts->num_branches; branch_no++) {
+      trunk_branch *branch      = &parts->branch[branch_no];
+      uint64        live_pivots = parts->live_pivots[branch_no];
+      uint16        pivot_no    = 0;
+      while (branch->root_addr != 0 && pivot_no < parts->num_children) {
+         if (!((live_pivots >> pivot_no) & 1)) {
+            pivot_no++;
+            continue;
+         }
+         key start_key = key_buffer_key(&parts->pivot[pivot_no]);
+         while (pivot_no < parts->num_children && (live_pivots >> pivot_no) & 1)
+         {
+            pivot_no++;
+         }
+         key end_key = key_buffer_key(&parts->pivot[pivot_no]);
+         if (inc) {
+            trunk_inc_branch_range(spl, branch, start_key, end_key);
+         } else {
+            trunk_zap_branch_range(
+               spl, branch, start_key, end_key, PAGE_TYPE_BRANCH);
+         }
+      }
+   }
+}
+
+static void
+trunk_compact_partitions_destroy(trunk_compact_partitions *parts)
+{
+   for (uint64 part_no = 0; part_no < parts->num_partitions; part_no++) {
+      trunk_compact_partition *part = &parts->partition[part_no];
+      key_buffer_deinit(&part->start_key);
+      key_buffer_deinit(&part->end_key);
+      btree_pack_req_deinit(&part->pack_req, parts->spl->heap_id);
+   }
+   for (uint16 pivot_no = 0; pivot_no <= parts->num_children; pivot_no++) {
+      key_buffer_deinit(&parts->pivot[pivot_no]);
+   }
+}
+
+static void
+trunk_compact_partitions_unref(trunk_compact_partitions *parts)
+{
+   platform_heap_id hid = parts->spl->heap_id;
+   if (__sync_sub_and_fetch(&parts->refs, 1) == 0) {
+      platform_free(hid, parts);
+   }
+}
+
+/*
+ * Returns the number of input tuples in [start_key, end_key), counting each
+ * branch only in the pivots it is live for.
+ */
+static uint64
+trunk_compact_partitions_count(trunk_compact_partitions *parts,
+                               key                       start_key,
+                               key                       end_key)
+{
+   trunk_handle *spl        = parts->spl;
+   uint64        num_tuples = 0;
+   for (uint16 branch_no = 0; branch_no < parts->num_branches; branch_no++) {
+      trunk_branch *branch = &parts->branch[branch_no];
+      if (branch->root_addr == 0) {
+         continue;
+      }
+      for (uint16 pivot_no = 0; pivot_no < parts->num_children; pivot_no++) {
+         if (!((parts->live_pivots[branch_no] >> pivot_no) & 1)) {
+            continue;
+         }
+         key min_key = key_buffer_key(&parts->pivot[pivot_no]);
+         key max_key = key_buffer_key(&parts->pivot[pivot_no + 1]);
+         if (trunk_key_compare(spl, min_key, start_key) < 0) {
+            min_key = start_key;
+         }
+         if (trunk_key_compare(spl, end_key, max_key) < 0) {
+            max_key = end_key;
+         }
+         if (trunk_key_compare(spl, min_key, max_key) < 0) {
+            btree_pivot_stats stats;
+            btree_count_in_range(spl->cc,
+                                 &spl->cfg.btree_cfg,
+                                 branch->root_addr,
+                                 min_key,
+                                 max_key,
+                                 &stats);
+            num_tuples += stats.num_kvs;
+         }
+      }
+   }
+   return num_tuples;
+}
+
+/*
+ * Splits the compaction of the bundle of num_branches branches from
+ * start_branch in node into num_partitions key ranges of roughly equal
+ * numbers of tuples, and initializes pack_req to stitch them. Returns NULL
+ * if the compaction should be packed whole after all.
+ *
+ * The split keys are chosen from the index entries of the branches, as
+ * trunk_split_leaf chooses the pivots of new leaves, and the ranges are sized
+ * with btree_count_in_range.
+ */
+static trunk_compact_partitions *
+trunk_compact_partitions_create(trunk_handle       *spl,
+                                trunk_node         *node,
+                                uint16              start_branch,
+                                uint16              num_branches,
+                                merge_behavior      merge_mode,
+                                uint64              num_partitions,
+                                split_leaf_scratch *scratch,
+                                btree_pack_req     *pack_req)
+{
+   platform_status           rc;
+   trunk_compact_partitions *parts = TYPED_FLEXIBLE_STRUCT_ZALLOC(
+      spl->heap_id, parts, partition, num_partitions);
+   if (parts == NULL) {
+      return NULL;
+   }
+   parts->spl          = spl;
+   parts->merge_mode   = merge_mode;
+   parts->num_branches = num_branches;
+   parts->num_children = trunk_num_children(spl, node);
+   for (uint16 pivot_no = 0; pivot_no <= parts->num_children; pivot_no++) {
+      rc = key_buffer_init_from_key(&parts->pivot[pivot_no],
+                                    spl->heap_id,
+                                    trunk_get_pivot(spl, node, pivot_no));
+      platform_assert_status_ok(rc);
+   }
+   for (uint16 branch_offset = 0; branch_offset < num_branches; branch_offset++)
+   {
+      uint16 branch_no =
+         trunk_add_branch_number(spl, start_branch, branch_offset);
+      parts->branch[branch_offset] = *trunk_get_branch(spl, node, branch_no);
+      for (uint16 pivot_no = 0; pivot_no < parts->num_children; pivot_no++) {
+         if (trunk_branch_live_for_pivot(spl, node, branch_no, pivot_no)) {
+            parts->live_pivots[branch_offset] |= 1ULL << pivot_no;
+         }
+      }
+   }
+
+   key min_key = key_buffer_key(&parts->pivot[0]);
+   key max_key = key_buffer_key(&parts->pivot[parts->num_children]);
+
+   uint64 total_tuples =
+      trunk_compact_partitions_count(parts, min_key, max_key);
+
+   /*
+    * Choose the split keys with rough merge iterators over the index entries
+    * of the branches. A branch may already be gone from the pivots it is not
+    * live for, so this goes one pivot at a time over the live branches.
+    */
+   platform_assert(num_branches <= ARRAY_SIZE(scratch->btree_itor));
+   uint64 part_no    = 0;
+   uint64 num_tuples = 0;
+   key_buffer_init_from_key(
+      &parts->partition[0].start_key, spl->heap_id, min_key);
+   for (uint16 pivot_no = 0;
+        pivot_no < parts->num_children && part_no + 1 < num_partitions;
+        pivot_no++)
+   {
+      key    pivot_start = key_buffer_key(&parts->pivot[pivot_no]);
+      key    pivot_end   = key_buffer_key(&parts->pivot[pivot_no + 1]);
+      uint16 num_live    = 0;
+      for (uint16 branch_no = 0; branch_no < num_branches; branch_no++) {
+         if (!((parts->live_pivots[branch_no] >> pivot_no) & 1)
+             || parts->branch[branch_no].root_addr == 0)
+         {
+            continue;
+         }
+         btree_iterator_init(spl->cc,
+                             &spl->cfg.btree_cfg,
+                             &scratch->btree_itor[num_live],
+                             parts->branch[branch_no].root_addr,
+                             PAGE_TYPE_BRANCH,
+                             pivot_start,
+                             pivot_end,
+                             pivot_start,
+                             greater_than_or_equal,
+                             TRUE,
+                             1);
+         scratch->rough_itor[num_live] = &scratch->btree_itor[num_live].super;
+         num_live++;
+      }
+      if (num_live == 0) {
+         continue;
+      }
+      merge_iterator *rough_merge_itor;
+      rc = merge_iterator_create(spl->heap_id,
+                                 spl->cfg.data_cfg,
+                                 num_live,
+                                 scratch->rough_itor,
+                                 MERGE_RAW,
+                                 &rough_merge_itor);
+      platform_assert_status_ok(rc);
+
+      while (iterator_can_next(&rough_merge_itor->super)
+             && part_no + 1 < num_partitions)
+      {
+         key     curr_key;
+         message pivot_data_message;
+         iterator_curr(
+            &rough_merge_itor->super, &curr_key, &pivot_data_message);
+         key part_start = key_buffer_key(&parts->partition[part_no].start_key);
+         if (total_tuples * (part_no + 1) / num_partitions <= num_tuples
+             && trunk_key_compare(spl, part_start, curr_key) < 0
+             && trunk_key_compare(spl, curr_key, max_key) < 0)
+         {
+            key_buffer_init_from_key(
+               &parts->partition[part_no].end_key, spl->heap_id, curr_key);
+            part_no++;
+            key_buffer_init_from_key(
+               &parts->partition[part_no].start_key, spl->heap_id, curr_key);
+         }
+         const btree_pivot_data *pivot_data = message_data(pivot_data_message);
+         num_tuples += pivot_data->stats.num_kvs;
+         rc = iterator_next(&rough_merge_itor->super);
+         platform_assert_status_ok(rc);
+      }
+
+      rc = merge_iterator_destroy(spl->heap_id, &rough_merge_itor);
+      platform_assert_status_ok(rc);
+      for (uint16 itor_no = 0; itor_no < num_live; itor_no++) {
+         btree_iterator_deinit(&scratch->btree_itor[itor_no]);
+      }
+   }
+   key_buffer_init_from_key(
+      &parts->partition[part_no].end_key, spl->heap_id, max_key);
+   parts->num_partitions = part_no + 1;
+
+   /*
+    * Size each partition by its inputs. A compaction which may exceed a node
+    * is packed whole, to fail as it would otherwise.
+    */
+   uint64 max_tuples = 0;
+   for (part_no = 0; part_no < parts->num_partitions; part_no++) {
+      trunk_compact_partition *part      = &parts->partition[part_no];
+      key                      start_key = key_buffer_key(&part->start_key);
+      key                      end_key   = key_buffer_key(&part->end_key);
+      part->parts                        = parts;
+      part->max_tuples =
+         trunk_compact_partitions_count(parts, start_key, end_key);
+      max_tuples += part->max_tuples;
+   }
+
+   if (parts->num_partitions == 1 || spl->cfg.max_tuples_per_node < max_tuples)
+   {
+      goto abort;
+   }
+   rc = btree_pack_req_init(pack_req,
+                            spl->cc,
+                            &spl->cfg.btree_cfg,
+                            NULL,
+                            MAX(max_tuples, 1),
+                            spl->cfg.filter_cfg.hash,
+                            spl->cfg.filter_cfg.seed,
+                            spl->heap_id);
+   if (!SUCCESS(rc)) {
+      goto abort;
+   }
+
+   trunk_compact_partitions_ref_inputs(parts, TRUE);
+   return parts;
+
+abort:
+   trunk_compact_partitions_destroy(parts);
+   platform_free(spl->heap_id, parts);
+   return NULL;
+}
+
+/*
+ * Packs the leaves of one partition, on the thread which claimed it.
+ */
+static void
+trunk_compact_partition_pack(trunk_compact_partition *part,
+                             compact_bundle_scratch  *scratch)
+{
+   trunk_compact_partitions *parts = part->parts;
+   trunk_handle             *spl   = parts->spl;
+   key start_key = key_buffer_key(&part->start_key);
+   key end_key   = key_buffer_key(&part->end_key);
+
+   for (uint16 branch_no = 0; branch_no < parts->num_branches; branch_no++) {
+      trunk_btree_skiperator_init_range(spl,
+                                        &scratch->skip_itor[branch_no],
+                                        &parts->branch[branch_no],
+                                        parts->live_pivots[branch_no],
+                                        parts->num_children,
+                                        parts->pivot,
+                                        start_key,
+                                        end_key);
+      scratch->itor_arr[branch_no] = &scratch->skip_itor[branch_no].super;
+   }
+
+   merge_iterator *merge_itor;
+   platform_status rc = merge_iterator_create(spl->heap_id,
+                                              spl->cfg.data_cfg,
+                                              parts->num_branches,
+                                              scratch->itor_arr,
+                                              parts->merge_mode,
+                                              &merge_itor);
+   platform_assert_status_ok(rc);
+
+   rc = btree_pack_req_init(&part->pack_req,
+                            spl->cc,
+                            &spl->cfg.btree_cfg,
+                            &merge_itor->super,
+                            part->max_tuples,
+                            spl->cfg.filter_cfg.hash,
+                            spl->cfg.filter_cfg.seed,
+                            spl->heap_id);
+   if (SUCCESS(rc)) {
+      rc = btree_pack_partition(&part->pack_req);
+   }
+   part->rc = rc;
+
+   trunk_compact_bundle_cleanup_iterators(
+      spl, &merge_itor, parts->num_branches, scratch->skip_itor);
+   __sync_fetch_and_sub(&parts->num_unpacked, 1);
+}
+
+static void
+trunk_compact_partition_task(void *arg, void *scratch_buf)
+{
+   trunk_compact_partition  *part         = arg;
+   trunk_compact_partitions *parts        = part->parts;
+   trunk_task_scratch       *task_scratch = scratch_buf;
+
+   if (__sync_bool_compare_and_swap(&part->claimed, FALSE, TRUE)) {
+      trunk_compact_partition_pack(part, &task_scratch->compact_bundle);
+   }
+   trunk_compact_partitions_unref(parts);
+}
+
+/*
+ * Packs the partitions, one per task, and stitches them into pack_req. The
+ * compaction packs the partitions no task has claimed yet itself, so it only
+ * ever waits for partitions being packed.
+ */
+static platform_status
+trunk_compact_partitions_pack(trunk_compact_partitions *parts,
+                              compact_bundle_scratch   *scratch,
+                              btree_pack_req           *pack_req)
+{
+   trunk_handle   *spl = parts->spl;
+   platform_status rc;
+
+   parts->num_unpacked = parts->num_partitions;
+   parts->refs         = 1;
+   for (uint64 part_no = 1; part_no < parts->num_partitions; part_no++) {
+      __sync_fetch_and_add(&parts->refs, 1);
+      rc = task_enqueue(spl->ts,
+                        TASK_TYPE_NORMAL,
+                        trunk_compact_partition_task,
+                        &parts->partition[part_no],
+                        TRUE);
+      if (!SUCCESS(rc)) {
+         __sync_fetch_and_sub(&parts->refs, 1);
+      }
+   }
+
+   for (uint64 part_no = 0; part_no < parts->num_partitions; part_no++) {
+      trunk_compact_partition *part = &parts->partition[part_no];
+      if (__sync_bool_compare_and_swap(&part->claimed, FALSE, TRUE)) {
+         trunk_compact_partition_pack(part, scratch);
+      }
+   }
+   uint64 wait = 1;
+   while (parts->num_unpacked != 0) {
+      platform_sleep_ns(wait);
+      wait = wait > 1024 ? wait : 2 * wait;
+   }
+   trunk_compact_partitions_ref_inputs(parts, FALSE);
+
+   // at most one partition per thread, see trunk_compact_bundle_num_partitions
+   btree_pack_req *part_reqs[MAX_THREADS];
+   platform_assert(parts->num_partitions <= ARRAY_SIZE(part_reqs));
+   rc = STATUS_OK;
+   for (uint64 part_no = 0; part_no < parts->num_partitions; part_no++) {
+      trunk_compact_partition *part = &parts->partition[part_no];
+      part_reqs[part_no]            = &part->pack_req;
+      if (!SUCCESS(part->rc)) {
+         rc = part->rc;
+      }
+   }
+   btree_pack_stitch(pack_req, part_reqs, parts->num_partitions);
+   if (!SUCCESS(rc) && pack_req->root_addr != 0) {
+      btree_dec_ref_range(spl->cc,
+                          &spl->cfg.btree_cfg,
+                          pack_req->root_addr,
+                          NEGATIVE_INFINITY_KEY,
+                          POSITIVE_INFINITY_KEY);
+   }
+
+   trunk_compact_partitions_destroy(parts);
+   trunk_compact_partitions_unref(parts);
+   return rc;
+}
+
+/*
+ * compact_bundle compacts a bundle of flushed branches into a single branch
+ *
+ * See "Interactions between Concurrent Processes"
+ * (numbering here mirrors that section)
+ *
+ * Interacts with splitting in two ways:
+ * 4. Internal node split occurs between job issue and this compact_bundle call:
+ *    the bundle was split too, issue compact_bundle on the new siblings
+ * 6. Leaf split occurs before this call or during compaction:
+ *    the bundle will be compacted as part of the split, so this compaction is
+ *    aborted if split occurred before this call or discarded if it occurred
+ *    during compaction.
+ *
  * Node splits are determined using generation numbers (in trunk_hdr)
  *   internal: generation number of left node is incremented on split
  *      -- given generation number g of a node, all the nodes it split
@@ -5202,28 +6202,45 @@ trunk_compact_bundle(void *arg, void *scratch_buf)
       req->bundle_no);
 
    /*
-    * 5. Build iterators
+    * 5. Build iterators, or the inputs of the partitions of a large compaction
     */
    platform_assert(num_branches <= ARRAY_SIZE(scratch->skip_itor));
-   trunk_btree_skiperator *skip_itor_arr = scratch->skip_itor;
-   iterator              **itor_arr      = scratch->itor_arr;
-
-   save_pivots_to_compact_bundle_scratch(spl, &node, scratch);
-
-   uint16 tree_offset = 0;
-   for (uint16 branch_no = bundle_start_branch; branch_no != bundle_end_branch;
-        branch_no        = trunk_add_branch_number(spl, branch_no, 1))
-   {
-      /*
-       * We are iterating from oldest to newest branch
-       */
-      trunk_btree_skiperator_init(spl,
-                                  &skip_itor_arr[tree_offset],
-                                  &node,
-                                  branch_no,
-                                  scratch->saved_pivot_keys);
-      itor_arr[tree_offset] = &skip_itor_arr[tree_offset].super;
-      tree_offset++;
+   trunk_btree_skiperator   *skip_itor_arr = scratch->skip_itor;
+   iterator                **itor_arr      = scratch->itor_arr;
+   trunk_compact_partitions *parts         = NULL;
+   btree_pack_req            pack_req;
+
+   uint64 num_partitions = trunk_compact_bundle_num_partitions(spl, bundle);
+   if (1 < num_partitions) {
+      parts = trunk_compact_partitions_create(spl,
+                                              &node,
+                                              bundle_start_branch,
+                                              num_branches,
+                                              merge_mode,
+                                              num_partitions,
+                                              &task_scratch->split_leaf,
+                                              &pack_req);
+   }
+
+   if (parts == NULL) {
+      save_pivots_to_compact_bundle_scratch(spl, &node, scratch);
+
+      uint16 tree_offset = 0;
+      for (uint16 branch_no = bundle_start_branch;
+           branch_no != bundle_end_branch;
+           branch_no = trunk_add_branch_number(spl, branch_no, 1))
+      {
+         /*
+          * We are iterating from oldest to newest branch
+          */
+         trunk_btree_skiperator_init(spl,
+                                     &skip_itor_arr[tree_offset],
+                                     &node,
+                                     branch_no,
+                                     scratch->saved_pivot_keys);
+         itor_arr[tree_offset] = &skip_itor_arr[tree_offset].super;
+         tree_offset++;
+      }
    }
    trunk_log_node_if_enabled(&stream, spl, &node);
 
@@ -5235,36 +6252,47 @@ trunk_compact_bundle(void *arg, void *scratch_buf)
    /*
     * 7. Perform compaction
     */
-   merge_iterator *merge_itor;
-   rc = merge_iterator_create(spl->heap_id,
-                              spl->cfg.data_cfg,
-                              num_branches,
-                              itor_arr,
-                              merge_mode,
-                              &merge_itor);
-   platform_assert_status_ok(rc);
-   btree_pack_req pack_req;
-   rc = trunk_btree_pack_req_init(spl, &merge_itor->super, &pack_req);
-   if (!SUCCESS(rc)) {
-      platform_error_log("trunk_btree_pack_req_init failed: %s\n",
-                         platform_status_to_string(rc));
+   merge_iterator *merge_itor = NULL;
+   platform_status pack_status;
+   if (parts != NULL) {
+      req->fp_arr = pack_req.fingerprint_arr;
+      if (spl->cfg.use_stats) {
+         pack_start = platform_get_timestamp();
+         spl->stats[tid].compactions_partitioned[height]++;
+      }
+      pack_status = trunk_compact_partitions_pack(parts, scratch, &pack_req);
+   } else {
+      rc = merge_iterator_create(spl->heap_id,
+                                 spl->cfg.data_cfg,
+                                 num_branches,
+                                 itor_arr,
+                                 merge_mode,
+                                 &merge_itor);
+      platform_assert_status_ok(rc);
+      rc = trunk_btree_pack_req_init(spl, &merge_itor->super, &pack_req);
+      if (!SUCCESS(rc)) {
+         platform_error_log("trunk_btree_pack_req_init failed: %s\n",
+                            platform_status_to_string(rc));
 
-      trunk_compact_bundle_cleanup_iterators(
-         spl, &merge_itor, num_branches, skip_itor_arr);
-      platform_free(spl->heap_id, req);
-      goto out;
-   }
-   req->fp_arr = pack_req.fingerprint_arr;
-   if (spl->cfg.use_stats) {
-      pack_start = platform_get_timestamp();
-   }
+         trunk_compact_bundle_cleanup_iterators(
+            spl, &merge_itor, num_branches, skip_itor_arr);
+         platform_free(spl->heap_id, req);
+         goto out;
+      }
+      req->fp_arr = pack_req.fingerprint_arr;
+      if (spl->cfg.use_stats) {
+         pack_start = platform_get_timestamp();
+      }
 
-   platform_status pack_status = btree_pack(&pack_req);
+      pack_status = btree_pack(&pack_req);
+   }
    if (!SUCCESS(pack_status)) {
       platform_default_log("btree_pack failed: %s\n",
                            platform_status_to_string(pack_status));
-      trunk_compact_bundle_cleanup_iterators(
-         spl, &merge_itor, num_branches, skip_itor_arr);
+      if (merge_itor != NULL) {
+         trunk_compact_bundle_cleanup_iterators(
+            spl, &merge_itor, num_branches, skip_itor_arr);
+      }
       btree_pack_req_deinit(&pack_req, spl->heap_id);
       platform_free(spl->heap_id, req);
       goto out;
@@ -5298,10 +6326,12 @@ trunk_compact_bundle(void *arg, void *scratch_buf)
    /*
     * 9. Clean up
     */
-   trunk_compact_bundle_cleanup_iterators(
-      spl, &merge_itor, num_branches, skip_itor_arr);
+   if (merge_itor != NULL) {
+      trunk_compact_bundle_cleanup_iterators(
+         spl, &merge_itor, num_branches, skip_itor_arr);
 
-   deinit_saved_pivots_in_scratch(scratch);
+      deinit_saved_pivots_in_scratch(scratch);
+   }
 
    /*
     * 11. For each newly split sibling replace bundle with new branch
@@ -5405,6 +6435,8 @@ trunk_compact_bundle(void *arg, void *scratch_buf)
       trunk_node_unget(spl->cc, &node);
    }
 
+   __sync_fetch_and_add(&spl->compaction_tuples_reclaimed,
+                        req->tuples_reclaimed);
    if (spl->cfg.use_stats) {
       if (req->type == TRUNK_COMPACTION_TYPE_SPACE_REC) {
          spl->stats[tid].space_rec_tuples_reclaimed[height] +=
@@ -5595,16 +6627,23 @@ trunk_split_index(trunk_handle             *spl,
 }
 
 /*
- * Estimate the number of unique keys in the pivot
+ * Estimate the number of unique keys in the pivot, from the union of the
+ * sketches of its filter and of the node's subbundle filters. If any of them
+ * was written without a sketch, count the unique fingerprints instead.
  */
 static inline uint64
 trunk_pivot_estimate_unique_keys(trunk_handle     *spl,
                                  trunk_node       *node,
                                  trunk_pivot_data *pdata)
 {
-   routing_filter filter[MAX_FILTERS];
-   uint64         filter_no = 0;
-   filter[filter_no++]      = pdata->filter;
+   routing_config *cfg = &spl->cfg.filter_cfg;
+   routing_filter  filter[MAX_FILTERS];
+   uint64          filter_no = 0;
+   filter[filter_no++]       = pdata->filter;
+   routing_sketch sketch;
+   ZERO_CONTENTS(&sketch);
+   bool32 have_sketches =
+      routing_filter_sketch_merge(spl->cc, cfg, &pdata->filter, &sketch);
 
    uint64 num_sb_fp     = 0;
    uint64 num_sb_unique = 0;
@@ -5616,13 +6655,21 @@ trunk_pivot_estimate_unique_keys(trunk_handle     *spl,
       num_sb_fp += sb_filter->num_fingerprints;
       num_sb_unique += sb_filter->num_unique;
       filter[filter_no++] = *sb_filter;
+      if (have_sketches) {
+         have_sketches =
+            routing_filter_sketch_merge(spl->cc, cfg, sb_filter, &sketch);
+      }
    }
 
-   uint32 num_unique = routing_filter_estimate_unique_fp(
-      spl->cc, &spl->cfg.filter_cfg, spl->heap_id, filter, filter_no);
-
-   num_unique = routing_filter_estimate_unique_keys_from_count(
-      &spl->cfg.filter_cfg, num_unique);
+   uint64 num_unique;
+   if (have_sketches) {
+      num_unique = routing_sketch_estimate_unique_keys(&sketch);
+   } else {
+      num_unique = routing_filter_estimate_unique_fp(
+         spl->cc, cfg, spl->heap_id, filter, filter_no);
+      num_unique =
+         routing_filter_estimate_unique_keys_from_count(cfg, num_unique);
+   }
 
    uint64 num_leaf_sb_fp = 0;
    for (uint16 bundle_no = pdata->start_bundle;
@@ -5635,7 +6682,7 @@ trunk_pivot_estimate_unique_keys(trunk_handle     *spl,
    uint64 est_num_leaf_sb_unique = num_sb_unique * num_leaf_sb_fp / num_sb_fp;
    uint64 est_num_non_leaf_sb_unique = num_sb_fp - est_num_leaf_sb_unique;
 
-   // platform_error_log("num_unique %u sb_fp %lu sb_unique %lu num_leaf_sb_fp
+   // platform_error_log("num_unique %lu sb_fp %lu sb_unique %lu num_leaf_sb_fp
    // %lu\n",
    //       num_unique, num_sb_fp, num_sb_unique, num_leaf_sb_fp);
    // platform_error_log("est_leaf_sb_fp %lu est_non_leaf_sb_unique %lu\n",
@@ -6215,6 +7262,15 @@ trunk_range_iterator_init(trunk_handle         *spl,
                       < ARRAY_SIZE(range_itor->branch));
          uint16 branch_no = trunk_subtract_branch_number(
             spl, trunk_end_branch(spl, &node), branch_offset + 1);
+         if (trunk_branch_is_whole(spl, &node, branch_no)
+             && !routing_filter_holds_value(
+                &pdata->filter,
+                trunk_subtract_branch_number(
+                   spl, branch_no, pdata->start_branch)))
+         {
+            // none of the pivot's keys, so none in range, are in the branch
+            continue;
+         }
          range_itor->branch[range_itor->num_branches] =
             *trunk_get_branch(spl, &node, branch_no);
          range_itor->compacted[range_itor->num_branches] = TRUE;
@@ -6279,13 +7335,16 @@ trunk_range_iterator_init(trunk_handle         *spl,
                                     start_type,
                                     do_prefetch,
                                     FALSE);
+         range_itor->itor[i] = &btree_itor->super;
       } else {
-         uint64 mt_root_addr = branch->root_addr;
-         bool32 is_live      = branch_no == 0;
-         trunk_memtable_iterator_init(
+         uint64    mt_gen  = range_itor->memtable_start_gen - branch_no;
+         memtable *mt      = trunk_get_memtable(spl, mt_gen);
+         bool32    is_live = branch_no == 0;
+         range_itor->itor[i] = trunk_memtable_iterator_init(
             spl,
+            mt,
             btree_itor,
-            mt_root_addr,
+            &range_itor->skiplist_itor[branch_no],
             key_buffer_key(&range_itor->local_min_key),
             key_buffer_key(&range_itor->local_max_key),
             start_key,
@@ -6293,7 +7352,6 @@ trunk_range_iterator_init(trunk_handle         *spl,
             is_live,
             FALSE);
       }
-      range_itor->itor[i] = &btree_itor->super;
    }
 
    platform_status rc = merge_iterator_create(spl->heap_id,
@@ -6509,8 +7567,10 @@ trunk_range_iterator_deinit(trunk_range_iterator *range_itor)
             trunk_branch_iterator_deinit(spl, btree_itor, FALSE);
             btree_unblock_dec_ref(spl->cc, &spl->cfg.btree_cfg, root_addr);
          } else {
-            uint64 mt_gen = range_itor->memtable_start_gen - i;
-            trunk_memtable_iterator_deinit(spl, btree_itor, mt_gen, FALSE);
+            uint64    mt_gen = range_itor->memtable_start_gen - i;
+            memtable *mt     = trunk_get_memtable(spl, mt_gen);
+            trunk_memtable_iterator_deinit(
+               spl, mt, btree_itor, &range_itor->skiplist_itor[i], FALSE);
             trunk_memtable_dec_ref(spl, mt_gen);
          }
       }
@@ -6752,6 +7812,7 @@ trunk_filter_lookup(trunk_handle      *spl,
                     routing_config    *cfg,
                     uint16             start_branch,
                     key                target,
+                    uint32             key_hash,
                     merge_accumulator *data)
 {
    uint16   height;
@@ -6762,8 +7823,8 @@ trunk_filter_lookup(trunk_handle      *spl,
    }
 
    uint64          found_values;
-   platform_status rc =
-      routing_filter_lookup(spl->cc, cfg, filter, target, &found_values);
+   platform_status rc = trunk_filter_lookup_hash(
+      spl, trunk_node_height(node), cfg, filter, key_hash, &found_values);
    platform_assert_status_ok(rc);
    if (spl->cfg.use_stats) {
       spl->stats[tid].filter_lookups[height]++;
@@ -6786,8 +7847,8 @@ trunk_filter_lookup(trunk_handle      *spl,
          if (message_is_definitive(msg)) {
             return FALSE;
          }
-      } else if (spl->cfg.use_stats) {
-         spl->stats[tid].filter_false_positives[height]++;
+      } else {
+         trunk_filter_false_positive(spl, trunk_node_height(node));
       }
       next_value = routing_filter_get_next_value(found_values, next_value);
    }
@@ -6799,6 +7860,7 @@ trunk_compacted_subbundle_lookup(trunk_handle      *spl,
                                  trunk_node        *node,
                                  trunk_subbundle   *sb,
                                  key                target,
+                                 uint32             key_hash,
                                  merge_accumulator *data)
 {
    debug_assert(sb->state == SB_STATE_COMPACTED);
@@ -6817,9 +7879,12 @@ trunk_compacted_subbundle_lookup(trunk_handle      *spl,
       }
       uint64          found_values;
       routing_filter *filter = trunk_subbundle_filter(spl, node, sb, filter_no);
-      debug_assert(filter->addr != 0);
-      platform_status rc = routing_filter_lookup(
-         spl->cc, &spl->cfg.filter_cfg, filter, target, &found_values);
+      platform_status rc = trunk_filter_lookup_hash(spl,
+                                                    trunk_node_height(node),
+                                                    &spl->cfg.filter_cfg,
+                                                    filter,
+                                                    key_hash,
+                                                    &found_values);
       platform_assert_status_ok(rc);
       if (found_values) {
          uint16          branch_no = sb->start_branch;
@@ -6837,8 +7902,8 @@ trunk_compacted_subbundle_lookup(trunk_handle      *spl,
             if (message_is_definitive(msg)) {
                return FALSE;
             }
-         } else if (spl->cfg.use_stats) {
-            spl->stats[tid].filter_false_positives[height]++;
+         } else {
+            trunk_filter_false_positive(spl, trunk_node_height(node));
          }
          return TRUE;
       }
@@ -6851,6 +7916,7 @@ trunk_bundle_lookup(trunk_handle      *spl,
                     trunk_node        *node,
                     trunk_bundle      *bundle,
                     key                target,
+                    uint32             key_hash,
                     merge_accumulator *data)
 {
    uint16 sb_count = trunk_bundle_subbundle_count(spl, node, bundle);
@@ -6860,14 +7926,13 @@ trunk_bundle_lookup(trunk_handle      *spl,
       trunk_subbundle *sb = trunk_get_subbundle(spl, node, sb_no);
       bool32           should_continue;
       if (sb->state == SB_STATE_COMPACTED) {
-         should_continue =
-            trunk_compacted_subbundle_lookup(spl, node, sb, target, data);
+         should_continue = trunk_compacted_subbundle_lookup(
+            spl, node, sb, target, key_hash, data);
       } else {
          routing_filter *filter = trunk_subbundle_filter(spl, node, sb, 0);
          routing_config *cfg    = &spl->cfg.filter_cfg;
-         debug_assert(filter->addr != 0);
          should_continue = trunk_filter_lookup(
-            spl, node, filter, cfg, sb->start_branch, target, data);
+            spl, node, filter, cfg, sb->start_branch, target, key_hash, data);
       }
       if (!should_continue) {
          return should_continue;
@@ -6881,6 +7946,7 @@ trunk_pivot_lookup(trunk_handle      *spl,
                    trunk_node        *node,
                    trunk_pivot_data  *pdata,
                    key                target,
+                   uint32             key_hash,
                    merge_accumulator *data)
 {
    // first check in bundles
@@ -6891,15 +7957,21 @@ trunk_pivot_lookup(trunk_handle      *spl,
       debug_assert(trunk_bundle_live(spl, node, bundle_no));
       trunk_bundle *bundle = trunk_get_bundle(spl, node, bundle_no);
       bool32        should_continue =
-         trunk_bundle_lookup(spl, node, bundle, target, data);
+         trunk_bundle_lookup(spl, node, bundle, target, key_hash, data);
       if (!should_continue) {
          return should_continue;
       }
    }
 
    routing_config *cfg = &spl->cfg.filter_cfg;
-   return trunk_filter_lookup(
-      spl, node, &pdata->filter, cfg, pdata->start_branch, target, data);
+   return trunk_filter_lookup(spl,
+                              node,
+                              &pdata->filter,
+                              cfg,
+                              pdata->start_branch,
+                              target,
+                              key_hash,
+                              data);
 }
 
 // If any change is made in here, please make similar change in
@@ -6938,6 +8010,9 @@ trunk_lookup(trunk_handle *spl, key target, merge_accumulator *result)
    // release memtable lookup lock
    memtable_end_lookup(spl->mt_ctxt);
 
+   // every filter on the way down is probed with the same hash
+   uint32 key_hash = routing_filter_hash(&spl->cfg.filter_cfg, target);
+
    // look in index nodes
    uint16 height = trunk_node_height(&node);
    for (uint16 h = height; h > 0; h--) {
@@ -6946,7 +8021,7 @@ trunk_lookup(trunk_handle *spl, key target, merge_accumulator *result)
       debug_assert(pivot_no < trunk_num_children(spl, &node));
       trunk_pivot_data *pdata = trunk_get_pivot_data(spl, &node, pivot_no);
       bool32            should_continue =
-         trunk_pivot_lookup(spl, &node, pdata, target, result);
+         trunk_pivot_lookup(spl, &node, pdata, target, key_hash, result);
       if (!should_continue) {
          goto found_final_answer_early;
       }
@@ -6959,7 +8034,7 @@ trunk_lookup(trunk_handle *spl, key target, merge_accumulator *result)
    // look in leaf
    trunk_pivot_data *pdata = trunk_get_pivot_data(spl, &node, 0);
    bool32            should_continue =
-      trunk_pivot_lookup(spl, &node, pdata, target, result);
+      trunk_pivot_lookup(spl, &node, pdata, target, key_hash, result);
    if (!should_continue) {
       goto found_final_answer_early;
    }
@@ -6997,6 +8072,143 @@ found_final_answer_early:
    return STATUS_OK;
 }
 
+/*
+ * Whether any filter the lookup of a key with key_hash would probe at pdata
+ * may contain it.
+ */
+static bool32
+trunk_pivot_may_contain(trunk_handle     *spl,
+                        trunk_node       *node,
+                        trunk_pivot_data *pdata,
+                        uint32            key_hash)
+{
+   uint16          height = trunk_node_height(node);
+   routing_config *cfg    = &spl->cfg.filter_cfg;
+   uint64          found_values;
+   platform_status rc;
+
+   uint16 num_bundles = trunk_pivot_bundle_count(spl, node, pdata);
+   for (uint16 bundle_off = 0; bundle_off != num_bundles; bundle_off++) {
+      uint16 bundle_no = trunk_subtract_bundle_number(
+         spl, trunk_end_bundle(spl, node), bundle_off + 1);
+      trunk_bundle *bundle   = trunk_get_bundle(spl, node, bundle_no);
+      uint16        sb_count = trunk_bundle_subbundle_count(spl, node, bundle);
+      for (uint16 sb_off = 0; sb_off != sb_count; sb_off++) {
+         uint16 sb_no = trunk_subtract_subbundle_number(
+            spl, bundle->end_subbundle, sb_off + 1);
+         trunk_subbundle *sb = trunk_get_subbundle(spl, node, sb_no);
+         uint16           filter_count =
+            sb->state == SB_STATE_COMPACTED
+               ? trunk_subbundle_filter_count(spl, node, sb)
+               : 1;
+         for (uint16 filter_no = 0; filter_no != filter_count; filter_no++) {
+            routing_filter *filter =
+               trunk_subbundle_filter(spl, node, sb, filter_no);
+            rc = trunk_filter_lookup_hash(
+               spl, height, cfg, filter, key_hash, &found_values);
+            platform_assert_status_ok(rc);
+            if (found_values) {
+               return TRUE;
+            }
+         }
+      }
+   }
+
+   rc = trunk_filter_lookup_hash(
+      spl, height, cfg, &pdata->filter, key_hash, &found_values);
+   platform_assert_status_ok(rc);
+   return found_values != 0;
+}
+
+/*
+ * Returns FALSE if target is certainly absent, TRUE if it may be present.
+ *
+ * Looks in the memtables as trunk_lookup does, except that a compacted
+ * memtable is only checked against its index and filter. Below the
+ * memtables, only the routing filters along target's path are probed, so no
+ * branch page is read. A TRUE answer may be followed by trunk_lookup.
+ */
+bool32
+trunk_may_contain(trunk_handle *spl, key target)
+{
+   merge_accumulator result;
+   bool32            may_contain = FALSE;
+   merge_accumulator_init(&result, spl->heap_id);
+
+   memtable_begin_lookup(spl->mt_ctxt);
+   uint64 mt_gen_start = memtable_generation(spl->mt_ctxt);
+   uint64 mt_gen_end   = memtable_generation_retired(spl->mt_ctxt);
+   platform_assert(mt_gen_start - mt_gen_end <= TRUNK_NUM_MEMTABLES);
+
+   for (uint64 mt_gen = mt_gen_start; mt_gen != mt_gen_end; mt_gen--) {
+      memtable *mt = trunk_get_memtable(spl, mt_gen);
+      platform_assert(memtable_ok_to_lookup(mt));
+      if (memtable_ok_to_lookup_compacted(mt)) {
+         if (!memtable_may_contain(mt, target)) {
+            continue;
+         }
+         trunk_compacted_memtable *cmt =
+            trunk_get_compacted_memtable(spl, mt_gen);
+         routing_config *cfg      = &spl->cfg.filter_cfg;
+         uint32          key_hash = routing_filter_hash(cfg, target);
+         uint64          found_values;
+         platform_status rc = routing_filter_lookup_hash(
+            spl->cc, cfg, &cmt->filter, key_hash, &found_values);
+         platform_assert_status_ok(rc);
+         if (found_values) {
+            may_contain = TRUE;
+            memtable_end_lookup(spl->mt_ctxt);
+            goto out;
+         }
+         continue;
+      }
+      platform_status rc = memtable_lookup(spl->mt_ctxt, mt, target, &result);
+      platform_assert_status_ok(rc);
+      if (!merge_accumulator_is_null(&result)) {
+         // the newest message decides: a delete is definite, anything else
+         // may leave the key present
+         may_contain =
+            merge_accumulator_message_class(&result) != MESSAGE_TYPE_DELETE;
+         memtable_end_lookup(spl->mt_ctxt);
+         goto out;
+      }
+   }
+
+   trunk_node node;
+   trunk_root_get(spl, &node);
+
+   // release memtable lookup lock
+   memtable_end_lookup(spl->mt_ctxt);
+
+   uint32 key_hash = routing_filter_hash(&spl->cfg.filter_cfg, target);
+
+   // index nodes, then the leaf
+   uint16 height = trunk_node_height(&node);
+   for (uint16 h = height; h > 0; h--) {
+      uint16 pivot_no =
+         trunk_find_pivot(spl, &node, target, less_than_or_equal);
+      debug_assert(pivot_no < trunk_num_children(spl, &node));
+      trunk_pivot_data *pdata = trunk_get_pivot_data(spl, &node, pivot_no);
+      if (trunk_pivot_may_contain(spl, &node, pdata, key_hash)) {
+         may_contain = TRUE;
+         goto unget;
+      }
+      trunk_node child;
+      trunk_node_get(spl->cc, pdata->addr, &child);
+      trunk_node_unget(spl->cc, &node);
+      node = child;
+   }
+
+   trunk_pivot_data *pdata = trunk_get_pivot_data(spl, &node, 0);
+   may_contain = trunk_pivot_may_contain(spl, &node, pdata, key_hash);
+
+unget:
+   trunk_node_unget(spl->cc, &node);
+out:
+   merge_accumulator_deinit(&result);
+   return may_contain;
+}
+
 /*
  * trunk_async_set_state sets the state of the async splinter
  * lookup state machine.
@@ -7155,6 +8367,8 @@ trunk_lookup_async(trunk_handle      *spl,    // IN
             if (ctxt->state == async_state_found_final_answer_early) {
                break;
             }
+            ctxt->key_hash =
+               routing_filter_hash(trunk_routing_cfg(spl), target);
             // fallthrough
          }
          case async_state_get_root_reentrant:
@@ -7252,6 +8466,16 @@ trunk_lookup_async(trunk_handle      *spl,    // IN
             if (spl->cfg.use_stats) {
                spl->stats[tid].filter_lookups[ctxt->height]++;
             }
+            // a decoded filter is probed without going async
+            if (trunk_filter_is_cached(spl, ctxt->height)
+                && routing_filter_cache_lookup(spl->filter_cache,
+                                               ctxt->filter,
+                                               ctxt->key_hash,
+                                               &ctxt->found_values))
+            {
+               trunk_async_set_state(ctxt, async_state_btree_lookup_start);
+               break;
+            }
             routing_filter_ctxt_init(&ctxt->filter_ctxt,
                                      &ctxt->cache_ctxt,
                                      trunk_filter_async_callback);
@@ -7279,7 +8503,7 @@ trunk_lookup_async(trunk_handle      *spl,    // IN
             res = trunk_filter_lookup_async(spl,
                                             filter_cfg,
                                             ctxt->filter,
-                                            target,
+                                            ctxt->key_hash,
                                             &ctxt->found_values,
                                             &ctxt->filter_ctxt);
             switch (res) {
@@ -7395,9 +8619,8 @@ trunk_lookup_async(trunk_handle      *spl,    // IN
                      trunk_node_unget(spl->cc, &ctxt->trunk_node);
                      ZERO_CONTENTS(&ctxt->trunk_node);
                      break;
-                  } else if (spl->cfg.use_stats) {
-                     const uint16 height = trunk_node_height(node);
-                     spl->stats[tid].filter_false_positives[height]++;
+                  } else {
+                     trunk_filter_false_positive(spl, trunk_node_height(node));
                   }
                   trunk_async_set_state(ctxt, async_state_next_in_node);
                   break;
@@ -7670,6 +8893,12 @@ trunk_create(trunk_config     *cfg,
       spl->log = log_create(cc, spl->cfg.log_cfg, spl->heap_id);
    }
 
+   // without the decoded filter cache, filters are probed on their pages
+   if (spl->cfg.filter_cache_size != 0) {
+      spl->filter_cache =
+         routing_filter_cache_create(spl->heap_id, spl->cfg.filter_cache_size);
+   }
+
    // ALEX: For now we assume an init means destroying any present super blocks
    trunk_set_super_block(spl, FALSE, FALSE, TRUE);
 
@@ -7758,9 +8987,10 @@ trunk_mount(trunk_config     *cfg,
    if (super != NULL) {
       if (super->unmounted && super->timestamp > latest_timestamp) {
          spl->root_addr    = super->root_addr;
-         spl->next_node_id = super->next_node_id;
-         meta_tail         = super->meta_tail;
-         latest_timestamp  = super->timestamp;
+         spl->next_node_id   = super->next_node_id;
+         spl->value_log_addr = super->value_log_addr;
+         meta_tail           = super->meta_tail;
+         latest_timestamp    = super->timestamp;
       }
       trunk_release_super_block(spl, super_page);
    }
@@ -7794,6 +9024,10 @@ trunk_mount(trunk_config     *cfg,
    if (spl->cfg.use_log) {
       spl->log = log_create(cc, spl->cfg.log_cfg, spl->heap_id);
    }
+   if (spl->cfg.filter_cache_size != 0) {
+      spl->filter_cache =
+         routing_filter_cache_create(spl->heap_id, spl->cfg.filter_cache_size);
+   }
 
    trunk_set_super_block(spl, FALSE, FALSE, FALSE);
 
@@ -7911,6 +9145,9 @@ trunk_destroy(trunk_handle *spl)
    mini_unkeyed_dec_ref(spl->cc, spl->mini.meta_head, PAGE_TYPE_TRUNK, FALSE);
    // clear out this splinter table from the meta page.
    allocator_remove_super_addr(spl->al, spl->id);
+   if (spl->filter_cache != NULL) {
+      routing_filter_cache_destroy(spl->filter_cache);
+   }
 
    if (spl->cfg.use_stats) {
       for (uint64 i = 0; i < MAX_THREADS; i++) {
@@ -7937,6 +9174,9 @@ trunk_unmount(trunk_handle **spl_in)
    srq_deinit(&spl->srq);
    trunk_prepare_for_shutdown(spl);
    trunk_set_super_block(spl, FALSE, TRUE, FALSE);
+   if (spl->filter_cache != NULL) {
+      routing_filter_cache_destroy(spl->filter_cache);
+   }
    if (spl->cfg.use_stats) {
       for (uint64 i = 0; i < MAX_THREADS; i++) {
          platform_histo_destroy(spl->heap_id,
@@ -8755,12 +9995,20 @@ trunk_print_memtable(platform_log_handle *log_handle, trunk_handle *spl)
    uint64 mt_gen_end   = memtable_generation_retired(spl->mt_ctxt);
    for (uint64 mt_gen = mt_gen_start; mt_gen != mt_gen_end; mt_gen--) {
       memtable *mt = trunk_get_memtable(spl, mt_gen);
-      platform_log(log_handle,
-                   "Memtable root_addr=%lu: gen %lu ref_count %u state %d\n",
-                   mt->root_addr,
-                   mt_gen,
-                   allocator_get_refcount(spl->al, mt->root_addr),
-                   mt->state);
+      if (memtable_is_skiplist(mt)) {
+         platform_log(log_handle,
+                      "Memtable skiplist: gen %lu ref_count %lu state %d\n",
+                      mt_gen,
+                      mt->ref_count,
+                      mt->state);
+      } else {
+         platform_log(log_handle,
+                      "Memtable root_addr=%lu: gen %lu ref_count %u state %d\n",
+                      mt->root_addr,
+                      mt_gen,
+                      allocator_get_refcount(spl->al, mt->root_addr),
+                      mt->state);
+      }
 
       memtable_print(log_handle, spl->cc, mt);
    }
@@ -8800,6 +10048,7 @@ trunk_print_super_block(platform_log_handle *log_handle, trunk_handle *spl)
                 super->meta_tail,
                 super->meta_tail,
                 super->log_meta_addr);
+   platform_log(log_handle, "value_log_addr=%lu\n", super->value_log_addr);
    platform_log(log_handle,
                 "timestamp=%lu, checkpointed=%d, unmounted=%d\n",
                 super->timestamp,
@@ -8874,6 +10123,7 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
          global->compactions_discarded_flushed[h]    += spl->stats[thr_i].compactions_discarded_flushed[h];
          global->compactions_discarded_leaf_split[h] += spl->stats[thr_i].compactions_discarded_leaf_split[h];
          global->compactions_empty[h]                += spl->stats[thr_i].compactions_empty[h];
+         global->compactions_partitioned[h]          += spl->stats[thr_i].compactions_partitioned[h];
          global->compaction_tuples[h]                += spl->stats[thr_i].compaction_tuples[h];
          if (spl->stats[thr_i].compaction_max_tuples[h] > global->compaction_max_tuples[h]) {
             global->compaction_max_tuples[h] = spl->stats[thr_i].compaction_max_tuples[h];
@@ -8902,6 +10152,7 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
          }
 
          global->filters_built[h]                    += spl->stats[thr_i].filters_built[h];
+         global->filters_built_by_tasks[h]           += spl->stats[thr_i].filters_built_by_tasks[h];
          global->filter_tuples[h]                    += spl->stats[thr_i].filter_tuples[h];
          global->filter_time_ns[h]                   += spl->stats[thr_i].filter_time_ns[h];
 
@@ -8914,6 +10165,8 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
       global->updates                     += spl->stats[thr_i].updates;
       global->deletions                   += spl->stats[thr_i].deletions;
       global->discarded_deletes           += spl->stats[thr_i].discarded_deletes;
+      global->bulk_load_branches          += spl->stats[thr_i].bulk_load_branches;
+      global->bulk_load_tuples            += spl->stats[thr_i].bulk_load_tuples;
 
       global->memtable_flushes            += spl->stats[thr_i].memtable_flushes;
       global->memtable_flush_wait_time_ns += spl->stats[thr_i].memtable_flush_wait_time_ns;
@@ -8965,6 +10218,8 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
    platform_log(log_handle, "| updates:           %10lu\n", global->updates);
    platform_log(log_handle, "| deletions:         %10lu\n", global->deletions);
    platform_log(log_handle, "| completed deletes: %10lu\n", global->discarded_deletes);
+   platform_log(log_handle, "| bulk loaded:       %10lu\n", global->bulk_load_tuples);
+   platform_log(log_handle, "| loaded branches:   %10lu\n", global->bulk_load_branches);
    platform_log(log_handle, "------------------------------------------------------------------------------------\n");
    platform_log(log_handle, "| root stalls:       %10lu\n", global->memtable_flush_root_full);
    platform_log(log_handle, "------------------------------------------------------------------------------------\n");
@@ -9015,9 +10270,9 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
    platform_log(log_handle, "\n");
 
    platform_log(log_handle, "Compaction Statistics\n");
-   platform_log(log_handle, "------------------------------------------------------------------------------------------------------------------------------------------\n");
-   platform_log(log_handle, "  height | compactions | avg setup time (ns) | time / tuple (ns) | avg tuples | max tuples | max time (ns) | empty | aborted | discarded |\n");
-   platform_log(log_handle, "---------|-------------|---------------------|-------------------|------------|------------|---------------|-------|---------|-----------|\n");
+   platform_log(log_handle, "-----------------------------------------------------------------------------------------------------------------------------------------------------\n");
+   platform_log(log_handle, "  height | compactions | avg setup time (ns) | time / tuple (ns) | avg tuples | max tuples | max time (ns) | empty | aborted | discarded | parallel |\n");
+   platform_log(log_handle, "---------|-------------|---------------------|-------------------|------------|------------|---------------|-------|---------|-----------|----------|\n");
 
    avg_setup_time = global->root_compactions == 0 ? 0
       : (global->root_compaction_time_ns - global->root_compaction_pack_time_ns)
@@ -9026,10 +10281,10 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
       : global->root_compaction_tuples / global->root_compactions;
    pack_time_per_tuple = global->root_compaction_tuples == 0 ? 0
       : global->root_compaction_pack_time_ns / global->root_compaction_tuples;
-   platform_log(log_handle, "    root | %11lu | %19lu | %17lu | %10lu | %10lu | %13lu | %5lu | %2lu | %2lu | %3lu | %3lu |\n",
+   platform_log(log_handle, "    root | %11lu | %19lu | %17lu | %10lu | %10lu | %13lu | %5lu | %2lu | %2lu | %3lu | %3lu | %8lu |\n",
          global->root_compactions, avg_setup_time, pack_time_per_tuple,
          avg_compaction_tuples, global->root_compaction_max_tuples,
-         global->root_compaction_time_max_ns, 0UL, 0UL, 0UL, 0UL, 0UL);
+         global->root_compaction_time_max_ns, 0UL, 0UL, 0UL, 0UL, 0UL, 0UL);
    for (h = 1; h <= height; h++) {
       rev_h = height - h;
       avg_setup_time = global->compactions[rev_h] == 0 ? 0
@@ -9040,14 +10295,15 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
          : global->compaction_tuples[rev_h] / global->compactions[rev_h];
       pack_time_per_tuple = global->compaction_tuples[rev_h] == 0 ? 0
          : global->compaction_pack_time_ns[rev_h] / global->compaction_tuples[rev_h];
-      platform_log(log_handle, "%8u | %11lu | %19lu | %17lu | %10lu | %10lu | %13lu | %5lu | %2lu | %2lu | %3lu | %3lu |\n",
+      platform_log(log_handle, "%8u | %11lu | %19lu | %17lu | %10lu | %10lu | %13lu | %5lu | %2lu | %2lu | %3lu | %3lu | %8lu |\n",
             rev_h, global->compactions[rev_h], avg_setup_time, pack_time_per_tuple,
             avg_compaction_tuples, global->compaction_max_tuples[rev_h],
             global->compaction_time_max_ns[rev_h], global->compactions_empty[rev_h],
             global->compactions_aborted_flushed[rev_h], global->compactions_aborted_leaf_split[rev_h],
-            global->compactions_discarded_flushed[rev_h], global->compactions_discarded_leaf_split[rev_h]);
+            global->compactions_discarded_flushed[rev_h], global->compactions_discarded_leaf_split[rev_h],
+            global->compactions_partitioned[rev_h]);
    }
-   platform_log(log_handle, "------------------------------------------------------------------------------------------------------------------------------------------\n");
+   platform_log(log_handle, "-----------------------------------------------------------------------------------------------------------------------------------------------------\n");
    platform_log(log_handle, "\n");
 
    if (global->leaf_splits == 0) {
@@ -9076,9 +10332,9 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
    platform_log(log_handle, "\n");
 
    platform_log(log_handle, "Filter Build Statistics\n");
-   platform_log(log_handle, "---------------------------------------------------------------------------------\n");
-   platform_log(log_handle, "| height |   built | avg tuples | avg build time (ns) | build_time / tuple (ns) |\n");
-   platform_log(log_handle, "---------|---------|------------|---------------------|-------------------------|\n");
+   platform_log(log_handle, "--------------------------------------------------------------------------------------------\n");
+   platform_log(log_handle, "| height |   built | by tasks | avg tuples | avg build time (ns) | build_time / tuple (ns) |\n");
+   platform_log(log_handle, "---------|---------|----------|------------|---------------------|-------------------------|\n");
 
    avg_filter_tuples = global->root_filters_built == 0 ? 0 :
       global->root_filter_tuples / global->root_filters_built;
@@ -9087,8 +10343,8 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
    filter_time_per_tuple = global->root_filter_tuples == 0 ? 0 :
       global->root_filter_time_ns / global->root_filter_tuples;
 
-   platform_log(log_handle, "|   root | %7lu | %10lu | %19lu | %23lu |\n",
-         global->root_filters_built, avg_filter_tuples,
+   platform_log(log_handle, "|   root | %7lu | %8lu | %10lu | %19lu | %23lu |\n",
+         global->root_filters_built, 0UL, avg_filter_tuples,
          avg_filter_time, filter_time_per_tuple);
    for (h = 1; h <= height; h++) {
       rev_h = height - h;
@@ -9098,11 +10354,12 @@ trunk_print_insertion_stats(platform_log_handle *log_handle, trunk_handle *spl)
          global->filter_time_ns[rev_h] / global->filters_built[rev_h];
       filter_time_per_tuple = global->filter_tuples[rev_h] == 0 ? 0 :
          global->filter_time_ns[rev_h] / global->filter_tuples[rev_h];
-      platform_log(log_handle, "| %6u | %7lu | %10lu | %19lu | %23lu |\n",
-            rev_h, global->filters_built[rev_h], avg_filter_tuples,
+      platform_log(log_handle, "| %6u | %7lu | %8lu | %10lu | %19lu | %23lu |\n",
+            rev_h, global->filters_built[rev_h],
+            global->filters_built_by_tasks[rev_h], avg_filter_tuples,
             avg_filter_time, filter_time_per_tuple);
    }
-   platform_log(log_handle, "--------------------------------------------------------------------------------|\n");
+   platform_log(log_handle, "-------------------------------------------------------------------------------------------|\n");
    platform_log(log_handle, "\n");
 
    platform_log(log_handle, "Space Reclamation Statistics\n");
@@ -9212,6 +10469,19 @@ trunk_print_lookup_stats(platform_log_handle *log_handle, trunk_handle *spl)
    }
    platform_log(log_handle, "------------------------------------------------------------------------------------|\n");
    platform_log(log_handle, "\n");
+
+   if (spl->filter_cache != NULL) {
+      routing_filter_cache_stats fcache_stats;
+      routing_filter_cache_get_stats(spl->filter_cache, &fcache_stats);
+      platform_log(log_handle, "Filter Cache Statistics\n");
+      platform_log(log_handle, "-----------------------------------------------------------------------------------\n");
+      platform_log(log_handle, "| hits:              %lu\n", fcache_stats.hits);
+      platform_log(log_handle, "| decodes:           %lu\n", fcache_stats.decodes);
+      platform_log(log_handle, "| uncached probes:   %lu\n", fcache_stats.uncached);
+      platform_log(log_handle, "| evictions:         %lu\n", fcache_stats.evictions);
+      platform_log(log_handle, "-----------------------------------------------------------------------------------\n");
+      platform_log(log_handle, "\n");
+   }
    platform_free(spl->heap_id, global);
    platform_log(log_handle, "------------------------------------------------------------------------------------\n");
    cache_print_stats(log_handle, spl->cc);
@@ -9236,8 +10506,29 @@ trunk_print_lookup(trunk_handle        *spl,
       bool32 memtable_is_compacted;
       uint64 root_addr = trunk_memtable_root_addr_for_lookup(
          spl, mt_gen, &memtable_is_compacted);
+      memtable       *mt = trunk_get_memtable(spl, mt_gen);
       platform_status rc;
 
+      if (!memtable_is_compacted && memtable_is_skiplist(mt)) {
+         merge_accumulator_set_to_null(&data);
+         rc = memtable_lookup(spl->mt_ctxt, mt, target, &data);
+         platform_assert_status_ok(rc);
+         if (!merge_accumulator_is_null(&data)) {
+            char    key_str[128];
+            char    message_str[128];
+            message msg = merge_accumulator_to_message(&data);
+            trunk_key_to_string(spl, target, key_str);
+            trunk_message_to_string(spl, msg, message_str);
+            platform_log_stream(
+               &stream,
+               "Key %s found in skiplist memtable (gen %lu) with data %s\n",
+               key_str,
+               mt_gen,
+               message_str);
+         }
+         continue;
+      }
+
       rc = btree_lookup(spl->cc,
                         &spl->cfg.btree_cfg,
                         root_addr,
@@ -9267,6 +10558,8 @@ trunk_print_lookup(trunk_handle        *spl,
       }
    }
 
+   uint32 key_hash = routing_filter_hash(&spl->cfg.filter_cfg, target);
+
    trunk_node node;
    trunk_node_get(spl->cc, spl->root_addr, &node);
    uint16 height = trunk_node_height(&node);
@@ -9277,7 +10570,7 @@ trunk_print_lookup(trunk_handle        *spl,
       debug_assert(pivot_no < trunk_num_children(spl, &node));
       trunk_pivot_data *pdata = trunk_get_pivot_data(spl, &node, pivot_no);
       merge_accumulator_set_to_null(&data);
-      trunk_pivot_lookup(spl, &node, pdata, target, &data);
+      trunk_pivot_lookup(spl, &node, pdata, target, key_hash, &data);
       if (!merge_accumulator_is_null(&data)) {
          char key_str[128];
          char message_str[128];
@@ -9330,7 +10623,7 @@ trunk_print_lookup(trunk_handle        *spl,
    trunk_print_locked_node(Platform_default_log_handle, spl, &node);
    trunk_pivot_data *pdata = trunk_get_pivot_data(spl, &node, 0);
    merge_accumulator_set_to_null(&data);
-   trunk_pivot_lookup(spl, &node, pdata, target, &data);
+   trunk_pivot_lookup(spl, &node, pdata, target, key_hash, &data);
    if (!merge_accumulator_is_null(&data)) {
       char key_str[128];
       char message_str[128];
@@ -9671,6 +10964,9 @@ trunk_config_init(trunk_config        *trunk_cfg,
    filter_cfg->index_size     = filter_index_size;
    filter_cfg->seed           = 42;
    filter_cfg->hash           = trunk_cfg->data_cfg->key_hash;
+   if (data_fixed_key_is_word_sized(trunk_cfg->data_cfg->fixed_key_size)) {
+      filter_cfg->hash = data_fixed_key_hash;
+   }
    filter_cfg->data_cfg       = trunk_cfg->data_cfg;
    filter_cfg->log_index_size = 31 - __builtin_clz(filter_cfg->index_size);
 
@@ -9727,6 +11023,12 @@ trunk_config_init(trunk_config        *trunk_cfg,
       filter_cfg->index_size *= 2;
       filter_cfg->log_index_size++;
    }
+
+   trunk_cfg->bloom_filter_cfg                    = *filter_cfg;
+   trunk_cfg->bloom_filter_cfg.family             = ROUTING_FILTER_BLOOM;
+   trunk_cfg->bloom_filter_cfg.bloom_bits_per_key =
+      ROUTING_BLOOM_DEFAULT_BITS_PER_KEY;
+
    // When everything succeeds, return success.
    return STATUS_OK;
 }
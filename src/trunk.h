@@ -43,6 +43,13 @@ _Static_assert(TRUNK_MAX_HEIGHT == MINI_MAX_BATCHES,
  */
 #define TRUNK_RANGE_ITOR_MAX_BRANCHES 256
 
+/*
+ * At any time, one Memtable is "active" for inserts / updates.
+ * At any time, the most # of Memtables that can be active or in one of these
+ * states, such as, compaction, incorporation, reclamation, is given by this
+ * limit.
+ */
+#define TRUNK_NUM_MEMTABLES (4)
 
 /*
  *----------------------------------------------------------------------
@@ -68,6 +75,16 @@ typedef struct trunk_config {
    memtable_config mt_cfg;
    btree_config    btree_cfg;
    routing_config  filter_cfg;
+   // filters of nodes at the heights in bloom_filter_heights (bit 0 is the
+   // leaves) are built from scratch with bloom_filter_cfg
+   routing_config  bloom_filter_cfg;
+   uint64          bloom_filter_heights;
+   // filters of nodes at the heights in filter_cache_heights are decoded
+   // into a cache of filter_cache_size bytes (0 for none) and probed there
+   uint64          filter_cache_size;
+   uint64          filter_cache_heights;
+   // size fingerprints by height, see trunk_filter_fingerprint_size
+   bool32          filter_adaptive_fingerprints;
    data_config    *data_cfg;
    bool32          use_log;
    log_config     *log_cfg;
@@ -111,6 +128,7 @@ typedef struct trunk_stats {
    uint64 compactions_discarded_flushed[TRUNK_MAX_HEIGHT];
    uint64 compactions_discarded_leaf_split[TRUNK_MAX_HEIGHT];
    uint64 compactions_empty[TRUNK_MAX_HEIGHT];
+   uint64 compactions_partitioned[TRUNK_MAX_HEIGHT];
    uint64 compaction_tuples[TRUNK_MAX_HEIGHT];
    uint64 compaction_max_tuples[TRUNK_MAX_HEIGHT];
    uint64 compaction_time_ns[TRUNK_MAX_HEIGHT];
@@ -125,6 +143,9 @@ typedef struct trunk_stats {
    uint64 root_compaction_time_ns;
    uint64 root_compaction_time_max_ns;
 
+   uint64 bulk_load_branches;
+   uint64 bulk_load_tuples;
+
    uint64 discarded_deletes;
    uint64 index_splits;
    uint64 leaf_splits;
@@ -140,6 +161,7 @@ typedef struct trunk_stats {
    uint64 root_filter_tuples;
    uint64 root_filter_time_ns;
    uint64 filters_built[TRUNK_MAX_HEIGHT];
+   uint64 filters_built_by_tasks[TRUNK_MAX_HEIGHT];
    uint64 filter_tuples[TRUNK_MAX_HEIGHT];
    uint64 filter_time_ns[TRUNK_MAX_HEIGHT];
 
@@ -186,7 +208,11 @@ struct trunk_handle {
    platform_batch_rwlock trunk_root_lock;
 
    // space reclamation
-   uint64 est_tuples_in_compaction;
+   uint64          est_tuples_in_compaction;
+   volatile uint64 compaction_tuples_reclaimed;
+
+   // the value log of splinterdb.c, recorded in the super block
+   uint64 value_log_addr;
 
    // allocator/cache/log
    allocator     *al;
@@ -194,6 +220,9 @@ struct trunk_handle {
    log_handle    *log;
    mini_allocator mini;
 
+   // decoded filters, see trunk_filter_is_cached
+   routing_filter_cache *filter_cache;
+
    // memtables
    allocator_root_id id;
    memtable_context *mt_ctxt;
@@ -216,6 +245,19 @@ struct trunk_handle {
       uint64 counter;
    } PLATFORM_CACHELINE_ALIGNED task_countup[MAX_THREADS];
 
+   /*
+    * Per thread counts, by height, of the filters built and the false
+    * positives of their probes, which size the fingerprints of new filters
+    * when cfg.filter_adaptive_fingerprints is set.
+    */
+   struct {
+      uint64 filters[TRUNK_MAX_HEIGHT];
+      uint64 fingerprints[TRUNK_MAX_HEIGHT];
+      uint64 false_positives[TRUNK_MAX_HEIGHT];
+   } PLATFORM_CACHELINE_ALIGNED filter_feedback[MAX_THREADS];
+   // last fingerprint size given to the filters of each height, or 0
+   uint32 fingerprint_size[TRUNK_MAX_HEIGHT];
+
    // space rec queue
    srq srq;
 
@@ -241,6 +283,10 @@ typedef struct trunk_range_iterator {
    btree_iterator  btree_itor[TRUNK_RANGE_ITOR_MAX_BRANCHES];
    trunk_branch    branch[TRUNK_RANGE_ITOR_MAX_BRANCHES];
 
+   // iterators over uncompacted skiplist memtables, which are the first
+   // num_memtable_branches branches
+   skiplist_iterator skiplist_itor[TRUNK_NUM_MEMTABLES];
+
    // used for merge iterator construction
    iterator *itor[TRUNK_RANGE_ITOR_MAX_BRANCHES];
 } trunk_range_iterator;
@@ -294,6 +340,7 @@ typedef struct trunk_async_ctxt {
    // These fields are internal
    trunk_async_state prev_state; // state machine's previous state
    trunk_async_state state;      // state machine's current state
+   uint32            key_hash;   // routing_filter_hash of the key
    trunk_node        trunk_node; // Current trunk node
    uint16            height;     // height of trunk_node
 
@@ -334,9 +381,15 @@ typedef struct trunk_async_ctxt {
 platform_status
 trunk_insert(trunk_handle *spl, key tuple_key, message data);
 
+platform_status
+trunk_bulk_load(trunk_handle *spl, iterator *itor);
+
 platform_status
 trunk_lookup(trunk_handle *spl, key target, merge_accumulator *result);
 
+bool32
+trunk_may_contain(trunk_handle *spl, key target);
+
 static inline bool32
 trunk_lookup_found(merge_accumulator *result)
 {
@@ -0,0 +1,567 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ *-----------------------------------------------------------------------------
+ * value_log.c --
+ *
+ *     This file contains the implementation of the value log.
+ *-----------------------------------------------------------------------------
+ */
+
+#include "platform.h"
+
+#include "value_log.h"
+#include "allocator.h"
+
+#include "poison.h"
+
+#define VALUE_LOG_INITIAL_CAPACITY 16
+
+/* a thread which was outside any reader section when an extent was retired */
+#define VALUE_LOG_QUIESCENT UINT64_MAX
+
+/*
+ * Header of a page listing the extents of an unmounted log: Disk-resident
+ * structure. The value_log_extents follow it.
+ */
+typedef struct ONDISK value_log_meta_hdr {
+   uint64 next_addr;
+   uint64 num_entries;
+} value_log_meta_hdr;
+
+static inline uint64
+value_log_page_size(value_log *vlog)
+{
+   return cache_config_page_size(vlog->cfg->cache_cfg);
+}
+
+static inline uint64
+value_log_extent_size(value_log *vlog)
+{
+   return cache_config_extent_size(vlog->cfg->cache_cfg);
+}
+
+static inline uint64
+value_log_base_addr(value_log *vlog, uint64 addr)
+{
+   return allocator_config_extent_base_addr(allocator_get_config(vlog->al),
+                                            addr);
+}
+
+static inline value_log_extent *
+value_log_get_extent(value_log *vlog, uint64 idx)
+{
+   return &vlog->extents[(vlog->oldest + idx) % vlog->capacity];
+}
+
+void
+value_log_config_init(value_log_config *cfg,
+                      cache_config     *cache_cfg,
+                      uint64            threshold,
+                      uint64            gc_garbage_percent)
+{
+   ZERO_CONTENTS(cfg);
+   cfg->cache_cfg          = cache_cfg;
+   cfg->threshold          = threshold;
+   cfg->gc_garbage_percent = gc_garbage_percent;
+}
+
+platform_status
+value_log_init(value_log        *vlog,
+               value_log_config *cfg,
+               cache            *cc,
+               platform_heap_id  hid)
+{
+   ZERO_CONTENTS(vlog);
+   vlog->cc       = cc;
+   vlog->al       = cache_get_allocator(cc);
+   vlog->cfg      = cfg;
+   vlog->heap_id  = hid;
+   vlog->capacity = VALUE_LOG_INITIAL_CAPACITY;
+   vlog->extents =
+      TYPED_ARRAY_MALLOC(vlog->heap_id, vlog->extents, vlog->capacity);
+   if (vlog->extents == NULL) {
+      return STATUS_NO_MEMORY;
+   }
+
+   platform_mutex_init(&vlog->lock, platform_get_module_id(), vlog->heap_id);
+   platform_mutex_init(
+      &vlog->gc_lock, platform_get_module_id(), vlog->heap_id);
+   for (uint64 i = 0; i < VALUE_LOG_KEY_LOCKS; i++) {
+      platform_mutex_init(
+         &vlog->key_lock[i], platform_get_module_id(), vlog->heap_id);
+   }
+   return STATUS_OK;
+}
+
+static void
+value_log_deinit(value_log *vlog)
+{
+   platform_mutex_destroy(&vlog->lock);
+   platform_mutex_destroy(&vlog->gc_lock);
+   for (uint64 i = 0; i < VALUE_LOG_KEY_LOCKS; i++) {
+      platform_mutex_destroy(&vlog->key_lock[i]);
+   }
+   platform_free(vlog->heap_id, vlog->extents);
+}
+
+/*
+ * Appends an extent to the ring, growing it if needed. Called with the lock
+ * held, or before the log is shared.
+ */
+static platform_status
+value_log_push_extent(value_log *vlog, uint64 addr, uint64 fill)
+{
+   if (vlog->num_extents == vlog->capacity) {
+      uint64            capacity = 2 * vlog->capacity;
+      value_log_extent *extents =
+         TYPED_ARRAY_MALLOC(vlog->heap_id, extents, capacity);
+      if (extents == NULL) {
+         return STATUS_NO_MEMORY;
+      }
+      for (uint64 i = 0; i < vlog->num_extents; i++) {
+         extents[i] = *value_log_get_extent(vlog, i);
+      }
+      platform_free(vlog->heap_id, vlog->extents);
+      vlog->extents  = extents;
+      vlog->capacity = capacity;
+      vlog->oldest   = 0;
+   }
+   value_log_extent *extent = value_log_get_extent(vlog, vlog->num_extents);
+   extent->addr             = addr;
+   extent->fill             = fill;
+   vlog->num_extents++;
+   return STATUS_OK;
+}
+
+static void
+value_log_free_extent(value_log *vlog, uint64 addr)
+{
+   uint8 ref = allocator_dec_ref(vlog->al, addr, PAGE_TYPE_LOG);
+   platform_assert(ref == AL_NO_REFS);
+   cache_extent_discard(vlog->cc, addr, PAGE_TYPE_LOG);
+   ref = allocator_dec_ref(vlog->al, addr, PAGE_TYPE_LOG);
+   platform_assert(ref == AL_FREE);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * value_log_mount --
+ *
+ *      Mounts the log unmounted to meta_addr, see value_log_unmount. The
+ *      extents holding the list of its extents are freed.
+ *-----------------------------------------------------------------------------
+ */
+platform_status
+value_log_mount(value_log        *vlog,
+                value_log_config *cfg,
+                cache            *cc,
+                platform_heap_id  hid,
+                uint64            meta_addr)
+{
+   platform_status rc = value_log_init(vlog, cfg, cc, hid);
+   if (!SUCCESS(rc)) {
+      return rc;
+   }
+
+   while (meta_addr != 0) {
+      page_handle        *page = cache_get(cc, meta_addr, TRUE, PAGE_TYPE_LOG);
+      value_log_meta_hdr *hdr  = (value_log_meta_hdr *)page->data;
+      value_log_extent   *entry = (value_log_extent *)(hdr + 1);
+      for (uint64 i = 0; SUCCESS(rc) && i < hdr->num_entries; i++) {
+         rc = value_log_push_extent(vlog, entry[i].addr, entry[i].fill);
+      }
+      uint64 last_addr = meta_addr;
+      meta_addr        = hdr->next_addr;
+      cache_unget(cc, page);
+      if (!SUCCESS(rc)) {
+         value_log_deinit(vlog);
+         return rc;
+      }
+
+      uint64 base_addr = value_log_base_addr(vlog, last_addr);
+      if (meta_addr == 0 || value_log_base_addr(vlog, meta_addr) != base_addr)
+      {
+         value_log_free_extent(vlog, base_addr);
+      }
+   }
+   return STATUS_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * value_log_unmount --
+ *
+ *      Writes the list of extents of the log to freshly allocated pages and
+ *      tears down the log. No other thread may be using the log.
+ *
+ * Results:
+ *      The address to pass to value_log_mount, never 0.
+ *-----------------------------------------------------------------------------
+ */
+uint64
+value_log_unmount(value_log *vlog)
+{
+   cache *cc = vlog->cc;
+   if (vlog->retired_addr != 0) {
+      value_log_free_extent(vlog, vlog->retired_addr);
+      vlog->retired_addr = 0;
+   }
+
+   uint64 page_size   = value_log_page_size(vlog);
+   uint64 extent_size = value_log_extent_size(vlog);
+   uint64 per_page =
+      (page_size - sizeof(value_log_meta_hdr)) / sizeof(value_log_extent);
+   uint64              meta_addr = 0;
+   uint64              idx       = 0;
+   page_handle        *page      = NULL;
+   value_log_meta_hdr *hdr       = NULL;
+   do {
+      uint64 next_addr;
+      if (page == NULL || (page->disk_addr + page_size) % extent_size == 0) {
+         platform_status rc =
+            allocator_alloc(vlog->al, &next_addr, PAGE_TYPE_LOG);
+         platform_assert_status_ok(rc);
+      } else {
+         next_addr = page->disk_addr + page_size;
+      }
+      if (page == NULL) {
+         meta_addr = next_addr;
+      } else {
+         hdr->next_addr = next_addr;
+         cache_unlock(cc, page);
+         cache_unclaim(cc, page);
+         cache_unget(cc, page);
+      }
+
+      page                   = cache_alloc(cc, next_addr, PAGE_TYPE_LOG);
+      hdr                    = (value_log_meta_hdr *)page->data;
+      hdr->next_addr         = 0;
+      hdr->num_entries       = 0;
+      value_log_extent *entry = (value_log_extent *)(hdr + 1);
+      while (idx < vlog->num_extents && hdr->num_entries < per_page) {
+         entry[hdr->num_entries++] = *value_log_get_extent(vlog, idx++);
+      }
+   } while (idx < vlog->num_extents);
+   cache_unlock(cc, page);
+   cache_unclaim(cc, page);
+   cache_unget(cc, page);
+
+   value_log_deinit(vlog);
+   return meta_addr;
+}
+
+/*
+ * Copies length bytes from data to the log at addr. The log is written
+ * sequentially, so a page is first written at its start, which is when it
+ * is allocated in the cache.
+ */
+static void
+value_log_copy_in(value_log *vlog, uint64 addr, const void *data, uint64 length)
+{
+   cache      *cc        = vlog->cc;
+   uint64      page_size = value_log_page_size(vlog);
+   const char *src       = data;
+   while (length != 0) {
+      uint64       offset = addr % page_size;
+      uint64       bytes  = MIN(length, page_size - offset);
+      page_handle *page;
+      if (offset == 0) {
+         page = cache_alloc(cc, addr, PAGE_TYPE_LOG);
+      } else {
+         page        = cache_get(cc, addr - offset, TRUE, PAGE_TYPE_LOG);
+         uint64 wait = 1;
+         while (!cache_try_claim(cc, page)) {
+            platform_sleep_ns(wait);
+            wait = wait > 1024 ? wait : 2 * wait;
+         }
+         cache_lock(cc, page);
+         cache_mark_dirty(cc, page);
+      }
+      memmove(page->data + offset, src, bytes);
+      cache_unlock(cc, page);
+      cache_unclaim(cc, page);
+      cache_unget(cc, page);
+
+      addr += bytes;
+      src += bytes;
+      length -= bytes;
+   }
+}
+
+static void
+value_log_copy_out(value_log *vlog, uint64 addr, void *data, uint64 length)
+{
+   cache *cc        = vlog->cc;
+   uint64 page_size = value_log_page_size(vlog);
+   char  *dst       = data;
+   while (length != 0) {
+      uint64       offset = addr % page_size;
+      uint64       bytes  = MIN(length, page_size - offset);
+      page_handle *page   = cache_get(cc, addr - offset, TRUE, PAGE_TYPE_LOG);
+      memmove(dst, page->data + offset, bytes);
+      cache_unget(cc, page);
+
+      addr += bytes;
+      dst += bytes;
+      length -= bytes;
+   }
+}
+
+/*
+ * Returns the longest value which can be stored in the log with a key of
+ * key_length bytes.
+ */
+uint64
+value_log_max_value_size(value_log *vlog, uint64 key_length)
+{
+   return value_log_extent_size(vlog) - sizeof(value_log_record_hdr)
+          - key_length;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * value_log_append --
+ *
+ *      Appends a record of tuple_key and value to the log, returning a
+ *      reference to the value in ref. Appends are serialized. A record which
+ *      does not fit in the newest extent starts a new one.
+ *-----------------------------------------------------------------------------
+ */
+platform_status
+value_log_append(value_log     *vlog,
+                 key            tuple_key,
+                 slice          value,
+                 value_log_ref *ref)
+{
+   value_log_record_hdr hdr = {.value_length = slice_length(value),
+                               .key_length   = key_length(tuple_key)};
+   uint64               size =
+      sizeof(hdr) + key_length(tuple_key) + slice_length(value);
+   if (slice_length(value) > value_log_max_value_size(vlog, hdr.key_length)) {
+      return STATUS_BAD_PARAM;
+   }
+
+   platform_mutex_lock(&vlog->lock);
+   value_log_extent *head = NULL;
+   if (vlog->num_extents != 0) {
+      head = value_log_get_extent(vlog, vlog->num_extents - 1);
+   }
+   if (head == NULL || head->fill + size > value_log_extent_size(vlog)) {
+      uint64          addr;
+      platform_status rc = allocator_alloc(vlog->al, &addr, PAGE_TYPE_LOG);
+      if (SUCCESS(rc)) {
+         rc = value_log_push_extent(vlog, addr, 0);
+         if (!SUCCESS(rc)) {
+            value_log_free_extent(vlog, addr);
+         }
+      }
+      if (!SUCCESS(rc)) {
+         platform_mutex_unlock(&vlog->lock);
+         return rc;
+      }
+      head = value_log_get_extent(vlog, vlog->num_extents - 1);
+   }
+
+   uint64 addr = head->addr + head->fill;
+   value_log_copy_in(vlog, addr, &hdr, sizeof(hdr));
+   addr += sizeof(hdr);
+   value_log_copy_in(vlog, addr, key_data(tuple_key), hdr.key_length);
+   addr += hdr.key_length;
+   value_log_copy_in(vlog, addr, slice_data(value), hdr.value_length);
+   head->fill += size;
+   platform_mutex_unlock(&vlog->lock);
+
+   __sync_fetch_and_add(&vlog->bytes_written, size);
+   ref->addr   = addr;
+   ref->length = hdr.value_length;
+   return STATUS_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * value_log_read_begin, value_log_read_end --
+ *
+ *      Bracket the use of references obtained from the trunk. An extent
+ *      collected by value_log_gc is not freed until every thread which was
+ *      in a section when it was collected has left it. Sections nest.
+ *-----------------------------------------------------------------------------
+ */
+void
+value_log_read_begin(value_log *vlog)
+{
+   value_log_reader *reader = &vlog->readers[platform_get_tid()];
+   reader->depth++;
+   // pairs with the barrier in value_log_gc
+   __sync_synchronize();
+}
+
+void
+value_log_read_end(value_log *vlog)
+{
+   value_log_reader *reader = &vlog->readers[platform_get_tid()];
+   debug_assert(reader->depth != 0);
+   if (--reader->depth == 0) {
+      reader->exits++;
+   }
+}
+
+platform_status
+value_log_read(value_log *vlog, value_log_ref ref, writable_buffer *value)
+{
+   platform_status rc = writable_buffer_resize(value, ref.length);
+   if (!SUCCESS(rc)) {
+      return rc;
+   }
+   value_log_copy_out(vlog, ref.addr, writable_buffer_data(value), ref.length);
+   return STATUS_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * value_log_needs_gc --
+ *
+ *      Estimates the garbage in the log from the number of tuples compaction
+ *      has reclaimed from the trunk, tuples_reclaimed, each of which is taken
+ *      to have freed the average bytes appended per tuple written. Each
+ *      extent collected is credited against the estimate.
+ *
+ * Results:
+ *      TRUE if the estimate exceeds cfg->gc_garbage_percent of the log.
+ *-----------------------------------------------------------------------------
+ */
+bool32
+value_log_needs_gc(value_log *vlog, uint64 tuples_reclaimed)
+{
+   uint64 tuples      = vlog->tuples_written;
+   uint64 num_extents = vlog->num_extents;
+   if (tuples == 0 || num_extents < 2) {
+      return FALSE;
+   }
+   uint64 garbage = tuples_reclaimed * (vlog->bytes_written / tuples);
+   if (garbage <= vlog->garbage_credited) {
+      return FALSE;
+   }
+   garbage -= vlog->garbage_credited;
+   uint64 log_size = num_extents * value_log_extent_size(vlog);
+   return 100 * garbage >= vlog->cfg->gc_garbage_percent * log_size;
+}
+
+static void
+value_log_retire(value_log *vlog, uint64 addr)
+{
+   // pairs with the barrier in value_log_read_begin
+   __sync_synchronize();
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      value_log_reader *reader = &vlog->readers[tid];
+      vlog->retired_exits[tid] =
+         reader->depth == 0 ? VALUE_LOG_QUIESCENT : reader->exits;
+   }
+   vlog->retired_addr = addr;
+}
+
+static bool32
+value_log_retired_quiescent(value_log *vlog)
+{
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      value_log_reader *reader = &vlog->readers[tid];
+      if (vlog->retired_exits[tid] != VALUE_LOG_QUIESCENT
+          && reader->depth != 0 && reader->exits == vlog->retired_exits[tid])
+      {
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * value_log_gc --
+ *
+ *      Collects the oldest extent of the log if value_log_needs_gc, after
+ *      waiting for any collection in progress, so that writers cannot
+ *      outrun collection: relocate is called on each record of the extent,
+ *      and should re-append and re-insert those still live. The extent is
+ *      freed by a later call, once readers have moved past it; nothing is
+ *      collected until the extent collected last can be freed.
+ *
+ *      relocate may append to the log, so must be called without locks the
+ *      log takes. It must serialize with writers of the key, see
+ *      value_log_key_lock.
+ *
+ * Results:
+ *      The bytes of dead records found.
+ *-----------------------------------------------------------------------------
+ */
+uint64
+value_log_gc(value_log            *vlog,
+             uint64                tuples_reclaimed,
+             value_log_relocate_fn relocate,
+             void                 *arg)
+{
+   platform_mutex_lock(&vlog->gc_lock);
+   if (!value_log_needs_gc(vlog, tuples_reclaimed)) {
+      platform_mutex_unlock(&vlog->gc_lock);
+      return 0;
+   }
+   if (vlog->retired_addr != 0) {
+      if (!value_log_retired_quiescent(vlog)) {
+         platform_mutex_unlock(&vlog->gc_lock);
+         return 0;
+      }
+      value_log_free_extent(vlog, vlog->retired_addr);
+      vlog->retired_addr = 0;
+   }
+
+   platform_mutex_lock(&vlog->lock);
+   if (vlog->num_extents < 2) {
+      platform_mutex_unlock(&vlog->lock);
+      platform_mutex_unlock(&vlog->gc_lock);
+      return 0;
+   }
+   value_log_extent victim = *value_log_get_extent(vlog, 0);
+   platform_mutex_unlock(&vlog->lock);
+
+   DECLARE_AUTO_WRITABLE_BUFFER(key_data, vlog->heap_id);
+   uint64 live   = 0;
+   uint64 offset = 0;
+   while (offset < victim.fill) {
+      value_log_record_hdr hdr;
+      uint64               addr = victim.addr + offset;
+      value_log_copy_out(vlog, addr, &hdr, sizeof(hdr));
+      addr += sizeof(hdr);
+      platform_status rc = writable_buffer_resize(&key_data, hdr.key_length);
+      platform_assert_status_ok(rc);
+      value_log_copy_out(
+         vlog, addr, writable_buffer_data(&key_data), hdr.key_length);
+      addr += hdr.key_length;
+
+      key tuple_key =
+         key_create(hdr.key_length, writable_buffer_data(&key_data));
+      value_log_ref ref  = {.addr = addr, .length = hdr.value_length};
+      uint64        size = sizeof(hdr) + hdr.key_length + hdr.value_length;
+      if (relocate(arg, tuple_key, ref)) {
+         live += size;
+      }
+      offset += size;
+   }
+
+   platform_mutex_lock(&vlog->lock);
+   vlog->oldest = (vlog->oldest + 1) % vlog->capacity;
+   vlog->num_extents--;
+   platform_mutex_unlock(&vlog->lock);
+
+   value_log_retire(vlog, victim.addr);
+
+   /*
+    * Relocated records are not new tuples, so are left out of the average
+    * tuple size. The tuples which referred to them will be reclaimed from
+    * the trunk without freeing anything in the log, so the whole extent is
+    * credited, not just its dead records.
+    */
+   __sync_fetch_and_sub(&vlog->bytes_written, live);
+   __sync_fetch_and_add(&vlog->garbage_credited, victim.fill);
+   platform_mutex_unlock(&vlog->gc_lock);
+   return victim.fill - live;
+}
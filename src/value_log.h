@@ -0,0 +1,166 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * value_log.h --
+ *
+ *     This file contains the interface for the value log, an append-only log
+ *     of large values kept out of the trunk and its branches.
+ *
+ *     Each record is a value_log_record_hdr followed by the key and the
+ *     value. Records are appended to the newest extent of the log and never
+ *     cross an extent boundary, so a record may span several pages. The
+ *     trunk carries a value_log_ref to the value in place of the value.
+ *
+ *     Space is reclaimed one extent at a time, oldest first: the caller
+ *     re-appends the records of the oldest extent which are still live (see
+ *     value_log_gc), and the extent is freed once no reader can still hold
+ *     a reference into it (see value_log_read_begin).
+ */
+
+#pragma once
+
+#include "platform.h"
+#include "cache.h"
+#include "util.h"
+#include "data_internal.h"
+
+/* number of locks striped over the key space, see value_log_key_lock */
+#define VALUE_LOG_KEY_LOCKS 64
+
+typedef struct value_log_config {
+   cache_config *cache_cfg;
+   uint64        threshold;          // longer values are separated
+   uint64        gc_garbage_percent; // of the log, before it is collected
+} value_log_config;
+
+/*
+ * Disk-resident structures.
+ */
+typedef struct ONDISK value_log_record_hdr {
+   uint32 value_length;
+   uint16 key_length;
+} value_log_record_hdr;
+
+typedef struct ONDISK value_log_ref {
+   uint64 addr; // of the value, following the key in its record
+   uint32 length;
+} value_log_ref;
+
+typedef struct ONDISK value_log_extent {
+   uint64 addr;
+   uint64 fill; // bytes of records appended to the extent
+} value_log_extent;
+
+/*
+ * A reader section of a thread, see value_log_read_begin. exits counts the
+ * times the thread left its outermost section.
+ */
+typedef struct value_log_reader {
+   volatile uint64 depth;
+   volatile uint64 exits;
+} PLATFORM_CACHELINE_ALIGNED value_log_reader;
+
+typedef struct value_log {
+   cache            *cc;
+   allocator        *al;
+   value_log_config *cfg;
+   platform_heap_id  heap_id;
+
+   // the extents of the log, oldest first, in a ring; protected by lock
+   platform_mutex    lock;
+   value_log_extent *extents;
+   uint64            capacity;
+   uint64            oldest;
+   uint64            num_extents;
+
+   // garbage estimate, see value_log_needs_gc
+   volatile uint64 tuples_written;
+   volatile uint64 bytes_written;
+   volatile uint64 garbage_credited;
+
+   // serializes collection, see value_log_gc
+   platform_mutex gc_lock;
+
+   // the extent collected last, freed once readers have moved past it
+   uint64 retired_addr;
+   uint64 retired_exits[MAX_THREADS];
+
+   value_log_reader readers[MAX_THREADS];
+   platform_mutex   key_lock[VALUE_LOG_KEY_LOCKS];
+} value_log;
+
+/*
+ * Re-appends the record of tuple_key at ref if it is still live, returning
+ * TRUE if it was.
+ */
+typedef bool32 (*value_log_relocate_fn)(void         *arg,
+                                        key           tuple_key,
+                                        value_log_ref ref);
+
+void
+value_log_config_init(value_log_config *cfg,
+                      cache_config     *cache_cfg,
+                      uint64            threshold,
+                      uint64            gc_garbage_percent);
+
+platform_status
+value_log_init(value_log        *vlog,
+               value_log_config *cfg,
+               cache            *cc,
+               platform_heap_id  hid);
+
+platform_status
+value_log_mount(value_log        *vlog,
+                value_log_config *cfg,
+                cache            *cc,
+                platform_heap_id  hid,
+                uint64            meta_addr);
+
+uint64
+value_log_unmount(value_log *vlog);
+
+static inline bool32
+value_log_separates(value_log *vlog, uint64 value_length)
+{
+   return value_length > vlog->cfg->threshold;
+}
+
+uint64
+value_log_max_value_size(value_log *vlog, uint64 key_length);
+
+platform_status
+value_log_append(value_log     *vlog,
+                 key            tuple_key,
+                 slice          value,
+                 value_log_ref *ref);
+
+void
+value_log_read_begin(value_log *vlog);
+
+void
+value_log_read_end(value_log *vlog);
+
+platform_status
+value_log_read(value_log *vlog, value_log_ref ref, writable_buffer *value);
+
+static inline void
+value_log_tuple_written(value_log *vlog)
+{
+   __sync_fetch_and_add(&vlog->tuples_written, 1);
+}
+
+bool32
+value_log_needs_gc(value_log *vlog, uint64 tuples_reclaimed);
+
+uint64
+value_log_gc(value_log            *vlog,
+             uint64                tuples_reclaimed,
+             value_log_relocate_fn relocate,
+             void                 *arg);
+
+static inline platform_mutex *
+value_log_key_lock(value_log *vlog, uint32 key_hash)
+{
+   return &vlog->key_lock[key_hash % VALUE_LOG_KEY_LOCKS];
+}
@@ -0,0 +1,263 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * zcache.c --
+ *
+ *     This file contains the implementation of the compressed page store.
+ */
+
+#include "zcache.h"
+#include "lz.h"
+
+#include "poison.h"
+
+#define ZCACHE_INVALID_ADDR UINT64_MAX
+
+/*
+ * Expected compressed page size relative to the page size, used to size the
+ * index. Branch pages typically compress 2-4x.
+ */
+#define ZCACHE_EXPECTED_RATIO 3
+
+/* only keep pages that compress to at most 3/4 of a page */
+#define ZCACHE_MAX_LENGTH_NUM 3
+#define ZCACHE_MAX_LENGTH_DEN 4
+
+platform_status
+zcache_init(zcache          *zc,
+            uint64           capacity,
+            uint64           page_size,
+            platform_heap_id hid)
+{
+   ZERO_CONTENTS(zc);
+   zc->capacity   = capacity;
+   zc->page_size  = page_size;
+   zc->max_length = page_size * ZCACHE_MAX_LENGTH_NUM / ZCACHE_MAX_LENGTH_DEN;
+   zc->heap_id    = hid;
+
+   uint64 expected_pages = capacity * ZCACHE_EXPECTED_RATIO / page_size;
+   zc->num_sets          = MAX(1, expected_pages / ZCACHE_WAYS);
+
+   platform_status rc = platform_buffer_init(&zc->log_bh, capacity);
+   if (!SUCCESS(rc)) {
+      goto alloc_error;
+   }
+   zc->log = platform_buffer_getaddr(&zc->log_bh);
+
+   zc->set = TYPED_ARRAY_ZALLOC(hid, zc->set, zc->num_sets);
+   if (zc->set == NULL) {
+      goto alloc_error;
+   }
+   for (uint64 i = 0; i < zc->num_sets; i++) {
+      for (uint64 way = 0; way < ZCACHE_WAYS; way++) {
+         zc->set[i].entry[way].addr = ZCACHE_INVALID_ADDR;
+      }
+   }
+
+   zc->scratch = TYPED_ARRAY_MALLOC(hid, zc->scratch, MAX_THREADS * page_size);
+   if (zc->scratch == NULL) {
+      goto alloc_error;
+   }
+
+   return STATUS_OK;
+
+alloc_error:
+   zcache_deinit(zc);
+   return STATUS_NO_MEMORY;
+}
+
+void
+zcache_deinit(zcache *zc)
+{
+   if (zc->log) {
+      debug_only platform_status rc = platform_buffer_deinit(&zc->log_bh);
+      debug_assert(SUCCESS(rc), "rc=%s", platform_status_to_string(rc));
+      zc->log = NULL;
+   }
+   if (zc->set) {
+      platform_free(zc->heap_id, zc->set);
+   }
+   if (zc->scratch) {
+      platform_free(zc->heap_id, zc->scratch);
+   }
+}
+
+static inline zcache_set *
+zcache_get_set(zcache *zc, uint64 addr)
+{
+   uint64 page_no = addr / zc->page_size;
+   return &zc->set[(page_no * 0x9E3779B97F4A7C15ULL >> 16) % zc->num_sets];
+}
+
+static inline void
+zcache_lock_set(zcache_set *set)
+{
+   while (__sync_lock_test_and_set(&set->lock, 1)) {
+      while (set->lock) {
+         platform_pause();
+      }
+   }
+}
+
+static inline void
+zcache_unlock_set(zcache_set *set)
+{
+   __sync_lock_release(&set->lock);
+}
+
+/*
+ * A compressed page is valid until the log head laps it.
+ */
+static inline bool32
+zcache_pos_valid(zcache *zc, uint64 pos)
+{
+   return zc->head <= pos + zc->capacity;
+}
+
+static inline bool32
+zcache_entry_live(zcache *zc, zcache_entry *entry)
+{
+   return entry->addr != ZCACHE_INVALID_ADDR
+          && zcache_pos_valid(zc, entry->pos);
+}
+
+static inline char *
+zcache_scratch(zcache *zc)
+{
+   return zc->scratch + platform_get_tid() * zc->page_size;
+}
+
+/*
+ * Reserves length contiguous bytes in the log and returns their logical
+ * position. Reservations never wrap around the end of the log.
+ */
+static uint64
+zcache_reserve(zcache *zc, uint64 length)
+{
+   uint64 old_head, pos;
+   do {
+      old_head = zc->head;
+      pos      = old_head;
+      if (pos % zc->capacity + length > zc->capacity) {
+         pos += zc->capacity - pos % zc->capacity;
+      }
+   } while (!__sync_bool_compare_and_swap(&zc->head, old_head, pos + length));
+   return pos;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * zcache_put --
+ *
+ *      Compresses the page and stores it under addr, replacing any older
+ *      copy. Returns FALSE if the page did not compress well enough to be
+ *      worth keeping.
+ *----------------------------------------------------------------------
+ */
+bool32
+zcache_put(zcache *zc, uint64 addr, const char *page)
+{
+   char  *scratch = zcache_scratch(zc);
+   uint64 length  = lz_compress(page, zc->page_size, scratch, zc->max_length);
+   if (length == 0 || length > zc->capacity) {
+      zcache_invalidate(zc, addr);
+      return FALSE;
+   }
+
+   uint64 pos = zcache_reserve(zc, length);
+   memcpy(zc->log + pos % zc->capacity, scratch, length);
+
+   zcache_set *set = zcache_get_set(zc, addr);
+   zcache_lock_set(set);
+   zcache_entry *victim = NULL;
+   for (uint64 way = 0; victim == NULL && way < ZCACHE_WAYS; way++) {
+      if (set->entry[way].addr == addr) {
+         victim = &set->entry[way];
+      }
+   }
+   for (uint64 way = 0; victim == NULL && way < ZCACHE_WAYS; way++) {
+      if (!zcache_entry_live(zc, &set->entry[way])) {
+         victim = &set->entry[way];
+      }
+   }
+   if (victim == NULL) {
+      victim = &set->entry[0];
+      for (uint64 way = 1; way < ZCACHE_WAYS; way++) {
+         if (set->entry[way].pos < victim->pos) {
+            victim = &set->entry[way];
+         }
+      }
+   }
+   victim->addr   = addr;
+   victim->pos    = pos;
+   victim->length = length;
+   zcache_unlock_set(set);
+   return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * zcache_take --
+ *
+ *      If a valid copy of the page at addr is present, removes it,
+ *      decompresses it into page and returns TRUE.
+ *----------------------------------------------------------------------
+ */
+bool32
+zcache_take(zcache *zc, uint64 addr, char *page)
+{
+   zcache_set *set = zcache_get_set(zc, addr);
+   uint64      pos, length;
+
+   zcache_lock_set(set);
+   uint64 way;
+   for (way = 0; way < ZCACHE_WAYS; way++) {
+      if (set->entry[way].addr == addr) {
+         break;
+      }
+   }
+   if (way == ZCACHE_WAYS) {
+      zcache_unlock_set(set);
+      return FALSE;
+   }
+   pos                  = set->entry[way].pos;
+   length               = set->entry[way].length;
+   set->entry[way].addr = ZCACHE_INVALID_ADDR;
+   zcache_unlock_set(set);
+
+   if (!zcache_pos_valid(zc, pos)) {
+      return FALSE;
+   }
+   char *scratch = zcache_scratch(zc);
+   memcpy(scratch, zc->log + pos % zc->capacity, length);
+   /* writers reserve before they copy, so recheck head after our copy */
+   __sync_synchronize();
+   if (!zcache_pos_valid(zc, pos)) {
+      return FALSE;
+   }
+
+   bool32 ok = lz_decompress(scratch, length, page, zc->page_size);
+   platform_assert(ok, "zcache: corrupt compressed page at addr %lu\n", addr);
+   return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * zcache_invalidate --
+ *
+ *      Drops any copy of the page at addr.
+ *----------------------------------------------------------------------
+ */
+void
+zcache_invalidate(zcache *zc, uint64 addr)
+{
+   zcache_set *set = zcache_get_set(zc, addr);
+   zcache_lock_set(set);
+   for (uint64 way = 0; way < ZCACHE_WAYS; way++) {
+      if (set->entry[way].addr == addr) {
+         set->entry[way].addr = ZCACHE_INVALID_ADDR;
+      }
+   }
+   zcache_unlock_set(set);
+}
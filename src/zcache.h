@@ -0,0 +1,76 @@
+// Copyright 2018-2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * zcache.h --
+ *
+ *     This file contains the interface for a compressed page store in DRAM,
+ *     used by the clockcache as a second tier for clean pages it evicts.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/* associativity of the zcache index */
+#define ZCACHE_WAYS 4
+
+typedef struct zcache_entry {
+   uint64 addr;
+   uint64 pos; // logical position of the compressed page in the log
+   uint64 length;
+} zcache_entry;
+
+typedef struct zcache_set {
+   volatile uint32 lock;
+   zcache_entry    entry[ZCACHE_WAYS];
+} zcache_set;
+
+/*
+ *----------------------------------------------------------------------
+ * zcache --
+ *
+ *      Compressed pages are appended to a circular log of capacity bytes,
+ *      so the oldest pages are overwritten first. A page whose log
+ *      position has been lapped by zcache->head is no longer valid.
+ *
+ *      Pages are found through a set-associative index keyed by disk
+ *      address. Each set has its own spin lock; the log itself is
+ *      reserved with a CAS on zcache->head, and readers validate their
+ *      copy against head after copying it out.
+ *
+ *      The zcache is exclusive: zcache_take removes the page it returns,
+ *      so the caller must zcache_invalidate an address whenever the page
+ *      at that address may change on disk.
+ *----------------------------------------------------------------------
+ */
+typedef struct zcache {
+   uint64           capacity;
+   uint64           page_size;
+   uint64           max_length; // pages that don't compress below are dropped
+   uint64           num_sets;
+   volatile uint64  head;
+   buffer_handle    log_bh;
+   char            *log;
+   zcache_set      *set;
+   char            *scratch; // one page per thread
+   platform_heap_id heap_id;
+} zcache;
+
+platform_status
+zcache_init(zcache          *zc,
+            uint64           capacity,
+            uint64           page_size,
+            platform_heap_id hid);
+
+void
+zcache_deinit(zcache *zc);
+
+bool32
+zcache_put(zcache *zc, uint64 addr, const char *page);
+
+bool32
+zcache_take(zcache *zc, uint64 addr, char *page);
+
+void
+zcache_invalidate(zcache *zc, uint64 addr);
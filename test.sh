@@ -594,6 +594,7 @@ function run_fast_unit_tests() {
    "$BINDIR"/unit/splinterdb_quick_test "$Use_shmem"
    "$BINDIR"/unit/btree_test "$Use_shmem"
    "$BINDIR"/unit/util_test "$Use_shmem"
+   "$BINDIR"/unit/lz_test "$Use_shmem"
    "$BINDIR"/unit/misc_test "$Use_shmem"
    "$BINDIR"/unit/limitations_test "$Use_shmem"
    "$BINDIR"/unit/task_system_test "$Use_shmem"
@@ -855,6 +856,27 @@ function run_btree_tests() {
                                           --key-size ${key_size} --seed "$SEED"
     rm db
 
+    # shellcheck disable=SC2086
+    run_with_timing "BTree test, with key prefix slots${use_msg}" \
+        "$BINDIR"/driver_test btree_test $Use_shmem \
+                                         --btree-key-prefix-slots \
+                                         --seed "$SEED"
+    rm db
+
+    # shellcheck disable=SC2086
+    run_with_timing "BTree test, with prefix compression${use_msg}" \
+        "$BINDIR"/driver_test btree_test $Use_shmem \
+                                         --btree-prefix-compression \
+                                         --seed "$SEED"
+    rm db
+
+    # shellcheck disable=SC2086
+    run_with_timing "BTree test, with compressed branch pages${use_msg}" \
+        "$BINDIR"/driver_test btree_test $Use_shmem \
+                                         --cache-branch-compression \
+                                         --seed "$SEED"
+    rm db
+
     # shellcheck disable=SC2086
     run_with_timing "BTree Perf test${use_msg}" \
         "$BINDIR"/driver_test btree_test --perf \
@@ -877,6 +899,12 @@ function run_other_driver_tests() {
         "$BINDIR"/driver_test cache_test --seed "$SEED" $Use_shmem
     rm db
 
+    # shellcheck disable=SC2086
+    run_with_timing "Cache test with multi-extent writes${use_msg}" \
+        "$BINDIR"/driver_test cache_test --libaio-max-pages 128 \
+                                         --seed "$SEED" $Use_shmem
+    rm db
+
     # shellcheck disable=SC2086
     run_with_timing "Log test${use_msg}" \
         "$BINDIR"/driver_test log_test --seed "$SEED" $Use_shmem
@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "util.h"
+#include "routing_filter.h"
 
 /*
  * --------------------------------------------------------------------------
@@ -127,18 +128,39 @@ config_usage()
    platform_error_log("\t--db-capacity-mib (%d)\n",
                       (int)(TEST_CONFIG_DEFAULT_DISK_SIZE_GB * KiB));
    platform_error_log("\t--libaio-queue-depth\n");
+   platform_error_log("\t--libaio-max-pages\n");
    platform_error_log("\t--cache-capacity-gib (%d)\n",
                       TEST_CONFIG_DEFAULT_CACHE_SIZE_GB);
    platform_error_log("\t--cache-capacity-mib (%d)\n",
                       (int)(TEST_CONFIG_DEFAULT_CACHE_SIZE_GB * KiB));
    platform_error_log("\t--cache-debug-log\n");
+   platform_error_log("\t--cache-trunk-min-share (0)\n");
+   platform_error_log("\t--cache-filter-min-share (0)\n");
+   platform_error_log("\t--cache-branch-max-share (0)\n");
+   platform_error_log("\t--cache-pin-trunk-pages\n");
+   platform_error_log("\t--cache-compressed-capacity-mib (0)\n");
+   platform_error_log("\t--cache-cleaner-clean-share (0)\n");
+   platform_error_log("\t--cache-branch-compression\n");
    platform_error_log("\t--queue-scale-percent (%d)\n",
                       TEST_CONFIG_DEFAULT_QUEUE_SCALE_PERCENT);
    platform_error_log("\t--memtable-capacity-gib\n");
    platform_error_log("\t--memtable-capacity-mib (%d)\n",
                       TEST_CONFIG_DEFAULT_MEMTABLE_CAPACITY_MB);
+   platform_error_log("\t--memtable-skiplist\n");
+   platform_error_log("\t--memtable-hash-index\n");
    platform_error_log("\t--rough-count-height\n");
+   platform_error_log("\t--btree-readahead-max-extents\n");
+   platform_error_log("\t--btree-readahead-budget (0)\n");
+   platform_error_log("\t--btree-key-prefix-slots\n");
+   platform_error_log("\t--btree-prefix-compression\n");
+   platform_error_log("\t--btree-optimistic-inserts\n");
    platform_error_log("\t--filter-remainder-size\n");
+   platform_error_log("\t--filter-bloom-heights (0)\n");
+   platform_error_log("\t--filter-bloom-bits-per-key (%d)\n",
+                      ROUTING_BLOOM_DEFAULT_BITS_PER_KEY);
+   platform_error_log("\t--filter-cache-size-mib (0)\n");
+   platform_error_log("\t--filter-cache-heights (all but the leaves)\n");
+   platform_error_log("\t--filter-adaptive-fingerprints\n");
    platform_error_log("\t--fanout (%d)\n", TEST_CONFIG_DEFAULT_FANOUT);
    platform_error_log("\t--max-branches-per-node (%d)\n",
                       TEST_CONFIG_DEFAULT_MAX_BRANCHES_PER_NODE);
@@ -279,16 +301,96 @@ config_parse(master_config *cfg, const uint8 num_config, int argc, char *argv[])
          config_set_mib("db-capacity", cfg, allocator_capacity) {}
          config_set_gib("db-capacity", cfg, allocator_capacity) {}
          config_set_uint64("libaio-queue-depth", cfg, io_async_queue_depth) {}
+         config_set_uint64("libaio-max-pages", cfg, io_async_max_pages) {}
          config_set_mib("cache-capacity", cfg, cache_capacity) {}
          config_set_gib("cache-capacity", cfg, cache_capacity) {}
          config_set_string("cache-debug-log", cfg, cache_logfile) {}
+         config_set_uint64(
+            "cache-trunk-min-share", cfg, cache_trunk_min_share)
+         {}
+         config_set_uint64(
+            "cache-filter-min-share", cfg, cache_filter_min_share)
+         {}
+         config_set_uint64(
+            "cache-branch-max-share", cfg, cache_branch_max_share)
+         {}
+         config_has_option("cache-pin-trunk-pages")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].cache_pin_trunk_pages = TRUE;
+            }
+         }
+         config_set_mib(
+            "cache-compressed-capacity", cfg, cache_compressed_capacity)
+         {}
+         config_set_gib(
+            "cache-compressed-capacity", cfg, cache_compressed_capacity)
+         {}
+         config_set_uint64(
+            "cache-cleaner-clean-share", cfg, cache_cleaner_clean_share)
+         {}
+         config_has_option("cache-branch-compression")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].cache_branch_compression = TRUE;
+            }
+         }
          config_set_uint64("queue-scale-percent", cfg, queue_scale_percent) {}
          config_set_mib("memtable-capacity", cfg, memtable_capacity) {}
          config_set_gib("memtable-capacity", cfg, memtable_capacity) {}
+         config_has_option("memtable-skiplist")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].memtable_skiplist = TRUE;
+            }
+         }
+         config_has_option("memtable-hash-index")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].memtable_hash_index = TRUE;
+            }
+         }
          config_set_uint64("rough-count-height", cfg, btree_rough_count_height)
          {}
+         config_set_uint64(
+            "btree-readahead-max-extents", cfg, btree_readahead_max_extents)
+         {}
+         config_set_uint64(
+            "btree-readahead-budget", cfg, btree_readahead_budget)
+         {}
+         config_has_option("btree-key-prefix-slots")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].btree_key_prefix_slots = TRUE;
+            }
+         }
+         config_has_option("btree-prefix-compression")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].btree_prefix_compression = TRUE;
+            }
+         }
+         config_has_option("btree-optimistic-inserts")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].btree_optimistic_inserts = TRUE;
+            }
+         }
          config_set_uint64("filter-remainder-size", cfg, filter_remainder_size)
          {}
+         config_set_uint64("filter-bloom-heights", cfg, filter_bloom_heights) {}
+         config_set_uint64(
+            "filter-bloom-bits-per-key", cfg, filter_bloom_bits_per_key)
+         {}
+         config_set_mib("filter-cache-size", cfg, filter_cache_size) {}
+         config_set_uint64("filter-cache-heights", cfg, filter_cache_heights)
+         {}
+         config_has_option("filter-adaptive-fingerprints")
+         {
+            for (uint8 cfg_idx = 0; cfg_idx < num_config; cfg_idx++) {
+               cfg[cfg_idx].filter_adaptive_fingerprints = TRUE;
+            }
+         }
          config_set_uint64("fanout", cfg, fanout) {}
          config_set_uint64("max-branches-per-node", cfg, max_branches_per_node)
          {}
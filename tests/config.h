@@ -55,6 +55,7 @@ typedef struct master_config {
    int    io_flags;
    uint32 io_perms;
    uint64 io_async_queue_depth;
+   uint64 io_async_max_pages;
 
    // allocator
    uint64 allocator_capacity;
@@ -63,13 +64,30 @@ typedef struct master_config {
    uint64 cache_capacity;
    bool32 cache_use_stats;
    char   cache_logfile[MAX_STRING_LENGTH];
+   uint64 cache_trunk_min_share;
+   uint64 cache_filter_min_share;
+   uint64 cache_branch_max_share;
+   bool32 cache_pin_trunk_pages;
+   uint64 cache_compressed_capacity;
+   uint64 cache_cleaner_clean_share;
+   bool32 cache_branch_compression;
 
    // btree
    uint64 btree_rough_count_height;
+   uint64 btree_readahead_max_extents;
+   uint64 btree_readahead_budget;
+   bool32 btree_key_prefix_slots;
+   bool32 btree_prefix_compression;
+   bool32 btree_optimistic_inserts;
 
    // routing filter
    uint64 filter_remainder_size;
    uint64 filter_index_size;
+   uint64 filter_bloom_heights;
+   uint64 filter_bloom_bits_per_key;
+   uint64 filter_cache_size;
+   uint64 filter_cache_heights;
+   bool32 filter_adaptive_fingerprints;
 
    // log
    bool32 use_log;
@@ -80,6 +98,8 @@ typedef struct master_config {
 
    // splinter
    uint64 memtable_capacity;
+   bool32 memtable_skiplist;
+   bool32 memtable_hash_index;
    uint64 fanout;
    uint64 max_branches_per_node;
    uint64 use_stats;
@@ -1507,6 +1507,169 @@ destroy_btrees:
    return rc;
 }
 
+/*
+ * Scans a packed branch from a cold cache and returns the number of tuples
+ * seen along with the readahead state of the iterator.
+ */
+static uint64
+test_btree_readahead_scan(cache          *cc,
+                          btree_config   *cfg,
+                          uint64          root_addr,
+                          key             max_key,
+                          key_buffer     *kth_key,
+                          uint64          k,
+                          btree_iterator *itor,
+                          uint64         *max_window)
+{
+   cache_flush(cc);
+   cache_evict(cc, TRUE);
+
+   btree_iterator_init(cc,
+                       cfg,
+                       itor,
+                       root_addr,
+                       PAGE_TYPE_BRANCH,
+                       NEGATIVE_INFINITY_KEY,
+                       max_key,
+                       NEGATIVE_INFINITY_KEY,
+                       greater_than_or_equal,
+                       TRUE,
+                       0);
+   uint64 count = 0;
+   *max_window  = itor->ra_window;
+   while (iterator_can_curr(&itor->super)) {
+      key     curr_key;
+      message data;
+      iterator_curr(&itor->super, &curr_key, &data);
+      if (kth_key != NULL && count == k) {
+         key_buffer_copy_key(kth_key, curr_key);
+      }
+      count++;
+      *max_window = MAX(*max_window, itor->ra_window);
+      platform_status rc = iterator_next(&itor->super);
+      platform_assert_status_ok(rc);
+   }
+   btree_iterator_deinit(itor);
+   return count;
+}
+
+static uint64
+test_btree_prefetch_hits(clockcache *cc)
+{
+   uint64 hits = 0;
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      hits += cc->stats[tid].prefetch_hits[PAGE_TYPE_BRANCH];
+   }
+   return hits;
+}
+
+/*
+ * A full scan of a cold branch should ramp its readahead window up, respect
+ * the per-iterator budget, and have its prefetched pages read. A scan that
+ * ends in its first extent should issue no readahead at all.
+ */
+static platform_status
+test_btree_readahead(cache             *cc,
+                     test_btree_config *cfg,
+                     platform_heap_id   hid)
+{
+   platform_default_log("btree_test: btree readahead test started\n");
+
+   uint64 root_addr;
+   test_btree_create_packed_trees(cc, cfg, hid, 1, &root_addr);
+   btree_config *btree_cfg    = cfg->mt_cfg->btree_cfg;
+   uint64        saved_budget = btree_cfg->readahead_budget_extents;
+   clockcache   *clock_cc     = (clockcache *)cc;
+   key_buffer    short_max;
+   key_buffer_init(&short_max, hid);
+
+   btree_pivot_stats stats;
+   btree_count_in_range(cc,
+                        btree_cfg,
+                        root_addr,
+                        NEGATIVE_INFINITY_KEY,
+                        POSITIVE_INFINITY_KEY,
+                        &stats);
+
+   platform_status rc = STATUS_OK;
+   btree_iterator  itor;
+   uint64          max_window;
+
+   btree_cfg->readahead_budget_extents = 0;
+   uint64 hits  = test_btree_prefetch_hits(clock_cc);
+   uint64 count = test_btree_readahead_scan(cc,
+                                            btree_cfg,
+                                            root_addr,
+                                            POSITIVE_INFINITY_KEY,
+                                            &short_max,
+                                            8,
+                                            &itor,
+                                            &max_window);
+   hits         = test_btree_prefetch_hits(clock_cc) - hits;
+   platform_default_log("btree_test: full scan of %lu tuples prefetched %lu "
+                        "extents, max window %lu, %lu prefetch hits\n",
+                        count,
+                        itor.ra_issued,
+                        max_window,
+                        hits);
+   if (count != stats.num_kvs || itor.ra_issued == 0 || max_window < 2
+       || (clock_cc->cfg->use_stats && hits == 0))
+   {
+      platform_error_log("btree_test: full scan with readahead failed\n");
+      rc = STATUS_TEST_FAILED;
+      goto out;
+   }
+
+   btree_cfg->readahead_budget_extents = 2;
+
+   count = test_btree_readahead_scan(cc,
+                                     btree_cfg,
+                                     root_addr,
+                                     POSITIVE_INFINITY_KEY,
+                                     NULL,
+                                     0,
+                                     &itor,
+                                     &max_window);
+   if (count != stats.num_kvs || itor.ra_issued > 2) {
+      platform_error_log("btree_test: readahead budget not respected, "
+                         "%lu tuples %lu extents\n",
+                         count,
+                         itor.ra_issued);
+      rc = STATUS_TEST_FAILED;
+      goto out;
+   }
+
+   btree_cfg->readahead_budget_extents = 0;
+
+   count = test_btree_readahead_scan(cc,
+                                     btree_cfg,
+                                     root_addr,
+                                     key_buffer_key(&short_max),
+                                     NULL,
+                                     0,
+                                     &itor,
+                                     &max_window);
+   if (count != 8 || itor.ra_issued != 0) {
+      platform_error_log("btree_test: short scan over-read, "
+                         "%lu tuples %lu extents\n",
+                         count,
+                         itor.ra_issued);
+      rc = STATUS_TEST_FAILED;
+   }
+
+out:
+   btree_cfg->readahead_budget_extents = saved_budget;
+   btree_dec_ref_range(
+      cc, btree_cfg, root_addr, NEGATIVE_INFINITY_KEY, POSITIVE_INFINITY_KEY);
+   key_buffer_deinit(&short_max);
+   if (SUCCESS(rc)) {
+      platform_default_log("btree_test: btree readahead test succeeded\n");
+   } else {
+      platform_default_log("btree_test: btree readahead test failed\n");
+   }
+   return rc;
+}
+
 static void
 usage(const char *argv0)
 {
@@ -1668,6 +1831,10 @@ btree_test(int argc, char *argv[])
        * cache lockup for low cache sizes.
        */
       if (cache_cfg.capacity > 4 * MiB) {
+         // Runs first, as it evicts the whole cache
+         rc = test_btree_readahead(ccp, &test_cfg, hid);
+         platform_assert_status_ok(rc);
+
          rc = test_btree_rough_iterator(ccp, &test_cfg, hid, 8);
          platform_assert_status_ok(rc);
 
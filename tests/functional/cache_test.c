@@ -294,6 +294,514 @@ exit:
    return rc;
 }
 
+/*
+ * Verify that trunk pages stay resident while a cache configured with
+ * pin_trunk_pages is churned through with twice its capacity of other pages.
+ */
+platform_status
+test_cache_pin_trunk(clockcache_config *base_cfg,
+                     io_handle         *io,
+                     allocator         *al,
+                     platform_heap_id   hid)
+{
+   platform_default_log("cache_test: pin trunk test started\n");
+   platform_status   rc       = STATUS_OK;
+   uint64           *addr_arr = NULL;
+   clockcache_config cfg      = *base_cfg;
+   cfg.pin_trunk_pages        = TRUE;
+
+   clockcache *cc = TYPED_MALLOC(hid, cc);
+   platform_assert(cc != NULL);
+   rc = clockcache_init(
+      cc, &cfg, io, al, "pin_trunk", hid, platform_get_module_id());
+   platform_assert_status_ok(rc);
+   cache *ccp = (cache *)cc;
+
+   uint64 page_size        = cache_config_page_size(&cfg.super);
+   uint64 pages_per_extent = cache_config_pages_per_extent(&cfg.super);
+   uint64 trunk_addr;
+   rc = allocator_alloc(al, &trunk_addr, PAGE_TYPE_TRUNK);
+   platform_assert_status_ok(rc);
+   for (uint64 i = 0; i < pages_per_extent; i++) {
+      page_handle *page =
+         cache_alloc(ccp, trunk_addr + i * page_size, PAGE_TYPE_TRUNK);
+      cache_unlock(ccp, page);
+      cache_unclaim(ccp, page);
+      cache_unget(ccp, page);
+   }
+   cache_flush(ccp);
+
+   uint32 extents_to_allocate = 2 * cfg.page_capacity / pages_per_extent;
+   uint64 pages_to_allocate   = extents_to_allocate * pages_per_extent;
+   addr_arr = TYPED_ARRAY_MALLOC(hid, addr_arr, pages_to_allocate);
+   platform_assert(addr_arr != NULL);
+   rc = cache_test_alloc_extents(ccp, &cfg, addr_arr, extents_to_allocate);
+   platform_assert_status_ok(rc);
+   cache_flush(ccp);
+
+   for (uint64 i = 0; i < pages_per_extent; i++) {
+      page_handle trunk_page = {.disk_addr = trunk_addr + i * page_size};
+      if (!cache_present(ccp, &trunk_page)) {
+         platform_error_log("Trunk page %lu evicted\n", trunk_page.disk_addr);
+         rc = STATUS_TEST_FAILED;
+         break;
+      }
+   }
+
+   /*
+    * Deallocate all the entries.
+    */
+   for (uint32 i = 0; i < extents_to_allocate; i++) {
+      uint64 addr = addr_arr[i * pages_per_extent];
+      uint8  ref  = allocator_dec_ref(al, addr, PAGE_TYPE_MISC);
+      platform_assert(ref == AL_NO_REFS);
+      cache_extent_discard(ccp, addr, PAGE_TYPE_MISC);
+      ref = allocator_dec_ref(al, addr, PAGE_TYPE_MISC);
+      platform_assert(ref == AL_FREE);
+   }
+   uint8 ref = allocator_dec_ref(al, trunk_addr, PAGE_TYPE_TRUNK);
+   platform_assert(ref == AL_NO_REFS);
+   cache_extent_discard(ccp, trunk_addr, PAGE_TYPE_TRUNK);
+   ref = allocator_dec_ref(al, trunk_addr, PAGE_TYPE_TRUNK);
+   platform_assert(ref == AL_FREE);
+
+   platform_free(hid, addr_arr);
+   clockcache_deinit(cc);
+   platform_free(hid, cc);
+
+   if (SUCCESS(rc)) {
+      platform_default_log("cache_test: pin trunk test passed\n");
+   } else {
+      platform_default_log("cache_test: pin trunk test failed\n");
+   }
+
+   return rc;
+}
+
+static void
+cache_test_fill_page(char *data, uint64 page_size, uint64 addr)
+{
+   for (uint64 off = 0; off < page_size; off += sizeof(uint64)) {
+      uint64 word = addr + off / 64;
+      memcpy(data + off, &word, sizeof(word));
+   }
+}
+
+/*
+ * Verify that clean branch pages evicted from a cache with a compressed tier
+ * come back intact.
+ */
+platform_status
+test_cache_compressed(clockcache_config *base_cfg,
+                      io_handle         *io,
+                      allocator         *al,
+                      platform_heap_id   hid)
+{
+   platform_default_log("cache_test: compressed tier test started\n");
+   platform_status   rc       = STATUS_OK;
+   uint64           *addr_arr = NULL;
+   clockcache_config cfg      = *base_cfg;
+   cfg.compressed_capacity    = cfg.capacity;
+
+   clockcache *cc = TYPED_MALLOC(hid, cc);
+   platform_assert(cc != NULL);
+   rc = clockcache_init(
+      cc, &cfg, io, al, "compressed", hid, platform_get_module_id());
+   platform_assert_status_ok(rc);
+   cache *ccp = (cache *)cc;
+
+   uint64 page_size           = cache_config_page_size(&cfg.super);
+   uint64 pages_per_extent    = cache_config_pages_per_extent(&cfg.super);
+   uint32 extents_to_allocate = cfg.page_capacity / pages_per_extent / 2;
+   addr_arr = TYPED_ARRAY_MALLOC(hid, addr_arr, extents_to_allocate);
+   platform_assert(addr_arr != NULL);
+   for (uint32 j = 0; j < extents_to_allocate; j++) {
+      rc = allocator_alloc(al, &addr_arr[j], PAGE_TYPE_BRANCH);
+      platform_assert_status_ok(rc);
+      for (uint64 i = 0; i < pages_per_extent; i++) {
+         uint64       addr = addr_arr[j] + i * page_size;
+         page_handle *page = cache_alloc(ccp, addr, PAGE_TYPE_BRANCH);
+         cache_test_fill_page(page->data, page_size, addr);
+         cache_unlock(ccp, page);
+         cache_unclaim(ccp, page);
+         cache_unget(ccp, page);
+      }
+   }
+   cache_flush(ccp);
+
+   /* evicted clean branch pages go to the compressed tier */
+   cache_evict(ccp, FALSE);
+
+   char *expected = TYPED_ARRAY_MALLOC(hid, expected, page_size);
+   platform_assert(expected != NULL);
+   for (uint32 j = 0; j < extents_to_allocate && SUCCESS(rc); j++) {
+      for (uint64 i = 0; i < pages_per_extent; i++) {
+         uint64       addr = addr_arr[j] + i * page_size;
+         page_handle *page = cache_get(ccp, addr, TRUE, PAGE_TYPE_BRANCH);
+         cache_test_fill_page(expected, page_size, addr);
+         if (memcmp(page->data, expected, page_size) != 0) {
+            platform_error_log("Page %lu corrupted\n", addr);
+            rc = STATUS_TEST_FAILED;
+         }
+         cache_unget(ccp, page);
+      }
+   }
+   platform_free(hid, expected);
+
+   for (uint32 j = 0; j < extents_to_allocate; j++) {
+      uint8 ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_BRANCH);
+      platform_assert(ref == AL_NO_REFS);
+      cache_extent_discard(ccp, addr_arr[j], PAGE_TYPE_BRANCH);
+      ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_BRANCH);
+      platform_assert(ref == AL_FREE);
+   }
+
+   cache_print_stats(Platform_default_log_handle, ccp);
+   platform_free(hid, addr_arr);
+   clockcache_deinit(cc);
+   platform_free(hid, cc);
+
+   if (SUCCESS(rc)) {
+      platform_default_log("cache_test: compressed tier test passed\n");
+   } else {
+      platform_default_log("cache_test: compressed tier test failed\n");
+   }
+
+   return rc;
+}
+
+/*
+ * Verify that branch pages written back through a codec are stored
+ * compressed on disk and read back intact, both by cache_get and by
+ * cache_prefetch.
+ */
+platform_status
+test_cache_branch_codec(clockcache_config *base_cfg,
+                        io_handle         *io,
+                        allocator         *al,
+                        platform_heap_id   hid)
+{
+   platform_default_log("cache_test: branch codec test started\n");
+   platform_status   rc       = STATUS_OK;
+   uint64           *addr_arr = NULL;
+   clockcache_config cfg      = *base_cfg;
+   cfg.branch_codec           = &page_codec_lz;
+   cfg.use_stats              = TRUE;
+
+   clockcache *cc = TYPED_MALLOC(hid, cc);
+   platform_assert(cc != NULL);
+   rc = clockcache_init(
+      cc, &cfg, io, al, "branch codec", hid, platform_get_module_id());
+   platform_assert_status_ok(rc);
+   cache *ccp = (cache *)cc;
+
+   uint64 page_size           = cache_config_page_size(&cfg.super);
+   uint64 pages_per_extent    = cache_config_pages_per_extent(&cfg.super);
+   uint32 extents_to_allocate = cfg.page_capacity / pages_per_extent / 2;
+   addr_arr = TYPED_ARRAY_MALLOC(hid, addr_arr, extents_to_allocate);
+   platform_assert(addr_arr != NULL);
+   for (uint32 j = 0; j < extents_to_allocate; j++) {
+      rc = allocator_alloc(al, &addr_arr[j], PAGE_TYPE_BRANCH);
+      platform_assert_status_ok(rc);
+      for (uint64 i = 0; i < pages_per_extent; i++) {
+         uint64       addr = addr_arr[j] + i * page_size;
+         page_handle *page = cache_alloc(ccp, addr, PAGE_TYPE_BRANCH);
+         cache_test_fill_page(page->data, page_size, addr);
+         cache_unlock(ccp, page);
+         cache_unclaim(ccp, page);
+         cache_unget(ccp, page);
+      }
+   }
+   cache_flush(ccp);
+
+   char *expected = TYPED_ARRAY_MALLOC(hid, expected, page_size);
+   platform_assert(expected != NULL);
+   char *on_disk = TYPED_ARRAY_MALLOC(hid, on_disk, page_size);
+   platform_assert(on_disk != NULL);
+   rc = io_read(io, on_disk, page_size, addr_arr[0]);
+   platform_assert_status_ok(rc);
+   if (!page_codec_is_encoded(on_disk)) {
+      platform_error_log("Page %lu not compressed on disk\n", addr_arr[0]);
+      rc = STATUS_TEST_FAILED;
+   }
+
+   for (uint64 pass = 0; pass < 2 && SUCCESS(rc); pass++) {
+      cache_evict(ccp, FALSE);
+      for (uint32 j = 0; j < extents_to_allocate && SUCCESS(rc); j++) {
+         if (pass == 1) {
+            cache_prefetch(ccp, addr_arr[j], PAGE_TYPE_BRANCH);
+         }
+         for (uint64 i = 0; i < pages_per_extent; i++) {
+            uint64       addr = addr_arr[j] + i * page_size;
+            page_handle *page = cache_get(ccp, addr, TRUE, PAGE_TYPE_BRANCH);
+            cache_test_fill_page(expected, page_size, addr);
+            if (memcmp(page->data, expected, page_size) != 0) {
+               platform_error_log("Page %lu corrupted\n", addr);
+               rc = STATUS_TEST_FAILED;
+            }
+            cache_unget(ccp, page);
+         }
+      }
+   }
+   platform_free(hid, on_disk);
+   platform_free(hid, expected);
+
+   for (uint32 j = 0; j < extents_to_allocate; j++) {
+      uint8 ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_BRANCH);
+      platform_assert(ref == AL_NO_REFS);
+      cache_extent_discard(ccp, addr_arr[j], PAGE_TYPE_BRANCH);
+      ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_BRANCH);
+      platform_assert(ref == AL_FREE);
+   }
+
+   cache_print_stats(Platform_default_log_handle, ccp);
+   platform_free(hid, addr_arr);
+   clockcache_deinit(cc);
+   platform_free(hid, cc);
+
+   if (SUCCESS(rc)) {
+      platform_default_log("cache_test: branch codec test passed\n");
+   } else {
+      platform_default_log("cache_test: branch codec test failed\n");
+   }
+
+   return rc;
+}
+
+static void
+cache_test_alloc_filled_extent(cache *cc, allocator *al, uint64 *extent_addr)
+{
+   uint64 page_size   = cache_page_size(cc);
+   uint64 extent_size = cache_extent_size(cc);
+
+   platform_status rc = allocator_alloc(al, extent_addr, PAGE_TYPE_MISC);
+   platform_assert_status_ok(rc);
+   for (uint64 i = 0; i < extent_size / page_size; i++) {
+      uint64       addr = *extent_addr + i * page_size;
+      page_handle *page = cache_alloc(cc, addr, PAGE_TYPE_MISC);
+      cache_test_fill_page(page->data, page_size, addr);
+      cache_unlock(cc, page);
+      cache_unclaim(cc, page);
+      cache_unget(cc, page);
+   }
+}
+
+/*
+ * Verify that the background cleaner writes back dirty pages ahead of the
+ * clock hands, and that pages dirtied under it read back intact after being
+ * churned through twice the cache's capacity.
+ */
+platform_status
+test_cache_cleaner(clockcache_config *base_cfg,
+                   io_handle         *io,
+                   allocator         *al,
+                   task_system       *ts,
+                   platform_heap_id   hid)
+{
+   platform_default_log("cache_test: cleaner test started\n");
+   platform_status   rc       = STATUS_OK;
+   uint64           *addr_arr = NULL;
+   clockcache_config cfg      = *base_cfg;
+   cfg.cleaner_clean_share    = 100;
+   cfg.use_stats              = TRUE;
+
+   clockcache *cc = TYPED_MALLOC(hid, cc);
+   platform_assert(cc != NULL);
+   rc = clockcache_init(
+      cc, &cfg, io, al, "cleaner", hid, platform_get_module_id());
+   platform_assert_status_ok(rc);
+   rc = clockcache_start_cleaner(cc, ts);
+   platform_assert_status_ok(rc);
+   cache *ccp = (cache *)cc;
+
+   uint64 page_size           = cache_config_page_size(&cfg.super);
+   uint64 pages_per_extent    = cache_config_pages_per_extent(&cfg.super);
+   uint32 extents_to_allocate = 2 * cfg.page_capacity / pages_per_extent;
+   addr_arr = TYPED_ARRAY_MALLOC(hid, addr_arr, extents_to_allocate);
+   platform_assert(addr_arr != NULL);
+
+   /* fill the cache with pages and write them back */
+   uint32 extents_per_cache = cfg.page_capacity / pages_per_extent;
+   uint32 j;
+   for (j = 0; j < extents_per_cache; j++) {
+      cache_test_alloc_filled_extent(ccp, al, &addr_arr[j]);
+   }
+   cache_flush(ccp);
+
+   /* dirty every other extent again */
+   for (j = 0; j < extents_per_cache; j += 2) {
+      for (uint64 i = 0; i < pages_per_extent; i++) {
+         uint64       addr    = addr_arr[j] + i * page_size;
+         page_handle *page    = cache_get(ccp, addr, TRUE, PAGE_TYPE_MISC);
+         bool32       claimed = cache_try_claim(ccp, page);
+         platform_assert(claimed);
+         cache_lock(ccp, page);
+         cache_mark_dirty(ccp, page);
+         cache_unlock(ccp, page);
+         cache_unclaim(ccp, page);
+         cache_unget(ccp, page);
+      }
+   }
+
+   /*
+    * The next allocation sends the evict hand around the cache once to clear
+    * the access bits before it can evict the clean extents. That leaves the
+    * dirty extents past the cleaning hand evictable but dirty, so the
+    * cleaner should write them back on its own.
+    */
+   const threadid tid = platform_get_tid();
+   for (j = extents_per_cache; j < extents_to_allocate; j++) {
+      cache_test_alloc_filled_extent(ccp, al, &addr_arr[j]);
+      if (j == extents_per_cache) {
+               uint64 pages_written = 0;
+         for (uint64 wait = 0; wait < 1000 && pages_written == 0; wait++) {
+            platform_sleep_ns(MILLION);
+            for (threadid i = 0; i < MAX_THREADS; i++) {
+               if (i != tid) {
+                  pages_written += cc->stats[i].page_writes[PAGE_TYPE_MISC];
+               }
+            }
+         }
+         if (pages_written == 0) {
+            platform_error_log("Cleaner wrote back no pages\n");
+            rc = STATUS_TEST_FAILED;
+         }
+      }
+   }
+
+   char *expected = TYPED_ARRAY_MALLOC(hid, expected, page_size);
+   platform_assert(expected != NULL);
+   for (j = 0; j < extents_to_allocate && SUCCESS(rc); j++) {
+      for (uint64 i = 0; i < pages_per_extent; i++) {
+         uint64       addr = addr_arr[j] + i * page_size;
+         page_handle *page = cache_get(ccp, addr, TRUE, PAGE_TYPE_MISC);
+         cache_test_fill_page(expected, page_size, addr);
+         if (memcmp(page->data, expected, page_size) != 0) {
+            platform_error_log("Page %lu corrupted\n", addr);
+            rc = STATUS_TEST_FAILED;
+         }
+         cache_unget(ccp, page);
+      }
+   }
+   platform_free(hid, expected);
+
+   for (j = 0; j < extents_to_allocate; j++) {
+      uint8 ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_MISC);
+      platform_assert(ref == AL_NO_REFS);
+      cache_extent_discard(ccp, addr_arr[j], PAGE_TYPE_MISC);
+      ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_MISC);
+      platform_assert(ref == AL_FREE);
+   }
+
+   cache_print_stats(Platform_default_log_handle, ccp);
+   platform_free(hid, addr_arr);
+   clockcache_deinit(cc);
+   platform_free(hid, cc);
+
+   if (SUCCESS(rc)) {
+      platform_default_log("cache_test: cleaner test passed\n");
+   } else {
+      platform_default_log("cache_test: cleaner test failed\n");
+   }
+
+   return rc;
+}
+
+static int
+cache_test_addr_compare(const void *a, const void *b, void *unused)
+{
+   uint64 addr_a = *(const uint64 *)a;
+   uint64 addr_b = *(const uint64 *)b;
+   return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+/*
+ * Verify that flushing dirty extents which are adjacent on disk issues a
+ * single write per run of adjacent extents, as long as the run fits in
+ * io_cfg->async_max_pages.
+ */
+platform_status
+test_cache_coalesced(clockcache_config *base_cfg,
+                     io_handle         *io,
+                     allocator         *al,
+                     platform_heap_id   hid)
+{
+   platform_default_log("cache_test: coalesced writeback test started\n");
+   platform_status   rc  = STATUS_OK;
+   clockcache_config cfg = *base_cfg;
+   cfg.use_stats         = TRUE;
+
+   clockcache *cc = TYPED_MALLOC(hid, cc);
+   platform_assert(cc != NULL);
+   rc = clockcache_init(
+      cc, &cfg, io, al, "coalesced", hid, platform_get_module_id());
+   platform_assert_status_ok(rc);
+   cache *ccp = (cache *)cc;
+
+   uint64 page_size        = cache_config_page_size(&cfg.super);
+   uint64 pages_per_extent = cache_config_pages_per_extent(&cfg.super);
+   uint64 num_extents =
+      MIN(8, cfg.io_cfg->async_max_pages / pages_per_extent);
+   uint64 addr_arr[8];
+   for (uint64 j = 0; j < num_extents; j++) {
+      rc = allocator_alloc(al, &addr_arr[j], PAGE_TYPE_MISC);
+      platform_assert_status_ok(rc);
+      for (uint64 i = 0; i < pages_per_extent; i++) {
+         page_handle *page =
+            cache_alloc(ccp, addr_arr[j] + i * page_size, PAGE_TYPE_MISC);
+         cache_unlock(ccp, page);
+         cache_unclaim(ccp, page);
+         cache_unget(ccp, page);
+      }
+   }
+
+   platform_sort_slow(addr_arr,
+                      num_extents,
+                      sizeof(addr_arr[0]),
+                      cache_test_addr_compare,
+                      NULL,
+                      NULL);
+   uint64 num_runs = 1;
+   for (uint64 j = 1; j < num_extents; j++) {
+      if (addr_arr[j] != addr_arr[j - 1] + pages_per_extent * page_size) {
+         num_runs++;
+      }
+   }
+
+   cache_flush(ccp);
+   uint64 writes_issued = 0;
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      writes_issued += cc->stats[tid].writes_issued;
+   }
+   platform_default_log("cache_test: %lu extents in %lu runs flushed with "
+                        "%lu writes\n",
+                        num_extents,
+                        num_runs,
+                        writes_issued);
+   if (writes_issued != num_runs) {
+      rc = STATUS_TEST_FAILED;
+   }
+
+   for (uint64 j = 0; j < num_extents; j++) {
+      uint8 ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_MISC);
+      platform_assert(ref == AL_NO_REFS);
+      cache_extent_discard(ccp, addr_arr[j], PAGE_TYPE_MISC);
+      ref = allocator_dec_ref(al, addr_arr[j], PAGE_TYPE_MISC);
+      platform_assert(ref == AL_FREE);
+   }
+
+   clockcache_deinit(cc);
+   platform_free(hid, cc);
+
+   if (SUCCESS(rc)) {
+      platform_default_log("cache_test: coalesced writeback test passed\n");
+   } else {
+      platform_default_log("cache_test: coalesced writeback test failed\n");
+   }
+
+   return rc;
+}
+
 typedef struct {
    enum { MONO, RAND, HOP } type;
    union {
@@ -1121,6 +1629,21 @@ cache_test(int argc, char *argv[])
       platform_assert(SUCCESS(rc));
    } else {
       rc = test_cache_basic(ccp, &cache_cfg, hid);
+      platform_assert_status_ok(rc);
+      rc = test_cache_pin_trunk(
+         &cache_cfg, (io_handle *)io, (allocator *)&al, hid);
+      platform_assert_status_ok(rc);
+      rc = test_cache_compressed(
+         &cache_cfg, (io_handle *)io, (allocator *)&al, hid);
+      platform_assert_status_ok(rc);
+      rc = test_cache_branch_codec(
+         &cache_cfg, (io_handle *)io, (allocator *)&al, hid);
+      platform_assert_status_ok(rc);
+      rc = test_cache_cleaner(
+         &cache_cfg, (io_handle *)io, (allocator *)&al, ts, hid);
+      platform_assert_status_ok(rc);
+      rc = test_cache_coalesced(
+         &cache_cfg, (io_handle *)io, (allocator *)&al, hid);
    }
    platform_assert_status_ok(rc);
 
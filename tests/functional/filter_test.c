@@ -89,6 +89,15 @@ test_filter_basic(cache           *cc,
                         num_input_keys[num_values - 1],
                         num_unique);
 
+   routing_sketch sketch;
+   ZERO_CONTENTS(&sketch);
+   for (uint64 i = 0; i < num_values; i++) {
+      routing_filter_sketch_merge(cc, cfg, &filter[i + 1], &sketch);
+   }
+   platform_default_log("across filters: num input keys %8u sketch %8lu\n",
+                        num_input_keys[num_values - 1],
+                        routing_sketch_estimate_unique_keys(&sketch));
+
    platform_free(hid, num_input_keys);
 
    for (uint64 i = 0; i < num_values; i++) {
@@ -401,6 +410,22 @@ filter_test(int argc, char *argv[])
       rc = test_filter_basic(
          (cache *)cc, &cfg->filter_cfg, hid, 1, 2 * cfg->fanout);
       platform_assert(SUCCESS(rc));
+
+      rc = test_filter_basic((cache *)cc,
+                             &cfg->bloom_filter_cfg,
+                             hid,
+                             max_tuples_per_memtable,
+                             cfg->fanout);
+      platform_assert(SUCCESS(rc));
+      rc = test_filter_basic((cache *)cc,
+                             &cfg->bloom_filter_cfg,
+                             hid,
+                             50,
+                             cfg->max_branches_per_node);
+      platform_assert(SUCCESS(rc));
+      rc = test_filter_basic(
+         (cache *)cc, &cfg->bloom_filter_cfg, hid, 1, 2 * cfg->fanout);
+      platform_assert(SUCCESS(rc));
    }
 
    clockcache_deinit(cc);
@@ -2794,6 +2794,8 @@ splinter_test(int argc, char *argv[])
                            hid,
                            platform_get_module_id());
       platform_assert_status_ok(rc);
+      rc = clockcache_start_cleaner(&cc[idx], ts);
+      platform_assert_status_ok(rc);
    }
    allocator *alp = (allocator *)&al;
 
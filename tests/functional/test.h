@@ -229,6 +229,9 @@ test_config_init(trunk_config           *splinter_cfg,  // OUT
                   master_cfg->io_perms,
                   master_cfg->io_async_queue_depth,
                   master_cfg->io_filename);
+   if (master_cfg->io_async_max_pages != 0) {
+      io_cfg->async_max_pages = master_cfg->io_async_max_pages;
+   }
 
    allocator_config_init(allocator_cfg, io_cfg, master_cfg->allocator_capacity);
 
@@ -237,6 +240,18 @@ test_config_init(trunk_config           *splinter_cfg,  // OUT
                           master_cfg->cache_capacity,
                           master_cfg->cache_logfile,
                           master_cfg->use_stats);
+   cache_cfg->type_min_share[PAGE_TYPE_TRUNK] =
+      master_cfg->cache_trunk_min_share;
+   cache_cfg->type_min_share[PAGE_TYPE_FILTER] =
+      master_cfg->cache_filter_min_share;
+   cache_cfg->type_max_share[PAGE_TYPE_BRANCH] =
+      master_cfg->cache_branch_max_share;
+   cache_cfg->pin_trunk_pages     = master_cfg->cache_pin_trunk_pages;
+   cache_cfg->compressed_capacity = master_cfg->cache_compressed_capacity;
+   cache_cfg->cleaner_clean_share = master_cfg->cache_cleaner_clean_share;
+   if (master_cfg->cache_branch_compression) {
+      cache_cfg->branch_codec = &page_codec_lz;
+   }
 
    shard_log_config_init(log_cfg, &cache_cfg->super, *data_cfg);
 
@@ -268,6 +283,31 @@ test_config_init(trunk_config           *splinter_cfg,  // OUT
    if (!SUCCESS(rc)) {
       return rc;
    }
+   if (master_cfg->btree_readahead_max_extents != 0) {
+      splinter_cfg->btree_cfg.readahead_max_extents =
+         master_cfg->btree_readahead_max_extents;
+   }
+   splinter_cfg->btree_cfg.readahead_budget_extents =
+      master_cfg->btree_readahead_budget;
+   splinter_cfg->btree_cfg.key_prefix_slots =
+      master_cfg->btree_key_prefix_slots;
+   splinter_cfg->btree_cfg.prefix_compression =
+      master_cfg->btree_prefix_compression;
+   splinter_cfg->mt_cfg.engine = master_cfg->memtable_skiplist
+                                    ? MEMTABLE_ENGINE_SKIPLIST
+                                    : MEMTABLE_ENGINE_BTREE;
+   splinter_cfg->mt_cfg.hash_index = master_cfg->memtable_hash_index;
+   splinter_cfg->bloom_filter_heights = master_cfg->filter_bloom_heights;
+   splinter_cfg->filter_cache_size    = master_cfg->filter_cache_size;
+   splinter_cfg->filter_cache_heights = master_cfg->filter_cache_heights != 0
+                                           ? master_cfg->filter_cache_heights
+                                           : ~1ULL;
+   splinter_cfg->filter_adaptive_fingerprints =
+      master_cfg->filter_adaptive_fingerprints;
+   if (master_cfg->filter_bloom_bits_per_key != 0) {
+      splinter_cfg->bloom_filter_cfg.bloom_bits_per_key =
+         master_cfg->filter_bloom_bits_per_key;
+   }
 
    gen->type             = MESSAGE_TYPE_INSERT;
    gen->min_payload_size = GENERATOR_MIN_PAYLOAD_SIZE;
@@ -58,6 +58,11 @@ query_tests(cache           *cc,
             uint64           root_addr,
             int              nkvs);
 
+static uint64
+count_prefix_compressed_leaves(cache        *cc,
+                               btree_config *cfg,
+                               uint64        root_addr);
+
 static int
 iterator_tests(cache           *cc,
                btree_config    *cfg,
@@ -80,6 +85,26 @@ pack_tests(cache           *cc,
            uint64           root_addr,
            uint64           nkvs);
 
+static void
+partition_bounds(cache           *cc,
+                 btree_config    *cfg,
+                 uint64           root_addr,
+                 uint64           nkvs,
+                 uint64           num_parts,
+                 key_buffer       bounds[],
+                 platform_heap_id hid);
+
+static uint64
+pack_partitioned_tests(cache           *cc,
+                       btree_config    *cfg,
+                       platform_heap_id hid,
+                       uint64           root_addr,
+                       uint64           nkvs,
+                       uint64           num_parts,
+                       key_buffer       bounds[],
+                       uint64           short_part,
+                       platform_status *part_rc);
+
 static key
 gen_key(btree_config *cfg, uint64 i, uint8 *buffer, size_t length);
 
@@ -307,6 +332,308 @@ CTEST2(btree_stress, test_random_inserts_concurrent)
    platform_free(hid, threads);
 }
 
+/*
+ * -------------------------------------------------------------------------
+ * Test case to exercise concurrent inserts with optimistic lock coupling,
+ * where inserters lock only the leaf they change, and verify the tree.
+ */
+CTEST2(btree_stress, test_random_inserts_concurrent_optimistic)
+{
+   int nkvs     = 1000000;
+   int nthreads = 8;
+
+   data->dbtree_cfg.optimistic_inserts = TRUE;
+
+   mini_allocator mini;
+
+   uint64 root_addr = btree_create(
+      (cache *)&data->cc, &data->dbtree_cfg, &mini, PAGE_TYPE_MEMTABLE);
+
+   platform_heap_id      hid     = data->hid;
+   insert_thread_params *params  = TYPED_ARRAY_ZALLOC(hid, params, nthreads);
+   platform_thread      *threads = TYPED_ARRAY_ZALLOC(hid, threads, nthreads);
+
+   for (uint64 i = 0; i < nthreads; i++) {
+      params[i].cc        = (cache *)&data->cc;
+      params[i].cfg       = &data->dbtree_cfg;
+      params[i].hid       = data->hid;
+      params[i].scratch   = TYPED_MALLOC(data->hid, params[i].scratch);
+      params[i].mini      = &mini;
+      params[i].root_addr = root_addr;
+      params[i].start     = i * (nkvs / nthreads);
+      params[i].end = i < nthreads - 1 ? (i + 1) * (nkvs / nthreads) : nkvs;
+   }
+
+   for (uint64 i = 0; i < nthreads; i++) {
+      platform_status ret = task_thread_create("insert thread",
+                                               insert_thread,
+                                               &params[i],
+                                               0,
+                                               data->ts,
+                                               data->hid,
+                                               &threads[i]);
+      ASSERT_TRUE(SUCCESS(ret));
+   }
+
+   for (uint64 thread_no = 0; thread_no < nthreads; thread_no++) {
+      platform_thread_join(threads[thread_no]);
+   }
+
+   ASSERT_TRUE(btree_verify_tree((cache *)&data->cc,
+                                 &data->dbtree_cfg,
+                                 root_addr,
+                                 PAGE_TYPE_MEMTABLE));
+
+   int rc = query_tests((cache *)&data->cc,
+                        &data->dbtree_cfg,
+                        data->hid,
+                        PAGE_TYPE_MEMTABLE,
+                        root_addr,
+                        nkvs);
+   ASSERT_NOT_EQUAL(0, rc, "Invalid tree\n");
+
+   rc = iterator_tests((cache *)&data->cc,
+                       &data->dbtree_cfg,
+                       root_addr,
+                       nkvs,
+                       TRUE,
+                       data->hid);
+   ASSERT_NOT_EQUAL(0, rc, "Invalid ranges in tree\n");
+
+   for (uint64 i = 0; i < nthreads; i++) {
+      platform_free(data->hid, params[i].scratch);
+   }
+   platform_free(hid, params);
+   platform_free(hid, threads);
+}
+
+/*
+ * -------------------------------------------------------------------------
+ * Test case to pack a branch with prefix compression enabled, and verify
+ * that lookups, iterators and seeks see the same data as in the memtable.
+ */
+CTEST2(btree_stress, test_packed_prefix_compression)
+{
+   int nkvs = 100000;
+
+   data->dbtree_cfg.prefix_compression = TRUE;
+
+   mini_allocator mini;
+
+   uint64 root_addr = btree_create(
+      (cache *)&data->cc, &data->dbtree_cfg, &mini, PAGE_TYPE_MEMTABLE);
+
+   insert_tests((cache *)&data->cc,
+                &data->dbtree_cfg,
+                data->hid,
+                &data->test_scratch,
+                &mini,
+                root_addr,
+                0,
+                nkvs);
+
+   uint64 packed_root_addr = pack_tests(
+      (cache *)&data->cc, &data->dbtree_cfg, data->hid, root_addr, nkvs);
+   ASSERT_NOT_EQUAL(0, packed_root_addr, "Pack failed.\n");
+
+   ASSERT_NOT_EQUAL(0,
+                    count_prefix_compressed_leaves((cache *)&data->cc,
+                                                   &data->dbtree_cfg,
+                                                   packed_root_addr),
+                    "No leaf of the packed tree was prefix-compressed\n");
+
+   ASSERT_TRUE(btree_verify_tree((cache *)&data->cc,
+                                 &data->dbtree_cfg,
+                                 packed_root_addr,
+                                 PAGE_TYPE_BRANCH));
+
+   int rc = query_tests((cache *)&data->cc,
+                        &data->dbtree_cfg,
+                        data->hid,
+                        PAGE_TYPE_BRANCH,
+                        packed_root_addr,
+                        nkvs);
+   ASSERT_NOT_EQUAL(0, rc, "Invalid tree\n");
+
+   rc = iterator_tests((cache *)&data->cc,
+                       &data->dbtree_cfg,
+                       packed_root_addr,
+                       nkvs,
+                       TRUE,
+                       data->hid);
+   ASSERT_NOT_EQUAL(0, rc, "Invalid ranges in packed tree\n");
+
+   rc = iterator_tests((cache *)&data->cc,
+                       &data->dbtree_cfg,
+                       packed_root_addr,
+                       nkvs,
+                       FALSE,
+                       data->hid);
+   ASSERT_NOT_EQUAL(0, rc, "Invalid ranges in packed tree, from the back\n");
+
+   rc = iterator_seek_tests((cache *)&data->cc,
+                            &data->dbtree_cfg,
+                            packed_root_addr,
+                            nkvs,
+                            data->hid);
+   ASSERT_NOT_EQUAL(0, rc, "Invalid ranges when seeking in packed tree\n");
+}
+
+/*
+ * Test that a tree packed in key ranges by btree_pack_partition and stitched
+ * by btree_pack_stitch is a valid tree holding every tuple, whose leaves are
+ * linked across the seams between ranges. One range is empty.
+ */
+CTEST2(btree_stress, test_packed_partitions_stitched)
+{
+   int        nkvs      = 100000;
+   uint64     num_parts = 5;
+   key_buffer bounds[5 + 1];
+
+   mini_allocator mini;
+
+   uint64 root_addr = btree_create(
+      (cache *)&data->cc, &data->dbtree_cfg, &mini, PAGE_TYPE_MEMTABLE);
+
+   insert_tests((cache *)&data->cc,
+                &data->dbtree_cfg,
+                data->hid,
+                &data->test_scratch,
+                &mini,
+                root_addr,
+                0,
+                nkvs);
+
+   partition_bounds((cache *)&data->cc,
+                    &data->dbtree_cfg,
+                    root_addr,
+                    nkvs,
+                    num_parts,
+                    bounds,
+                    data->hid);
+   // make the middle range empty
+   platform_status rc =
+      key_buffer_copy_key(&bounds[3], key_buffer_key(&bounds[2]));
+   ASSERT_TRUE(SUCCESS(rc));
+
+   platform_status part_rc;
+   uint64          packed_root_addr = pack_partitioned_tests((cache *)&data->cc,
+                                                     &data->dbtree_cfg,
+                                                     data->hid,
+                                                     root_addr,
+                                                     nkvs,
+                                                     num_parts,
+                                                     bounds,
+                                                     num_parts,
+                                                     &part_rc);
+   ASSERT_TRUE(SUCCESS(part_rc));
+   ASSERT_NOT_EQUAL(0, packed_root_addr, "Stitch failed.\n");
+
+   ASSERT_TRUE(btree_verify_tree((cache *)&data->cc,
+                                 &data->dbtree_cfg,
+                                 packed_root_addr,
+                                 PAGE_TYPE_BRANCH));
+
+   int test_rc = query_tests((cache *)&data->cc,
+                             &data->dbtree_cfg,
+                             data->hid,
+                             PAGE_TYPE_BRANCH,
+                             packed_root_addr,
+                             nkvs);
+   ASSERT_NOT_EQUAL(0, test_rc, "Invalid tree\n");
+
+   test_rc = iterator_tests((cache *)&data->cc,
+                            &data->dbtree_cfg,
+                            packed_root_addr,
+                            nkvs,
+                            TRUE,
+                            data->hid);
+   ASSERT_NOT_EQUAL(0, test_rc, "Invalid ranges in stitched tree\n");
+
+   test_rc = iterator_tests((cache *)&data->cc,
+                            &data->dbtree_cfg,
+                            packed_root_addr,
+                            nkvs,
+                            FALSE,
+                            data->hid);
+   ASSERT_NOT_EQUAL(
+      0, test_rc, "Invalid ranges in stitched tree, from the back\n");
+
+   test_rc = iterator_seek_tests((cache *)&data->cc,
+                                 &data->dbtree_cfg,
+                                 packed_root_addr,
+                                 nkvs,
+                                 data->hid);
+   ASSERT_NOT_EQUAL(
+      0, test_rc, "Invalid ranges when seeking in stitched tree\n");
+
+   for (uint64 i = 0; i <= num_parts; i++) {
+      key_buffer_deinit(&bounds[i]);
+   }
+}
+
+/*
+ * Test that a range which fails to pack still leaves a stitchable, valid
+ * tree of the tuples packed so far, which can then be discarded, as a
+ * partitioned compaction does.
+ */
+CTEST2(btree_stress, test_packed_partitions_failed_range)
+{
+   int        nkvs      = 50000;
+   uint64     num_parts = 4;
+   key_buffer bounds[4 + 1];
+
+   mini_allocator mini;
+
+   uint64 root_addr = btree_create(
+      (cache *)&data->cc, &data->dbtree_cfg, &mini, PAGE_TYPE_MEMTABLE);
+
+   insert_tests((cache *)&data->cc,
+                &data->dbtree_cfg,
+                data->hid,
+                &data->test_scratch,
+                &mini,
+                root_addr,
+                0,
+                nkvs);
+
+   partition_bounds((cache *)&data->cc,
+                    &data->dbtree_cfg,
+                    root_addr,
+                    nkvs,
+                    num_parts,
+                    bounds,
+                    data->hid);
+
+   platform_status part_rc;
+   uint64          packed_root_addr = pack_partitioned_tests((cache *)&data->cc,
+                                                     &data->dbtree_cfg,
+                                                     data->hid,
+                                                     root_addr,
+                                                     nkvs,
+                                                     num_parts,
+                                                     bounds,
+                                                     1,
+                                                     &part_rc);
+   ASSERT_TRUE(STATUS_IS_EQ(part_rc, STATUS_LIMIT_EXCEEDED));
+   ASSERT_NOT_EQUAL(0, packed_root_addr, "Stitch failed.\n");
+
+   ASSERT_TRUE(btree_verify_tree((cache *)&data->cc,
+                                 &data->dbtree_cfg,
+                                 packed_root_addr,
+                                 PAGE_TYPE_BRANCH));
+
+   btree_dec_ref_range((cache *)&data->cc,
+                       &data->dbtree_cfg,
+                       packed_root_addr,
+                       NEGATIVE_INFINITY_KEY,
+                       POSITIVE_INFINITY_KEY);
+
+   for (uint64 i = 0; i <= num_parts; i++) {
+      key_buffer_deinit(&bounds[i]);
+   }
+}
+
 /*
  * ********************************************************************************
  * Define minions and helper functions used by this test suite.
@@ -364,6 +691,136 @@ insert_tests(cache           *cc,
    platform_free(hid, msgbuf);
 }
 
+/*
+ * Splits the nkvs tuples of the tree at root_addr into num_parts key ranges
+ * of about the same size, [bounds[i], bounds[i + 1]).
+ */
+static void
+partition_bounds(cache           *cc,
+                 btree_config    *cfg,
+                 uint64           root_addr,
+                 uint64           nkvs,
+                 uint64           num_parts,
+                 key_buffer       bounds[],
+                 platform_heap_id hid)
+{
+   btree_iterator dbiter;
+   iterator      *iter = (iterator *)&dbiter;
+
+   btree_iterator_init(cc,
+                       cfg,
+                       &dbiter,
+                       root_addr,
+                       PAGE_TYPE_MEMTABLE,
+                       NEGATIVE_INFINITY_KEY,
+                       POSITIVE_INFINITY_KEY,
+                       NEGATIVE_INFINITY_KEY,
+                       greater_than_or_equal,
+                       FALSE,
+                       0);
+
+   key_buffer_init_from_key(&bounds[0], hid, NEGATIVE_INFINITY_KEY);
+   uint64 part_no = 1;
+   for (uint64 seen = 0; iterator_can_curr(iter); seen++) {
+      if (part_no < num_parts && seen == nkvs * part_no / num_parts) {
+         key     curr_key;
+         message msg;
+         iterator_curr(iter, &curr_key, &msg);
+         key_buffer_init_from_key(&bounds[part_no], hid, curr_key);
+         part_no++;
+      }
+      platform_status rc = iterator_next(iter);
+      ASSERT_TRUE(SUCCESS(rc));
+   }
+   ASSERT_EQUAL(num_parts, part_no);
+   key_buffer_init_from_key(&bounds[num_parts], hid, POSITIVE_INFINITY_KEY);
+
+   btree_iterator_deinit(&dbiter);
+}
+
+/*
+ * Packs the tree at root_addr in the key ranges of bounds, one
+ * btree_pack_partition each, and stitches them with btree_pack_stitch.
+ * Range short_part, if less than num_parts, has room for only half its
+ * tuples. Returns the root of the stitched tree, and in part_rc the status of
+ * the last range which failed to pack, if any.
+ */
+static uint64
+pack_partitioned_tests(cache           *cc,
+                       btree_config    *cfg,
+                       platform_heap_id hid,
+                       uint64           root_addr,
+                       uint64           nkvs,
+                       uint64           num_parts,
+                       key_buffer       bounds[],
+                       uint64           short_part,
+                       platform_status *part_rc)
+{
+   btree_iterator  *part_iter = TYPED_ARRAY_MALLOC(hid, part_iter, num_parts);
+   btree_pack_req  *part_req  = TYPED_ARRAY_MALLOC(hid, part_req, num_parts);
+   btree_pack_req **parts     = TYPED_ARRAY_MALLOC(hid, parts, num_parts);
+   ASSERT_TRUE(part_iter != NULL && part_req != NULL && parts != NULL);
+
+   *part_rc = STATUS_OK;
+   for (uint64 part_no = 0; part_no < num_parts; part_no++) {
+      key start_key = key_buffer_key(&bounds[part_no]);
+      key end_key   = key_buffer_key(&bounds[part_no + 1]);
+      btree_iterator_init(cc,
+                          cfg,
+                          &part_iter[part_no],
+                          root_addr,
+                          PAGE_TYPE_MEMTABLE,
+                          start_key,
+                          end_key,
+                          start_key,
+                          greater_than_or_equal,
+                          FALSE,
+                          0);
+      uint64 max_tuples = nkvs;
+      if (part_no == short_part) {
+         max_tuples = nkvs / num_parts / 2;
+      }
+      platform_status rc = btree_pack_req_init(&part_req[part_no],
+                                               cc,
+                                               cfg,
+                                               &part_iter[part_no].super,
+                                               max_tuples,
+                                               NULL,
+                                               0,
+                                               hid);
+      ASSERT_TRUE(SUCCESS(rc));
+      rc = btree_pack_partition(&part_req[part_no]);
+      if (!SUCCESS(rc)) {
+         *part_rc = rc;
+      }
+      parts[part_no] = &part_req[part_no];
+   }
+
+   btree_pack_req  req;
+   platform_status rc =
+      btree_pack_req_init(&req, cc, cfg, NULL, nkvs, NULL, 0, hid);
+   ASSERT_TRUE(SUCCESS(rc));
+   btree_pack_stitch(&req, parts, num_parts);
+   if (SUCCESS(*part_rc)) {
+      ASSERT_EQUAL(nkvs, req.num_tuples);
+   } else {
+      ASSERT_TRUE(req.num_tuples < nkvs);
+   }
+   CTEST_LOG_INFO(
+      "Stitched %lu items from %lu ranges ", req.num_tuples, num_parts);
+   btree_pack_req_deinit(&req, hid);
+
+   for (uint64 part_no = 0; part_no < num_parts; part_no++) {
+      btree_pack_req_deinit(&part_req[part_no], hid);
+      btree_iterator_deinit(&part_iter[part_no]);
+   }
+   platform_free(hid, parts);
+   platform_free(hid, part_req);
+   platform_free(hid, part_iter);
+
+   return req.root_addr;
+}
+
 static key
 gen_key(btree_config *cfg, uint64 i, uint8 *buffer, size_t length)
 {
@@ -596,6 +1053,38 @@ iterator_seek_tests(cache           *cc,
    return 1;
 }
 
+/* Counts the leaves of a packed tree that have a key prefix. */
+static uint64
+count_prefix_compressed_leaves(cache        *cc,
+                               btree_config *cfg,
+                               uint64        root_addr)
+{
+   uint64       count = 0;
+   page_handle *page  = cache_get(cc, root_addr, TRUE, PAGE_TYPE_BRANCH);
+   btree_hdr   *hdr   = (btree_hdr *)page->data;
+
+   while (hdr->height > 0) {
+      uint64 child_addr = btree_get_child_addr(cfg, hdr, 0);
+      cache_unget(cc, page);
+      page = cache_get(cc, child_addr, TRUE, PAGE_TYPE_BRANCH);
+      hdr  = (btree_hdr *)page->data;
+   }
+
+   while (TRUE) {
+      if (hdr->prefix_length != 0) {
+         count++;
+      }
+      uint64 next_addr = hdr->next_addr;
+      cache_unget(cc, page);
+      if (next_addr == 0) {
+         break;
+      }
+      page = cache_get(cc, next_addr, TRUE, PAGE_TYPE_BRANCH);
+      hdr  = (btree_hdr *)page->data;
+   }
+   return count;
+}
+
 static uint64
 pack_tests(cache           *cc,
            btree_config    *cfg,
@@ -27,14 +27,14 @@ static int
 leaf_hdr_tests(btree_config *cfg, btree_scratch *scratch, platform_heap_id hid);
 
 static int
-leaf_hdr_search_tests(btree_config *cfg, platform_heap_id hid);
+leaf_hdr_search_tests(btree_config *cfg, int nkvs, platform_heap_id hid);
 static int
 index_hdr_tests(btree_config    *cfg,
                 btree_scratch   *scratch,
                 platform_heap_id hid);
 
 static int
-index_hdr_search_tests(btree_config *cfg, platform_heap_id hid);
+index_hdr_search_tests(btree_config *cfg, int nkvs, platform_heap_id hid);
 
 static int
 leaf_split_tests(btree_config    *cfg,
@@ -128,7 +128,7 @@ CTEST2(btree, test_leaf_hdr)
  */
 CTEST2(btree, test_leaf_hdr_search)
 {
-   int rc = leaf_hdr_search_tests(&data->dbtree_cfg, data->hid);
+   int rc = leaf_hdr_search_tests(&data->dbtree_cfg, 256, data->hid);
    ASSERT_EQUAL(0, rc);
 }
 
@@ -146,7 +146,7 @@ CTEST2(btree, test_index_hdr)
  */
 CTEST2(btree, test_index_hdr_search)
 {
-   int rc = index_hdr_search_tests(&data->dbtree_cfg, data->hid);
+   int rc = index_hdr_search_tests(&data->dbtree_cfg, 256, data->hid);
    ASSERT_EQUAL(0, rc);
 }
 
@@ -162,6 +162,34 @@ CTEST2(btree, test_leaf_split)
    }
 }
 
+/*
+ * Test the search and split paths on nodes whose offset table carries
+ * key prefix slots. The wider slots leave room for fewer entries.
+ */
+CTEST2(btree, test_leaf_hdr_search_prefix_slots)
+{
+   data->dbtree_cfg.key_prefix_slots = TRUE;
+   int rc = leaf_hdr_search_tests(&data->dbtree_cfg, 192, data->hid);
+   ASSERT_EQUAL(0, rc);
+}
+
+CTEST2(btree, test_index_hdr_search_prefix_slots)
+{
+   data->dbtree_cfg.key_prefix_slots = TRUE;
+   int rc = index_hdr_search_tests(&data->dbtree_cfg, 200, data->hid);
+   ASSERT_EQUAL(0, rc);
+}
+
+CTEST2(btree, test_leaf_split_prefix_slots)
+{
+   data->dbtree_cfg.key_prefix_slots = TRUE;
+   for (int nkvs = 2; nkvs < 100; nkvs++) {
+      int rc = leaf_split_tests(
+         &data->dbtree_cfg, &data->test_scratch, nkvs, data->hid);
+      ASSERT_EQUAL(0, rc);
+   }
+}
+
 /*
  * *****************************************************************
  * Helper functions, and actual test-case methods.
@@ -259,12 +287,11 @@ leaf_hdr_tests(btree_config *cfg, btree_scratch *scratch, platform_heap_id hid)
 }
 
 static int
-leaf_hdr_search_tests(btree_config *cfg, platform_heap_id hid)
+leaf_hdr_search_tests(btree_config *cfg, int nkvs, platform_heap_id hid)
 {
    char *leaf_buffer =
       TYPED_MANUAL_MALLOC(hid, leaf_buffer, btree_page_size(cfg));
-   btree_hdr *hdr  = (btree_hdr *)leaf_buffer;
-   int        nkvs = 256;
+   btree_hdr *hdr = (btree_hdr *)leaf_buffer;
 
    btree_init_hdr(cfg, hdr);
 
@@ -272,7 +299,8 @@ leaf_hdr_search_tests(btree_config *cfg, platform_heap_id hid)
       uint64 generation;
       uint8  keybuf[1];
       uint8  messagebuf[8];
-      keybuf[0]     = 17 * i;
+      // A permutation of [0, nkvs), as nkvs is coprime to 17
+      keybuf[0]     = (17 * i) % nkvs;
       messagebuf[0] = i;
 
       key     tuple_key = key_create(1, &keybuf);
@@ -363,12 +391,11 @@ index_hdr_tests(btree_config *cfg, btree_scratch *scratch, platform_heap_id hid)
 }
 
 static int
-index_hdr_search_tests(btree_config *cfg, platform_heap_id hid)
+index_hdr_search_tests(btree_config *cfg, int nkvs, platform_heap_id hid)
 {
    char *leaf_buffer =
       TYPED_MANUAL_MALLOC(hid, leaf_buffer, btree_page_size(cfg));
-   btree_hdr        *hdr  = (btree_hdr *)leaf_buffer;
-   int               nkvs = 256;
+   btree_hdr        *hdr = (btree_hdr *)leaf_buffer;
    btree_pivot_stats stats;
    memset(&stats, 0, sizeof(stats));
 
@@ -419,7 +446,7 @@ leaf_split_tests(btree_config    *cfg,
       message_create(MESSAGE_TYPE_INSERT, slice_create(msgsize, msg_buffer));
    message bigger_msg = message_create(
       MESSAGE_TYPE_INSERT,
-      slice_create(msgsize + sizeof(table_entry) + 1, msg_buffer));
+      slice_create(msgsize + btree_table_entry_size(cfg) + 1, msg_buffer));
 
    uint8 realnkvs = 0;
    while (realnkvs < nkvs) {
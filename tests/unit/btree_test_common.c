@@ -24,6 +24,9 @@ init_io_config_from_master_config(io_config *io_cfg, master_config *master_cfg)
                   master_cfg->io_perms,
                   master_cfg->io_async_queue_depth,
                   master_cfg->io_filename);
+   if (master_cfg->io_async_max_pages != 0) {
+      io_cfg->async_max_pages = master_cfg->io_async_max_pages;
+   }
    return 1;
 }
 
@@ -46,6 +49,18 @@ init_clockcache_config_from_master_config(clockcache_config *cache_cfg,
                           master_cfg->cache_capacity,
                           master_cfg->cache_logfile,
                           master_cfg->use_stats);
+   cache_cfg->type_min_share[PAGE_TYPE_TRUNK] =
+      master_cfg->cache_trunk_min_share;
+   cache_cfg->type_min_share[PAGE_TYPE_FILTER] =
+      master_cfg->cache_filter_min_share;
+   cache_cfg->type_max_share[PAGE_TYPE_BRANCH] =
+      master_cfg->cache_branch_max_share;
+   cache_cfg->pin_trunk_pages     = master_cfg->cache_pin_trunk_pages;
+   cache_cfg->compressed_capacity = master_cfg->cache_compressed_capacity;
+   cache_cfg->cleaner_clean_share = master_cfg->cache_cleaner_clean_share;
+   if (master_cfg->cache_branch_compression) {
+      cache_cfg->branch_codec = &page_codec_lz;
+   }
    return 1;
 }
 
@@ -71,5 +86,13 @@ init_btree_config_from_master_config(btree_config  *dbtree_cfg,
                                      data_config   *data_cfg)
 {
    btree_config_init(dbtree_cfg, cache_cfg, data_cfg);
+   if (master_cfg->btree_readahead_max_extents != 0) {
+      dbtree_cfg->readahead_max_extents =
+         master_cfg->btree_readahead_max_extents;
+   }
+   dbtree_cfg->readahead_budget_extents = master_cfg->btree_readahead_budget;
+   dbtree_cfg->key_prefix_slots         = master_cfg->btree_key_prefix_slots;
+   dbtree_cfg->prefix_compression       = master_cfg->btree_prefix_compression;
+   dbtree_cfg->optimistic_inserts       = master_cfg->btree_optimistic_inserts;
    return 1;
 }
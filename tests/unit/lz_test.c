@@ -0,0 +1,193 @@
+// Copyright 2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * -----------------------------------------------------------------------------
+ * lz_test.c --
+ *
+ *  Exercise the built-in LZ codec used to compress pages in DRAM, and the
+ *  page encoding used to store compressed pages on disk.
+ * -----------------------------------------------------------------------------
+ */
+#include "lz.h"
+#include "page_codec.h"
+#include "ctest.h" // This is required for all test-case files.
+
+#define LZ_TEST_PAGE_SIZE 4096
+
+static int
+check_round_trip(const char *src, uint64 src_len);
+
+/*
+ * Global data declaration macro:
+ */
+CTEST_DATA(lz)
+{
+   char src[LZ_TEST_PAGE_SIZE];
+};
+
+// Optional setup function for suite, called before every test in suite
+CTEST_SETUP(lz)
+{
+   memset(data->src, 0, sizeof(data->src));
+}
+
+// Optional teardown function for suite, called after every test in suite
+CTEST_TEARDOWN(lz) {}
+
+/*
+ * A page of zeros compresses to a handful of bytes.
+ */
+CTEST2(lz, test_zero_page)
+{
+   char   dst[LZ_TEST_PAGE_SIZE];
+   uint64 len = lz_compress(data->src, sizeof(data->src), dst, sizeof(dst));
+   ASSERT_TRUE(len > 0);
+   ASSERT_TRUE(len < 64, "len=%lu", len);
+   ASSERT_EQUAL(0, check_round_trip(data->src, sizeof(data->src)));
+}
+
+/*
+ * A page that looks like sorted keys with a shared prefix and small values,
+ * followed by free space.
+ */
+CTEST2(lz, test_structured_page)
+{
+   uint64 off = 0;
+   for (uint64 i = 0; off + 32 < LZ_TEST_PAGE_SIZE / 2; i++) {
+      off += snprintf(data->src + off, 32, "user_key_%08lu:v%lu;", i, i % 7);
+   }
+   char   dst[LZ_TEST_PAGE_SIZE];
+   uint64 len = lz_compress(data->src, sizeof(data->src), dst, sizeof(dst));
+   ASSERT_TRUE(len > 0);
+   ASSERT_TRUE(len < LZ_TEST_PAGE_SIZE / 2, "len=%lu", len);
+   ASSERT_EQUAL(0, check_round_trip(data->src, sizeof(data->src)));
+}
+
+/*
+ * Random data does not fit in less than its own size, but round-trips when
+ * given the worst-case bound.
+ */
+CTEST2(lz, test_incompressible_page)
+{
+   uint64 seed = 42;
+   for (uint64 i = 0; i < LZ_TEST_PAGE_SIZE; i++) {
+      seed         = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      data->src[i] = (char)(seed >> 56);
+   }
+   char   dst[LZ_TEST_PAGE_SIZE];
+   uint64 len =
+      lz_compress(data->src, sizeof(data->src), dst, 3 * sizeof(dst) / 4);
+   ASSERT_EQUAL(0, len);
+   ASSERT_EQUAL(0, check_round_trip(data->src, sizeof(data->src)));
+}
+
+/*
+ * Inputs shorter than a minimum match, and overlapping matches of every
+ * small period.
+ */
+CTEST2(lz, test_short_and_periodic)
+{
+   for (uint64 len = 0; len <= 2 * LZ_MIN_MATCH; len++) {
+      memset(data->src, 'a' + len, len);
+      ASSERT_EQUAL(0, check_round_trip(data->src, len), "len=%lu", len);
+   }
+   for (uint64 period = 1; period < 16; period++) {
+      for (uint64 i = 0; i < LZ_TEST_PAGE_SIZE; i++) {
+         data->src[i] = (char)(i % period);
+      }
+      ASSERT_EQUAL(0,
+                   check_round_trip(data->src, sizeof(data->src)),
+                   "period=%lu",
+                   period);
+   }
+}
+
+/*
+ * Truncated blocks and blocks of the wrong decompressed size are rejected.
+ */
+CTEST2(lz, test_malformed_input)
+{
+   for (uint64 i = 0; i < LZ_TEST_PAGE_SIZE; i++) {
+      data->src[i] = (char)(i % 13);
+   }
+   char   dst[LZ_TEST_PAGE_SIZE];
+   char   out[LZ_TEST_PAGE_SIZE];
+   uint64 len = lz_compress(data->src, sizeof(data->src), dst, sizeof(dst));
+   ASSERT_TRUE(len > 1);
+
+   ASSERT_FALSE(lz_decompress(dst, len - 1, out, sizeof(out)));
+   ASSERT_FALSE(lz_decompress(dst, len, out, sizeof(out) - 1));
+   ASSERT_TRUE(lz_decompress(dst, len, out, sizeof(out)));
+}
+
+/*
+ * Encoded pages are block-aligned, shorter than a page by at least a block,
+ * and decode back to the original page.
+ */
+CTEST2(lz, test_page_codec_round_trip)
+{
+   uint64 off = 0;
+   for (uint64 i = 0; off + 32 < LZ_TEST_PAGE_SIZE / 2; i++) {
+      off += snprintf(data->src + off, 32, "user_key_%08lu:v%lu;", i, i % 7);
+   }
+   char   buf[LZ_TEST_PAGE_SIZE];
+   char   out[LZ_TEST_PAGE_SIZE];
+   uint64 bytes =
+      page_codec_encode(&page_codec_lz, data->src, sizeof(data->src), buf);
+   ASSERT_TRUE(bytes > 0);
+   ASSERT_EQUAL(0, bytes % PAGE_CODEC_ALIGNMENT, "bytes=%lu", bytes);
+   ASSERT_TRUE(bytes <= LZ_TEST_PAGE_SIZE - PAGE_CODEC_ALIGNMENT);
+   ASSERT_TRUE(page_codec_is_encoded(buf));
+   ASSERT_TRUE(page_codec_decode(&page_codec_lz, buf, sizeof(out), out));
+   ASSERT_EQUAL(0, memcmp(data->src, out, sizeof(out)));
+}
+
+/*
+ * Pages that do not save a block are left alone, and pages that were not
+ * encoded, or were encoded by another codec, are not decoded.
+ */
+CTEST2(lz, test_page_codec_rejects)
+{
+   uint64 seed = 42;
+   for (uint64 i = 0; i < LZ_TEST_PAGE_SIZE; i++) {
+      seed         = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      data->src[i] = (char)(seed >> 56);
+   }
+   char buf[LZ_TEST_PAGE_SIZE];
+   char out[LZ_TEST_PAGE_SIZE];
+   ASSERT_EQUAL(
+      0, page_codec_encode(&page_codec_lz, data->src, sizeof(data->src), buf));
+   ASSERT_FALSE(page_codec_is_encoded(data->src));
+   ASSERT_FALSE(
+      page_codec_decode(&page_codec_lz, data->src, sizeof(out), out));
+
+   memset(data->src, 0, sizeof(data->src));
+   ASSERT_TRUE(
+      page_codec_encode(&page_codec_lz, data->src, sizeof(data->src), buf)
+      > 0);
+   page_codec other = page_codec_lz;
+   other.id++;
+   ASSERT_FALSE(page_codec_decode(&other, buf, sizeof(out), out));
+}
+
+static int
+check_round_trip(const char *src, uint64 src_len)
+{
+   char   dst[LZ_TEST_PAGE_SIZE + LZ_TEST_PAGE_SIZE / 8];
+   char   out[LZ_TEST_PAGE_SIZE];
+   uint64 len = lz_compress(src, src_len, dst, lz_compress_bound(src_len));
+   if (len == 0) {
+      CTEST_ERR("failed to compress %lu bytes\n", src_len);
+      return -1;
+   }
+   if (!lz_decompress(dst, len, out, src_len)) {
+      CTEST_ERR("failed to decompress %lu bytes\n", src_len);
+      return -1;
+   }
+   if (memcmp(src, out, src_len) != 0) {
+      CTEST_ERR("round trip of %lu bytes does not match\n", src_len);
+      return -1;
+   }
+   return 0;
+}
@@ -0,0 +1,822 @@
+// Copyright 2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * -----------------------------------------------------------------------------
+ * routing_filter_test.c --
+ *
+ *  Exercises the routing filter interfaces in routing_filter.c. Validates
+ *  that filters large enough to be sorted in buckets hold every fingerprint,
+ *  that Bloom filters keep their keys when extended, which values filters
+ *  hold, that extensions keep their fingerprint size, which filters the
+ *  decoded filter cache keeps and how often it is hit, and the unique key
+ *  sketches of filters with and without one.
+ * -----------------------------------------------------------------------------
+ */
+#include "splinterdb/public_platform.h"
+#include "unit_tests.h"
+#include "ctest.h" // This is required for all test-case files.
+
+#include "test_data.h"
+#include "splinterdb/data.h"
+#include "io.h"
+#include "rc_allocator.h"
+#include "clockcache.h"
+#include "routing_filter.h"
+#include "mini_allocator.h"
+#include "btree_test_common.h"
+
+// Function Prototypes
+static void
+routing_filter_sorted_tests(cache           *cc,
+                            routing_config  *cfg,
+                            platform_heap_id hid,
+                            uint32           num_hashes,
+                            uint16           value);
+
+static void
+routing_filter_build(cache           *cc,
+                     routing_config  *cfg,
+                     uint32           hashes[],
+                     uint32           num_hashes,
+                     uint16           value,
+                     routing_filter  *filter,
+                     platform_heap_id hid);
+
+static void
+routing_filter_extend(cache           *cc,
+                      routing_config  *cfg,
+                      routing_filter  *old_filter,
+                      uint32           hashes[],
+                      uint32           num_hashes,
+                      uint16           value,
+                      routing_filter  *filter,
+                      platform_heap_id hid);
+
+static void
+routing_filter_random_hashes(routing_config *cfg,
+                             uint32          start,
+                             uint32          hashes[],
+                             uint32          num_hashes);
+
+static void
+routing_filter_check_found(cache          *cc,
+                           routing_config *cfg,
+                           routing_filter *filter,
+                           uint32          hashes[],
+                           uint32          num_hashes,
+                           uint16          value);
+
+static void
+routing_filter_check_cached(cache                *cc,
+                            routing_config       *cfg,
+                            routing_filter_cache *fcache,
+                            routing_filter       *filter,
+                            uint32                hashes[],
+                            uint32                num_hashes);
+
+/*
+ * Global data declaration macro:
+ */
+CTEST_DATA(routing_filter)
+{
+   master_config      master_cfg;
+   data_config       *data_cfg;
+   io_config          io_cfg;
+   allocator_config   allocator_cfg;
+   clockcache_config  cache_cfg;
+   task_system_config task_cfg;
+   routing_config     filter_cfg;
+   platform_heap_id   hid;
+
+   platform_io_handle io;
+   task_system       *ts;
+   rc_allocator       al;
+   clockcache         cc;
+};
+
+// Optional setup function for suite, called before every test in suite
+CTEST_SETUP(routing_filter)
+{
+   config_set_defaults(&data->master_cfg);
+   data->data_cfg = test_data_config;
+
+   if (!SUCCESS(
+          config_parse(&data->master_cfg, 1, Ctest_argc, (char **)Ctest_argv))
+       || !init_data_config_from_master_config(data->data_cfg,
+                                               &data->master_cfg)
+       || !init_io_config_from_master_config(&data->io_cfg, &data->master_cfg)
+       || !init_rc_allocator_config_from_master_config(
+          &data->allocator_cfg, &data->master_cfg, &data->io_cfg)
+       || !init_clockcache_config_from_master_config(
+          &data->cache_cfg, &data->master_cfg, &data->io_cfg)
+       || !init_task_config_from_master_config(
+          &data->task_cfg, &data->master_cfg, 0))
+   {
+      ASSERT_TRUE(FALSE, "Failed to parse args\n");
+   }
+
+   // Create a heap for io, task system, allocator and cache
+   platform_status rc = platform_heap_create(platform_get_module_id(),
+                                             1 * GiB,
+                                             data->master_cfg.use_shmem,
+                                             &data->hid);
+   platform_assert_status_ok(rc);
+
+   data->ts = NULL;
+   if (!SUCCESS(io_handle_init(&data->io, &data->io_cfg, data->hid))
+       || !SUCCESS(
+          task_system_create(data->hid, &data->io, &data->ts, &data->task_cfg))
+       || !SUCCESS(rc_allocator_init(&data->al,
+                                     &data->allocator_cfg,
+                                     (io_handle *)&data->io,
+                                     data->hid,
+                                     platform_get_module_id()))
+       || !SUCCESS(clockcache_init(&data->cc,
+                                   &data->cache_cfg,
+                                   (io_handle *)&data->io,
+                                   (allocator *)&data->al,
+                                   "test",
+                                   data->hid,
+                                   platform_get_module_id())))
+   {
+      ASSERT_TRUE(
+         FALSE,
+         "Failed to init io or task system or rc_allocator or clockcache\n");
+   }
+
+   // The tests set fingerprint_size
+   ZERO_STRUCT(data->filter_cfg);
+   data->filter_cfg.cache_cfg      = &data->cache_cfg.super;
+   data->filter_cfg.data_cfg       = data->data_cfg;
+   data->filter_cfg.index_size     = 512;
+   data->filter_cfg.log_index_size = 9;
+   data->filter_cfg.hash           = data->data_cfg->key_hash;
+   data->filter_cfg.seed           = 42;
+   data->filter_cfg.family         = ROUTING_FILTER_QUOTIENT;
+}
+
+// Optional teardown function for suite, called after every test in suite
+CTEST_TEARDOWN(routing_filter)
+{
+   clockcache_deinit(&data->cc);
+   rc_allocator_deinit(&data->al);
+   task_system_destroy(data->hid, &data->ts);
+   io_handle_deinit(&data->io);
+   platform_heap_destroy(&data->hid);
+}
+
+/*
+ * Filters of 2^19 hashes and more are sorted in buckets by the top byte of
+ * their fingerprints, then on the remaining bytes. With 24-bit fingerprints
+ * each bucket takes an even number of rounds, ending where it started.
+ */
+CTEST2(routing_filter, test_sorted_even_rounds)
+{
+   data->filter_cfg.fingerprint_size = 24;
+   routing_filter_sorted_tests((cache *)&data->cc,
+                               &data->filter_cfg,
+                               data->hid,
+                               1 << 19,
+                               5);
+}
+
+/*
+ * With 28-bit fingerprints each bucket takes an odd number of rounds, ending
+ * in the other array.
+ */
+CTEST2(routing_filter, test_sorted_odd_rounds)
+{
+   data->filter_cfg.fingerprint_size = 28;
+   routing_filter_sorted_tests((cache *)&data->cc,
+                               &data->filter_cfg,
+                               data->hid,
+                               (1 << 19) + 12345,
+                               3);
+}
+
+/*
+ * The largest filter with 512 buckets to an index has a full extent of
+ * indices. Its sketch has a page of its own, so the index keeps every entry.
+ */
+CTEST2(routing_filter, test_largest_filter)
+{
+   data->filter_cfg.fingerprint_size = 28;
+   routing_filter_sorted_tests((cache *)&data->cc,
+                               &data->filter_cfg,
+                               data->hid,
+                               cache_config_extent_size(&data->cache_cfg.super)
+                                  / sizeof(uint64)
+                                  * data->filter_cfg.index_size,
+                               1);
+}
+
+/*
+ * A filter's sketch estimates its unique keys. A filter written without a
+ * sketch, with sketch_addr 0, leaves the merged sketch as it was and its
+ * keys are still found.
+ */
+CTEST2(routing_filter, test_filter_without_sketch)
+{
+   uint32       hashes[20000];
+   const uint32 num_hashes = ARRAY_SIZE(hashes);
+
+   // the sketch needs hashes whose bits look random
+   data->filter_cfg.fingerprint_size = 24;
+   routing_filter_random_hashes(&data->filter_cfg, 0, hashes, num_hashes);
+   routing_filter filter;
+   routing_filter_build((cache *)&data->cc,
+                        &data->filter_cfg,
+                        hashes,
+                        num_hashes,
+                        1,
+                        &filter,
+                        data->hid);
+   ASSERT_NOT_EQUAL(0, filter.sketch_addr);
+
+   routing_sketch sketch;
+   ZERO_CONTENTS(&sketch);
+   ASSERT_TRUE(routing_filter_sketch_merge(
+      (cache *)&data->cc, &data->filter_cfg, &filter, &sketch));
+   uint64 estimate = routing_sketch_estimate_unique_keys(&sketch);
+   ASSERT_TRUE(estimate > num_hashes * 0.8 && estimate < num_hashes * 1.2,
+               "sketch estimates %lu unique keys of %u\n",
+               estimate,
+               num_hashes);
+
+   routing_filter old_filter = filter;
+   old_filter.sketch_addr    = 0;
+   routing_sketch old_sketch = sketch;
+   ASSERT_FALSE(routing_filter_sketch_merge(
+      (cache *)&data->cc, &data->filter_cfg, &old_filter, &old_sketch));
+   ASSERT_EQUAL(0, memcmp(&sketch, &old_sketch, sizeof(sketch)));
+
+   routing_filter_check_found((cache *)&data->cc,
+                              &data->filter_cfg,
+                              &old_filter,
+                              hashes,
+                              num_hashes,
+                              1);
+
+   routing_filter_zap((cache *)&data->cc, &filter);
+}
+
+/*
+ * A Bloom filter finds every key with the value it was added with, and few
+ * others. Extending it past the capacity of its segment adds a segment and
+ * leaves the old keys where they were.
+ */
+CTEST2(routing_filter, test_bloom_filter)
+{
+   uint32       hashes[3][16384];
+   const uint32 num_hashes = ARRAY_SIZE(hashes[0]);
+
+   data->filter_cfg.family             = ROUTING_FILTER_BLOOM;
+   data->filter_cfg.bloom_bits_per_key = 10;
+   for (uint32 h = 0; h < 3; h++) {
+      routing_filter_random_hashes(
+         &data->filter_cfg, h * num_hashes, hashes[h], num_hashes);
+   }
+
+   routing_filter filter[2];
+   routing_filter_build((cache *)&data->cc,
+                        &data->filter_cfg,
+                        hashes[0],
+                        num_hashes,
+                        1,
+                        &filter[0],
+                        data->hid);
+   ASSERT_EQUAL(ROUTING_FILTER_BLOOM, filter[0].family);
+   ASSERT_EQUAL(1, filter[0].num_segments);
+   routing_filter_extend((cache *)&data->cc,
+                         &data->filter_cfg,
+                         &filter[0],
+                         hashes[1],
+                         num_hashes,
+                         2,
+                         &filter[1],
+                         data->hid);
+   ASSERT_EQUAL(ROUTING_FILTER_BLOOM, filter[1].family);
+   ASSERT_EQUAL(2, filter[1].num_segments);
+   ASSERT_EQUAL(2 * num_hashes, filter[1].num_fingerprints);
+
+   routing_filter_check_found((cache *)&data->cc,
+                              &data->filter_cfg,
+                              &filter[1],
+                              hashes[0],
+                              num_hashes,
+                              1);
+   routing_filter_check_found((cache *)&data->cc,
+                              &data->filter_cfg,
+                              &filter[1],
+                              hashes[1],
+                              num_hashes,
+                              2);
+
+   // 10 bits per key give about 1% false positives for each value
+   uint32 false_positives = 0;
+   for (uint32 i = 0; i < num_hashes; i++) {
+      uint64          found_values;
+      platform_status rc = routing_filter_lookup_hash((cache *)&data->cc,
+                                                      &data->filter_cfg,
+                                                      &filter[1],
+                                                      hashes[2][i],
+                                                      &found_values);
+      ASSERT_TRUE(SUCCESS(rc));
+      false_positives += found_values != 0;
+   }
+   ASSERT_TRUE(false_positives < num_hashes / 20,
+               "%u false positives of %u\n",
+               false_positives,
+               num_hashes);
+
+   for (uint32 f = 0; f < 2; f++) {
+      routing_filter_zap((cache *)&data->cc, &filter[f]);
+   }
+}
+
+/*
+ * A filter holds exactly the values its keys were added with, across
+ * extensions and in both families, so a clear value rules out a branch
+ * without a lookup. An extension without keys adds no value.
+ */
+CTEST2(routing_filter, test_filter_holds_values)
+{
+   uint32       hashes[2][1000];
+   const uint32 num_hashes = ARRAY_SIZE(hashes[0]);
+
+   data->filter_cfg.fingerprint_size   = 24;
+   data->filter_cfg.bloom_bits_per_key = 10;
+   for (uint32 h = 0; h < 2; h++) {
+      routing_filter_random_hashes(
+         &data->filter_cfg, h * num_hashes, hashes[h], num_hashes);
+   }
+
+   routing_filter empty = {0};
+   ASSERT_FALSE(routing_filter_holds_value(&empty, 3));
+
+   routing_filter_family families[] = {ROUTING_FILTER_QUOTIENT,
+                                       ROUTING_FILTER_BLOOM};
+   for (uint32 fam = 0; fam < ARRAY_SIZE(families); fam++) {
+      data->filter_cfg.family = families[fam];
+      routing_filter filter[3];
+      routing_filter_build((cache *)&data->cc,
+                           &data->filter_cfg,
+                           hashes[0],
+                           num_hashes,
+                           3,
+                           &filter[0],
+                           data->hid);
+      routing_filter_extend((cache *)&data->cc,
+                            &data->filter_cfg,
+                            &filter[0],
+                            hashes[1],
+                            num_hashes,
+                            5,
+                            &filter[1],
+                            data->hid);
+      routing_filter_extend((cache *)&data->cc,
+                            &data->filter_cfg,
+                            &filter[1],
+                            hashes[1],
+                            0,
+                            7,
+                            &filter[2],
+                            data->hid);
+
+      for (uint16 value = 0; value < 64; value++) {
+         ASSERT_EQUAL(value == 3,
+                      routing_filter_holds_value(&filter[0], value),
+                      "family %u value %u\n",
+                      families[fam],
+                      value);
+         for (uint32 f = 1; f < 3; f++) {
+            ASSERT_EQUAL(value == 3 || value == 5,
+                         routing_filter_holds_value(&filter[f], value),
+                         "family %u filter %u value %u\n",
+                         families[fam],
+                         f,
+                         value);
+         }
+      }
+      // values past the mask can't be ruled out
+      ASSERT_TRUE(routing_filter_holds_value(&filter[0], 64));
+      routing_filter_check_found((cache *)&data->cc,
+                                 &data->filter_cfg,
+                                 &filter[2],
+                                 hashes[1],
+                                 num_hashes,
+                                 5);
+
+      for (uint32 f = 0; f < 3; f++) {
+         routing_filter_zap((cache *)&data->cc, &filter[f]);
+      }
+   }
+}
+
+/*
+ * An extended filter keeps the fingerprint size it was built with, whatever
+ * the config's size is now, and filters of different sizes are counted
+ * together at the smallest of them.
+ */
+CTEST2(routing_filter, test_filter_fingerprint_sizes)
+{
+   uint32       hashes[2][4096];
+   const uint32 num_hashes = ARRAY_SIZE(hashes[0]);
+
+   for (uint32 h = 0; h < 2; h++) {
+      routing_filter_random_hashes(
+         &data->filter_cfg, h * num_hashes, hashes[h], num_hashes);
+   }
+
+   routing_filter filter[3];
+   data->filter_cfg.fingerprint_size = 20;
+   routing_filter_build((cache *)&data->cc,
+                        &data->filter_cfg,
+                        hashes[0],
+                        num_hashes,
+                        1,
+                        &filter[0],
+                        data->hid);
+   data->filter_cfg.fingerprint_size = 28;
+   routing_filter_extend((cache *)&data->cc,
+                         &data->filter_cfg,
+                         &filter[0],
+                         hashes[1],
+                         num_hashes,
+                         2,
+                         &filter[1],
+                         data->hid);
+   routing_filter_build((cache *)&data->cc,
+                        &data->filter_cfg,
+                        hashes[1],
+                        num_hashes,
+                        1,
+                        &filter[2],
+                        data->hid);
+   ASSERT_EQUAL(20, filter[0].fingerprint_size);
+   ASSERT_EQUAL(20, filter[1].fingerprint_size);
+   ASSERT_EQUAL(28, filter[2].fingerprint_size);
+
+   routing_filter_check_found((cache *)&data->cc,
+                              &data->filter_cfg,
+                              &filter[1],
+                              hashes[0],
+                              num_hashes,
+                              1);
+   routing_filter_check_found((cache *)&data->cc,
+                              &data->filter_cfg,
+                              &filter[1],
+                              hashes[1],
+                              num_hashes,
+                              2);
+
+   // the keys of filter[2] are all in filter[1]
+   uint32 num_unique = routing_filter_estimate_unique_fp(
+      (cache *)&data->cc, &data->filter_cfg, data->hid, &filter[1], 2);
+   uint64 estimate = routing_filter_estimate_unique_keys_from_count(
+      &data->filter_cfg, num_unique);
+   ASSERT_TRUE(estimate > 2 * num_hashes * 0.97
+                  && estimate < 2 * num_hashes * 1.03,
+               "estimated %lu unique keys of %u\n",
+               estimate,
+               2 * num_hashes);
+
+   for (uint32 f = 0; f < 3; f++) {
+      routing_filter_zap((cache *)&data->cc, &filter[f]);
+   }
+}
+
+/*
+ * A filter that doesn't fit in the decoded filter cache takes the place of
+ * one not probed since.
+ */
+CTEST2(routing_filter, test_cache_replaces_filters)
+{
+   uint32       hashes[2][4096];
+   const uint32 num_hashes = ARRAY_SIZE(hashes[0]);
+
+   // each decoded filter takes a little over 32 KiB
+   data->filter_cfg.fingerprint_size = 24;
+   routing_filter_cache *fcache =
+      routing_filter_cache_create(data->hid, 48 * KiB);
+   ASSERT_TRUE(fcache != NULL);
+
+   routing_filter filter[2];
+   for (uint32 f = 0; f < 2; f++) {
+      for (uint32 i = 0; i < num_hashes; i++) {
+         hashes[f][i] = (2 * i + f) * 2654435761U;
+      }
+      routing_filter_build((cache *)&data->cc,
+                           &data->filter_cfg,
+                           hashes[f],
+                           num_hashes,
+                           1,
+                           &filter[f],
+                           data->hid);
+   }
+
+   for (uint32 f = 0; f < 2; f++) {
+      routing_filter_check_cached((cache *)&data->cc,
+                                  &data->filter_cfg,
+                                  fcache,
+                                  &filter[f],
+                                  hashes[f],
+                                  num_hashes);
+      uint64 found_values;
+      ASSERT_TRUE(routing_filter_cache_lookup(
+         fcache, &filter[f], hashes[f][0], &found_values));
+      if (f == 1) {
+         ASSERT_FALSE(routing_filter_cache_lookup(
+            fcache, &filter[0], hashes[0][0], &found_values));
+      }
+
+      // the first probe decodes the filter, the second evicts the first
+      routing_filter_cache_stats stats;
+      routing_filter_cache_get_stats(fcache, &stats);
+      ASSERT_EQUAL(f + 1, stats.decodes);
+      ASSERT_EQUAL(f, stats.evictions);
+      ASSERT_EQUAL((f + 1) * num_hashes, stats.hits);
+      ASSERT_EQUAL(0, stats.uncached);
+   }
+
+   for (uint32 f = 0; f < 2; f++) {
+      routing_filter_zap_cached((cache *)&data->cc, fcache, &filter[f]);
+   }
+   routing_filter_cache_destroy(fcache);
+}
+
+/*
+ * Bloom filters are decoded into the cache like quotient filters. A cache
+ * too small for a filter probes it on its pages instead.
+ */
+CTEST2(routing_filter, test_cache_bloom_filters)
+{
+   uint32       hashes[4096];
+   const uint32 num_hashes = ARRAY_SIZE(hashes);
+
+   data->filter_cfg.family             = ROUTING_FILTER_BLOOM;
+   data->filter_cfg.bloom_bits_per_key = 10;
+   routing_filter_random_hashes(&data->filter_cfg, 0, hashes, num_hashes);
+   routing_filter filter;
+   routing_filter_build((cache *)&data->cc,
+                        &data->filter_cfg,
+                        hashes,
+                        num_hashes,
+                        1,
+                        &filter,
+                        data->hid);
+
+   uint64 capacity[] = {64 * MiB, KiB};
+   for (uint32 c = 0; c < ARRAY_SIZE(capacity); c++) {
+      routing_filter_cache *fcache =
+         routing_filter_cache_create(data->hid, capacity[c]);
+      ASSERT_TRUE(fcache != NULL);
+      routing_filter_check_cached((cache *)&data->cc,
+                                  &data->filter_cfg,
+                                  fcache,
+                                  &filter,
+                                  hashes,
+                                  num_hashes);
+
+      routing_filter_cache_stats stats;
+      routing_filter_cache_get_stats(fcache, &stats);
+      if (c == 0) {
+         ASSERT_EQUAL(1, stats.decodes);
+         ASSERT_EQUAL(num_hashes - 1, stats.hits);
+         ASSERT_EQUAL(0, stats.uncached);
+      } else {
+         ASSERT_EQUAL(0, stats.decodes);
+         ASSERT_EQUAL(0, stats.hits);
+         ASSERT_EQUAL(num_hashes, stats.uncached);
+      }
+      routing_filter_cache_destroy(fcache);
+   }
+   routing_filter_zap((cache *)&data->cc, &filter);
+}
+
+/*
+ * A filter stays in the decoded filter cache until its last reference is
+ * dropped.
+ */
+CTEST2(routing_filter, test_cache_evicts_on_last_ref)
+{
+   uint32       hashes[4096];
+   const uint32 num_hashes = ARRAY_SIZE(hashes);
+
+   data->filter_cfg.fingerprint_size = 24;
+   routing_filter_cache *fcache =
+      routing_filter_cache_create(data->hid, 64 * MiB);
+   ASSERT_TRUE(fcache != NULL);
+
+   for (uint32 i = 0; i < num_hashes; i++) {
+      hashes[i] = i * 2654435761U;
+   }
+   routing_filter filter;
+   routing_filter_build((cache *)&data->cc,
+                        &data->filter_cfg,
+                        hashes,
+                        num_hashes,
+                        1,
+                        &filter,
+                        data->hid);
+
+   uint64          found_values;
+   platform_status rc = routing_filter_lookup_cached((cache *)&data->cc,
+                                                     &data->filter_cfg,
+                                                     fcache,
+                                                     &filter,
+                                                     hashes[0],
+                                                     &found_values);
+   ASSERT_TRUE(SUCCESS(rc));
+
+   // a second reference, as a flush shares a filter with a child
+   mini_unkeyed_inc_ref((cache *)&data->cc, filter.meta_head);
+   routing_filter_zap_cached((cache *)&data->cc, fcache, &filter);
+   ASSERT_TRUE(
+      routing_filter_cache_lookup(fcache, &filter, hashes[0], &found_values));
+   ASSERT_TRUE(routing_filter_is_value_found(found_values, 1));
+
+   routing_filter_zap_cached((cache *)&data->cc, fcache, &filter);
+   ASSERT_FALSE(
+      routing_filter_cache_lookup(fcache, &filter, hashes[0], &found_values));
+
+   routing_filter_cache_destroy(fcache);
+}
+
+/*
+ * ********************************************************************************
+ * Define minions and helper functions used by this test suite.
+ * ********************************************************************************
+ */
+static int
+fingerprint_compare(const void *a, const void *b, void *arg)
+{
+   uint32 fp_a = *(const uint32 *)a;
+   uint32 fp_b = *(const uint32 *)b;
+   return fp_a < fp_b ? -1 : fp_a > fp_b;
+}
+
+/*
+ * Builds filter from the num_hashes hashes, leaving hashes as they were.
+ */
+static void
+routing_filter_build(cache           *cc,
+                     routing_config  *cfg,
+                     uint32           hashes[],
+                     uint32           num_hashes,
+                     uint16           value,
+                     routing_filter  *filter,
+                     platform_heap_id hid)
+{
+   routing_filter empty = {0};
+   routing_filter_extend(
+      cc, cfg, &empty, hashes, num_hashes, value, filter, hid);
+}
+
+/*
+ * Builds filter from old_filter and the num_hashes hashes, leaving hashes as
+ * they were. old_filter is left for the caller to zap.
+ */
+static void
+routing_filter_extend(cache           *cc,
+                      routing_config  *cfg,
+                      routing_filter  *old_filter,
+                      uint32           hashes[],
+                      uint32           num_hashes,
+                      uint16           value,
+                      routing_filter  *filter,
+                      platform_heap_id hid)
+{
+   // an extension may have no hashes
+   uint32 *fp_arr = TYPED_ARRAY_MALLOC(hid, fp_arr, MAX(num_hashes, 1));
+   ASSERT_TRUE(fp_arr != NULL);
+   memmove(fp_arr, hashes, num_hashes * sizeof(uint32));
+
+   platform_status rc = routing_filter_add(
+      cc, cfg, old_filter, filter, fp_arr, num_hashes, value);
+   ASSERT_TRUE(SUCCESS(rc));
+   platform_free(hid, fp_arr);
+}
+
+/*
+ * The hashes of the keys start to start + num_hashes - 1, whose bits look
+ * random, as those of real keys do.
+ */
+static void
+routing_filter_random_hashes(routing_config *cfg,
+                             uint32          start,
+                             uint32          hashes[],
+                             uint32          num_hashes)
+{
+   for (uint32 i = 0; i < num_hashes; i++) {
+      uint32 k  = start + i;
+      hashes[i] = cfg->hash(&k, sizeof(k), cfg->seed);
+   }
+}
+
+/*
+ * Checks that each of the num_hashes hashes is found in filter with value.
+ */
+static void
+routing_filter_check_found(cache          *cc,
+                           routing_config *cfg,
+                           routing_filter *filter,
+                           uint32          hashes[],
+                           uint32          num_hashes,
+                           uint16          value)
+{
+   for (uint32 i = 0; i < num_hashes; i++) {
+      uint64          found_values;
+      platform_status rc =
+         routing_filter_lookup_hash(cc, cfg, filter, hashes[i], &found_values);
+      ASSERT_TRUE(SUCCESS(rc));
+      ASSERT_TRUE(routing_filter_is_value_found(found_values, value),
+                  "hash %u of %u (0x%x) not found with value %u\n",
+                  i,
+                  num_hashes,
+                  hashes[i],
+                  value);
+   }
+}
+
+/*
+ * Checks that each of the num_hashes hashes, added with value 1, is found in
+ * filter through fcache.
+ */
+static void
+routing_filter_check_cached(cache                *cc,
+                            routing_config       *cfg,
+                            routing_filter_cache *fcache,
+                            routing_filter       *filter,
+                            uint32                hashes[],
+                            uint32                num_hashes)
+{
+   for (uint32 i = 0; i < num_hashes; i++) {
+      uint64          found_values;
+      platform_status rc = routing_filter_lookup_cached(
+         cc, cfg, fcache, filter, hashes[i], &found_values);
+      ASSERT_TRUE(SUCCESS(rc));
+      ASSERT_TRUE(routing_filter_is_value_found(found_values, 1));
+   }
+}
+
+/*
+ * Builds a filter of num_hashes hashes with value and checks that each hash
+ * is found in it. The filter counts its unique fingerprints while encoding
+ * them in sorted order, so the count only matches if the sort was right.
+ */
+static void
+routing_filter_sorted_tests(cache           *cc,
+                            routing_config  *cfg,
+                            platform_heap_id hid,
+                            uint32           num_hashes,
+                            uint16           value)
+{
+   uint32 *hashes = TYPED_ARRAY_MALLOC(hid, hashes, num_hashes);
+   uint32 *fp_arr = TYPED_ARRAY_MALLOC(hid, fp_arr, num_hashes);
+   ASSERT_TRUE(hashes != NULL && fp_arr != NULL);
+
+   // an odd multiplier, so the hashes are distinct and spread over all bytes
+   for (uint32 i = 0; i < num_hashes; i++) {
+      hashes[i] = i * 2654435761U;
+      fp_arr[i] = hashes[i];
+   }
+
+   routing_filter  empty  = {0};
+   routing_filter  filter = {0};
+   platform_status rc =
+      routing_filter_add(cc, cfg, &empty, &filter, fp_arr, num_hashes, value);
+   ASSERT_TRUE(SUCCESS(rc));
+   ASSERT_EQUAL(num_hashes, filter.num_fingerprints);
+
+   for (uint32 i = 0; i < num_hashes; i++) {
+      uint64 found_values;
+      rc =
+         routing_filter_lookup_hash(cc, cfg, &filter, hashes[i], &found_values);
+      ASSERT_TRUE(SUCCESS(rc));
+      ASSERT_TRUE(routing_filter_is_value_found(found_values, value),
+                  "hash %u of %u (0x%x) not found\n",
+                  i,
+                  num_hashes,
+                  hashes[i]);
+   }
+
+   uint32 hash_shift = 32 - cfg->fingerprint_size;
+   for (uint32 i = 0; i < num_hashes; i++) {
+      fp_arr[i] = hashes[i] >> hash_shift;
+   }
+   platform_sort_slow(
+      fp_arr, num_hashes, sizeof(uint32), fingerprint_compare, NULL, NULL);
+   uint32 num_unique = 0;
+   for (uint32 i = 0; i < num_hashes; i++) {
+      if (i == 0 || fp_arr[i] != fp_arr[i - 1]) {
+         num_unique++;
+      }
+   }
+   ASSERT_EQUAL(num_unique, filter.num_unique);
+
+   routing_filter_zap(cc, &filter);
+   platform_free(hid, fp_arr);
+   platform_free(hid, hashes);
+}
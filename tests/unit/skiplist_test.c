@@ -0,0 +1,372 @@
+// Copyright 2021 VMware, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * -----------------------------------------------------------------------------
+ * skiplist_test.c --
+ *
+ *  Exercise the skiplist memtable engine: inserts and lookups, overwrites of
+ *  existing keys, bounded iteration in both directions, and concurrent
+ *  inserts of the same keys.
+ * -----------------------------------------------------------------------------
+ */
+#include "splinterdb/public_platform.h"
+#include "splinterdb/default_data_config.h"
+#include "platform.h"
+#include "skiplist.h"
+#include "config.h"
+#include "unit_tests.h"
+#include "ctest.h" // This is required for all test-case files.
+
+#define SKIPLIST_TEST_NUM_KEYS    20000
+#define SKIPLIST_TEST_NUM_THREADS 4
+
+typedef struct skiplist_test_params {
+   skiplist *sl;
+   uint64    num_keys;
+   uint64    num_unique;
+   uint64    thread_no;
+} skiplist_test_params;
+
+static key
+skiplist_test_key(uint64 i, uint64 *buf);
+
+static message
+skiplist_test_message(uint64 i, uint64 *buf);
+
+static void
+skiplist_test_insert_thread(void *arg);
+
+/*
+ * Global data declaration macro:
+ */
+CTEST_DATA(skiplist)
+{
+   platform_heap_id hid;
+   bool             use_shmem;
+   data_config      data_cfg;
+   skiplist         sl;
+};
+
+// Optional setup function for suite, called before every test in suite
+CTEST_SETUP(skiplist)
+{
+   data->use_shmem = config_parse_use_shmem(Ctest_argc, (char **)Ctest_argv);
+
+   platform_status rc = platform_heap_create(
+      platform_get_module_id(), (1 * GiB), data->use_shmem, &data->hid);
+   platform_assert_status_ok(rc);
+
+   default_data_config_init(sizeof(uint64), &data->data_cfg);
+   skiplist_init(&data->sl, data->hid, &data->data_cfg);
+}
+
+// Optional teardown function for suite, called after every test in suite
+CTEST_TEARDOWN(skiplist)
+{
+   skiplist_deinit(&data->sl);
+   platform_heap_destroy(&data->hid);
+}
+
+/*
+ * Keys inserted in a scrambled order can all be found, and iterate back in
+ * sorted order.
+ */
+CTEST2(skiplist, test_insert_lookup)
+{
+   uint64 key_buf, msg_buf;
+   for (uint64 i = 0; i < SKIPLIST_TEST_NUM_KEYS; i++) {
+      uint64 k = (i * 7919) % SKIPLIST_TEST_NUM_KEYS;
+      uint64 generation;
+      bool32 was_unique;
+      platform_status rc = skiplist_insert(&data->sl,
+                                           skiplist_test_key(k, &key_buf),
+                                           skiplist_test_message(k, &msg_buf),
+                                           &generation,
+                                           &was_unique,
+                                           NULL);
+      ASSERT_TRUE(SUCCESS(rc));
+      ASSERT_TRUE(was_unique);
+   }
+   ASSERT_EQUAL(SKIPLIST_TEST_NUM_KEYS, skiplist_num_tuples(&data->sl));
+   ASSERT_TRUE(skiplist_verify(&data->sl));
+
+   merge_accumulator result;
+   merge_accumulator_init(&result, data->hid);
+   for (uint64 i = 0; i < SKIPLIST_TEST_NUM_KEYS + 10; i++) {
+      bool32 found;
+      merge_accumulator_set_to_null(&result);
+      platform_status rc = skiplist_lookup_and_merge(
+         &data->sl, skiplist_test_key(i, &key_buf), &result, &found);
+      ASSERT_TRUE(SUCCESS(rc));
+      ASSERT_EQUAL(i < SKIPLIST_TEST_NUM_KEYS, found);
+      if (found) {
+         ASSERT_EQUAL(MESSAGE_TYPE_INSERT, result.type);
+         ASSERT_EQUAL(sizeof(uint64), merge_accumulator_length(&result));
+         ASSERT_EQUAL(i, *(uint64 *)merge_accumulator_data(&result));
+      }
+   }
+   merge_accumulator_deinit(&result);
+
+   skiplist_iterator itor;
+   skiplist_iterator_init(&data->sl,
+                          &itor,
+                          NEGATIVE_INFINITY_KEY,
+                          POSITIVE_INFINITY_KEY,
+                          NEGATIVE_INFINITY_KEY,
+                          greater_than_or_equal);
+   uint64 count = 0;
+   while (iterator_can_curr(&itor.super)) {
+      key     curr_key;
+      message msg;
+      iterator_curr(&itor.super, &curr_key, &msg);
+      ASSERT_EQUAL(0,
+                   data_key_compare(&data->data_cfg,
+                                    curr_key,
+                                    skiplist_test_key(count, &key_buf)));
+      count++;
+      iterator_next(&itor.super);
+   }
+   ASSERT_EQUAL(SKIPLIST_TEST_NUM_KEYS, count);
+   skiplist_iterator_deinit(&itor);
+}
+
+/*
+ * Inserting an existing key replaces its message without adding a node, and
+ * reports an increasing generation.
+ */
+CTEST2(skiplist, test_overwrite)
+{
+   uint64 key_buf, msg_buf;
+   uint64 generation;
+   bool32 was_unique;
+   key    k = skiplist_test_key(42, &key_buf);
+
+   for (uint64 i = 0; i < 10; i++) {
+      platform_status rc = skiplist_insert(&data->sl,
+                                           k,
+                                           skiplist_test_message(i, &msg_buf),
+                                           &generation,
+                                           &was_unique,
+                                           NULL);
+      ASSERT_TRUE(SUCCESS(rc));
+      ASSERT_EQUAL(i == 0, was_unique);
+      ASSERT_EQUAL(i, generation);
+   }
+   platform_status rc = skiplist_insert(&data->sl,
+                                        k,
+                                        DELETE_MESSAGE,
+                                        &generation,
+                                        &was_unique,
+                                        NULL);
+   ASSERT_TRUE(SUCCESS(rc));
+   ASSERT_EQUAL(1, skiplist_num_tuples(&data->sl));
+
+   merge_accumulator result;
+   merge_accumulator_init(&result, data->hid);
+   bool32 found;
+   rc = skiplist_lookup_and_merge(&data->sl, k, &result, &found);
+   ASSERT_TRUE(SUCCESS(rc));
+   ASSERT_TRUE(found);
+   ASSERT_EQUAL(MESSAGE_TYPE_DELETE, result.type);
+   merge_accumulator_deinit(&result);
+}
+
+/*
+ * A bounded iterator stays within [min_key, max_key), starts where asked,
+ * and can turn around at either end.
+ */
+CTEST2(skiplist, test_iterator_bounds)
+{
+   uint64 key_buf, msg_buf, min_buf, max_buf, start_buf;
+   uint64 generation;
+   bool32 was_unique;
+   // even keys 0, 2, ..., 198
+   for (uint64 i = 0; i < 100; i++) {
+      platform_status rc = skiplist_insert(&data->sl,
+                                           skiplist_test_key(2 * i, &key_buf),
+                                           skiplist_test_message(i, &msg_buf),
+                                           &generation,
+                                           &was_unique,
+                                           NULL);
+      ASSERT_TRUE(SUCCESS(rc));
+   }
+
+   key min_key = skiplist_test_key(10, &min_buf);
+   key max_key = skiplist_test_key(20, &max_buf);
+
+   skiplist_iterator itor;
+   key               curr_key;
+   message           msg;
+
+   // start between keys, going up: 12 14 16 18
+   skiplist_iterator_init(&data->sl,
+                          &itor,
+                          min_key,
+                          max_key,
+                          skiplist_test_key(11, &start_buf),
+                          greater_than_or_equal);
+   for (uint64 expected = 12; expected < 20; expected += 2) {
+      ASSERT_TRUE(iterator_can_curr(&itor.super));
+      iterator_curr(&itor.super, &curr_key, &msg);
+      ASSERT_EQUAL(0,
+                   data_key_compare(&data->data_cfg,
+                                    curr_key,
+                                    skiplist_test_key(expected, &key_buf)));
+      iterator_next(&itor.super);
+   }
+   ASSERT_FALSE(iterator_can_next(&itor.super));
+   ASSERT_TRUE(iterator_can_prev(&itor.super));
+
+   // turn around at the end: 18 ... 10
+   for (int64 expected = 18; expected >= 10; expected -= 2) {
+      iterator_prev(&itor.super);
+      ASSERT_TRUE(iterator_can_curr(&itor.super));
+      iterator_curr(&itor.super, &curr_key, &msg);
+      ASSERT_EQUAL(0,
+                   data_key_compare(&data->data_cfg,
+                                    curr_key,
+                                    skiplist_test_key(expected, &key_buf)));
+   }
+   iterator_prev(&itor.super);
+   ASSERT_FALSE(iterator_can_prev(&itor.super));
+   ASSERT_TRUE(iterator_can_next(&itor.super));
+   iterator_next(&itor.super);
+   iterator_curr(&itor.super, &curr_key, &msg);
+   ASSERT_EQUAL(
+      0,
+      data_key_compare(
+         &data->data_cfg, curr_key, skiplist_test_key(10, &key_buf)));
+   skiplist_iterator_deinit(&itor);
+
+   // start at the exclusive max going down
+   skiplist_iterator_init(
+      &data->sl, &itor, min_key, max_key, max_key, less_than_or_equal);
+   ASSERT_TRUE(iterator_can_curr(&itor.super));
+   iterator_curr(&itor.super, &curr_key, &msg);
+   ASSERT_EQUAL(
+      0,
+      data_key_compare(
+         &data->data_cfg, curr_key, skiplist_test_key(18, &key_buf)));
+   skiplist_iterator_deinit(&itor);
+
+   // an empty range
+   skiplist_iterator_init(&data->sl,
+                          &itor,
+                          skiplist_test_key(11, &min_buf),
+                          skiplist_test_key(12, &max_buf),
+                          skiplist_test_key(11, &start_buf),
+                          greater_than_or_equal);
+   ASSERT_FALSE(iterator_can_curr(&itor.super));
+   skiplist_iterator_deinit(&itor);
+}
+
+/*
+ * Threads inserting the same keys at once leave one node per key.
+ */
+CTEST2(skiplist, test_concurrent_inserts)
+{
+   platform_thread      threads[SKIPLIST_TEST_NUM_THREADS];
+   skiplist_test_params params[SKIPLIST_TEST_NUM_THREADS];
+
+   for (uint64 i = 0; i < SKIPLIST_TEST_NUM_THREADS; i++) {
+      params[i].sl         = &data->sl;
+      params[i].num_keys   = SKIPLIST_TEST_NUM_KEYS;
+      params[i].num_unique = 0;
+      params[i].thread_no  = i;
+      platform_status rc   = platform_thread_create(&threads[i],
+                                                  FALSE,
+                                                  skiplist_test_insert_thread,
+                                                  &params[i],
+                                                  data->hid);
+      ASSERT_TRUE(SUCCESS(rc));
+   }
+
+   uint64 num_unique = 0;
+   for (uint64 i = 0; i < SKIPLIST_TEST_NUM_THREADS; i++) {
+      platform_thread_join(threads[i]);
+      num_unique += params[i].num_unique;
+   }
+
+   ASSERT_EQUAL(SKIPLIST_TEST_NUM_KEYS, num_unique);
+   ASSERT_EQUAL(SKIPLIST_TEST_NUM_KEYS, skiplist_num_tuples(&data->sl));
+   ASSERT_TRUE(skiplist_verify(&data->sl));
+}
+
+/*
+ * A reset skiplist is empty and reuses its arena.
+ */
+CTEST2(skiplist, test_reset)
+{
+   uint64 key_buf, msg_buf;
+   uint64 generation;
+   bool32 was_unique;
+   uint64 bytes = 0;
+
+   for (uint64 round = 0; round < 3; round++) {
+      for (uint64 i = 0; i < SKIPLIST_TEST_NUM_KEYS; i++) {
+         platform_status rc =
+            skiplist_insert(&data->sl,
+                            skiplist_test_key(i, &key_buf),
+                            skiplist_test_message(i + round, &msg_buf),
+                            &generation,
+                            &was_unique,
+                            NULL);
+         ASSERT_TRUE(SUCCESS(rc));
+         ASSERT_TRUE(was_unique);
+      }
+      ASSERT_TRUE(skiplist_verify(&data->sl));
+      if (round == 0) {
+         bytes = skiplist_bytes(&data->sl);
+      } else {
+         ASSERT_EQUAL(bytes, skiplist_bytes(&data->sl));
+      }
+      skiplist_reset(&data->sl);
+      ASSERT_EQUAL(0, skiplist_num_tuples(&data->sl));
+      ASSERT_EQUAL(0, skiplist_bytes(&data->sl));
+   }
+}
+
+/*
+ * Big-endian, so that the default data config's memcmp order is numeric.
+ */
+static key
+skiplist_test_key(uint64 i, uint64 *buf)
+{
+   *buf = __builtin_bswap64(i);
+   return key_create(sizeof(*buf), buf);
+}
+
+static message
+skiplist_test_message(uint64 i, uint64 *buf)
+{
+   *buf = i;
+   return message_create(MESSAGE_TYPE_INSERT, slice_create(sizeof(*buf), buf));
+}
+
+/*
+ * Each thread inserts all the keys, starting at a different point.
+ */
+static void
+skiplist_test_insert_thread(void *arg)
+{
+   skiplist_test_params *params = (skiplist_test_params *)arg;
+   uint64                key_buf, msg_buf;
+   uint64                start = params->thread_no * 1237;
+
+   for (uint64 i = 0; i < params->num_keys; i++) {
+      uint64 k = (start + i) % params->num_keys;
+      uint64 generation;
+      bool32 was_unique;
+      platform_status rc = skiplist_insert(params->sl,
+                                           skiplist_test_key(k, &key_buf),
+                                           skiplist_test_message(k, &msg_buf),
+                                           &generation,
+                                           &was_unique,
+                                           NULL);
+      platform_assert_status_ok(rc);
+      if (was_unique) {
+         params->num_unique++;
+      }
+   }
+}
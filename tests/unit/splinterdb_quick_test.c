@@ -27,6 +27,7 @@
 #include <stdlib.h> // Needed for system calls; e.g. free
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "splinterdb/splinterdb.h"
 #include "splinterdb/data.h"
@@ -38,6 +39,9 @@
 #include "ctest.h" // This is required for all test-case files.
 #include "btree.h" // for MAX_INLINE_MESSAGE_SIZE
 #include "config.h"
+#include "trunk.h"
+#include "clockcache.h"
+#include "splinterdb_tests_private.h"
 
 #define TEST_MAX_KEY_SIZE 13
 
@@ -52,6 +56,26 @@ static const char val_fmt[] = "val-%04x";
 #define TEST_INSERT_KEY_LENGTH (KEY_FMT_LENGTH + 1)
 #define TEST_INSERT_VAL_LENGTH (VAL_FMT_LENGTH + 1)
 
+// Tuples generated by bulk_load_next
+static const char bulk_load_key_fmt[] = "key-%08x";
+#define BULK_LOAD_KEY_LENGTH   (12 + 1)
+#define BULK_LOAD_VALUE_LENGTH (200)
+
+typedef struct {
+   int  next; // key of the next tuple
+   int  step;
+   int  count; // of tuples returned
+   int  num_tuples;
+   char key[BULK_LOAD_KEY_LENGTH];
+   char value[BULK_LOAD_VALUE_LENGTH];
+} bulk_load_source;
+
+typedef struct {
+   splinterdb       *kvsb;
+   bulk_load_source *source;
+   int               rc;
+} bulk_load_thread;
+
 // Function Prototypes
 static void
 create_default_cfg(splinterdb_config *out_cfg, data_config *default_data_cfg);
@@ -77,6 +101,38 @@ test_two_step_iterator(splinterdb *kvsb,
 static int
 custom_key_comparator(const data_config *cfg, slice key1, slice key2);
 
+static void
+fixed_width_key(uint64 k, uint64 key_size, char *key);
+
+static void
+bulk_load_source_init(bulk_load_source *source,
+                      int               start,
+                      int               num_tuples,
+                      int               step);
+
+static _Bool
+bulk_load_next(void *arg, slice *key, slice *value);
+
+static uint64
+bulk_load_value(int i, char value[static BULK_LOAD_VALUE_LENGTH]);
+
+static _Bool
+bulk_load_next_oversized(void *arg, slice *key, slice *value);
+
+static void *
+bulk_load_worker(void *arg);
+
+static int
+check_bulk_loaded_keys(splinterdb *kvsb,
+                       int         start,
+                       int         end,
+                       int         overwrite_every);
+
+static void
+may_contain_page_gets(trunk_handle *spl,
+                      uint64       *branch_pages,
+                      uint64       *filter_pages);
+
 typedef struct {
    data_config super;
    uint64      num_comparisons;
@@ -688,6 +744,285 @@ CTEST2(splinterdb_quick, test_iterator_prev_and_next)
          data->kvsb, start_key, num_inserts, minkey, start_i, hop_amt));
 }
 
+/*
+ * Same as test_iterator_prev_and_next, with memtables held in skiplists and
+ * small enough that the inserts fill several of them, so iterators see
+ * skiplist memtables, memtables packed into branches, and the trunk.
+ */
+CTEST2(splinterdb_quick, test_skiplist_memtable)
+{
+   splinterdb_close(&data->kvsb);
+   data->cfg.memtable_skiplist = TRUE;
+   data->cfg.memtable_capacity = 256 * KiB;
+   int rc                      = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   const int num_inserts = 1 << 14;
+   int       minkey      = 1;
+   int       hop_amt     = 3;
+   rc = insert_keys(data->kvsb, minkey, num_inserts, hop_amt);
+   ASSERT_EQUAL(0, rc);
+
+   ASSERT_EQUAL(0,
+                test_two_step_iterator(
+                   data->kvsb, NULL_SLICE, num_inserts, minkey, 0, hop_amt));
+
+   char key[TEST_INSERT_KEY_LENGTH];
+   int  start_i = num_inserts / 2;
+   snprintf(key, sizeof(key), key_fmt, hop_amt * start_i + minkey - 1);
+   slice start_key = slice_create(strlen(key), key);
+   ASSERT_EQUAL(
+      0,
+      test_two_step_iterator(
+         data->kvsb, start_key, num_inserts, minkey, start_i, hop_amt));
+
+   splinterdb_lookup_result result;
+   splinterdb_lookup_result_init(data->kvsb, &result, 0, NULL);
+   for (int i = 0; i < num_inserts; i += 97) {
+      memset(key, 0, sizeof(key));
+      snprintf(key, sizeof(key), key_fmt, hop_amt * i + minkey);
+      rc = splinterdb_lookup(
+         data->kvsb, slice_create(sizeof(key), key), &result);
+      ASSERT_EQUAL(0, rc);
+      ASSERT_TRUE(splinterdb_lookup_found(&result), "key=%s", key);
+   }
+   splinterdb_lookup_result_deinit(&result);
+}
+
+/*
+ * Point lookups with memtable hash indexes, for both memtable engines.
+ * Present keys are spread over the live memtable, compacted memtables and
+ * the trunk; absent keys fall between them.
+ */
+CTEST2(splinterdb_quick, test_memtable_hash_index)
+{
+   const int num_inserts = 1 << 14;
+   int       minkey      = 1;
+   int       hop_amt     = 3;
+
+   for (int skiplist = 0; skiplist < 2; skiplist++) {
+      splinterdb_close(&data->kvsb);
+      data->cfg.memtable_skiplist   = skiplist;
+      data->cfg.memtable_hash_index = TRUE;
+      data->cfg.memtable_capacity   = MiB;
+      int rc = splinterdb_create(&data->cfg, &data->kvsb);
+      ASSERT_EQUAL(0, rc);
+
+      rc = insert_keys(data->kvsb, minkey, num_inserts, hop_amt);
+      ASSERT_EQUAL(0, rc);
+
+      splinterdb_lookup_result result;
+      splinterdb_lookup_result_init(data->kvsb, &result, 0, NULL);
+      for (int k = 0; k < hop_amt * num_inserts; k++) {
+         char key[TEST_INSERT_KEY_LENGTH] = {0};
+         snprintf(key, sizeof(key), key_fmt, k);
+         rc = splinterdb_lookup(
+            data->kvsb, slice_create(sizeof(key), key), &result);
+         ASSERT_EQUAL(0, rc);
+         bool32 present = minkey <= k && (k - minkey) % hop_amt == 0;
+         ASSERT_EQUAL(present,
+                      splinterdb_lookup_found(&result),
+                      "skiplist=%d key=%s",
+                      skiplist,
+                      key);
+      }
+      splinterdb_lookup_result_deinit(&result);
+   }
+}
+
+/*
+ * Inserts with fingerprints sized by height, with lookups of missing keys in
+ * between for the sizes to be drawn from. Every height that built filters
+ * gets a size within 4 bits of the configured one.
+ */
+CTEST2(splinterdb_quick, test_filter_adaptive_fingerprints)
+{
+   const int    num_keys = 1 << 18;
+   const uint64 stride   = 40503; // odd, so i * stride mod num_keys permutes
+
+   splinterdb_close(&data->kvsb);
+   data->cfg.filter_adaptive_fingerprints = TRUE;
+   data->cfg.memtable_capacity            = MiB;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   splinterdb_lookup_result result;
+   splinterdb_lookup_result_init(data->kvsb, &result, 0, NULL);
+   char key_data[TEST_MAX_KEY_SIZE];
+   for (int i = 0; i < num_keys; i++) {
+      int k = (i * stride) % num_keys;
+      snprintf(key_data, sizeof(key_data), key_fmt, 2 * k);
+      slice key = slice_create(strlen(key_data), key_data);
+      rc        = splinterdb_insert(data->kvsb, key, key);
+      ASSERT_EQUAL(0, rc);
+
+      snprintf(key_data, sizeof(key_data), key_fmt, 2 * k + 1);
+      key = slice_create(strlen(key_data), key_data);
+      rc  = splinterdb_lookup(data->kvsb, key, &result);
+      ASSERT_EQUAL(0, rc);
+   }
+   splinterdb_lookup_result_deinit(&result);
+
+   trunk_handle *spl = (trunk_handle *)splinterdb_get_trunk_handle(data->kvsb);
+   uint32        base_size = spl->cfg.filter_cfg.fingerprint_size;
+   uint32        num_sized = 0;
+   for (uint64 height = 0; height < TRUNK_MAX_HEIGHT; height++) {
+      uint32 size = spl->fingerprint_size[height];
+      if (size != 0) {
+         num_sized++;
+         ASSERT_TRUE(base_size <= size + 4 && size <= base_size + 4,
+                     "height=%lu size=%u base_size=%u",
+                     height,
+                     size,
+                     base_size);
+      }
+   }
+   ASSERT_NOT_EQUAL(0, num_sized);
+}
+
+/*
+ * Filter-only existence checks read filter pages but no branch page. Keys
+ * that are present are always reported as maybe present. A key whose delete
+ * is in the active memtable is definitely absent.
+ */
+CTEST2(splinterdb_quick, test_may_contain)
+{
+   const int num_keys = 1 << 17;
+
+   splinterdb_close(&data->kvsb);
+   data->cfg.memtable_capacity = MiB;
+   data->cfg.use_stats         = TRUE;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   char key_data[TEST_MAX_KEY_SIZE];
+   for (int i = 0; i < num_keys; i++) {
+      snprintf(key_data, sizeof(key_data), key_fmt, 2 * i);
+      slice key = slice_create(strlen(key_data), key_data);
+      rc        = splinterdb_insert(data->kvsb, key, key);
+      ASSERT_EQUAL(0, rc);
+   }
+
+   trunk_handle *spl = (trunk_handle *)splinterdb_get_trunk_handle(data->kvsb);
+   uint64        branch_pages_before, filter_pages_before;
+   may_contain_page_gets(spl, &branch_pages_before, &filter_pages_before);
+
+   int false_positives = 0;
+   for (int k = 0; k < 2 * num_keys; k += 7) {
+      snprintf(key_data, sizeof(key_data), key_fmt, k);
+      slice key = slice_create(strlen(key_data), key_data);
+      if (k % 2 == 0) {
+         ASSERT_TRUE(
+            splinterdb_may_contain(data->kvsb, key), "key=%s", key_data);
+      } else if (splinterdb_may_contain(data->kvsb, key)) {
+         false_positives++;
+      }
+   }
+
+   uint64 branch_pages_after, filter_pages_after;
+   may_contain_page_gets(spl, &branch_pages_after, &filter_pages_after);
+   ASSERT_EQUAL(branch_pages_before, branch_pages_after);
+   ASSERT_TRUE(filter_pages_before < filter_pages_after);
+   ASSERT_TRUE(false_positives < num_keys / 70,
+               "false_positives=%d",
+               false_positives);
+
+   snprintf(key_data, sizeof(key_data), key_fmt, 2 * (num_keys - 1));
+   slice key = slice_create(strlen(key_data), key_data);
+   rc        = splinterdb_delete(data->kvsb, key);
+   ASSERT_EQUAL(0, rc);
+   ASSERT_FALSE(splinterdb_may_contain(data->kvsb, key));
+}
+
+/*
+ * Inserts in random order with background threads, so compactions of index
+ * nodes output to several pivots and hand some of their filters to tasks.
+ */
+CTEST2(splinterdb_quick, test_parallel_filter_builds)
+{
+   const int    num_keys = 1 << 19;
+   const uint64 stride   = 400009; // odd, so i * stride mod num_keys permutes
+
+   splinterdb_close(&data->kvsb);
+   data->cfg.memtable_capacity       = MiB;
+   data->cfg.num_normal_bg_threads   = 4;
+   data->cfg.num_memtable_bg_threads = 1;
+   data->cfg.use_stats               = TRUE;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   char key_data[TEST_MAX_KEY_SIZE];
+   for (int i = 0; i < num_keys; i++) {
+      int k = (i * stride) % num_keys;
+      snprintf(key_data, sizeof(key_data), key_fmt, k);
+      slice key = slice_create(strlen(key_data), key_data);
+      rc        = splinterdb_insert(data->kvsb, key, key);
+      ASSERT_EQUAL(0, rc);
+   }
+   task_wait_for_completion(
+      (task_system *)splinterdb_get_task_system_handle(data->kvsb));
+
+   trunk_handle *spl = (trunk_handle *)splinterdb_get_trunk_handle(data->kvsb);
+   uint64        num_built          = 0;
+   uint64        num_built_by_tasks = 0;
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      for (uint64 height = 0; height < TRUNK_MAX_HEIGHT; height++) {
+         num_built += spl->stats[tid].filters_built[height];
+         num_built_by_tasks += spl->stats[tid].filters_built_by_tasks[height];
+      }
+   }
+   ASSERT_NOT_EQUAL(0, num_built_by_tasks);
+   ASSERT_TRUE(num_built_by_tasks <= num_built,
+               "num_built_by_tasks=%lu num_built=%lu",
+               num_built_by_tasks,
+               num_built);
+   ASSERT_TRUE(trunk_verify_tree(spl));
+}
+
+/*
+ * Inserts in random order with background threads and small enough root
+ * nodes that flushes bring large bundles to the leaves, whose compactions
+ * pack in partitions and stitch the partitions into one branch. The
+ * packing and stitching themselves are tested in btree_stress_test.
+ */
+CTEST2(splinterdb_quick, test_partitioned_compactions)
+{
+   const int    num_keys = 1 << 19;
+   const uint64 stride   = 400009; // odd, so i * stride mod num_keys permutes
+
+   splinterdb_close(&data->kvsb);
+   data->cfg.memtable_capacity       = 2 * MiB;
+   data->cfg.max_branches_per_node   = 4;
+   data->cfg.num_normal_bg_threads   = 3;
+   data->cfg.num_memtable_bg_threads = 1;
+   data->cfg.use_stats               = TRUE;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   char key_data[TEST_MAX_KEY_SIZE];
+   for (int i = 0; i < num_keys; i++) {
+      int k = (i * stride) % num_keys;
+      snprintf(key_data, sizeof(key_data), key_fmt, k);
+      slice key = slice_create(strlen(key_data), key_data);
+      rc        = splinterdb_insert(data->kvsb, key, key);
+      ASSERT_EQUAL(0, rc);
+   }
+
+   // the compactions of the last flushes may still be running
+   task_wait_for_completion(
+      (task_system *)splinterdb_get_task_system_handle(data->kvsb));
+
+   trunk_handle *spl = (trunk_handle *)splinterdb_get_trunk_handle(data->kvsb);
+   uint64        num_partitioned = 0;
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      for (uint64 height = 0; height < TRUNK_MAX_HEIGHT; height++) {
+         num_partitioned += spl->stats[tid].compactions_partitioned[height];
+      }
+   }
+   ASSERT_NOT_EQUAL(0, num_partitioned);
+   ASSERT_TRUE(trunk_verify_tree(spl));
+}
+
 /*
  * Test case to verify the interfaces to close() and reopen() a KVS work
  * as expected. After reopening the KVS, we should be able to retrieve data
@@ -866,6 +1201,80 @@ CTEST2(splinterdb_quick, test_iterator_custom_comparator)
    }
 }
 
+/*
+ * With fixed-width keys, keys sort as big-endian integers, the user's
+ * comparator is never called, and keys of other sizes are rejected.
+ */
+CTEST2(splinterdb_quick, test_fixed_width_keys)
+{
+   const uint64 num_inserts = 100000;
+
+   for (uint64 key_size = 8; key_size <= 16; key_size += 8) {
+      splinterdb_close(&data->kvsb);
+      data->default_data_cfg.super.key_compare    = custom_key_comparator;
+      data->default_data_cfg.super.fixed_key_size = key_size;
+      data->default_data_cfg.super.max_key_size   = key_size;
+      data->default_data_cfg.num_comparisons      = 0;
+      data->cfg.memtable_capacity                 = MiB;
+      int rc = splinterdb_create(&data->cfg, &data->kvsb);
+      ASSERT_EQUAL(0, rc);
+
+      // a bijection on uint64, so the keys are distinct and out of order
+      char key[16];
+      char value[8] = "value";
+      for (uint64 i = 0; i < num_inserts; i++) {
+         fixed_width_key(i * 0x9e3779b97f4a7c15ULL, key_size, key);
+         rc = splinterdb_insert(data->kvsb,
+                                slice_create(key_size, key),
+                                slice_create(sizeof(value), value));
+         ASSERT_EQUAL(0, rc);
+      }
+
+      rc = splinterdb_insert(data->kvsb,
+                             slice_create(key_size - 1, key),
+                             slice_create(sizeof(value), value));
+      ASSERT_NOT_EQUAL(0, rc);
+
+      splinterdb_iterator *it = NULL;
+      rc = splinterdb_iterator_init(data->kvsb, &it, NULL_SLICE);
+      ASSERT_EQUAL(0, rc);
+      uint64 count = 0;
+      char   prev_key[16];
+      for (; splinterdb_iterator_valid(it); splinterdb_iterator_next(it)) {
+         slice curr_key, curr_value;
+         splinterdb_iterator_get_current(it, &curr_key, &curr_value);
+         ASSERT_EQUAL(key_size, slice_length(curr_key));
+         if (count != 0) {
+            ASSERT_TRUE(memcmp(prev_key, slice_data(curr_key), key_size) < 0);
+         }
+         memcpy(prev_key, slice_data(curr_key), key_size);
+         count++;
+      }
+      ASSERT_EQUAL(0, splinterdb_iterator_status(it));
+      splinterdb_iterator_deinit(it);
+      ASSERT_EQUAL(num_inserts, count);
+
+      splinterdb_lookup_result result;
+      splinterdb_lookup_result_init(data->kvsb, &result, 0, NULL);
+      for (uint64 i = 0; i < num_inserts; i += 7) {
+         fixed_width_key(i * 0x9e3779b97f4a7c15ULL, key_size, key);
+         rc = splinterdb_lookup(
+            data->kvsb, slice_create(key_size, key), &result);
+         ASSERT_EQUAL(0, rc);
+         ASSERT_TRUE(splinterdb_lookup_found(&result), "i=%lu", i);
+
+         fixed_width_key(i * 0x9e3779b97f4a7c15ULL + 1, key_size, key);
+         rc = splinterdb_lookup(
+            data->kvsb, slice_create(key_size, key), &result);
+         ASSERT_EQUAL(0, rc);
+         ASSERT_FALSE(splinterdb_lookup_found(&result), "i=%lu", i);
+      }
+      splinterdb_lookup_result_deinit(&result);
+
+      ASSERT_EQUAL(0, data->default_data_cfg.num_comparisons);
+   }
+}
+
 /*
  * Test case to verify that iterator interfaces work correctly.
  * Prior to fix for issue #419, this test case would fail with an assertion
@@ -954,6 +1363,330 @@ CTEST2(splinterdb_quick, test_splinterdb_create_w_all_background_threads)
    ASSERT_EQUAL(0, rv);
 }
 
+/*
+ * ------------------------------------------------------------------------
+ * Test that with a value log, values of all sizes, including ones longer
+ * than a page, can be inserted, looked up and iterated over, also after
+ * the database is re-opened.
+ * ------------------------------------------------------------------------
+ */
+CTEST2(splinterdb_quick, test_value_log_large_values)
+{
+   splinterdb_close(&data->kvsb);
+   data->cfg.value_log_threshold = 64;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   const size_t value_lens[] = {0, 10, 64, 65, 1000, 3 * 4096 + 17, 60000};
+   const int    num_values   = ARRAY_SIZE(value_lens);
+   const size_t max_len      = value_lens[num_values - 1];
+   char        *expected;
+   expected = TYPED_ARRAY_MALLOC(data->cfg.heap_id, expected, max_len);
+   ASSERT_TRUE(expected != NULL);
+
+   char key_data[TEST_INSERT_KEY_LENGTH];
+   for (int i = 0; i < num_values; i++) {
+      snprintf(key_data, sizeof(key_data), key_fmt, i);
+      memset(expected, 'a' + i, value_lens[i]);
+      rc = splinterdb_insert(data->kvsb,
+                             slice_create(strlen(key_data), key_data),
+                             slice_create(value_lens[i], expected));
+      ASSERT_EQUAL(
+         0, rc, "Insert of value of length %lu failed", value_lens[i]);
+   }
+
+   // Updates cannot be merged with values in the value log
+   rc = splinterdb_update(
+      data->kvsb, slice_create(strlen(key_data), key_data), NULL_SLICE);
+   ASSERT_EQUAL(EINVAL, rc);
+
+   for (int pass = 0; pass < 2; pass++) {
+      splinterdb_lookup_result result;
+      splinterdb_lookup_result_init(data->kvsb, &result, 0, NULL);
+      for (int i = 0; i < num_values; i++) {
+         snprintf(key_data, sizeof(key_data), key_fmt, i);
+         memset(expected, 'a' + i, value_lens[i]);
+         rc = splinterdb_lookup(
+            data->kvsb, slice_create(strlen(key_data), key_data), &result);
+         ASSERT_EQUAL(0, rc);
+         ASSERT_TRUE(splinterdb_lookup_found(&result));
+
+         slice value;
+         rc = splinterdb_lookup_result_value(&result, &value);
+         ASSERT_EQUAL(0, rc);
+         ASSERT_EQUAL(value_lens[i], slice_length(value));
+         ASSERT_EQUAL(0, memcmp(expected, slice_data(value), value_lens[i]));
+      }
+      splinterdb_lookup_result_deinit(&result);
+
+      splinterdb_iterator *it = NULL;
+      rc = splinterdb_iterator_init(data->kvsb, &it, NULL_SLICE);
+      ASSERT_EQUAL(0, rc);
+      int i = 0;
+      for (; splinterdb_iterator_valid(it); splinterdb_iterator_next(it)) {
+         slice key, value;
+         splinterdb_iterator_get_current(it, &key, &value);
+         memset(expected, 'a' + i, value_lens[i]);
+         ASSERT_EQUAL(value_lens[i], slice_length(value));
+         ASSERT_EQUAL(0, memcmp(expected, slice_data(value), value_lens[i]));
+         i++;
+      }
+      ASSERT_EQUAL(0, splinterdb_iterator_status(it));
+      ASSERT_EQUAL(num_values, i);
+      splinterdb_iterator_deinit(it);
+
+      splinterdb_close(&data->kvsb);
+      rc = splinterdb_open(&data->cfg, &data->kvsb);
+      ASSERT_EQUAL(0, rc);
+   }
+
+   // The device must be opened with the value log it was created with
+   splinterdb_close(&data->kvsb);
+   data->cfg.value_log_threshold = 0;
+   rc = splinterdb_open(&data->cfg, &data->kvsb);
+   ASSERT_NOT_EQUAL(0, rc);
+
+   platform_free(data->cfg.heap_id, expected);
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * Test that the value log is collected as its values are overwritten:
+ * overwriting a few keys with several times the disk size in values must
+ * not run out of space, and both the latest values and values which were
+ * never overwritten, and so were relocated, must survive collection.
+ * ------------------------------------------------------------------------
+ */
+CTEST2(splinterdb_quick, test_value_log_gc_reclaims_space)
+{
+   splinterdb_close(&data->kvsb);
+   data->cfg.value_log_threshold = 64;
+   data->cfg.memtable_capacity   = 4 * Mega;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   const int    num_keys  = 1000;
+   const size_t value_len = 4000;
+   const int    num_writes =
+      4 * data->cfg.disk_size / value_len; // several times the disk size
+   char *value_data;
+   value_data = TYPED_ARRAY_MALLOC(data->cfg.heap_id, value_data, value_len);
+   ASSERT_TRUE(value_data != NULL);
+
+   // Keys num_keys and up are only written once, before the others
+   char key_data[TEST_INSERT_KEY_LENGTH];
+   for (int i = num_keys; i < 2 * num_keys; i++) {
+      snprintf(key_data, sizeof(key_data), key_fmt, i);
+      memset(value_data, 'a' + i % 26, value_len);
+      snprintf(value_data, value_len, "%d", i);
+      rc = splinterdb_insert(data->kvsb,
+                             slice_create(strlen(key_data), key_data),
+                             slice_create(value_len, value_data));
+      ASSERT_EQUAL(0, rc);
+   }
+   for (int i = 0; i < num_writes; i++) {
+      snprintf(key_data, sizeof(key_data), key_fmt, i % num_keys);
+      memset(value_data, 'a' + i % 26, value_len);
+      snprintf(value_data, value_len, "%d", i);
+      rc = splinterdb_insert(data->kvsb,
+                             slice_create(strlen(key_data), key_data),
+                             slice_create(value_len, value_data));
+      ASSERT_EQUAL(0, rc, "Insert %d of %d failed", i, num_writes);
+   }
+
+   splinterdb_lookup_result result;
+   splinterdb_lookup_result_init(data->kvsb, &result, 0, NULL);
+   for (int k = 0; k < 2 * num_keys; k++) {
+      // i is the last write to key k
+      int i = k;
+      if (k < num_keys) {
+         i += (num_writes - 1 - k) / num_keys * num_keys;
+      }
+      snprintf(key_data, sizeof(key_data), key_fmt, k);
+      memset(value_data, 'a' + i % 26, value_len);
+      snprintf(value_data, value_len, "%d", i);
+      rc = splinterdb_lookup(
+         data->kvsb, slice_create(strlen(key_data), key_data), &result);
+      ASSERT_EQUAL(0, rc);
+      ASSERT_TRUE(splinterdb_lookup_found(&result));
+
+      slice value;
+      rc = splinterdb_lookup_result_value(&result, &value);
+      ASSERT_EQUAL(0, rc);
+      ASSERT_EQUAL(value_len, slice_length(value));
+      ASSERT_EQUAL(0, memcmp(value_data, slice_data(value), value_len));
+   }
+   splinterdb_lookup_result_deinit(&result);
+
+   platform_free(data->cfg.heap_id, value_data);
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * Test that a bulk load of many branches' worth of tuples can be read back
+ * with lookups and iterators, across a reopen, and that later inserts
+ * override loaded values.
+ * ------------------------------------------------------------------------
+ */
+CTEST2(splinterdb_quick, test_bulk_load)
+{
+   splinterdb_close(&data->kvsb);
+   data->cfg.memtable_capacity = Mega;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   const int         num_keys = 50000;
+   bulk_load_source *source;
+   source = TYPED_MALLOC(data->cfg.heap_id, source);
+   ASSERT_TRUE(source != NULL);
+   bulk_load_source_init(source, 0, num_keys, 1);
+   rc = splinterdb_bulk_load(data->kvsb, bulk_load_next, source);
+   ASSERT_EQUAL(0, rc);
+   ASSERT_EQUAL(num_keys, source->count);
+
+   // Overwrite every 1000th key after the load
+   char key_data[BULK_LOAD_KEY_LENGTH];
+   for (int i = 0; i < num_keys; i += 1000) {
+      snprintf(key_data, sizeof(key_data), bulk_load_key_fmt, i);
+      rc = splinterdb_insert(data->kvsb,
+                             slice_create(strlen(key_data), key_data),
+                             slice_create(strlen("new"), "new"));
+      ASSERT_EQUAL(0, rc);
+   }
+
+   for (int pass = 0; pass < 2; pass++) {
+      rc = check_bulk_loaded_keys(data->kvsb, 0, num_keys, 1000);
+      ASSERT_EQUAL(0, rc);
+
+      splinterdb_iterator *it = NULL;
+      rc = splinterdb_iterator_init(data->kvsb, &it, NULL_SLICE);
+      ASSERT_EQUAL(0, rc);
+      int i = 0;
+      for (; splinterdb_iterator_valid(it); splinterdb_iterator_next(it)) {
+         slice key, value;
+         splinterdb_iterator_get_current(it, &key, &value);
+         snprintf(key_data, sizeof(key_data), bulk_load_key_fmt, i);
+         ASSERT_EQUAL(strlen(key_data), slice_length(key));
+         ASSERT_EQUAL(0, memcmp(key_data, slice_data(key), slice_length(key)));
+         i++;
+      }
+      ASSERT_EQUAL(0, splinterdb_iterator_status(it));
+      ASSERT_EQUAL(num_keys, i);
+      splinterdb_iterator_deinit(it);
+
+      splinterdb_close(&data->kvsb);
+      rc = splinterdb_open(&data->cfg, &data->kvsb);
+      ASSERT_EQUAL(0, rc);
+   }
+
+   platform_free(data->cfg.heap_id, source);
+}
+
+/*
+ * Test that threads can bulk load disjoint key ranges concurrently.
+ */
+CTEST2(splinterdb_quick, test_bulk_load_parallel)
+{
+   splinterdb_close(&data->kvsb);
+   data->cfg.memtable_capacity = Mega;
+   int rc = splinterdb_create(&data->cfg, &data->kvsb);
+   ASSERT_EQUAL(0, rc);
+
+   const int         num_threads     = 4;
+   const int         keys_per_thread = 5000;
+   bulk_load_source *sources;
+   bulk_load_thread *params;
+   pthread_t        *threads;
+   sources = TYPED_ARRAY_MALLOC(data->cfg.heap_id, sources, num_threads);
+   params  = TYPED_ARRAY_MALLOC(data->cfg.heap_id, params, num_threads);
+   threads = TYPED_ARRAY_MALLOC(data->cfg.heap_id, threads, num_threads);
+   ASSERT_TRUE(sources != NULL && params != NULL && threads != NULL);
+
+   for (int t = 0; t < num_threads; t++) {
+      bulk_load_source_init(
+         &sources[t], t * keys_per_thread, keys_per_thread, 1);
+      params[t] = (bulk_load_thread){.kvsb = data->kvsb, .source = &sources[t]};
+      rc = pthread_create(&threads[t], NULL, bulk_load_worker, &params[t]);
+      ASSERT_EQUAL(0, rc);
+   }
+   for (int t = 0; t < num_threads; t++) {
+      rc = pthread_join(threads[t], NULL);
+      ASSERT_EQUAL(0, rc);
+      ASSERT_EQUAL(0, params[t].rc);
+   }
+
+   for (int t = 0; t < num_threads; t++) {
+      rc = check_bulk_loaded_keys(
+         data->kvsb, t * keys_per_thread, (t + 1) * keys_per_thread, 0);
+      ASSERT_EQUAL(0, rc);
+   }
+
+   platform_free(data->cfg.heap_id, threads);
+   platform_free(data->cfg.heap_id, params);
+   platform_free(data->cfg.heap_id, sources);
+}
+
+/*
+ * Test that a bulk load stops at the first key out of order, having loaded
+ * the keys before it.
+ */
+CTEST2(splinterdb_quick, test_bulk_load_unsorted)
+{
+   bulk_load_source *source;
+   source = TYPED_MALLOC(data->cfg.heap_id, source);
+   ASSERT_TRUE(source != NULL);
+
+   // the same key twice
+   bulk_load_source_init(source, 7, 10, 0);
+   int rc = splinterdb_bulk_load(data->kvsb, bulk_load_next, source);
+   ASSERT_EQUAL(EINVAL, rc);
+   ASSERT_EQUAL(2, source->count);
+
+   // the tuple before the error was loaded
+   rc = check_bulk_loaded_keys(data->kvsb, 7, 8, 0);
+   ASSERT_EQUAL(0, rc);
+
+   // decreasing keys
+   bulk_load_source_init(source, 100, 10, -1);
+   rc = splinterdb_bulk_load(data->kvsb, bulk_load_next, source);
+   ASSERT_EQUAL(EINVAL, rc);
+   ASSERT_EQUAL(2, source->count);
+
+   platform_free(data->cfg.heap_id, source);
+}
+
+/*
+ * Test that a bulk load stops at a value too long for a branch leaf, having
+ * loaded the tuples before it, rather than failing to pack it.
+ */
+CTEST2(splinterdb_quick, test_bulk_load_oversized_value)
+{
+   bulk_load_source *source;
+   source = TYPED_MALLOC(data->cfg.heap_id, source);
+   ASSERT_TRUE(source != NULL);
+
+   // the second tuple's value is too long
+   bulk_load_source_init(source, 7, 3, 1);
+   int rc = splinterdb_bulk_load(data->kvsb, bulk_load_next_oversized, source);
+   ASSERT_EQUAL(EINVAL, rc);
+   ASSERT_EQUAL(2, source->count);
+
+   rc = check_bulk_loaded_keys(data->kvsb, 7, 8, 0);
+   ASSERT_EQUAL(0, rc);
+
+   splinterdb_lookup_result result;
+   splinterdb_lookup_result_init(data->kvsb, &result, 0, NULL);
+   char key_data[BULK_LOAD_KEY_LENGTH];
+   snprintf(key_data, sizeof(key_data), bulk_load_key_fmt, 8);
+   rc = splinterdb_lookup(
+      data->kvsb, slice_create(strlen(key_data), key_data), &result);
+   ASSERT_EQUAL(0, rc);
+   ASSERT_FALSE(splinterdb_lookup_found(&result));
+   splinterdb_lookup_result_deinit(&result);
+
+   platform_free(data->cfg.heap_id, source);
+}
+
 /*
  * ********************************************************************************
  * Define minions and helper functions here, after all test cases are
@@ -1130,6 +1863,21 @@ test_two_step_iterator(splinterdb *kvsb,
    return rc;
 }
 
+/*
+ * Encodes k as a big-endian key of key_size (8 or 16) bytes. 16-byte keys
+ * are followed by ~k, so they differ in both words.
+ */
+static void
+fixed_width_key(uint64 k, uint64 key_size, char *key)
+{
+   for (int i = 0; i < 8; i++) {
+      key[i] = (char)(k >> (56 - 8 * i));
+      if (key_size == 16) {
+         key[8 + i] = (char)(~k >> (56 - 8 * i));
+      }
+   }
+}
+
 // A user-specified spy comparator
 static int
 custom_key_comparator(const data_config *cfg, slice key1, slice key2)
@@ -1145,3 +1893,139 @@ custom_key_comparator(const data_config *cfg, slice key1, slice key2)
    ccfg->num_comparisons += 1;
    return r;
 }
+
+/*
+ * A splinterdb_bulk_load source of num_tuples tuples, whose keys are the
+ * formatted integers start, start + step, ...
+ */
+static void
+bulk_load_source_init(bulk_load_source *source,
+                      int               start,
+                      int               num_tuples,
+                      int               step)
+{
+   ZERO_CONTENTS(source);
+   source->next       = start;
+   source->step       = step;
+   source->num_tuples = num_tuples;
+}
+
+static _Bool
+bulk_load_next(void *arg, slice *key, slice *value)
+{
+   bulk_load_source *source = arg;
+   if (source->count == source->num_tuples) {
+      return FALSE;
+   }
+   int i = source->next;
+   snprintf(source->key, sizeof(source->key), bulk_load_key_fmt, i);
+   *key   = slice_create(strlen(source->key), source->key);
+   *value = slice_create(bulk_load_value(i, source->value), source->value);
+   source->next += source->step;
+   source->count++;
+   return TRUE;
+}
+
+/*
+ * Like bulk_load_next, except that the second tuple's value is longer than a
+ * branch leaf can hold.
+ */
+static _Bool
+bulk_load_next_oversized(void *arg, slice *key, slice *value)
+{
+   static char oversized[MAX_INLINE_MESSAGE_SIZE(LAIO_DEFAULT_PAGE_SIZE) + 1];
+   bulk_load_source *source = arg;
+   if (!bulk_load_next(arg, key, value)) {
+      return FALSE;
+   }
+   if (source->count == 2) {
+      memset(oversized, 'z', sizeof(oversized));
+      *value = slice_create(sizeof(oversized), oversized);
+   }
+   return TRUE;
+}
+
+/*
+ * Formats the value loaded for key i into value, returning its length.
+ */
+static uint64
+bulk_load_value(int i, char value[static BULK_LOAD_VALUE_LENGTH])
+{
+   uint64 half   = BULK_LOAD_VALUE_LENGTH / 2;
+   uint64 length = half + i % half;
+   memset(value, 'a' + i % 26, length);
+   memcpy(value, &i, sizeof(i));
+   return length;
+}
+
+static void *
+bulk_load_worker(void *arg)
+{
+   bulk_load_thread *params = arg;
+   splinterdb_register_thread(params->kvsb);
+   params->rc =
+      splinterdb_bulk_load(params->kvsb, bulk_load_next, params->source);
+   splinterdb_deregister_thread(params->kvsb);
+   return NULL;
+}
+
+/*
+ * Checks the values of the keys in [start, end) loaded by bulk_load_next,
+ * except that every overwrite_every-th key, if not 0, has the value "new".
+ *
+ * Returns: Return code: rc == 0 => success; anything else => failure
+ */
+static int
+check_bulk_loaded_keys(splinterdb *kvsb,
+                       int         start,
+                       int         end,
+                       int         overwrite_every)
+{
+   char key_data[BULK_LOAD_KEY_LENGTH];
+   char expected[BULK_LOAD_VALUE_LENGTH];
+
+   splinterdb_lookup_result result;
+   splinterdb_lookup_result_init(kvsb, &result, 0, NULL);
+   for (int i = start; i < end; i++) {
+      snprintf(key_data, sizeof(key_data), bulk_load_key_fmt, i);
+      slice user_key = slice_create(strlen(key_data), key_data);
+      int   rc       = splinterdb_lookup(kvsb, user_key, &result);
+      ASSERT_EQUAL(0, rc);
+      ASSERT_TRUE(splinterdb_lookup_found(&result), "key %d not found", i);
+
+      slice value;
+      rc = splinterdb_lookup_result_value(&result, &value);
+      ASSERT_EQUAL(0, rc);
+      if (overwrite_every != 0 && i % overwrite_every == 0) {
+         ASSERT_EQUAL(strlen("new"), slice_length(value));
+         ASSERT_EQUAL(0, memcmp("new", slice_data(value), strlen("new")));
+      } else {
+         uint64 length = bulk_load_value(i, expected);
+         ASSERT_EQUAL(length, slice_length(value));
+         ASSERT_EQUAL(0, memcmp(expected, slice_data(value), length));
+      }
+   }
+   splinterdb_lookup_result_deinit(&result);
+   return 0;
+}
+
+/*
+ * The number of branch and filter pages spl's cache has been asked for, hits
+ * and misses, over all threads.
+ */
+static void
+may_contain_page_gets(trunk_handle *spl,
+                      uint64       *branch_pages,
+                      uint64       *filter_pages)
+{
+   clockcache *cc = (clockcache *)spl->cc;
+   *branch_pages  = 0;
+   *filter_pages  = 0;
+   for (threadid tid = 0; tid < MAX_THREADS; tid++) {
+      cache_stats *stats = &cc->stats[tid];
+      *branch_pages += stats->cache_hits[PAGE_TYPE_BRANCH]
+                       + stats->cache_misses[PAGE_TYPE_BRANCH];
+      *filter_pages += stats->cache_hits[PAGE_TYPE_FILTER]
+                       + stats->cache_misses[PAGE_TYPE_FILTER];
+   }
+}